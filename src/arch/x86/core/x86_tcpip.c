@@ -32,7 +32,19 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <limits.h>
 #include <ipxe/tcpip.h>
 
-extern char x86_tcpip_loop_end[];
+/** Size of a native machine word, as an assembler expression */
+#if ULONG_MAX > 0xffffffffUL
+#define X86_TCPIP_WORD "8"
+#else
+#define X86_TCPIP_WORD "4"
+#endif
+
+/** Number of native machine words processed in each main loop iteration */
+#define X86_TCPIP_UNROLL 16
+
+/** Add native machine word at specified index within main loop */
+#define X86_TCPIP_ADC( index ) \
+	"adc " #index "*" X86_TCPIP_WORD "(%1), %0\n\t"
 
 /**
  * Calculate continued TCP/IP checkum
@@ -47,14 +59,12 @@ uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 	unsigned long sum = ( ( ~partial ) & 0xffff );
 	unsigned long initial_word_count;
 	unsigned long loop_count;
-	unsigned long loop_partial_count;
+	unsigned long loop_word_count;
 	unsigned long final_word_count;
 	unsigned long final_byte;
 	unsigned long discard_S;
 	unsigned long discard_c;
 	unsigned long discard_a;
-	unsigned long discard_r1;
-	unsigned long discard_r2;
 
 	/* Calculate number of initial 16-bit words required to bring
 	 * the main loop into alignment.  (We don't care about the
@@ -70,13 +80,15 @@ uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 	len -= ( initial_word_count * 2 );
 
 	/* Calculate number of iterations of the main loop.  This loop
-	 * processes native machine words (32-bit or 64-bit), and is
-	 * unrolled 16 times.  We calculate an overall iteration
-	 * count, and a starting point for the first iteration.
+	 * processes native machine words (32-bit or 64-bit) using
+	 * add-with-carry instructions, and is unrolled 16 times.
+	 * Any remaining native machine words are processed one at a
+	 * time.
 	 */
-	loop_count = ( len / ( sizeof ( sum ) * 16 ) );
-	loop_partial_count =
-		( ( len % ( sizeof ( sum ) * 16 ) ) / sizeof ( sum ) );
+	loop_count = ( len / ( sizeof ( sum ) * X86_TCPIP_UNROLL ) );
+	loop_word_count =
+		( ( len % ( sizeof ( sum ) * X86_TCPIP_UNROLL ) ) /
+		  sizeof ( sum ) );
 
 	/* Calculate number of 16-bit words remaining after the main
 	 * loop completes.
@@ -86,61 +98,64 @@ uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 	/* Calculate whether or not a final byte remains at the end */
 	final_byte = ( len & 1 );
 
-	/* Calculate the checksum */
-	__asm__ ( /* Calculate position at which to jump into the
-		   * unrolled loop.
-		   */
-		  "imul $( -x86_tcpip_loop_step_size ), %4\n\t"
-		  "add %5, %4\n\t"
-
-		  /* Clear carry flag before starting checksumming */
+	/* Calculate the checksum.  Note that "lea" and "dec" do not
+	 * modify the carry flag, and so the carry chain is preserved
+	 * throughout.  (The "lods" and "loop" instructions are
+	 * avoided since both are microcoded on many CPUs.)
+	 */
+	__asm__ ( /* Clear carry flag before starting checksumming */
 		  "clc\n\t"
 
 		  /* Checksum initial words */
 		  "jmp 2f\n\t"
 		  "\n1:\n\t"
-		  "lodsw\n\t"
-		  "adcw %w2, %w0\n\t"
+		  "adcw (%1), %w0\n\t"
+		  "lea 2(%1), %1\n\t"
 		  "\n2:\n\t"
-		  "loop 1b\n\t"
-
-		  /* Main "lods;adc" loop, unrolled x16 */
-		  "mov %12, %3\n\t"
-		  "jmp *%4\n\t"
-		  "\nx86_tcpip_loop_start:\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "lods%z2\n\tadc %2, %0\n\t"
-		  "\nx86_tcpip_loop_end:\n\t"
-		  "loop x86_tcpip_loop_start\n\t"
-		  ".equ x86_tcpip_loop_step_size, "
-		  "  ( ( x86_tcpip_loop_end - x86_tcpip_loop_start ) >> 4 )\n\t"
-
-		  /* Checksum remaining whole words */
-		  "mov %13, %3\n\t"
+		  "dec %3\n\t"
+		  "jnz 1b\n\t"
+
+		  /* Main loop, unrolled x16 */
+		  "mov %6, %3\n\t"
 		  "jmp 2f\n\t"
 		  "\n1:\n\t"
-		  "lodsw\n\t"
-		  "adcw %w2, %w0\n\t"
+		  X86_TCPIP_ADC ( 0 ) X86_TCPIP_ADC ( 1 )
+		  X86_TCPIP_ADC ( 2 ) X86_TCPIP_ADC ( 3 )
+		  X86_TCPIP_ADC ( 4 ) X86_TCPIP_ADC ( 5 )
+		  X86_TCPIP_ADC ( 6 ) X86_TCPIP_ADC ( 7 )
+		  X86_TCPIP_ADC ( 8 ) X86_TCPIP_ADC ( 9 )
+		  X86_TCPIP_ADC ( 10 ) X86_TCPIP_ADC ( 11 )
+		  X86_TCPIP_ADC ( 12 ) X86_TCPIP_ADC ( 13 )
+		  X86_TCPIP_ADC ( 14 ) X86_TCPIP_ADC ( 15 )
+		  "lea 16*" X86_TCPIP_WORD "(%1), %1\n\t"
+		  "\n2:\n\t"
+		  "dec %3\n\t"
+		  "jnz 1b\n\t"
+
+		  /* Checksum remaining native machine words */
+		  "mov %7, %3\n\t"
+		  "jmp 2f\n\t"
+		  "\n1:\n\t"
+		  "adc (%1), %0\n\t"
+		  "lea " X86_TCPIP_WORD "(%1), %1\n\t"
+		  "\n2:\n\t"
+		  "dec %3\n\t"
+		  "jnz 1b\n\t"
+
+		  /* Checksum remaining 16-bit words */
+		  "mov %8, %3\n\t"
+		  "jmp 2f\n\t"
+		  "\n1:\n\t"
+		  "adcw (%1), %w0\n\t"
+		  "lea 2(%1), %1\n\t"
 		  "\n2:\n\t"
-		  "loop 1b\n\t"
+		  "dec %3\n\t"
+		  "jnz 1b\n\t"
 
 		  /* Checksum final byte if applicable */
-		  "mov %14, %3\n\t"
-		  "loop 1f\n\t"
+		  "mov %9, %3\n\t"
+		  "dec %3\n\t"
+		  "jnz 1f\n\t"
 		  "adcb (%1), %b0\n\t"
 		  "adcb $0, %h0\n\t"
 		  "\n1:\n\t"
@@ -162,12 +177,11 @@ uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 		  "adcw $0, %w0\n\t"
 
 		  : "=&Q" ( sum ), "=&S" ( discard_S ), "=&a" ( discard_a ),
-		    "=&c" ( discard_c ), "=&r" ( discard_r1 ),
-		    "=&r" ( discard_r2 )
-		  : "0" ( sum ), "1" ( data ), "2" ( 0 ),
-		    "3" ( initial_word_count + 1 ), "4" ( loop_partial_count ),
-		    "5" ( x86_tcpip_loop_end ), "g" ( loop_count + 1 ),
-		    "g" ( final_word_count + 1 ), "g" ( final_byte ) );
+		    "=&c" ( discard_c )
+		  : "0" ( sum ), "1" ( data ), "g" ( loop_count + 1 ),
+		    "g" ( loop_word_count + 1 ), "g" ( final_word_count + 1 ),
+		    "g" ( final_byte ), "3" ( initial_word_count + 1 ),
+		    "2" ( 0 ) );
 
 	return ( ~sum & 0xffff );
 }
@@ -11,6 +11,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #ifdef UMALLOC_MEMTOP
 #define UMALLOC_PREFIX_memtop
+
+/** External memory is allocated as a stack
+ *
+ * Freed memory can be reused only once all memory allocated after it
+ * has also been freed, so any long-lived allocation will strand all
+ * external memory allocated after it.
+ */
+#define UMALLOC_STACKLIKE 1
+
 #else
 #define UMALLOC_PREFIX_memtop __memtop_
 #endif
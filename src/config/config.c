@@ -272,6 +272,18 @@ REQUIRE_OBJECT ( ipstat_cmd );
 #ifdef PROFSTAT_CMD
 REQUIRE_OBJECT ( profstat_cmd );
 #endif
+#ifdef MEMSTAT_CMD
+REQUIRE_OBJECT ( memstat_cmd );
+#endif
+#ifdef TRACE_CMD
+REQUIRE_OBJECT ( trace_cmd );
+#ifdef TRACE_LINUX
+REQUIRE_OBJECT ( linux_trace );
+#endif
+#endif
+#ifdef TCPSTAT_CMD
+REQUIRE_OBJECT ( tcpstat_cmd );
+#endif
 #ifdef NTP_CMD
 REQUIRE_OBJECT ( ntp_cmd );
 #endif
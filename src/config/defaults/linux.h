@@ -20,6 +20,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define TIME_LINUX
 #define REBOOT_NULL
 #define PCIAPI_LINUX
+#define TRACE_LINUX
 
 #define DRIVERS_LINUX
 
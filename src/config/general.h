@@ -29,6 +29,27 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define BANNER_TIMEOUT		20
 #define ROM_BANNER_TIMEOUT	( 2 * BANNER_TIMEOUT )
 
+/*
+ * Network receive budget
+ *
+ * This controls the maximum number of received packets that will be
+ * processed from each network device within a single poll of the
+ * networking stack.  Any remaining packets are processed in the next
+ * poll, allowing other processes to run.
+ */
+#define NET_RX_BUDGET		32
+
+/*
+ * Receive coalescing limit
+ *
+ * This controls the maximum number of consecutive in-order TCP
+ * segments of the same connection (already waiting on a network
+ * device's receive queue) that will be coalesced into a single
+ * packet before being passed to the network stack.  Set to 1 to
+ * disable receive coalescing.
+ */
+#define NET_RX_COALESCE		16
+
 /*
  * Network protocols
  *
@@ -149,6 +170,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 //#define CONSOLE_CMD		/* Console command */
 //#define IPSTAT_CMD		/* IP statistics commands */
 //#define PROFSTAT_CMD		/* Profiling commands */
+//#define MEMSTAT_CMD		/* Memory usage commands */
+//#define TRACE_CMD		/* Binary event trace commands */
+//#define TCPSTAT_CMD		/* TCP statistics commands */
 //#define NTP_CMD		/* NTP commands */
 
 /*
@@ -0,0 +1,21 @@
+#ifndef CONFIG_TRACE_H
+#define CONFIG_TRACE_H
+
+/** @file
+ *
+ * Event tracing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <config/defaults.h>
+
+/* Number of events held in the binary trace ring (must be a power of
+ * two, or zero to disable tracing)
+ */
+#define TRACE_RING_SIZE 0
+
+#include <config/local/trace.h>
+
+#endif /* CONFIG_TRACE_H */
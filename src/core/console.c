@@ -97,8 +97,13 @@ int getchar ( void ) {
 		 * power dissipation of a modern CPU considerably, and also
 		 * makes Etherboot waiting for user interaction waste a lot
 		 * less CPU time in a VMware session.
+		 *
+		 * Don't doze while background tasks still have work
+		 * to do, since that would throttle them to the timer
+		 * interrupt rate.
 		 */
-		cpu_nap();
+		if ( process_idle() )
+			cpu_nap();
 
 		/* Keep processing background tasks while we wait for
 		 * input.
@@ -88,6 +88,11 @@ static void downloader_finished ( struct downloader *downloader, int rc ) {
 			 downloader->image->name, strerror ( rc ) );
 	}
 
+	/* Release any spare buffer capacity (ignoring errors, since
+	 * the untrimmed buffer remains valid).
+	 */
+	xferbuf_trim ( &downloader->buffer );
+
 	/* Update image length */
 	downloader->image->len = downloader->buffer.len;
 
@@ -51,7 +51,8 @@ static int getchar_timeout ( unsigned long timeout ) {
 		step();
 		if ( iskey() )
 			return getchar();
-		cpu_nap();
+		if ( process_idle() )
+			cpu_nap();
 	}
 
 	return -1;
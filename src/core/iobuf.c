@@ -27,6 +27,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <strings.h>
 #include <errno.h>
 #include <ipxe/malloc.h>
+#include <ipxe/refcnt.h>
 #include <ipxe/iobuf.h>
 
 /** @file
@@ -35,6 +36,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** List of I/O buffer recycling pools */
+static LIST_HEAD ( iob_pools );
+
 /**
  * Allocate I/O buffer with specified alignment and offset
  *
@@ -112,6 +116,9 @@ struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
 	/* Populate descriptor */
 	iobuf->head = iobuf->data = iobuf->tail = data;
 	iobuf->end = ( data + len );
+	iobuf->pool = NULL;
+	iobuf->flags = 0;
+	INIT_LIST_HEAD ( &iobuf->chain );
 
 	return iobuf;
 }
@@ -137,12 +144,47 @@ struct io_buffer * alloc_iob ( size_t len ) {
 	return alloc_iob_raw ( len, len, 0 );
 }
 
+/**
+ * Return I/O buffer to its recycling pool
+ *
+ * @v iobuf	I/O buffer
+ * @ret recycled	I/O buffer was recycled
+ */
+static int iob_pool_recycle ( struct io_buffer *iobuf ) {
+	struct io_buffer_pool *pool = iobuf->pool;
+	struct refcnt *refcnt = pool->refcnt;
+
+	/* Detach from pool.  Any buffer that is not retained will be
+	 * freed as a normal I/O buffer.
+	 */
+	iobuf->pool = NULL;
+
+	/* Retain buffer if it is still usable and the pool has space */
+	if ( ( pool->count >= pool->max ) ||
+	     ( ( size_t ) ( iobuf->end - iobuf->head ) < pool->len ) ) {
+		ref_put ( refcnt );
+		return 0;
+	}
+	iobuf->data = iobuf->tail = iobuf->head;
+	iobuf->flags = 0;
+	list_add ( &iobuf->list, &pool->free );
+	pool->count++;
+
+	/* Drop reference to containing object.  This may cause the
+	 * pool (and this buffer) to be freed.
+	 */
+	ref_put ( refcnt );
+	return 1;
+}
+
 /**
  * Free I/O buffer
  *
  * @v iobuf	I/O buffer
  */
 void free_iob ( struct io_buffer *iobuf ) {
+	struct io_buffer *frag;
+	struct io_buffer *tmp;
 	size_t len;
 
 	/* Allow free_iob(NULL) to be valid */
@@ -154,6 +196,16 @@ void free_iob ( struct io_buffer *iobuf ) {
 	assert ( iobuf->data <= iobuf->tail );
 	assert ( iobuf->tail <= iobuf->end );
 
+	/* Free any coalesced continuation buffers */
+	list_for_each_entry_safe ( frag, tmp, &iobuf->chain, list ) {
+		list_del ( &frag->list );
+		free_iob ( frag );
+	}
+
+	/* Return to recycling pool, if applicable */
+	if ( iobuf->pool && iob_pool_recycle ( iobuf ) )
+		return;
+
 	/* Free buffer */
 	len = ( iobuf->end - iobuf->head );
 	if ( iobuf->end == iobuf ) {
@@ -259,3 +311,255 @@ struct io_buffer * iob_split ( struct io_buffer *iobuf, size_t len ) {
 	iob_pull ( iobuf, len );
 	return split;
 }
+
+/**
+ * Skip over any exhausted I/O buffers
+ *
+ * @v cursor		I/O buffer cursor
+ */
+static void iob_cursor_normalise ( struct iob_cursor *cursor ) {
+	struct io_buffer *iobuf;
+
+	while ( ( iobuf = cursor->iobuf ) &&
+		( cursor->offset >= iob_len ( iobuf ) ) ) {
+		assert ( cursor->offset == iob_len ( iobuf ) );
+		cursor->offset = 0;
+		cursor->iobuf = ( list_is_last ( &iobuf->list, cursor->list ) ?
+				  NULL : list_entry ( iobuf->list.next,
+						      struct io_buffer, list ));
+	}
+}
+
+/**
+ * Initialise I/O buffer cursor
+ *
+ * @v cursor		I/O buffer cursor
+ * @v list		List of I/O buffers
+ */
+void iob_cursor_init ( struct iob_cursor *cursor, struct list_head *list ) {
+
+	cursor->list = list;
+	cursor->iobuf = list_first_entry ( list, struct io_buffer, list );
+	cursor->offset = 0;
+	iob_cursor_normalise ( cursor );
+}
+
+/**
+ * Calculate length of data remaining after I/O buffer cursor
+ *
+ * @v cursor		I/O buffer cursor
+ * @ret len		Length of remaining data
+ */
+size_t iob_cursor_len ( struct iob_cursor *cursor ) {
+	struct io_buffer *iobuf = cursor->iobuf;
+	size_t len;
+
+	if ( ! iobuf )
+		return 0;
+	len = ( iob_len ( iobuf ) - cursor->offset );
+	list_for_each_entry_continue ( iobuf, cursor->list, list )
+		len += iob_len ( iobuf );
+	return len;
+}
+
+/**
+ * Copy data from I/O buffer cursor
+ *
+ * @v cursor		I/O buffer cursor
+ * @v data		Data buffer, or NULL to discard data
+ * @v len		Length of data
+ * @ret rc		Return status code
+ *
+ * The cursor is advanced past the copied data.
+ */
+int iob_cursor_copy ( struct iob_cursor *cursor, void *data, size_t len ) {
+	struct io_buffer *iobuf;
+	size_t frag_len;
+
+	while ( len ) {
+
+		/* Fail if we have run out of data */
+		iobuf = cursor->iobuf;
+		if ( ! iobuf )
+			return -ERANGE;
+
+		/* Copy as much as possible from the current buffer */
+		frag_len = ( iob_len ( iobuf ) - cursor->offset );
+		if ( frag_len > len )
+			frag_len = len;
+		if ( data ) {
+			memcpy ( data, ( iobuf->data + cursor->offset ),
+				 frag_len );
+			data += frag_len;
+		}
+		len -= frag_len;
+
+		/* Advance cursor */
+		cursor->offset += frag_len;
+		iob_cursor_normalise ( cursor );
+	}
+
+	return 0;
+}
+
+/**
+ * Obtain contiguous data from I/O buffer cursor
+ *
+ * @v cursor		I/O buffer cursor
+ * @v len		Length of data
+ * @v data		Contiguous data to fill in
+ * @v copy		Temporary copy to fill in, or NULL if no copy made
+ * @ret rc		Return status code
+ *
+ * The cursor is advanced past the data.  If the data lies entirely
+ * within a single I/O buffer, then a pointer into that buffer is
+ * returned.  Otherwise, the data is copied into a temporary buffer,
+ * which the caller must eventually free().
+ */
+int iob_cursor_pull ( struct iob_cursor *cursor, size_t len,
+		      const void **data, void **copy ) {
+	struct io_buffer *iobuf = cursor->iobuf;
+	int rc;
+
+	/* Use data in place if possible */
+	*copy = NULL;
+	if ( ( ! len ) ||
+	     ( iobuf && ( len <= ( iob_len ( iobuf ) - cursor->offset ) ) ) ) {
+		*data = ( iobuf ? ( iobuf->data + cursor->offset ) : NULL );
+		cursor->offset += len;
+		iob_cursor_normalise ( cursor );
+		return 0;
+	}
+
+	/* Otherwise, copy to a temporary buffer */
+	*copy = malloc ( len );
+	if ( ! *copy )
+		return -ENOMEM;
+	if ( ( rc = iob_cursor_copy ( cursor, *copy, len ) ) != 0 ) {
+		free ( *copy );
+		*copy = NULL;
+		return rc;
+	}
+	*data = *copy;
+
+	return 0;
+}
+
+/**
+ * Initialise I/O buffer recycling pool
+ *
+ * @v pool		I/O buffer pool
+ * @v max		Maximum number of recycled I/O buffers
+ * @v refcnt		Containing object reference counter, or NULL
+ */
+void iob_pool_init ( struct io_buffer_pool *pool, unsigned int max,
+		     struct refcnt *refcnt ) {
+
+	INIT_LIST_HEAD ( &pool->free );
+	pool->refcnt = refcnt;
+	pool->max = max;
+	list_add_tail ( &pool->list, &iob_pools );
+}
+
+/**
+ * Allocate I/O buffer from recycling pool
+ *
+ * @v pool		I/O buffer pool
+ * @v len		Required length of buffer
+ * @ret iobuf		I/O buffer, or NULL if none available
+ *
+ * The I/O buffer will be aligned as for alloc_iob().  All buffers
+ * allocated from a pool are expected to have the same length; any
+ * change in length will cause all recycled buffers to be discarded.
+ */
+struct io_buffer * iob_pool_alloc ( struct io_buffer_pool *pool,
+				    size_t len ) {
+	struct io_buffer *iobuf;
+
+	/* Discard recycled buffers if length has changed */
+	if ( len != pool->len ) {
+		iob_pool_flush ( pool );
+		pool->len = len;
+	}
+
+	/* Reuse a recycled buffer, if available */
+	iobuf = list_first_entry ( &pool->free, struct io_buffer, list );
+	if ( iobuf ) {
+		list_del ( &iobuf->list );
+		pool->count--;
+		pool->hits++;
+	} else {
+		iobuf = alloc_iob ( len );
+		if ( ! iobuf )
+			return NULL;
+		pool->misses++;
+	}
+
+	/* Attach to pool */
+	assert ( iob_tailroom ( iobuf ) >= len );
+	iobuf->pool = pool;
+	ref_get ( pool->refcnt );
+
+	return iobuf;
+}
+
+/**
+ * Discard one recycled I/O buffer
+ *
+ * @v pool		I/O buffer pool
+ * @ret discarded	A recycled I/O buffer was discarded
+ */
+static int iob_pool_shrink ( struct io_buffer_pool *pool ) {
+	struct io_buffer *iobuf;
+
+	iobuf = list_first_entry ( &pool->free, struct io_buffer, list );
+	if ( ! iobuf )
+		return 0;
+	list_del ( &iobuf->list );
+	pool->count--;
+	free_iob ( iobuf );
+	return 1;
+}
+
+/**
+ * Discard all recycled I/O buffers
+ *
+ * @v pool		I/O buffer pool
+ */
+void iob_pool_flush ( struct io_buffer_pool *pool ) {
+
+	while ( iob_pool_shrink ( pool ) ) {}
+	assert ( pool->count == 0 );
+}
+
+/**
+ * Shut down I/O buffer recycling pool
+ *
+ * @v pool		I/O buffer pool
+ */
+void iob_pool_fini ( struct io_buffer_pool *pool ) {
+
+	iob_pool_flush ( pool );
+	list_del ( &pool->list );
+}
+
+/**
+ * Discard some recycled I/O buffers
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int iob_pool_discard ( void ) {
+	struct io_buffer_pool *pool;
+	unsigned int discarded = 0;
+
+	/* Try to drop one recycled buffer from each pool */
+	list_for_each_entry ( pool, &iob_pools, list )
+		discarded += iob_pool_shrink ( pool );
+
+	return discarded;
+}
+
+/** I/O buffer recycling pool cache discarder */
+struct cache_discarder iob_pool_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = iob_pool_discard,
+};
@@ -31,6 +31,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/list.h>
 #include <ipxe/init.h>
 #include <ipxe/refcnt.h>
+#include <ipxe/umalloc.h>
 #include <ipxe/malloc.h>
 #include <valgrind/memcheck.h>
 
@@ -93,16 +94,136 @@ static LIST_HEAD ( free_blocks );
 /** Total amount of free memory */
 size_t freemem;
 
+/** Total amount of heap memory */
+size_t heapmem;
+
+/** Maximum amount of heap memory ever in use */
+size_t maxusedmem;
+
+/** Number of dynamically allocated heap regions */
+unsigned int heapregions;
+
 /**
- * Heap size
+ * Initial heap size
  *
- * Currently fixed at 512kB.
+ * The heap is initially populated from a fixed 512kB static array,
+ * and is grown on demand using external memory (unless the external
+ * memory allocator is stack-like).
  */
 #define HEAP_SIZE ( 512 * 1024 )
 
 /** The heap itself */
 static char heap[HEAP_SIZE] __attribute__ (( aligned ( __alignof__(void *) )));
 
+/** Minimum size of a dynamically allocated heap region */
+#define HEAP_REGION_MIN_SIZE ( 256 * 1024 )
+
+/** Granularity of dynamically allocated heap regions */
+#define HEAP_REGION_ALIGN 4096
+
+/** A dynamically allocated heap region
+ *
+ * This header is placed at the start of each region.  Since the
+ * header is never free, it also prevents free blocks from being
+ * merged across the boundaries of adjacent regions.
+ */
+struct heap_region {
+	/** List of heap regions */
+	struct list_head list;
+	/** External memory */
+	userptr_t data;
+	/** Total length of external memory */
+	size_t len;
+	/** Start of usable memory */
+	void *start;
+	/** Length of usable memory */
+	size_t size;
+};
+
+/** List of dynamically allocated heap regions */
+static LIST_HEAD ( heap_regions );
+
+/** Idle (entirely free) heap region retained for reuse, if any */
+static struct heap_region *heap_idle;
+
+/**
+ * Maximum slab object size (log2)
+ *
+ * Allocations of up to this size are satisfied from fixed-size
+ * object caches rather than from the free block list.
+ */
+#define SLAB_MAX_LOG2 11
+
+/** Maximum slab object size */
+#define SLAB_MAX_SIZE ( 1UL << SLAB_MAX_LOG2 )
+
+/** Slab page size (log2) */
+#define SLAB_PAGE_LOG2 14
+
+/** Slab page size */
+#define SLAB_PAGE_SIZE ( 1UL << SLAB_PAGE_LOG2 )
+
+/** Number of completely empty slab pages to retain per cache */
+#define SLAB_SPARE_PAGES 1
+
+/** Number of slab page hash buckets */
+#define SLAB_HASH_SIZE 64
+
+/** A free slab object */
+struct slab_object {
+	/** Next free object in this page */
+	struct slab_object *next;
+};
+
+/** A slab page
+ *
+ * A slab page is a physically aligned block obtained from the free
+ * block list, and is carved up into objects of a single size class.
+ * The page descriptor lives at the start of the page, and objects
+ * are laid out from the first object-aligned offset after it.
+ */
+struct slab_page {
+	/** List of pages within cache */
+	struct list_head list;
+	/** Next page in the same hash bucket */
+	struct slab_page *hash;
+	/** Free object list */
+	struct slab_object *free;
+	/** First never-allocated object */
+	void *unused;
+	/** Number of objects currently allocated */
+	unsigned int used;
+	/** Object size (log2) */
+	unsigned int log2;
+};
+
+/** A slab object cache */
+struct slab_cache {
+	/** Pages with at least one free object
+	 *
+	 * Partially used pages are kept towards the head of the list,
+	 * and completely empty pages are kept at the tail.
+	 */
+	struct list_head pages;
+	/** Number of completely empty pages */
+	unsigned int empty;
+};
+
+/** Define a slab object cache */
+#define SLAB_CACHE( log2 ) \
+	[log2] = { .pages = LIST_HEAD_INIT ( slab_caches[log2].pages ) }
+
+/** Slab object caches, indexed by object size (log2) */
+static struct slab_cache slab_caches[ SLAB_MAX_LOG2 + 1 ] = {
+	SLAB_CACHE ( 0 ), SLAB_CACHE ( 1 ), SLAB_CACHE ( 2 ),
+	SLAB_CACHE ( 3 ), SLAB_CACHE ( 4 ), SLAB_CACHE ( 5 ),
+	SLAB_CACHE ( 6 ), SLAB_CACHE ( 7 ), SLAB_CACHE ( 8 ),
+	SLAB_CACHE ( 9 ), SLAB_CACHE ( 10 ), SLAB_CACHE ( 11 ),
+};
+
+/** Slab page hash table, used to identify slab objects when freeing */
+static struct slab_page *slab_hash[SLAB_HASH_SIZE];
+
 /**
  * Mark all blocks in free list as defined
  *
@@ -245,6 +366,34 @@ static unsigned int discard_cache ( void ) {
 	return 0;
 }
 
+/**
+ * Sub-table index marking the end of cheap cache discarders
+ *
+ * This sorts after CACHE_CHEAP and before CACHE_NORMAL.
+ */
+#define CACHE_CHEAP_END 01_end
+
+/**
+ * Discard some cheaply replaced cached data
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int discard_cheap_cache ( void ) {
+	struct cache_discarder *end =
+		__table_entries ( CACHE_DISCARDERS, CACHE_CHEAP_END );
+	struct cache_discarder *discarder;
+	unsigned int discarded;
+
+	for_each_table_entry ( discarder, CACHE_DISCARDERS ) {
+		if ( discarder >= end )
+			break;
+		discarded = discarder->discard();
+		if ( discarded )
+			return discarded;
+	}
+	return 0;
+}
+
 /**
  * Discard all cached data
  *
@@ -257,8 +406,146 @@ static void discard_all_cache ( void ) {
 	} while ( discarded );
 }
 
+static void free_heap_block ( void *ptr, size_t size );
+
+/**
+ * Grow heap using external memory
+ *
+ * @v size		Size of block to be allocated
+ * @v align		Physical alignment of block to be allocated
+ * @ret region		New heap region, or NULL on failure
+ */
+static struct heap_region * heap_grow ( size_t size, size_t align ) {
+	struct heap_region *region;
+	userptr_t data;
+	size_t len;
+	size_t pad;
+
+	/* Do not grow the heap using a stack-like external memory
+	 * allocator, since a long-lived heap region would strand
+	 * all external memory (e.g. image buffers) allocated after it.
+	 */
+	if ( UMALLOC_STACKLIKE )
+		return NULL;
+
+	/* Calculate region length, allowing for header and alignment
+	 * padding.
+	 */
+	len = ( size + align + sizeof ( *region ) + MIN_MEMBLOCK_SIZE +
+		HEAP_REGION_ALIGN - 1 );
+	if ( len < size )
+		return NULL;
+	len &= ~( HEAP_REGION_ALIGN - 1 );
+	if ( len < HEAP_REGION_MIN_SIZE )
+		len = HEAP_REGION_MIN_SIZE;
+
+	/* Allocate external memory */
+	data = umalloc ( len );
+	if ( ! data ) {
+		DBGC ( &heap, "Could not grow heap by %#zx\n", len );
+		return NULL;
+	}
+	region = user_to_virt ( data, 0 );
+	region->data = data;
+	region->len = len;
+
+	/* Place usable memory after the header, physically aligned to
+	 * the minimum block size.
+	 */
+	pad = ( ( -( virt_to_phys ( region ) + sizeof ( *region ) ) ) &
+		( MIN_MEMBLOCK_SIZE - 1 ) );
+	region->start = ( ( ( void * ) region ) + sizeof ( *region ) + pad );
+	region->size = ( ( len - sizeof ( *region ) - pad ) &
+			 ~( MIN_MEMBLOCK_SIZE - 1 ) );
+
+	/* Populate heap.  The region is added to the list of regions
+	 * only after populating, so that it will not immediately be
+	 * considered idle.
+	 */
+	free_heap_block ( region->start, region->size );
+	list_add_tail ( &region->list, &heap_regions );
+	heapmem += region->size;
+	heapregions++;
+	DBGC ( &heap, "Grew heap by [%p,%p)\n", region,
+	       ( ( ( void * ) region ) + len ) );
+
+	return region;
+}
+
 /**
- * Allocate a memory block
+ * Release heap region
+ *
+ * @v region		Heap region
+ *
+ * The region must be entirely free.
+ */
+static void heap_release ( struct heap_region *region ) {
+	struct memory_block *block = region->start;
+
+	/* Remove from free list */
+	assert ( block->size == region->size );
+	list_del ( &block->list );
+	freemem -= block->size;
+	heapmem -= block->size;
+	VALGRIND_MAKE_MEM_NOACCESS ( block, sizeof ( *block ) );
+
+	/* Release external memory */
+	DBGC ( &heap, "Releasing heap region [%p,%p)\n", region,
+	       ( ( ( void * ) region ) + region->len ) );
+	list_del ( &region->list );
+	heapregions--;
+	if ( heap_idle == region )
+		heap_idle = NULL;
+	ufree ( region->data );
+}
+
+/**
+ * Check for newly idle heap region
+ *
+ * @v block		Free memory block
+ *
+ * Called whenever a block has been returned to the free list.  If
+ * this block covers an entire heap region, then the region is now
+ * idle.  A single idle region is retained to avoid repeatedly
+ * allocating and releasing external memory; any further idle regions
+ * are released immediately.
+ */
+static void heap_check_idle ( struct memory_block *block ) {
+	struct heap_region *region;
+
+	/* Ignore blocks too small to be a whole region */
+	if ( block->size < ( HEAP_REGION_MIN_SIZE / 2 ) )
+		return;
+
+	/* Find containing region, if any */
+	list_for_each_entry ( region, &heap_regions, list ) {
+		if ( ( ( ( void * ) block ) == region->start ) &&
+		     ( block->size == region->size ) ) {
+			if ( heap_idle && ( heap_idle != region ) ) {
+				heap_release ( region );
+			} else {
+				heap_idle = region;
+			}
+			return;
+		}
+	}
+}
+
+/**
+ * Release idle heap region, if any
+ *
+ */
+static void heap_release_idle ( void ) {
+
+	if ( heap_idle ) {
+		valgrind_make_blocks_defined();
+		heap_release ( heap_idle );
+		valgrind_make_blocks_noaccess();
+	}
+}
+
+/**
+ * Allocate a memory block from the free block list
  *
  * @v size		Requested size
  * @v align		Physical alignment
@@ -270,7 +557,7 @@ static void discard_all_cache ( void ) {
  *
  * @c align must be a power of two.  @c size may not be zero.
  */
-void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
+static void * alloc_heap_block ( size_t size, size_t align, size_t offset ) {
 	struct memory_block *block;
 	size_t align_mask;
 	size_t actual_size;
@@ -351,6 +638,10 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 				VALGRIND_MAKE_MEM_NOACCESS ( pre,
 							     sizeof ( *pre ) );
 			}
+			/* Region is no longer idle, if applicable */
+			if ( heap_idle &&
+			     ( ( ( void * ) pre ) == heap_idle->start ) )
+				heap_idle = NULL;
 			/* Update total free memory */
 			freemem -= actual_size;
 			/* Return allocated block */
@@ -361,14 +652,29 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 			goto done;
 		}
 
-		/* Try discarding some cached data to free up memory */
-		if ( ! discard_cache() ) {
-			/* Nothing available to discard */
-			DBGC ( &heap, "Failed to allocate %#zx (aligned "
-			       "%#zx)\n", size, align );
-			ptr = NULL;
-			goto done;
+		/* Try discarding some cheaply replaced cached data
+		 * (e.g. empty slab pages) to free up memory
+		 */
+		if ( discard_cheap_cache() )
+			continue;
+
+		/* Try growing the heap */
+		if ( heap_grow ( actual_size, align ) ) {
+			valgrind_make_blocks_defined();
+			continue;
 		}
+
+		/* Try discarding any other cached data (e.g. queued
+		 * packets) to free up memory
+		 */
+		if ( discard_cache() )
+			continue;
+
+		/* Nothing available to discard, and heap cannot grow */
+		DBGC ( &heap, "Failed to allocate %#zx (aligned %#zx)\n",
+		       size, align );
+		ptr = NULL;
+		goto done;
 	}
 
  done:
@@ -378,14 +684,14 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 }
 
 /**
- * Free a memory block
+ * Return a memory block to the free block list
  *
- * @v ptr		Memory allocated by alloc_memblock(), or NULL
+ * @v ptr		Memory allocated by alloc_heap_block(), or NULL
  * @v size		Size of the memory
  *
  * If @c ptr is NULL, no action is taken.
  */
-void free_memblock ( void *ptr, size_t size ) {
+static void free_heap_block ( void *ptr, size_t size ) {
 	struct memory_block *freeing;
 	struct memory_block *block;
 	struct memory_block *tmp;
@@ -402,7 +708,7 @@ void free_memblock ( void *ptr, size_t size ) {
 	valgrind_make_blocks_defined();
 	check_blocks();
 
-	/* Round up size to match actual size that alloc_memblock()
+	/* Round up size to match actual size that alloc_heap_block()
 	 * would have used.
 	 */
 	assert ( size != 0 );
@@ -477,10 +783,323 @@ void free_memblock ( void *ptr, size_t size ) {
 	/* Update free memory counter */
 	freemem += actual_size;
 
+	/* Check for a newly idle heap region */
+	heap_check_idle ( freeing );
+
 	check_blocks();
 	valgrind_make_blocks_noaccess();
 }
 
+/**
+ * Calculate slab object size class
+ *
+ * @v size		Requested size
+ * @ret log2		Object size (log2)
+ */
+static inline unsigned int slab_log2 ( size_t size ) {
+
+	if ( size <= MIN_MEMBLOCK_SIZE )
+		size = MIN_MEMBLOCK_SIZE;
+	return fls ( size - 1 );
+}
+
+/**
+ * Calculate offset of first object within a slab page
+ *
+ * @v log2		Object size (log2)
+ * @ret offset		Offset of first object
+ */
+static inline size_t slab_first ( unsigned int log2 ) {
+	size_t size = ( 1UL << log2 );
+
+	return ( ( sizeof ( struct slab_page ) + size - 1 ) & ~( size - 1 ) );
+}
+
+/**
+ * Calculate number of objects within a slab page
+ *
+ * @v log2		Object size (log2)
+ * @ret count		Number of objects
+ */
+static inline unsigned int slab_count ( unsigned int log2 ) {
+
+	return ( ( SLAB_PAGE_SIZE - slab_first ( log2 ) ) >> log2 );
+}
+
+/**
+ * Get slab page hash bucket
+ *
+ * @v page		Slab page address
+ * @ret bucket		Hash bucket
+ */
+static inline struct slab_page ** slab_bucket ( void *page ) {
+	unsigned int index;
+
+	index = ( ( virt_to_phys ( page ) >> SLAB_PAGE_LOG2 ) &
+		  ( SLAB_HASH_SIZE - 1 ) );
+	return &slab_hash[index];
+}
+
+/**
+ * Find slab page containing an object
+ *
+ * @v ptr		Object
+ * @ret page		Slab page, or NULL if not allocated from a slab
+ */
+static struct slab_page * slab_find ( void *ptr ) {
+	struct slab_page *page;
+	void *base;
+
+	base = ( ptr - ( virt_to_phys ( ptr ) & ( SLAB_PAGE_SIZE - 1 ) ) );
+	for ( page = *slab_bucket ( base ) ; page ; page = page->hash ) {
+		if ( page == base )
+			return page;
+	}
+	return NULL;
+}
+
+/**
+ * Release a slab page back to the free block list
+ *
+ * @v page		Slab page
+ */
+static void slab_release ( struct slab_page *page ) {
+	struct slab_page **prev;
+
+	/* Sanity check */
+	assert ( page->used == 0 );
+
+	/* Remove from hash table */
+	for ( prev = slab_bucket ( page ) ; *prev != page ;
+	      prev = &(*prev)->hash ) {
+		assert ( *prev != NULL );
+	}
+	*prev = page->hash;
+
+	/* Remove from cache */
+	list_del ( &page->list );
+	DBGC2 ( &heap, "Releasing slab page [%p,%p) for %#lx-byte objects\n",
+		page, ( ( ( void * ) page ) + SLAB_PAGE_SIZE ),
+		( 1UL << page->log2 ) );
+
+	/* Return page to the free block list */
+	freemem -= ( slab_count ( page->log2 ) << page->log2 );
+	free_heap_block ( page, SLAB_PAGE_SIZE );
+}
+
+/**
+ * Allocate a slab object
+ *
+ * @v log2		Object size (log2)
+ * @ret ptr		Object, or NULL
+ */
+static void * slab_alloc ( unsigned int log2 ) {
+	struct slab_cache *cache = &slab_caches[log2];
+	struct slab_page *page;
+	struct slab_page **bucket;
+	struct slab_object *object;
+
+	/* Create a new page if no free objects are available */
+	if ( list_empty ( &cache->pages ) ) {
+		page = alloc_heap_block ( SLAB_PAGE_SIZE, SLAB_PAGE_SIZE, 0 );
+		if ( ! page )
+			return NULL;
+		VALGRIND_MAKE_MEM_UNDEFINED ( page, sizeof ( *page ) );
+		page->free = NULL;
+		page->unused = ( ( ( void * ) page ) + slab_first ( log2 ) );
+		page->used = 0;
+		page->log2 = log2;
+		VALGRIND_MAKE_MEM_NOACCESS ( page->unused, ( SLAB_PAGE_SIZE -
+						slab_first ( log2 ) ) );
+		bucket = slab_bucket ( page );
+		page->hash = *bucket;
+		*bucket = page;
+		list_add_tail ( &page->list, &cache->pages );
+		cache->empty++;
+		freemem += ( slab_count ( log2 ) << log2 );
+		DBGC2 ( &heap, "Created slab page [%p,%p) for %#lx-byte "
+			"objects\n", page, ( ( ( void * ) page ) +
+					    SLAB_PAGE_SIZE ), ( 1UL << log2 ) );
+	}
+
+	/* Take an object from the first page with free objects */
+	page = list_first_entry ( &cache->pages, struct slab_page, list );
+	if ( page->free ) {
+		object = page->free;
+		VALGRIND_MAKE_MEM_DEFINED ( object, sizeof ( *object ) );
+		page->free = object->next;
+	} else {
+		object = page->unused;
+		page->unused += ( 1UL << log2 );
+	}
+	if ( page->used++ == 0 )
+		cache->empty--;
+	if ( page->used == slab_count ( log2 ) )
+		list_del ( &page->list );
+	freemem -= ( 1UL << log2 );
+
+	return object;
+}
+
+/**
+ * Free a slab object
+ *
+ * @v page		Slab page
+ * @v ptr		Object
+ */
+static void slab_free ( struct slab_page *page, void *ptr ) {
+	struct slab_cache *cache = &slab_caches[page->log2];
+	struct slab_object *object = ptr;
+	struct slab_object *tmp;
+	struct slab_object *next;
+
+	/* Sanity checks */
+	assert ( page->used > 0 );
+	assert ( ( ( ptr - ( ( void * ) page ) - slab_first ( page->log2 ) ) &
+		   ( ( 1UL << page->log2 ) - 1 ) ) == 0 );
+	if ( ASSERTING ) {
+		for ( tmp = page->free ; tmp ; tmp = next ) {
+			VALGRIND_MAKE_MEM_DEFINED ( tmp, sizeof ( *tmp ) );
+			next = tmp->next;
+			VALGRIND_MAKE_MEM_NOACCESS ( tmp, sizeof ( *tmp ) );
+			if ( tmp == object ) {
+				assert ( 0 );
+				DBGC ( &heap, "Double free of slab object %p "
+				       "detected from %p\n", object,
+				       __builtin_return_address ( 0 ) );
+			}
+		}
+	}
+
+	/* Return object to page */
+	if ( page->used-- == slab_count ( page->log2 ) )
+		list_add ( &page->list, &cache->pages );
+	VALGRIND_MAKE_MEM_UNDEFINED ( object, sizeof ( *object ) );
+	object->next = page->free;
+	page->free = object;
+	VALGRIND_MAKE_MEM_NOACCESS ( object, sizeof ( *object ) );
+	freemem += ( 1UL << page->log2 );
+
+	/* Move completely empty pages to the tail of the list, and
+	 * release them if we already have enough spare pages.
+	 */
+	if ( page->used == 0 ) {
+		if ( cache->empty >= SLAB_SPARE_PAGES ) {
+			slab_release ( page );
+		} else {
+			list_del ( &page->list );
+			list_add_tail ( &page->list, &cache->pages );
+			cache->empty++;
+		}
+	}
+}
+
+/**
+ * Allocate a memory block
+ *
+ * @v size		Requested size
+ * @v align		Physical alignment
+ * @v offset		Offset from physical alignment
+ * @ret ptr		Memory block, or NULL
+ *
+ * Allocates a memory block @b physically aligned as requested.  No
+ * guarantees are provided for the alignment of the virtual address.
+ *
+ * Small blocks are allocated from a slab object cache in constant
+ * time whenever the natural alignment of the object size class
+ * satisfies the requested alignment.  All other blocks are allocated
+ * from the free block list.
+ *
+ * @c align must be a power of two.  @c size may not be zero.
+ */
+void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
+	unsigned int log2;
+	size_t usedmem;
+	void *ptr = NULL;
+
+	/* Use a slab object cache if possible */
+	if ( size && ( size <= SLAB_MAX_SIZE ) ) {
+		log2 = slab_log2 ( size );
+		if ( ( align <= ( 1UL << log2 ) ) &&
+		     ( ( offset & ( align - 1 ) ) == 0 ) ) {
+			ptr = slab_alloc ( log2 );
+			if ( ptr )
+				VALGRIND_MAKE_MEM_UNDEFINED ( ptr, size );
+		}
+	}
+
+	/* Otherwise, allocate from the free block list */
+	if ( ! ptr )
+		ptr = alloc_heap_block ( size, align, offset );
+
+	/* Record peak memory usage */
+	usedmem = ( heapmem - freemem );
+	if ( usedmem > maxusedmem )
+		maxusedmem = usedmem;
+
+	return ptr;
+}
+
+/**
+ * Free a memory block
+ *
+ * @v ptr		Memory allocated by alloc_memblock(), or NULL
+ * @v size		Size of the memory
+ *
+ * If @c ptr is NULL, no action is taken.
+ */
+void free_memblock ( void *ptr, size_t size ) {
+	struct slab_page *page;
+
+	/* Allow for ptr==NULL */
+	if ( ! ptr )
+		return;
+
+	/* Return small blocks to their slab page, if applicable */
+	if ( size <= SLAB_MAX_SIZE ) {
+		page = slab_find ( ptr );
+		if ( page ) {
+			assert ( slab_log2 ( size ) == page->log2 );
+			VALGRIND_MAKE_MEM_NOACCESS ( ptr, size );
+			slab_free ( page, ptr );
+			return;
+		}
+	}
+
+	/* Otherwise, return to the free block list */
+	free_heap_block ( ptr, size );
+}
+
+/**
+ * Discard spare slab pages
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int slab_discard ( void ) {
+	struct slab_cache *cache;
+	struct slab_page *page;
+	struct slab_page *tmp;
+	unsigned int discarded = 0;
+	unsigned int log2;
+
+	for ( log2 = 0 ; log2 <= SLAB_MAX_LOG2 ; log2++ ) {
+		cache = &slab_caches[log2];
+		list_for_each_entry_safe ( page, tmp, &cache->pages, list ) {
+			if ( page->used )
+				continue;
+			slab_release ( page );
+			cache->empty--;
+			discarded++;
+		}
+	}
+	return discarded;
+}
+
+/** Slab page cache discarder */
+struct cache_discarder slab_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = slab_discard,
+};
+
 /**
  * Reallocate memory
  *
@@ -629,10 +1248,12 @@ void * zalloc ( size_t size ) {
  * @c start must be aligned to at least a multiple of sizeof(void*).
  */
 void mpopulate ( void *start, size_t len ) {
-	/* Prevent free_memblock() from rounding up len beyond the end
-	 * of what we were actually given...
+	/* Prevent free_heap_block() from rounding up len beyond the
+	 * end of what we were actually given...
 	 */
-	free_memblock ( start, ( len & ~( MIN_MEMBLOCK_SIZE - 1 ) ) );
+	len &= ~( MIN_MEMBLOCK_SIZE - 1 );
+	free_heap_block ( start, len );
+	heapmem += len;
 }
 
 /**
@@ -651,11 +1272,12 @@ struct init_fn heap_init_fn __init_fn ( INIT_EARLY ) = {
 };
 
 /**
- * Discard all cached data on shutdown
+ * Discard all cached data and release idle heap memory on shutdown
  *
  */
 static void shutdown_cache ( int booting __unused ) {
 	discard_all_cache();
+	heap_release_idle();
 }
 
 /** Memory allocator shutdown function */
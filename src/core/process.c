@@ -23,9 +23,11 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <assert.h>
 #include <ipxe/list.h>
 #include <ipxe/init.h>
 #include <ipxe/process.h>
+#include <ipxe/profile.h>
 
 /** @file
  *
@@ -33,10 +35,31 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  * We implement a trivial form of cooperative multitasking, in which
  * all processes share a single stack and address space.
+ *
+ * A process that has no work to do may remove itself from the run
+ * queue using process_del(), and be woken by the relevant event
+ * source using process_add().  Processes report useful work via
+ * process_activity(), allowing callers that are waiting for input to
+ * put the CPU to sleep only when nothing is runnable.
  */
 
-/** Process run queue */
-static LIST_HEAD ( run_queue );
+/** List of profiled process descriptors */
+struct list_head process_descriptors = LIST_HEAD_INIT ( process_descriptors );
+
+/** Process run queues (one per priority class) */
+static struct list_head run_queue[PROC_NUM_PRIO] = {
+	[PROC_PRIO_NORMAL] = LIST_HEAD_INIT ( run_queue[PROC_PRIO_NORMAL] ),
+	[PROC_PRIO_HIGH] = LIST_HEAD_INIT ( run_queue[PROC_PRIO_HIGH] ),
+};
+
+/** Number of processes in the run queues */
+static unsigned int run_count;
+
+/** Number of steps since a process last reported activity */
+static unsigned int idle_steps;
+
+/** Most recent step executed a high priority process */
+static int step_high;
 
 /**
  * Get pointer to object containing process
@@ -60,8 +83,12 @@ void process_add ( struct process *process ) {
 	if ( ! process_running ( process ) ) {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
 		       " starting\n", PROC_DBG ( process ) );
+		assert ( process->desc->priority < PROC_NUM_PRIO );
 		ref_get ( process->refcnt );
-		list_add_tail ( &process->list, &run_queue );
+		list_add_tail ( &process->list,
+				&run_queue[process->desc->priority] );
+		run_count++;
+		process_activity();
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
 		       " already started\n", PROC_DBG ( process ) );
@@ -82,6 +109,7 @@ void process_del ( struct process *process ) {
 		       " stopping\n", PROC_DBG ( process ) );
 		list_del ( &process->list );
 		INIT_LIST_HEAD ( &process->list );
+		run_count--;
 		ref_put ( process->refcnt );
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
@@ -89,31 +117,77 @@ void process_del ( struct process *process ) {
 	}
 }
 
+/**
+ * Record process activity
+ *
+ * This should be called by a process that has performed useful work
+ * (e.g. processing a received packet), or by an event source that
+ * has made work available.
+ */
+void process_activity ( void ) {
+	idle_steps = 0;
+}
+
+/**
+ * Check if all processes are idle
+ *
+ * @ret idle		All processes are idle
+ *
+ * The processes are idle if every runnable process has been stepped
+ * (allowing for the interleaving of priority classes) since activity
+ * was last reported.  A caller waiting for an external event may
+ * safely sleep until the next interrupt only if this is true.
+ */
+int process_idle ( void ) {
+	return ( idle_steps >= ( PROC_NUM_PRIO * run_count ) );
+}
+
 /**
  * Single-step a single process
  *
  * This executes a single step of the first process in the run queue,
- * and moves the process to the end of the run queue.
+ * and moves the process to the end of the run queue.  High priority
+ * processes are executed on alternate steps whenever any normal
+ * priority processes are also runnable.
  */
 void step ( void ) {
+	struct list_head *queue = &run_queue[PROC_PRIO_NORMAL];
+	struct list_head *high = &run_queue[PROC_PRIO_HIGH];
 	struct process *process;
 	struct process_descriptor *desc;
 	void *object;
 
-	if ( ( process = list_first_entry ( &run_queue, struct process,
+	/* Choose run queue */
+	if ( ( ! list_empty ( high ) ) &&
+	     ( ( ! step_high ) || list_empty ( queue ) ) ) {
+		queue = high;
+	}
+	step_high = ( queue == high );
+
+	/* Count steps since last activity */
+	idle_steps++;
+
+	if ( ( process = list_first_entry ( queue, struct process,
 					    list ) ) ) {
 		ref_get ( process->refcnt ); /* Inhibit destruction mid-step */
 		desc = process->desc;
 		object = process_object ( process );
 		if ( desc->reschedule ) {
 			list_del ( &process->list );
-			list_add_tail ( &process->list, &run_queue );
+			list_add_tail ( &process->list, queue );
 		} else {
+			/* Running a one-shot process is useful work */
 			process_del ( process );
+			process_activity();
 		}
 		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
 			" executing\n", PROC_DBG ( process ) );
+		profile_start ( &desc->profiler );
 		desc->step ( object );
+		profile_stop ( &desc->profiler );
+		if ( PROFILING && ( ! desc->list.next ) ) {
+			list_add_tail ( &desc->list, &process_descriptors );
+		}
 		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
 			" finished executing\n", PROC_DBG ( process ) );
 		ref_put ( process->refcnt ); /* Allow destruction */
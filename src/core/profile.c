@@ -25,6 +25,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include <assert.h>
 #include <ipxe/isqrt.h>
@@ -122,8 +123,9 @@ void profile_update ( struct profiler *profiler, unsigned long sample ) {
 	 */
 	assert ( ( ( signed ) sample ) >= 0 );
 
-	/* Update sample count */
+	/* Update sample count and accumulated sample value */
 	profiler->count++;
+	profiler->total += sample;
 
 	/* Adjust mean sample value scale if necessary.  Skip if
 	 * sample is zero (in which case flsl(sample)-1 would
@@ -274,3 +276,17 @@ unsigned long profile_stddev ( struct profiler *profiler ) {
 
 	return isqrt ( profile_variance ( profiler ) );
 }
+
+/**
+ * Reset profiler
+ *
+ * @v profiler		Profiler
+ *
+ * All samples are discarded.  The profiler name is preserved.
+ */
+void profile_reset ( struct profiler *profiler ) {
+	const char *name = profiler->name;
+
+	memset ( profiler, 0, sizeof ( *profiler ) );
+	profiler->name = name;
+}
@@ -31,6 +31,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/open.h>
 #include <ipxe/process.h>
 #include <ipxe/socket.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
 #include <ipxe/resolv.h>
 
 /** @file
@@ -51,6 +53,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  * @v intf		Object interface
  * @v sa		Completed socket address (if successful)
+ *
+ * A name resolver may report more than one address (e.g. one for
+ * each address family), in order of preference, before closing the
+ * interface.
  */
 void resolv_done ( struct interface *intf, struct sockaddr *sa ) {
 	struct interface *dest;
@@ -291,6 +297,9 @@ int resolv ( struct interface *resolv, const char *name,
  ***************************************************************************
  */
 
+/** Connection attempt delay (as recommended by RFC 8305 section 5) */
+#define NAMED_ATTEMPT_DELAY ( TICKS_PER_SEC / 4 )
+
 /** A named socket */
 struct named_socket {
 	/** Reference counter */
@@ -305,8 +314,62 @@ struct named_socket {
 	struct sockaddr local;
 	/** Stored local socket address exists */
 	int have_local;
+
+	/** Connection attempts */
+	struct list_head attempts;
+	/** Connection attempt delay timer */
+	struct retry_timer timer;
+	/** Name resolution is complete */
+	int resolved;
+	/** Most recent failure status code */
+	int rc;
+};
+
+/** A named socket connection attempt */
+struct named_attempt {
+	/** Reference counter */
+	struct refcnt refcnt;
+	/** Named socket */
+	struct named_socket *named;
+	/** List of connection attempts */
+	struct list_head list;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Peer socket address */
+	struct sockaddr peer;
+	/** Connection attempt has been started */
+	int started;
 };
 
+/**
+ * Free named socket connection attempt
+ *
+ * @v refcnt		Reference counter
+ */
+static void named_attempt_free ( struct refcnt *refcnt ) {
+	struct named_attempt *attempt =
+		container_of ( refcnt, struct named_attempt, refcnt );
+
+	ref_put ( &attempt->named->refcnt );
+	free ( attempt );
+}
+
+/**
+ * Remove named socket connection attempt
+ *
+ * @v attempt		Connection attempt
+ * @v rc		Reason for removal
+ */
+static void named_attempt_remove ( struct named_attempt *attempt, int rc ) {
+
+	/* Shut down interface */
+	intf_shutdown ( &attempt->xfer, rc );
+
+	/* Remove from list of attempts and drop list's reference */
+	list_del ( &attempt->list );
+	ref_put ( &attempt->refcnt );
+}
+
 /**
  * Terminate named socket opener
  *
@@ -314,6 +377,16 @@ struct named_socket {
  * @v rc		Reason for termination
  */
 static void named_close ( struct named_socket *named, int rc ) {
+	struct named_attempt *attempt;
+	struct named_attempt *tmp;
+
+	/* Stop connection attempt delay timer */
+	stop_timer ( &named->timer );
+
+	/* Abandon any outstanding connection attempts */
+	list_for_each_entry_safe ( attempt, tmp, &named->attempts, list )
+		named_attempt_remove ( attempt, ( rc ? rc : -ECANCELED ) );
+
 	/* Shut down interfaces */
 	intf_shutdown ( &named->resolv, rc );
 	intf_shutdown ( &named->xfer, rc );
@@ -341,13 +414,13 @@ static struct interface_descriptor named_xfer_desc =
 	INTF_DESC ( struct named_socket, xfer, named_xfer_ops );
 
 /**
- * Name resolved
+ * Redirect parent interface to resolved address
  *
  * @v named		Named socket
- * @v sa		Completed socket address
+ * @v sa		Resolved socket address
  */
-static void named_resolv_done ( struct named_socket *named,
-				struct sockaddr *sa ) {
+static void named_redirect ( struct named_socket *named,
+			     struct sockaddr *sa ) {
 	int rc;
 
 	/* Nullify data transfer interface */
@@ -371,12 +444,272 @@ static void named_resolv_done ( struct named_socket *named,
 	named_close ( named, rc );
 }
 
+/**
+ * Hand over connection attempt to parent interface
+ *
+ * @v attempt		Connection attempt
+ */
+static void named_attempt_commit ( struct named_attempt *attempt ) {
+	struct named_socket *named = attempt->named;
+	struct interface *socket = attempt->xfer.dest;
+
+	DBGC ( named, "NAMED %p using connection to %s\n",
+	       named, sock_ntoa ( &attempt->peer ) );
+
+	/* Report peer socket address to parent, since the parent is
+	 * not being redirected to this address.
+	 */
+	xfer_connected ( &named->xfer, &attempt->peer );
+
+	/* Plug parent interface directly into the socket, and unplug
+	 * our own interfaces without closing either end.
+	 */
+	intf_plug_plug ( named->xfer.dest, socket );
+	intf_unplug ( &named->xfer );
+	intf_unplug ( &attempt->xfer );
+
+	/* Notify parent that the window may have opened */
+	xfer_window_changed ( socket );
+
+	/* Terminate named socket opener */
+	named_close ( named, 0 );
+}
+
+/**
+ * Find next connection attempt to be started
+ *
+ * @v named		Named socket
+ * @ret attempt		Connection attempt, or NULL
+ */
+static struct named_attempt * named_next ( struct named_socket *named ) {
+	struct named_attempt *attempt;
+
+	list_for_each_entry ( attempt, &named->attempts, list ) {
+		if ( ! attempt->started )
+			return attempt;
+	}
+	return NULL;
+}
+
+/**
+ * Start connection attempts and check for completion
+ *
+ * @v named		Named socket
+ *
+ * Connection attempts are started in the order in which addresses
+ * were resolved, with each attempt staggered by the connection
+ * attempt delay unless the previous attempt has already failed
+ * (RFC 8305 section 5).
+ */
+static void named_progress ( struct named_socket *named ) {
+	struct named_attempt *attempt;
+	int rc;
+
+	/* Once name resolution is complete, handle the cases in which
+	 * there is nothing left to race.
+	 */
+	if ( named->resolved ) {
+
+		/* Fail if all connection attempts have failed */
+		if ( list_empty ( &named->attempts ) ) {
+			DBGC ( named, "NAMED %p could not connect: %s\n",
+			       named, strerror ( named->rc ) );
+			named_close ( named, named->rc );
+			return;
+		}
+
+		/* Use a sole remaining address directly.  If no
+		 * attempt has yet been started, then redirect the
+		 * parent exactly as for a single resolved address;
+		 * otherwise hand over the attempt without waiting
+		 * for it to connect.
+		 */
+		if ( list_is_singular ( &named->attempts ) ) {
+			attempt = list_first_entry ( &named->attempts,
+						     struct named_attempt,
+						     list );
+			if ( attempt->started ) {
+				named_attempt_commit ( attempt );
+			} else {
+				named_redirect ( named, &attempt->peer );
+			}
+			return;
+		}
+	}
+
+	/* Start next connection attempt, if applicable */
+	while ( ( ! timer_running ( &named->timer ) ) &&
+		( ( attempt = named_next ( named ) ) != NULL ) ) {
+
+		/* Start connection attempt */
+		DBGC ( named, "NAMED %p attempting connection to %s\n",
+		       named, sock_ntoa ( &attempt->peer ) );
+		attempt->started = 1;
+		if ( ( rc = xfer_open_socket ( &attempt->xfer,
+					       named->semantics,
+					       &attempt->peer,
+					       ( named->have_local ?
+						 &named->local : NULL ) ) )!=0){
+			DBGC ( named, "NAMED %p could not open %s: %s\n",
+			       named, sock_ntoa ( &attempt->peer ),
+			       strerror ( rc ) );
+			named->rc = rc;
+			named_attempt_remove ( attempt, rc );
+			named_progress ( named );
+			return;
+		}
+		start_timer_fixed ( &named->timer, NAMED_ATTEMPT_DELAY );
+	}
+}
+
+/**
+ * Handle connection attempt delay timer expiry
+ *
+ * @v timer		Connection attempt delay timer
+ * @v fail		Failure indicator
+ */
+static void named_expired ( struct retry_timer *timer, int fail __unused ) {
+	struct named_socket *named =
+		container_of ( timer, struct named_socket, timer );
+
+	named_progress ( named );
+}
+
+/**
+ * Handle connection attempt window change
+ *
+ * @v attempt		Connection attempt
+ */
+static void named_attempt_window_changed ( struct named_attempt *attempt ) {
+
+	/* Use the first connection attempt to become established and
+	 * ready for data.  (A connection may be ready for data before
+	 * it is established, e.g. when using TCP Fast Open.)
+	 */
+	if ( xfer_established ( &attempt->xfer ) &&
+	     xfer_window ( &attempt->xfer ) ) {
+		named_attempt_commit ( attempt );
+	}
+}
+
+/**
+ * Handle connection attempt failure
+ *
+ * @v attempt		Connection attempt
+ * @v rc		Reason for failure
+ */
+static void named_attempt_close ( struct named_attempt *attempt, int rc ) {
+	struct named_socket *named = attempt->named;
+
+	/* Treat a premature close as a failure */
+	if ( rc == 0 )
+		rc = -ECONNRESET;
+	DBGC ( named, "NAMED %p connection to %s failed: %s\n",
+	       named, sock_ntoa ( &attempt->peer ), strerror ( rc ) );
+
+	/* Remove attempt and start any next attempt immediately */
+	named->rc = rc;
+	named_attempt_remove ( attempt, rc );
+	stop_timer ( &named->timer );
+	named_progress ( named );
+}
+
+/** Named socket connection attempt data transfer interface operations */
+static struct interface_operation named_attempt_ops[] = {
+	INTF_OP ( xfer_window_changed, struct named_attempt *,
+		  named_attempt_window_changed ),
+	INTF_OP ( intf_close, struct named_attempt *, named_attempt_close ),
+};
+
+/** Named socket connection attempt data transfer interface descriptor */
+static struct interface_descriptor named_attempt_desc =
+	INTF_DESC ( struct named_attempt, xfer, named_attempt_ops );
+
+/**
+ * Add connection attempt
+ *
+ * @v named		Named socket
+ * @v sa		Peer socket address
+ */
+static void named_attempt ( struct named_socket *named,
+			    struct sockaddr *sa ) {
+	struct named_attempt *attempt;
+
+	/* Allocate and initialise structure */
+	attempt = zalloc ( sizeof ( *attempt ) );
+	if ( ! attempt ) {
+		named->rc = -ENOMEM;
+		return;
+	}
+	ref_init ( &attempt->refcnt, named_attempt_free );
+	intf_init ( &attempt->xfer, &named_attempt_desc, &attempt->refcnt );
+	attempt->named = named;
+	ref_get ( &named->refcnt );
+	memcpy ( &attempt->peer, sa, sizeof ( attempt->peer ) );
+
+	/* Add to list of attempts (transferring reference to list) */
+	list_add_tail ( &attempt->list, &named->attempts );
+	DBGC ( named, "NAMED %p resolved %s\n", named, sock_ntoa ( sa ) );
+
+	/* Start attempt once any current connection attempt delay
+	 * has expired.  The first attempt is deferred until the
+	 * resolver has had a chance to report completion, so that a
+	 * single resolved address can be used without racing.
+	 */
+	if ( ! timer_running ( &named->timer ) )
+		start_timer_nodelay ( &named->timer );
+}
+
+/**
+ * Name resolved
+ *
+ * @v named		Named socket
+ * @v sa		Completed socket address
+ *
+ * Stream sockets race a connection attempt to each resolved address
+ * ("Happy Eyeballs", RFC 8305).  Other sockets are redirected to the
+ * first resolved address.
+ */
+static void named_resolv_done ( struct named_socket *named,
+				struct sockaddr *sa ) {
+
+	/* Race connection attempts for stream sockets */
+	if ( named->semantics == SOCK_STREAM ) {
+		named_attempt ( named, sa );
+		return;
+	}
+
+	/* Redirect other sockets to first resolved address */
+	named_redirect ( named, sa );
+}
+
+/**
+ * Name resolution complete
+ *
+ * @v named		Named socket
+ * @v rc		Reason for completion
+ */
+static void named_resolv_close ( struct named_socket *named, int rc ) {
+
+	/* Terminate immediately unless racing connection attempts */
+	if ( named->semantics != SOCK_STREAM ) {
+		named_close ( named, rc );
+		return;
+	}
+
+	/* Record completion and check for remaining attempts */
+	intf_restart ( &named->resolv, rc );
+	named->resolved = 1;
+	if ( rc != 0 )
+		named->rc = rc;
+	named_progress ( named );
+}
+
 /** Named socket opener resolver interface operations */
 static struct interface_operation named_resolv_op[] = {
-	INTF_OP ( intf_close, struct named_socket *, named_close ),
+	INTF_OP ( intf_close, struct named_socket *, named_resolv_close ),
 	INTF_OP ( resolv_done, struct named_socket *, named_resolv_done ),
 };
-
 /** Named socket opener resolver interface descriptor */
 static struct interface_descriptor named_resolv_desc =
 	INTF_DESC ( struct named_socket, resolv, named_resolv_op );
@@ -403,6 +736,8 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 	ref_init ( &named->refcnt, NULL );
 	intf_init ( &named->xfer, &named_xfer_desc, &named->refcnt );
 	intf_init ( &named->resolv, &named_resolv_desc, &named->refcnt );
+	INIT_LIST_HEAD ( &named->attempts );
+	timer_init ( &named->timer, named_expired, &named->refcnt );
 	named->semantics = semantics;
 	if ( local ) {
 		memcpy ( &named->local, local, sizeof ( named->local ) );
@@ -54,7 +54,8 @@ unsigned int sleep ( unsigned int secs ) {
 			step();
 			if ( iskey() && ( getchar() == CTRL_C ) )
 				return secs;
-			cpu_nap();
+			if ( process_idle() )
+				cpu_nap();
 		}
 		start = now;
 	}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <ipxe/trace.h>
+
+/** @file
+ *
+ * Binary event tracing
+ *
+ * Trace events are recorded into a fixed-size ring, overwriting the
+ * oldest events.  Recording an event costs only a timestamp and a
+ * few stores, so tracing may be left enabled in production builds
+ * to help diagnose throughput stalls.
+ */
+
+/* Ensure that the ring size is a power of two */
+#if ( TRACE_RING_SIZE & ( TRACE_RING_SIZE - 1 ) )
+#error "TRACE_RING_SIZE must be a power of two"
+#endif
+
+/** Trace events */
+static struct trace_event trace_events[TRACE_RING_SIZE];
+
+/** Trace ring */
+struct trace_ring trace_ring = {
+	.events = trace_events,
+	.size = TRACE_RING_SIZE,
+};
+
+/**
+ * Record event in trace ring
+ *
+ * @v ring		Trace ring
+ * @v id		Event identifier
+ * @v data0		First payload word
+ * @v data1		Second payload word
+ * @v data2		Third payload word
+ */
+void trace_ring_record ( struct trace_ring *ring, unsigned int id,
+			 unsigned long data0, unsigned long data1,
+			 unsigned long data2 ) {
+	struct trace_event *event;
+
+	/* Do nothing if ring is empty */
+	if ( ! ring->size )
+		return;
+
+	/* Record event, overwriting the oldest event if necessary */
+	event = &ring->events[ ring->prod++ & ( ring->size - 1 ) ];
+	event->timestamp = profile_timestamp();
+	event->id = id;
+	event->data[0] = data0;
+	event->data[1] = data1;
+	event->data[2] = data2;
+}
+
+/**
+ * Get event from trace ring
+ *
+ * @v ring		Trace ring
+ * @v seq		Event sequence number
+ * @ret event		Trace event, or NULL if not present in ring
+ */
+struct trace_event * trace_ring_event ( struct trace_ring *ring,
+					unsigned int seq ) {
+	unsigned int age = ( ring->prod - seq );
+
+	/* Fail if event has not yet been recorded or has been overwritten */
+	if ( ( age == 0 ) || ( age > ring->size ) )
+		return NULL;
+
+	return &ring->events[ seq & ( ring->size - 1 ) ];
+}
+
+/**
+ * Get sequence number of oldest event in trace ring
+ *
+ * @v ring		Trace ring
+ * @ret seq		Sequence number of oldest event
+ */
+unsigned int trace_ring_oldest ( struct trace_ring *ring ) {
+
+	if ( ring->prod < ring->size )
+		return 0;
+	return ( ring->prod - ring->size );
+}
+
+/**
+ * Get trace event name
+ *
+ * @v id		Event identifier
+ * @ret name		Event name
+ */
+const char * trace_name ( unsigned int id ) {
+
+	switch ( id ) {
+	case TRACE_NETDEV_TX:	return "netdev_tx";
+	case TRACE_NETDEV_RX:	return "netdev_rx";
+	case TRACE_TCP_TX:	return "tcp_tx";
+	case TRACE_TCP_RX:	return "tcp_rx";
+	case TRACE_TLS_TX:	return "tls_tx";
+	case TRACE_TLS_RX:	return "tls_rx";
+	case TRACE_HTTP_RX:	return "http_rx";
+	case TRACE_XFERBUF:	return "xferbuf";
+	default:		return "unknown";
+	}
+}
+
+/**
+ * Save trace ring to file
+ *
+ * @v filename		Filename
+ * @ret rc		Return status code
+ *
+ * This is a stub for platforms that have no access to a filesystem.
+ */
+__weak int trace_save ( const char *filename __unused ) {
+	return -ENOTSUP;
+}
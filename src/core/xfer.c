@@ -147,6 +147,57 @@ void xfer_window_changed ( struct interface *intf ) {
 	intf_poke ( intf, xfer_window_changed );
 }
 
+/**
+ * Check if connection is established
+ *
+ * @v intf		Data transfer interface
+ * @ret established	Connection is established
+ *
+ * A connection may be ready to accept data before it has been
+ * established (e.g. when using TCP Fast Open).  This method may be
+ * used to distinguish between the two cases.
+ */
+int xfer_established ( struct interface *intf ) {
+	struct interface *dest;
+	xfer_established_TYPE ( void * ) *op =
+		intf_get_dest_op ( intf, xfer_established, &dest );
+	void *object = intf_object ( dest );
+	int established;
+
+	if ( op ) {
+		established = op ( object );
+	} else {
+		/* Default is to be always established */
+		established = 1;
+	}
+
+	intf_put ( dest );
+	return established;
+}
+
+/**
+ * Report connected peer socket address
+ *
+ * @v intf		Data transfer interface
+ * @v peer		Peer socket address
+ *
+ * This method is used to report the peer socket address of a
+ * connection that is handed over to the parent interface without
+ * redirecting the parent (e.g. the winner of a race between
+ * connection attempts to several resolved addresses).
+ */
+void xfer_connected ( struct interface *intf, struct sockaddr *peer ) {
+	struct interface *dest;
+	xfer_connected_TYPE ( void * ) *op =
+		intf_get_dest_op ( intf, xfer_connected, &dest );
+	void *object = intf_object ( dest );
+
+	if ( op )
+		op ( object, peer );
+
+	intf_put ( dest );
+}
+
 /**
  * Allocate I/O buffer
  *
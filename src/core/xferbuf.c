@@ -30,6 +30,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/iobuf.h>
 #include <ipxe/umalloc.h>
 #include <ipxe/profile.h>
+#include <ipxe/trace.h>
 #include <ipxe/xferbuf.h>
 
 /** @file
@@ -59,9 +60,35 @@ void xferbuf_free ( struct xfer_buffer *xferbuf ) {
 
 	xferbuf->op->realloc ( xferbuf, 0 );
 	xferbuf->len = 0;
+	xferbuf->size = 0;
 	xferbuf->pos = 0;
 }
 
+/**
+ * Trim data transfer buffer to fit data
+ *
+ * @v xferbuf		Data transfer buffer
+ * @ret rc		Return status code
+ *
+ * Release any spare capacity allocated to allow for future growth.
+ */
+int xferbuf_trim ( struct xfer_buffer *xferbuf ) {
+	int rc;
+
+	/* Do nothing unless there is spare capacity */
+	if ( xferbuf->size <= xferbuf->len )
+		return 0;
+
+	/* Shrink buffer */
+	if ( ( rc = xferbuf->op->realloc ( xferbuf, xferbuf->len ) ) != 0 ) {
+		DBGC ( xferbuf, "XFERBUF %p could not trim buffer to %zd "
+		       "bytes: %s\n", xferbuf, xferbuf->len, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
 /**
  * Ensure that data transfer buffer is large enough for the specified size
  *
@@ -76,8 +103,9 @@ static int xferbuf_ensure_size ( struct xfer_buffer *xferbuf, size_t len ) {
 	if ( len <= xferbuf->len )
 		return 0;
 
-	/* Extend buffer */
-	if ( ( rc = xferbuf->op->realloc ( xferbuf, len ) ) != 0 ) {
+	/* Extend buffer, unless sufficient capacity is already allocated */
+	if ( ( len > xferbuf->size ) &&
+	     ( ( rc = xferbuf->op->realloc ( xferbuf, len ) ) != 0 ) ) {
 		DBGC ( xferbuf, "XFERBUF %p could not extend buffer to "
 		       "%zd bytes: %s\n", xferbuf, len, strerror ( rc ) );
 		return rc;
@@ -163,6 +191,7 @@ int xferbuf_deliver ( struct xfer_buffer *xferbuf, struct io_buffer *iobuf,
 	if ( meta->flags & XFER_FL_ABS_OFFSET )
 		pos = 0;
 	pos += meta->offset;
+	trace ( TRACE_XFERBUF, pos, len, xferbuf->len );
 
 	/* Write data to buffer */
 	if ( ( rc = xferbuf_write ( xferbuf, pos, iobuf->data, len ) ) != 0 )
@@ -239,11 +268,34 @@ struct xfer_buffer_operations xferbuf_malloc_operations = {
 static int xferbuf_umalloc_realloc ( struct xfer_buffer *xferbuf, size_t len ) {
 	userptr_t *udata = xferbuf->data;
 	userptr_t new_udata;
+	size_t size = len;
 
-	new_udata = urealloc ( *udata, len );
-	if ( ! new_udata )
+	/* When growing an existing buffer, allocate spare capacity
+	 * to avoid copying the whole buffer for each extension.  The
+	 * initial allocation is made at exactly the requested length,
+	 * so that a buffer presized via a size hint (e.g. from an
+	 * xfer_seek()) does not waste any memory.
+	 */
+	if ( xferbuf->size && ( len > xferbuf->size ) ) {
+		size = ( xferbuf->size + ( xferbuf->size / 2 ) );
+		if ( size < len )
+			size = len;
+		new_udata = urealloc ( *udata, size );
+		if ( new_udata )
+			goto done;
+		DBGC ( xferbuf, "XFERBUF %p could not extend buffer to "
+		       "%zd bytes; trying %zd bytes\n", xferbuf, size, len );
+		size = len;
+	}
+
+	/* Reallocate to exact length */
+	new_udata = urealloc ( *udata, size );
+	if ( ( ! new_udata ) && size )
 		return -ENOSPC;
+
+ done:
 	*udata = new_udata;
+	xferbuf->size = size;
 	return 0;
 }
 
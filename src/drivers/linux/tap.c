@@ -38,7 +38,11 @@
 #include <linux/if_ether.h>
 #include <linux/if_tun.h>
 
-#define RX_BUF_SIZE 1536
+/** Receive buffer overhead beyond the MTU */
+#define RX_BUF_OVERHEAD 36
+
+/** Maximum MTU */
+#define TAP_MAX_MTU 9000
 
 /** @file
  *
@@ -47,6 +51,28 @@
  * The TAP is a Virtual Ethernet network device.
  */
 
+/** Virtio net packet header, prepended to each packet */
+struct tap_vnet_header {
+	/** Flags */
+	uint8_t flags;
+	/** Segmentation offload type */
+	uint8_t gso_type;
+	/** Header length */
+	uint16_t hdr_len;
+	/** Segment size */
+	uint16_t gso_size;
+	/** Start of checksummed region */
+	uint16_t csum_start;
+	/** Offset of checksum field within checksummed region */
+	uint16_t csum_offset;
+};
+
+/** Checksum must be completed using csum_start and csum_offset */
+#define TAP_VNET_F_NEEDS_CSUM 0x01
+
+/** Checksum has been validated */
+#define TAP_VNET_F_DATA_VALID 0x02
+
 struct tap_nic {
 	/** Tap interface name */
 	char * interface;
@@ -68,8 +94,9 @@ static int tap_open(struct net_device * netdev)
 	}
 
 	memset(&ifr, 0, sizeof(ifr));
-	/* IFF_NO_PI for no extra packet information */
-	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	/* IFF_NO_PI for no extra packet information, IFF_VNET_HDR for a
+	 * virtio net header carrying checksum offload information */
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR;
 	strncpy(ifr.ifr_name, nic->interface, IFNAMSIZ);
 	DBGC(nic, "tap %p interface = '%s'\n", nic, nic->interface);
 
@@ -81,6 +108,12 @@ static int tap_open(struct net_device * netdev)
 		return ret;
 	}
 
+	/* Allow the host to hand us packets without checksums.  This is
+	 * only an optimisation, so failure is not fatal. */
+	ret = linux_ioctl(nic->fd, TUNSETOFFLOAD, (void *)(unsigned long)TUN_F_CSUM);
+	if (ret != 0)
+		DBGC(nic, "tap %p ioctl(%d, TUNSETOFFLOAD) = %d (%s)\n", nic, nic->fd, ret, linux_strerror(linux_errno));
+
 	/* Set nonblocking mode to make tap_poll easier */
 	ret = linux_fcntl(nic->fd, F_SETFL, O_NONBLOCK);
 
@@ -90,6 +123,9 @@ static int tap_open(struct net_device * netdev)
 		return ret;
 	}
 
+	/* Checksums may be both inserted and validated by the host */
+	netdev->state |= (NETDEV_TX_CSUM | NETDEV_RX_CSUM);
+
 	return 0;
 }
 
@@ -98,6 +134,7 @@ static void tap_close(struct net_device *netdev)
 {
 	struct tap_nic * nic = netdev->priv;
 	linux_close(nic->fd);
+	netdev->state &= ~(NETDEV_TX_CSUM | NETDEV_RX_CSUM);
 }
 
 /**
@@ -108,10 +145,22 @@ static void tap_close(struct net_device *netdev)
 static int tap_transmit(struct net_device *netdev, struct io_buffer *iobuf)
 {
 	struct tap_nic * nic = netdev->priv;
+	struct tap_vnet_header *header;
 	int rc;
 
-	/* Pad and align packet */
-	iob_pad(iobuf, ETH_ZLEN);
+	/* Prepend virtio net header.  There is no need to pad the
+	 * packet, since the host will do so if necessary. */
+	if ((rc = iob_ensure_headroom(iobuf, sizeof(*header))) != 0) {
+		DBGC(nic, "tap %p no space for header\n", nic);
+		return rc;
+	}
+	header = iob_push(iobuf, sizeof(*header));
+	memset(header, 0, sizeof(*header));
+	if (iobuf->flags & IOB_CSUM_PARTIAL) {
+		header->flags = TAP_VNET_F_NEEDS_CSUM;
+		header->csum_start = (iob_csum_start(iobuf) - (iobuf->data + sizeof(*header)));
+		header->csum_offset = iobuf->csum_offset;
+	}
 
 	rc = linux_write(nic->fd, iobuf->data, iobuf->tail - iobuf->data);
 	DBGC2(nic, "tap %p wrote %d bytes\n", nic, rc);
@@ -124,8 +173,10 @@ static int tap_transmit(struct net_device *netdev, struct io_buffer *iobuf)
 static void tap_poll(struct net_device *netdev)
 {
 	struct tap_nic * nic = netdev->priv;
+	struct tap_vnet_header *header;
 	struct pollfd pfd;
 	struct io_buffer * iobuf;
+	size_t len = (sizeof(*header) + netdev->mtu + RX_BUF_OVERHEAD);
 	int r;
 
 	pfd.fd = nic->fd;
@@ -139,17 +190,28 @@ static void tap_poll(struct net_device *netdev)
 
 	/* At this point we know there is at least one new packet to be read */
 
-	iobuf = alloc_iob(RX_BUF_SIZE);
+	iobuf = netdev_alloc_rx_iob(netdev, len);
 	if (! iobuf)
 		goto allocfail;
 
-	while ((r = linux_read(nic->fd, iobuf->data, RX_BUF_SIZE)) > 0) {
+	while ((r = linux_read(nic->fd, iobuf->data, len)) > 0) {
 		DBGC2(nic, "tap %p read %d bytes\n", nic, r);
 
+		/* Record checksum status and strip virtio net header.  A
+		 * packet with an incomplete checksum originated within the
+		 * host and so is also known to be valid. */
 		iob_put(iobuf, r);
-		netdev_rx(netdev, iobuf);
-
-		iobuf = alloc_iob(RX_BUF_SIZE);
+		header = iobuf->data;
+		if ((size_t)r < sizeof(*header)) {
+			netdev_rx_err(netdev, iobuf, -EINVAL);
+		} else {
+			if (header->flags & (TAP_VNET_F_NEEDS_CSUM | TAP_VNET_F_DATA_VALID))
+				iobuf->flags |= IOB_CSUM_VERIFIED;
+			iob_pull(iobuf, sizeof(*header));
+			netdev_rx(netdev, iobuf);
+		}
+
+		iobuf = netdev_alloc_rx_iob(netdev, len);
 		if (! iobuf)
 			goto allocfail;
 	}
@@ -198,6 +260,7 @@ static int tap_probe(struct linux_device *device, struct linux_device_request *r
 	nic = netdev->priv;
 	linux_set_drvdata(device, netdev);
 	netdev->dev = &device->dev;
+	netdev->max_pkt_len = (ETH_HLEN + TAP_MAX_MTU);
 	memset(nic, 0, sizeof(*nic));
 
 	/* Look for the mandatory if setting */
@@ -25,6 +25,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <errno.h>
 #include <byteswap.h>
@@ -498,14 +499,36 @@ void intel_destroy_ring ( struct intel_nic *intel, struct intel_ring *ring ) {
 	ring->cons = 0;
 }
 
+/**
+ * Calculate receive buffer length
+ *
+ * @v netdev		Network device
+ * @ret len		Receive buffer length
+ *
+ * The hardware supports only power-of-two receive buffer lengths.
+ */
+static size_t intel_rx_len ( struct net_device *netdev ) {
+	size_t len;
+
+	/* Allow for link-layer header, VLAN tag and CRC */
+	len = ( netdev->mtu + ETH_HLEN + 4 /* VLAN */ + 4 /* CRC */ );
+	if ( len <= INTEL_RX_MAX_LEN )
+		return INTEL_RX_MAX_LEN;
+	len = ( 1UL << fls ( len - 1 ) );
+	assert ( len <= INTEL_RX_MAX_JUMBO_LEN );
+	return len;
+}
+
 /**
  * Refill receive descriptor ring
  *
- * @v intel		Intel device
+ * @v netdev		Network device
  */
-void intel_refill_rx ( struct intel_nic *intel ) {
+void intel_refill_rx ( struct net_device *netdev ) {
+	struct intel_nic *intel = netdev->priv;
 	struct intel_descriptor *rx;
 	struct io_buffer *iobuf;
+	size_t len = intel_rx_len ( netdev );
 	unsigned int rx_idx;
 	unsigned int rx_tail;
 	physaddr_t address;
@@ -515,7 +538,7 @@ void intel_refill_rx ( struct intel_nic *intel ) {
 	while ( ( intel->rx.prod - intel->rx.cons ) < INTEL_RX_FILL ) {
 
 		/* Allocate I/O buffer */
-		iobuf = alloc_iob ( INTEL_RX_MAX_LEN );
+		iobuf = netdev_alloc_rx_iob ( netdev, len );
 		if ( ! iobuf ) {
 			/* Wait for next refill */
 			break;
@@ -535,7 +558,7 @@ void intel_refill_rx ( struct intel_nic *intel ) {
 
 		DBGC2 ( intel, "INTEL %p RX %d is [%llx,%llx)\n", intel, rx_idx,
 			( ( unsigned long long ) address ),
-			( ( unsigned long long ) address + INTEL_RX_MAX_LEN ) );
+			( ( unsigned long long ) address + len ) );
 		refilled++;
 	}
 
@@ -574,6 +597,7 @@ void intel_empty_rx ( struct intel_nic *intel ) {
 static int intel_open ( struct net_device *netdev ) {
 	struct intel_nic *intel = netdev->priv;
 	union intel_receive_address mac;
+	size_t rx_len = intel_rx_len ( netdev );
 	uint32_t tctl;
 	uint32_t rctl;
 	int rc;
@@ -602,13 +626,29 @@ static int intel_open ( struct net_device *netdev ) {
 
 	/* Enable receiver */
 	rctl = readl ( intel->regs + INTEL_RCTL );
-	rctl &= ~( INTEL_RCTL_BSIZE_BSEX_MASK );
+	rctl &= ~( INTEL_RCTL_BSIZE_BSEX_MASK | INTEL_RCTL_LPE );
 	rctl |= ( INTEL_RCTL_EN | INTEL_RCTL_UPE | INTEL_RCTL_MPE |
-		  INTEL_RCTL_BAM | INTEL_RCTL_BSIZE_2048 | INTEL_RCTL_SECRC );
+		  INTEL_RCTL_BAM | INTEL_RCTL_SECRC );
+	switch ( rx_len ) {
+	case 4096:
+		rctl |= INTEL_RCTL_BSIZE_4096;
+		break;
+	case 8192:
+		rctl |= INTEL_RCTL_BSIZE_8192;
+		break;
+	case 16384:
+		rctl |= INTEL_RCTL_BSIZE_16384;
+		break;
+	default:
+		rctl |= INTEL_RCTL_BSIZE_2048;
+		break;
+	}
+	if ( netdev->mtu > ETH_MAX_MTU )
+		rctl |= INTEL_RCTL_LPE;
 	writel ( rctl, intel->regs + INTEL_RCTL );
 
 	/* Fill receive ring */
-	intel_refill_rx ( intel );
+	intel_refill_rx ( netdev );
 
 	/* Update link state */
 	intel_check_link ( netdev );
@@ -737,6 +777,8 @@ void intel_poll_rx ( struct net_device *netdev ) {
 	struct intel_nic *intel = netdev->priv;
 	struct intel_descriptor *rx;
 	struct io_buffer *iobuf;
+	LIST_HEAD ( batch );
+	unsigned int fill = ( intel->rx.prod - intel->rx.cons );
 	unsigned int rx_idx;
 	size_t len;
 
@@ -749,7 +791,7 @@ void intel_poll_rx ( struct net_device *netdev ) {
 
 		/* Stop if descriptor is still in use */
 		if ( ! ( rx->status & cpu_to_le32 ( INTEL_DESC_STATUS_DD ) ) )
-			return;
+			break;
 
 		/* Populate I/O buffer */
 		iobuf = intel->rx_iobuf[rx_idx];
@@ -757,7 +799,7 @@ void intel_poll_rx ( struct net_device *netdev ) {
 		len = le16_to_cpu ( rx->length );
 		iob_put ( iobuf, len );
 
-		/* Hand off to network stack */
+		/* Add to batch for network stack */
 		if ( rx->status & cpu_to_le32 ( INTEL_DESC_STATUS_RXE ) ) {
 			DBGC ( intel, "INTEL %p RX %d error (length %zd, "
 			       "status %08x)\n", intel, rx_idx, len,
@@ -766,10 +808,17 @@ void intel_poll_rx ( struct net_device *netdev ) {
 		} else {
 			DBGC2 ( intel, "INTEL %p RX %d complete (length %zd)\n",
 				intel, rx_idx, len );
-			netdev_rx ( netdev, iobuf );
+			list_add_tail ( &iobuf->list, &batch );
 		}
 		intel->rx.cons++;
 	}
+
+	/* Record a possible overrun if the entire ring was consumed */
+	if ( ( fill == INTEL_RX_FILL ) && ( intel->rx.cons == intel->rx.prod ) )
+		netdev_rx_overrun ( netdev );
+
+	/* Hand off batch to network stack */
+	netdev_rx_batch ( netdev, &batch );
 }
 
 /**
@@ -815,7 +864,7 @@ static void intel_poll ( struct net_device *netdev ) {
 	}
 
 	/* Refill RX ring */
-	intel_refill_rx ( intel );
+	intel_refill_rx ( netdev );
 }
 
 /**
@@ -876,6 +925,8 @@ static int intel_probe ( struct pci_device *pci ) {
 	memset ( intel, 0, sizeof ( *intel ) );
 	intel->port = PCI_FUNC ( pci->busdevfn );
 	intel->flags = pci->id->driver_data;
+	if ( ! ( intel->flags & INTEL_NO_JUMBO ) )
+		netdev->max_pkt_len = INTEL_MAX_JUMBO_PKT_LEN;
 	intel_init_ring ( &intel->tx, INTEL_NUM_TX_DESC, INTEL_TD,
 			  intel_describe_tx );
 	intel_init_ring ( &intel->rx, INTEL_NUM_RX_DESC, INTEL_RD,
@@ -973,11 +1024,16 @@ static struct pci_device_id intel_nics[] = {
 	PCI_ROM ( 0x8086, 0x1026, "82545gm", "82545GM", 0 ),
 	PCI_ROM ( 0x8086, 0x1027, "82545gm-1", "82545GM", 0 ),
 	PCI_ROM ( 0x8086, 0x1028, "82545gm-2", "82545GM", 0 ),
-	PCI_ROM ( 0x8086, 0x1049, "82566mm", "82566MM", INTEL_PBS_ERRATA ),
-	PCI_ROM ( 0x8086, 0x104a, "82566dm", "82566DM", INTEL_PBS_ERRATA ),
-	PCI_ROM ( 0x8086, 0x104b, "82566dc", "82566DC", INTEL_PBS_ERRATA ),
-	PCI_ROM ( 0x8086, 0x104c, "82562v", "82562V", INTEL_PBS_ERRATA ),
-	PCI_ROM ( 0x8086, 0x104d, "82566mc", "82566MC", INTEL_PBS_ERRATA ),
+	PCI_ROM ( 0x8086, 0x1049, "82566mm", "82566MM",
+		  ( INTEL_PBS_ERRATA | INTEL_NO_JUMBO ) ),
+	PCI_ROM ( 0x8086, 0x104a, "82566dm", "82566DM",
+		  ( INTEL_PBS_ERRATA | INTEL_NO_JUMBO ) ),
+	PCI_ROM ( 0x8086, 0x104b, "82566dc", "82566DC",
+		  ( INTEL_PBS_ERRATA | INTEL_NO_JUMBO ) ),
+	PCI_ROM ( 0x8086, 0x104c, "82562v", "82562V",
+		  ( INTEL_PBS_ERRATA | INTEL_NO_JUMBO ) ),
+	PCI_ROM ( 0x8086, 0x104d, "82566mc", "82566MC",
+		  ( INTEL_PBS_ERRATA | INTEL_NO_JUMBO ) ),
 	PCI_ROM ( 0x8086, 0x105e, "82571eb", "82571EB", 0 ),
 	PCI_ROM ( 0x8086, 0x105f, "82571eb-1", "82571EB", 0 ),
 	PCI_ROM ( 0x8086, 0x1060, "82571eb-2", "82571EB", 0 ),
@@ -998,7 +1054,7 @@ static struct pci_device_id intel_nics[] = {
 	PCI_ROM ( 0x8086, 0x1096, "80003es2lan", "80003ES2LAN (Copper)", 0 ),
 	PCI_ROM ( 0x8086, 0x1098, "80003es2lan-s", "80003ES2LAN (Serdes)", 0 ),
 	PCI_ROM ( 0x8086, 0x1099, "82546gb-4", "82546GB (Copper)", 0 ),
-	PCI_ROM ( 0x8086, 0x109a, "82573l", "82573L", 0 ),
+	PCI_ROM ( 0x8086, 0x109a, "82573l", "82573L", INTEL_NO_JUMBO ),
 	PCI_ROM ( 0x8086, 0x10a4, "82571eb", "82571EB", 0 ),
 	PCI_ROM ( 0x8086, 0x10a5, "82571eb", "82571EB (Fiber)", 0 ),
 	PCI_ROM ( 0x8086, 0x10a7, "82575eb", "82575EB", 0 ),
@@ -1013,8 +1069,10 @@ static struct pci_device_id intel_nics[] = {
 	PCI_ROM ( 0x8086, 0x10c0, "82562v-2", "82562V-2", 0 ),
 	PCI_ROM ( 0x8086, 0x10c2, "82562g-2", "82562G-2", 0 ),
 	PCI_ROM ( 0x8086, 0x10c3, "82562gt-2", "82562GT-2", 0 ),
-	PCI_ROM ( 0x8086, 0x10c4, "82562gt", "82562GT", INTEL_PBS_ERRATA ),
-	PCI_ROM ( 0x8086, 0x10c5, "82562g", "82562G", INTEL_PBS_ERRATA ),
+	PCI_ROM ( 0x8086, 0x10c4, "82562gt", "82562GT",
+		  ( INTEL_PBS_ERRATA | INTEL_NO_JUMBO ) ),
+	PCI_ROM ( 0x8086, 0x10c5, "82562g", "82562G",
+		  ( INTEL_PBS_ERRATA | INTEL_NO_JUMBO ) ),
 	PCI_ROM ( 0x8086, 0x10c9, "82576", "82576", 0 ),
 	PCI_ROM ( 0x8086, 0x10cb, "82567v", "82567V", 0 ),
 	PCI_ROM ( 0x8086, 0x10cc, "82567lm-2", "82567LM-2", 0 ),
@@ -1037,11 +1095,12 @@ static struct pci_device_id intel_nics[] = {
 	PCI_ROM ( 0x8086, 0x10f0, "82578dc", "82578DC", 0 ),
 	PCI_ROM ( 0x8086, 0x10f5, "82567lm", "82567LM", 0 ),
 	PCI_ROM ( 0x8086, 0x10f6, "82574l", "82574L", 0 ),
-	PCI_ROM ( 0x8086, 0x1501, "82567v-3", "82567V-3", INTEL_PBS_ERRATA ),
+	PCI_ROM ( 0x8086, 0x1501, "82567v-3", "82567V-3",
+		  ( INTEL_PBS_ERRATA | INTEL_NO_JUMBO ) ),
 	PCI_ROM ( 0x8086, 0x1502, "82579lm", "82579LM", INTEL_NO_PHY_RST ),
 	PCI_ROM ( 0x8086, 0x1503, "82579v", "82579V", 0 ),
 	PCI_ROM ( 0x8086, 0x150a, "82576ns", "82576NS", 0 ),
-	PCI_ROM ( 0x8086, 0x150c, "82583v", "82583V", 0 ),
+	PCI_ROM ( 0x8086, 0x150c, "82583v", "82583V", INTEL_NO_JUMBO ),
 	PCI_ROM ( 0x8086, 0x150d, "82576-4", "82576 Backplane", 0 ),
 	PCI_ROM ( 0x8086, 0x150e, "82580", "82580", 0 ),
 	PCI_ROM ( 0x8086, 0x150f, "82580-f", "82580 Fiber", 0 ),
@@ -113,10 +113,14 @@ struct intel_descriptor {
 #define INTEL_RCTL_EN		0x00000002UL	/**< Receive enable */
 #define INTEL_RCTL_UPE		0x00000008UL	/**< Unicast promiscuous mode */
 #define INTEL_RCTL_MPE		0x00000010UL	/**< Multicast promiscuous */
+#define INTEL_RCTL_LPE		0x00000020UL	/**< Long packet enable */
 #define INTEL_RCTL_BAM		0x00008000UL	/**< Broadcast accept mode */
 #define INTEL_RCTL_BSIZE_BSEX(bsex,bsize) \
 	( ( (bsize) << 16 ) | ( (bsex) << 25 ) ) /**< Buffer size */
 #define INTEL_RCTL_BSIZE_2048	INTEL_RCTL_BSIZE_BSEX ( 0, 0 )
+#define INTEL_RCTL_BSIZE_4096	INTEL_RCTL_BSIZE_BSEX ( 1, 3 )
+#define INTEL_RCTL_BSIZE_8192	INTEL_RCTL_BSIZE_BSEX ( 1, 2 )
+#define INTEL_RCTL_BSIZE_16384	INTEL_RCTL_BSIZE_BSEX ( 1, 1 )
 #define INTEL_RCTL_BSIZE_BSEX_MASK INTEL_RCTL_BSIZE_BSEX ( 1, 3 )
 #define INTEL_RCTL_SECRC	0x04000000UL	/**< Strip CRC */
 
@@ -153,6 +157,12 @@ struct intel_descriptor {
 /** Receive buffer length */
 #define INTEL_RX_MAX_LEN 2048
 
+/** Maximum jumbo receive buffer length */
+#define INTEL_RX_MAX_JUMBO_LEN 16384
+
+/** Maximum packet length (including link-layer header) with jumbo frames */
+#define INTEL_MAX_JUMBO_PKT_LEN ( ETH_HLEN + 9000 )
+
 /** Transmit Descriptor register block */
 #define INTEL_TD 0x03800UL
 
@@ -303,6 +313,8 @@ enum intel_flags {
 	INTEL_VMWARE = 0x0002,
 	/** PHY reset is broken */
 	INTEL_NO_PHY_RST = 0x0004,
+	/** Jumbo frames are not supported */
+	INTEL_NO_JUMBO = 0x0008,
 };
 
 /**
@@ -334,7 +346,7 @@ extern int intel_create_ring ( struct intel_nic *intel,
 			       struct intel_ring *ring );
 extern void intel_destroy_ring ( struct intel_nic *intel,
 				 struct intel_ring *ring );
-extern void intel_refill_rx ( struct intel_nic *intel );
+extern void intel_refill_rx ( struct net_device *netdev );
 extern void intel_empty_rx ( struct intel_nic *intel );
 extern int intel_transmit ( struct net_device *netdev,
 			    struct io_buffer *iobuf );
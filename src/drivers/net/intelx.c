@@ -257,7 +257,7 @@ static int intelx_open ( struct net_device *netdev ) {
 	writel ( rxctrl, intel->regs + INTELX_RXCTRL );
 
 	/* Fill receive ring */
-	intel_refill_rx ( intel );
+	intel_refill_rx ( netdev );
 
 	/* Update link state */
 	intelx_check_link ( netdev );
@@ -335,7 +335,7 @@ static void intelx_poll ( struct net_device *netdev ) {
 		intelx_check_link ( netdev );
 
 	/* Refill RX ring */
-	intel_refill_rx ( intel );
+	intel_refill_rx ( netdev );
 }
 
 /**
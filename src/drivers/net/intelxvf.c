@@ -297,7 +297,7 @@ static int intelxvf_open ( struct net_device *netdev ) {
 	writel ( dca_rxctrl, intel->regs + INTELXVF_DCA_RXCTRL );
 
 	/* Fill receive ring */
-	intel_refill_rx ( intel );
+	intel_refill_rx ( netdev );
 
 	/* Update link state */
 	intelxvf_check_link ( netdev );
@@ -374,7 +374,7 @@ static void intelxvf_poll ( struct net_device *netdev ) {
 	}
 
 	/* Refill RX ring */
-	intel_refill_rx ( intel );
+	intel_refill_rx ( netdev );
 }
 
 /**
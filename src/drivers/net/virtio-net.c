@@ -24,13 +24,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <byteswap.h>
 #include <ipxe/list.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/pci.h>
 #include <ipxe/if_ether.h>
 #include <ipxe/ethernet.h>
+#include <ipxe/tcpip.h>
 #include <ipxe/virtio-pci.h>
 #include <ipxe/virtio-ring.h>
 #include "virtio-net.h"
@@ -81,8 +84,11 @@ enum {
 	/** Max number of pending rx packets */
 	NUM_RX_BUF = 8,
 
-	/** Max Ethernet frame length, including FCS and VLAN tag */
-	RX_BUF_SIZE = 1522,
+	/** Ethernet frame overhead, including header, FCS and VLAN tag */
+	RX_BUF_OVERHEAD = ( ETH_HLEN + 4 /* FCS */ + 4 /* VLAN */ ),
+
+	/** Max MTU, if not advised by the host */
+	MAX_MTU = 9000,
 };
 
 struct virtnet_nic {
@@ -104,40 +110,50 @@ struct virtnet_nic {
 	/** Pending rx packet count */
 	unsigned int rx_num_iobufs;
 
-	/** Virtio net packet header, we only need one */
+	/** Virtio net packet header for tx packets without checksum
+	 * offload, we only need one
+	 */
 	struct virtio_net_hdr_modern empty_header;
 };
 
+/** Get virtio net packet header length
+ *
+ * @v virtnet		Virtio-net device
+ * @ret header_len	Packet header length
+ */
+static inline size_t virtnet_header_len ( struct virtnet_nic *virtnet ) {
+	return ( virtnet->virtio_version ?
+		 sizeof ( virtnet->empty_header ) :
+		 sizeof ( virtnet->empty_header.legacy ) );
+}
+
 /** Add an iobuf to a virtqueue
  *
  * @v netdev		Network device
  * @v vq_idx		Virtqueue index (RX_INDEX or TX_INDEX)
  * @v iobuf		I/O buffer
+ * @v header		Packet header, or NULL if held within the iobuf
  *
  * The virtqueue is kicked after the iobuf has been added.
  */
 static void virtnet_enqueue_iob ( struct net_device *netdev,
-				  int vq_idx, struct io_buffer *iobuf ) {
+				  int vq_idx, struct io_buffer *iobuf,
+				  struct virtio_net_hdr_modern *header ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	struct vring_virtqueue *vq = &virtnet->virtqueue[vq_idx];
 	unsigned int out = ( vq_idx == TX_INDEX ) ? 2 : 0;
 	unsigned int in = ( vq_idx == TX_INDEX ) ? 0 : 2;
-	size_t header_len = virtnet->virtio_version
-		? sizeof ( virtnet->empty_header )
-		: sizeof ( virtnet->empty_header.legacy );
+	size_t header_len = virtnet_header_len ( virtnet );
+	size_t skip = ( header ? 0 : header_len );
 	struct vring_list list[] = {
 		{
-			/* Share a single zeroed virtio net header between all
-			 * rx and tx packets.  This works because this driver
-			 * does not use any advanced features so none of the
-			 * header fields get used.
-			 */
-			.addr = ( char* ) &virtnet->empty_header,
+			.addr = ( header ? ( char * ) header :
+				  ( char * ) iobuf->data ),
 			.length = header_len,
 		},
 		{
-			.addr = ( char* ) iobuf->data,
-			.length = iob_len ( iobuf ),
+			.addr = ( ( char * ) iobuf->data + skip ),
+			.length = ( iob_len ( iobuf ) - skip ),
 		},
 	};
 
@@ -156,25 +172,46 @@ static void virtnet_enqueue_iob ( struct net_device *netdev,
 static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 
+	size_t len = ( virtnet_header_len ( virtnet ) + netdev->mtu +
+		       RX_BUF_OVERHEAD );
+
 	while ( virtnet->rx_num_iobufs < NUM_RX_BUF ) {
 		struct io_buffer *iobuf;
 
 		/* Try to allocate a buffer, stop for now if out of memory */
-		iobuf = alloc_iob ( RX_BUF_SIZE );
+		iobuf = netdev_alloc_rx_iob ( netdev, len );
 		if ( ! iobuf )
 			break;
 
 		/* Keep track of iobuf so close() can free it */
 		list_add ( &iobuf->list, &virtnet->rx_iobufs );
 
-		/* Mark packet length until we know the actual size */
-		iob_put ( iobuf, RX_BUF_SIZE );
+		/* Mark packet length until we know the actual size.  The
+		 * packet header is received into the start of the
+		 * iobuf, so that its checksum status can be inspected.
+		 */
+		iob_put ( iobuf, len );
 
-		virtnet_enqueue_iob ( netdev, RX_INDEX, iobuf );
+		virtnet_enqueue_iob ( netdev, RX_INDEX, iobuf, NULL );
 		virtnet->rx_num_iobufs++;
 	}
 }
 
+/** Record negotiated checksum offload features
+ *
+ * @v netdev	Network device
+ * @v features	Negotiated features
+ */
+static void virtnet_csum_features ( struct net_device *netdev,
+				    u64 features ) {
+
+	netdev->state &= ~( NETDEV_TX_CSUM | NETDEV_RX_CSUM );
+	if ( features & ( 1ULL << VIRTIO_NET_F_CSUM ) )
+		netdev->state |= NETDEV_TX_CSUM;
+	if ( features & ( 1ULL << VIRTIO_NET_F_GUEST_CSUM ) )
+		netdev->state |= NETDEV_RX_CSUM;
+}
+
 /** Open network device, legacy virtio 0.9.5
  *
  * @v netdev	Network device
@@ -215,8 +252,12 @@ static int virtnet_open_legacy ( struct net_device *netdev ) {
 	netdev_irq ( netdev, 0 );
 
 	/* Driver is ready */
-	features = vp_get_features ( ioaddr );
-	vp_set_features ( ioaddr, features & ( 1 << VIRTIO_NET_F_MAC ) );
+	features = ( vp_get_features ( ioaddr ) &
+		     ( ( 1 << VIRTIO_NET_F_MAC ) |
+		       ( 1 << VIRTIO_NET_F_CSUM ) |
+		       ( 1 << VIRTIO_NET_F_GUEST_CSUM ) ) );
+	vp_set_features ( ioaddr, features );
+	virtnet_csum_features ( netdev, features );
 	vp_set_status ( ioaddr, VIRTIO_CONFIG_S_DRIVER | VIRTIO_CONFIG_S_DRIVER_OK );
 	return 0;
 }
@@ -237,10 +278,13 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 		vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FAILED );
 		return -EINVAL;
 	}
-	vpm_set_features ( &virtnet->vdev, features & (
-		( 1ULL << VIRTIO_NET_F_MAC ) |
-		( 1ULL << VIRTIO_F_VERSION_1 ) |
-		( 1ULL << VIRTIO_F_ANY_LAYOUT ) ) );
+	features &= ( ( 1ULL << VIRTIO_NET_F_MAC ) |
+		      ( 1ULL << VIRTIO_NET_F_CSUM ) |
+		      ( 1ULL << VIRTIO_NET_F_GUEST_CSUM ) |
+		      ( 1ULL << VIRTIO_NET_F_MTU ) |
+		      ( 1ULL << VIRTIO_F_VERSION_1 ) |
+		      ( 1ULL << VIRTIO_F_ANY_LAYOUT ) );
+	vpm_set_features ( &virtnet->vdev, features );
 	vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FEATURES_OK );
 
 	status = vpm_get_status ( &virtnet->vdev );
@@ -250,6 +294,7 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 		vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FAILED );
 		return -EINVAL;
 	}
+	virtnet_csum_features ( netdev, features );
 
 	/* Allocate virtqueues */
 	virtnet->virtqueue = zalloc ( QUEUE_NB *
@@ -326,6 +371,9 @@ static void virtnet_close ( struct net_device *netdev ) {
 	}
 	INIT_LIST_HEAD ( &virtnet->rx_iobufs );
 	virtnet->rx_num_iobufs = 0;
+
+	/* Checksum offload features are renegotiated on open */
+	netdev->state &= ~( NETDEV_TX_CSUM | NETDEV_RX_CSUM );
 }
 
 /** Transmit packet
@@ -336,7 +384,30 @@ static void virtnet_close ( struct net_device *netdev ) {
  */
 static int virtnet_transmit ( struct net_device *netdev,
 			      struct io_buffer *iobuf ) {
-	virtnet_enqueue_iob ( netdev, TX_INDEX, iobuf );
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct virtio_net_hdr_modern *header;
+	size_t header_len = virtnet_header_len ( virtnet );
+
+	/* Construct a packet header within the iobuf if the checksum
+	 * is to be inserted by the device, otherwise share a single
+	 * zeroed header between all packets.
+	 */
+	if ( iobuf->flags & IOB_CSUM_PARTIAL ) {
+		if ( iob_headroom ( iobuf ) >= header_len ) {
+			header = iob_push ( iobuf, header_len );
+			memset ( header, 0, header_len );
+			header->legacy.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+			header->legacy.csum_start =
+				( iob_csum_start ( iobuf ) -
+				  ( iobuf->data + header_len ) );
+			header->legacy.csum_offset = iobuf->csum_offset;
+			virtnet_enqueue_iob ( netdev, TX_INDEX, iobuf, NULL );
+			return 0;
+		}
+		tcpip_csum_complete ( iobuf );
+	}
+	virtnet_enqueue_iob ( netdev, TX_INDEX, iobuf,
+			      &virtnet->empty_header );
 	return 0;
 }
 
@@ -366,17 +437,30 @@ static void virtnet_process_rx_packets ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	struct vring_virtqueue *rx_vq = &virtnet->virtqueue[RX_INDEX];
 
+	size_t header_len = virtnet_header_len ( virtnet );
+
 	while ( vring_more_used ( rx_vq ) ) {
 		unsigned int len;
 		struct io_buffer *iobuf = vring_get_buf ( rx_vq, &len );
+		struct virtio_net_hdr *header = iobuf->data;
 
 		/* Release ownership of iobuf */
 		list_del ( &iobuf->list );
 		virtnet->rx_num_iobufs--;
 
 		/* Update iobuf length */
-		iob_unput ( iobuf, RX_BUF_SIZE );
-		iob_put ( iobuf, len - sizeof ( struct virtio_net_hdr ) );
+		iob_unput ( iobuf, iob_len ( iobuf ) );
+		iob_put ( iobuf, len );
+
+		/* Record checksum status and strip packet header.  A
+		 * packet with an incomplete checksum originated within
+		 * the host and so is also known to be valid.
+		 */
+		if ( header->flags & ( VIRTIO_NET_HDR_F_NEEDS_CSUM |
+				       VIRTIO_NET_HDR_F_DATA_VALID ) ) {
+			iobuf->flags |= IOB_CSUM_VERIFIED;
+		}
+		iob_pull ( iobuf, header_len );
 
 		DBGC2 ( virtnet, "VIRTIO-NET %p rx complete iobuf %p len %zd\n",
 			virtnet, iobuf, iob_len ( iobuf ) );
@@ -458,6 +542,7 @@ static int virtnet_probe_legacy ( struct pci_device *pci ) {
 	virtnet->ioaddr = ioaddr;
 	pci_set_drvdata ( pci, netdev );
 	netdev->dev = &pci->dev;
+	netdev->max_pkt_len = ( ETH_HLEN + MAX_MTU );
 
 	DBGC ( virtnet, "VIRTIO-NET %p busaddr=%s ioaddr=%#lx irq=%d\n",
 	       virtnet, pci->dev.name, ioaddr, pci->irq );
@@ -503,6 +588,7 @@ static int virtnet_probe_modern ( struct pci_device *pci, int *found_dev ) {
 	struct net_device *netdev;
 	struct virtnet_nic *virtnet;
 	u64 features;
+	u16 mtu;
 	int rc, common, isr, notify, config, device;
 
 	common = virtio_pci_find_capability ( pci, VIRTIO_PCI_CAP_COMMON_CFG );
@@ -531,6 +617,7 @@ static int virtnet_probe_modern ( struct pci_device *pci, int *found_dev ) {
 
 	pci_set_drvdata ( pci, netdev );
 	netdev->dev = &pci->dev;
+	netdev->max_pkt_len = ( ETH_HLEN + MAX_MTU );
 
 	DBGC ( virtnet, "VIRTIO-NET modern %p busaddr=%s irq=%d\n",
 	       virtnet, pci->dev.name, pci->irq );
@@ -579,6 +666,18 @@ static int virtnet_probe_modern ( struct pci_device *pci, int *found_dev ) {
 			DBGC ( virtnet, "VIRTIO-NET %p mac=%s\n", virtnet,
 			       eth_ntoa ( netdev->hw_addr ) );
 		}
+
+		/* Use host-advised MTU, if any */
+		if ( features & ( 1ULL << VIRTIO_NET_F_MTU ) ) {
+			vpm_get ( &virtnet->vdev,
+				  offsetof ( struct virtio_net_config, mtu ),
+				  &mtu, sizeof ( mtu ) );
+			mtu = le16_to_cpu ( mtu );
+			DBGC ( virtnet, "VIRTIO-NET %p mtu=%d\n", virtnet,
+			       mtu );
+			netdev->max_pkt_len = ( ETH_HLEN + mtu );
+			netdev->mtu = mtu;
+		}
 	}
 
 	/* We need a valid MAC address */
@@ -200,6 +200,16 @@ static void vmxnet3_flush_tx ( struct net_device *netdev ) {
 	}
 }
 
+/**
+ * Calculate receive buffer length
+ *
+ * @v netdev		Network device
+ * @ret len		Receive buffer length
+ */
+static inline size_t vmxnet3_rx_len ( struct net_device *netdev ) {
+	return ( netdev->mtu + VMXNET3_RX_OVERHEAD );
+}
+
 /**
  * Refill receive ring
  *
@@ -209,6 +219,7 @@ static void vmxnet3_refill_rx ( struct net_device *netdev ) {
 	struct vmxnet3_nic *vmxnet = netdev_priv ( netdev );
 	struct vmxnet3_rx_desc *rx_desc;
 	struct io_buffer *iobuf;
+	size_t len = vmxnet3_rx_len ( netdev );
 	unsigned int orig_rx_prod = vmxnet->count.rx_prod;
 	unsigned int desc_idx;
 	unsigned int generation;
@@ -223,7 +234,7 @@ static void vmxnet3_refill_rx ( struct net_device *netdev ) {
 		assert ( vmxnet->rx_iobuf[desc_idx] == NULL );
 
 		/* Allocate I/O buffer */
-		iobuf = alloc_iob ( VMXNET3_MTU + NET_IP_ALIGN );
+		iobuf = netdev_alloc_rx_iob ( netdev, ( len + NET_IP_ALIGN ) );
 		if ( ! iobuf ) {
 			/* Non-fatal low memory condition */
 			break;
@@ -240,7 +251,7 @@ static void vmxnet3_refill_rx ( struct net_device *netdev ) {
 		/* Populate receive descriptor */
 		rx_desc = &vmxnet->dma->rx_desc[desc_idx];
 		rx_desc->address = cpu_to_le64 ( virt_to_bus ( iobuf->data ) );
-		rx_desc->flags = ( generation | cpu_to_le32 ( VMXNET3_MTU ) );
+		rx_desc->flags = ( generation | cpu_to_le32 ( len ) );
 
 	}
 
@@ -501,7 +512,7 @@ static int vmxnet3_open ( struct net_device *netdev ) {
 		cpu_to_le32 ( VMXNET3_UPT_VERSION_SELECT );
 	shared->misc.queue_desc_address = cpu_to_le64 ( queues_bus );
 	shared->misc.queue_desc_len = cpu_to_le32 ( sizeof ( *queues ) );
-	shared->misc.mtu = cpu_to_le32 ( VMXNET3_MTU );
+	shared->misc.mtu = cpu_to_le32 ( vmxnet3_rx_len ( netdev ) );
 	shared->misc.num_tx_queues = 1;
 	shared->misc.num_rx_queues = 1;
 	shared->interrupt.num_intrs = 1;
@@ -635,6 +646,7 @@ static int vmxnet3_probe ( struct pci_device *pci ) {
 	vmxnet = netdev_priv ( netdev );
 	pci_set_drvdata ( pci, netdev );
 	netdev->dev = &pci->dev;
+	netdev->max_pkt_len = ( ETH_HLEN + VMXNET3_MAX_MTU );
 	memset ( vmxnet, 0, sizeof ( *vmxnet ) );
 
 	/* Fix up PCI device */
@@ -490,8 +490,11 @@ struct vmxnet3_nic {
 /** UPT version that we support */
 #define VMXNET3_UPT_VERSION_SELECT 1
 
-/** MTU size */
-#define VMXNET3_MTU ( ETH_FRAME_LEN + 4 /* VLAN */ + 4 /* FCS */ )
+/** Maximum MTU size */
+#define VMXNET3_MAX_MTU 9000
+
+/** Receive buffer overhead */
+#define VMXNET3_RX_OVERHEAD ( ETH_HLEN + 4 /* VLAN */ + 4 /* FCS */ )
 
 /** Transmit ring maximum fill level */
 #define VMXNET3_TX_FILL ( VMXNET3_NUM_TX_DESC - 1 )
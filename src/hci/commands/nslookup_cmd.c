@@ -21,8 +21,10 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdio.h>
 #include <getopt.h>
+#include <errno.h>
 #include <ipxe/command.h>
 #include <ipxe/parseopt.h>
+#include <ipxe/dns.h>
 #include <usr/nslookup.h>
 
 /** @file
@@ -32,15 +34,25 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 
 /** "nslookup" options */
-struct nslookup_options {};
+struct nslookup_options {
+	/** Flush DNS cache */
+	int flush;
+	/** Show DNS cache statistics */
+	int stats;
+};
 
 /** "nslookup" option list */
-static struct option_descriptor nslookup_opts[] = {};
+static struct option_descriptor nslookup_opts[] = {
+	OPTION_DESC ( "flush", 'f', no_argument,
+		      struct nslookup_options, flush, parse_flag ),
+	OPTION_DESC ( "stats", 's', no_argument,
+		      struct nslookup_options, stats, parse_flag ),
+};
 
 /** "nslookup" command descriptor */
 static struct command_descriptor nslookup_cmd =
-	COMMAND_DESC ( struct nslookup_options, nslookup_opts, 2, 2,
-		       "<setting> <name>" );
+	COMMAND_DESC ( struct nslookup_options, nslookup_opts, 0, 2,
+		       "[<setting> <name>]" );
 
 /**
  * The "nslookup" command
@@ -59,6 +71,22 @@ static int nslookup_exec ( int argc, char **argv ) {
 	if ( ( rc = parse_options ( argc, argv, &nslookup_cmd, &opts ) ) != 0 )
 		return rc;
 
+	/* Flush DNS cache, if applicable */
+	if ( opts.flush )
+		dns_cache_flush();
+
+	/* Show DNS cache statistics, if applicable */
+	if ( opts.stats )
+		nslookup_stat();
+
+	/* Allow cache operations without a name to be resolved */
+	if ( ( optind == argc ) && ( opts.flush || opts.stats ) )
+		return 0;
+	if ( ( optind + 2 ) != argc ) {
+		print_usage ( &nslookup_cmd, argv );
+		return -EINVAL;
+	}
+
 	/* Parse setting name */
 	setting_name = argv[optind];
 
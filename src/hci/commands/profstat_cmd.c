@@ -36,10 +36,20 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 /** "profstat" options */
-struct profstat_options {};
+struct profstat_options {
+	/** Show per-process statistics */
+	int processes;
+	/** Reset statistics */
+	int reset;
+};
 
 /** "profstat" option list */
-static struct option_descriptor profstat_opts[] = {};
+static struct option_descriptor profstat_opts[] = {
+	OPTION_DESC ( "processes", 'p', no_argument,
+		      struct profstat_options, processes, parse_flag ),
+	OPTION_DESC ( "reset", 'r', no_argument,
+		      struct profstat_options, reset, parse_flag ),
+};
 
 /** "profstat" command descriptor */
 static struct command_descriptor profstat_cmd =
@@ -60,7 +70,14 @@ static int profstat_exec ( int argc, char **argv ) {
 	if ( ( rc = parse_options ( argc, argv, &profstat_cmd, &opts ) ) != 0 )
 		return rc;
 
-	profstat();
+	/* Reset or show statistics */
+	if ( opts.reset ) {
+		profstat_reset();
+	} else if ( opts.processes ) {
+		profstat_processes();
+	} else {
+		profstat();
+	}
 
 	return 0;
 }
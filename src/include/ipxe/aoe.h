@@ -106,8 +106,12 @@ struct aoehdr {
 /** AoE tag magic marker */
 #define AOE_TAG_MAGIC 0x18ae0000
 
-/** Maximum number of sectors per packet */
-#define AOE_MAX_COUNT 2
+/** Maximum number of sectors per packet
+ *
+ * The actual limit is normally imposed by the MTU; this is the limit
+ * imposed by the 8-bit sector count field.
+ */
+#define AOE_MAX_COUNT 255
 
 /** AoE boot firmware table signature */
 #define ABFT_SIG ACPI_SIGNATURE ( 'a', 'B', 'F', 'T' )
@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <ipxe/in.h>
+#include <ipxe/list.h>
 
 /** DNS server port */
 #define DNS_PORT 53
@@ -55,6 +56,23 @@ struct dns_name {
 /** Maximum length of a DNS name (mandated by RFC1035 section 2.3.4) */
 #define DNS_MAX_NAME_LEN 255
 
+/** Maximum number of DNS servers
+ *
+ * Queries are sent to all DNS servers simultaneously.
+ */
+#define DNS_MAX_SERVERS 4
+
+/** Maximum number of concurrent queries (one per address family) */
+#define DNS_MAX_QUERIES 2
+
+/** Resolution delay
+ *
+ * This is the time for which an IPv4 address will be held back while
+ * waiting for an AAAA query to complete, as recommended by RFC 8305
+ * section 3.
+ */
+#define DNS_RESOLUTION_DELAY ( TICKS_PER_SEC / 20 )
+
 /** Maximum depth of CNAME recursion
  *
  * This is a policy decision.
@@ -134,6 +152,29 @@ struct dns_rr_cname {
 	struct dns_rr_common common;
 } __attribute__ (( packed ));
 
+/** Type of a DNS "SOA" record */
+#define DNS_TYPE_SOA 6
+
+/** A DNS "SOA" record */
+struct dns_rr_soa {
+	/** Common fields */
+	struct dns_rr_common common;
+} __attribute__ (( packed ));
+
+/** DNS "SOA" record timers (following the MNAME and RNAME fields) */
+struct dns_soa_timers {
+	/** Zone serial number */
+	uint32_t serial;
+	/** Refresh interval */
+	uint32_t refresh;
+	/** Retry interval */
+	uint32_t retry;
+	/** Expiry interval */
+	uint32_t expire;
+	/** Minimum time to live (used for negative caching) */
+	uint32_t minimum;
+} __attribute__ (( packed ));
+
 /** A DNS resource record */
 union dns_rr {
 	/** Common fields */
@@ -144,12 +185,72 @@ union dns_rr {
 	struct dns_rr_aaaa aaaa;
 	/** "CNAME" record */
 	struct dns_rr_cname cname;
+	/** "SOA" record */
+	struct dns_rr_soa soa;
 };
 
+/** A DNS cache entry */
+struct dns_cache_entry {
+	/** List of DNS cache entries */
+	struct list_head list;
+	/** Query type (in network byte order) */
+	uint16_t qtype;
+	/** Status code (zero for a positive entry) */
+	int rc;
+	/** Resolved address (for a positive entry) */
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} address;
+	/** Time at which entry was created */
+	unsigned long created;
+	/** Time to live (in seconds) */
+	unsigned long ttl;
+	/** Name as originally requested */
+	char name[0];
+};
+
+/** DNS cache statistics */
+struct dns_cache_statistics {
+	/** Number of positive cache hits */
+	unsigned long hits;
+	/** Number of negative cache hits */
+	unsigned long negative;
+	/** Number of cache misses */
+	unsigned long misses;
+};
+
+/** Default maximum DNS cache entry lifetime (in seconds)
+ *
+ * This may be overridden using the "dnsttl" setting.
+ */
+#define DNS_CACHE_MAX_TTL 300
+
+/** Negative DNS cache entry lifetime used in the absence of an SOA
+ * record (in seconds)
+ */
+#define DNS_CACHE_NEGATIVE_TTL 60
+
+/** Maximum number of DNS cache entries
+ *
+ * This is a policy decision.
+ */
+#define DNS_CACHE_MAX_ENTRIES 32
+
 extern int dns_encode ( const char *string, struct dns_name *name );
 extern int dns_decode ( struct dns_name *name, char *data, size_t len );
 extern int dns_compare ( struct dns_name *first, struct dns_name *second );
 extern int dns_copy ( struct dns_name *src, struct dns_name *dst );
 extern int dns_skip ( struct dns_name *name );
 
+extern struct list_head dns_cache;
+extern struct dns_cache_statistics dns_cache_stats;
+extern unsigned long dns_cache_remaining ( struct dns_cache_entry *entry );
+extern struct dns_cache_entry * dns_cache_find ( const char *name,
+						 unsigned int qtype );
+extern void dns_cache_add ( const char *name, unsigned int qtype,
+			    struct sockaddr *sa, int rc, unsigned long ttl );
+extern void dns_cache_flush ( void );
+
 #endif /* _IPXE_DNS_H */
@@ -71,6 +71,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_fault		       ( ERRFILE_CORE | 0x001f0000 )
 #define ERRFILE_blocktrans	       ( ERRFILE_CORE | 0x00200000 )
 #define ERRFILE_pixbuf		       ( ERRFILE_CORE | 0x00210000 )
+#define ERRFILE_trace		       ( ERRFILE_CORE | 0x00220000 )
 
 #define ERRFILE_eisa		     ( ERRFILE_DRIVER | 0x00000000 )
 #define ERRFILE_isa		     ( ERRFILE_DRIVER | 0x00010000 )
@@ -268,6 +269,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_peermux			( ERRFILE_NET | 0x00470000 )
 #define ERRFILE_xsigo			( ERRFILE_NET | 0x00480000 )
 #define ERRFILE_ntp			( ERRFILE_NET | 0x00490000 )
+#define ERRFILE_fragment		( ERRFILE_NET | 0x004a0000 )
 
 #define ERRFILE_image		      ( ERRFILE_IMAGE | 0x00000000 )
 #define ERRFILE_elf		      ( ERRFILE_IMAGE | 0x00010000 )
@@ -359,6 +361,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_efi_fbcon	      ( ERRFILE_OTHER | 0x004c0000 )
 #define ERRFILE_efi_local	      ( ERRFILE_OTHER | 0x004d0000 )
 #define ERRFILE_efi_entropy	      ( ERRFILE_OTHER | 0x004e0000 )
+#define ERRFILE_xferbuf_test	      ( ERRFILE_OTHER | 0x004f0000 )
+#define ERRFILE_linux_trace	      ( ERRFILE_OTHER | 0x00500000 )
+#define ERRFILE_demux_test	      ( ERRFILE_OTHER | 0x00510000 )
+#define ERRFILE_route_test	      ( ERRFILE_OTHER | 0x00520000 )
+#define ERRFILE_dns_test	      ( ERRFILE_OTHER | 0x00530000 )
+#define ERRFILE_nslookup_cmd	      ( ERRFILE_OTHER | 0x00540000 )
+#define ERRFILE_resolv_test	      ( ERRFILE_OTHER | 0x00550000 )
+#define ERRFILE_testnet		      ( ERRFILE_OTHER | 0x00560000 )
+#define ERRFILE_mtu_test	      ( ERRFILE_OTHER | 0x00570000 )
 
 /** @} */
 
@@ -17,14 +17,53 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Fragment reassembly timeout */
 #define FRAGMENT_TIMEOUT ( TICKS_PER_SEC / 2 )
 
+/**
+ * Fragment reassembly memory budget
+ *
+ * This is the maximum total size of the I/O buffers that may be held
+ * by a single fragment reassembler.  The oldest incomplete packets
+ * will be discarded as needed to remain within this budget.
+ */
+#define FRAGMENT_BUDGET ( 512 * 1024 )
+
+/**
+ * A queued fragment header
+ *
+ * This is the header that replaces the non-fragmentable portion of
+ * fragments held within a fragment reassembly buffer.
+ */
+struct fragment_queued_header {
+	/** Offset of fragment data within fragmentable portion */
+	size_t offset;
+};
+
 /** A fragment reassembly buffer */
 struct fragment {
 	/* List of fragment reassembly buffers */
 	struct list_head list;
-	/** Reassembled packet */
-	struct io_buffer *iobuf;
+	/** Non-fragmentable portion of reassembled packet
+	 *
+	 * This is copied from the first fragment received, and
+	 * replaced by the copy from the fragment at offset zero when
+	 * that fragment is received.
+	 */
+	void *hdr;
 	/** Length of non-fragmentable portion of reassembled packet */
 	size_t hdrlen;
+	/** Received fragments
+	 *
+	 * Fragments are held in order of offset, and never overlap.
+	 * Any gaps between fragments represent holes yet to be
+	 * filled.  Each fragment has its non-fragmentable portion
+	 * replaced by a queued fragment header.
+	 */
+	struct list_head chain;
+	/** Length of fragmentable portion received so far */
+	size_t len;
+	/** Length of fragmentable portion (or zero if not yet known) */
+	size_t total;
+	/** Total size of I/O buffers held */
+	size_t size;
 	/** Reassembly timer */
 	struct retry_timer timer;
 	/** Fragment reassembler */
@@ -63,6 +102,8 @@ struct fragment_reassembler {
 	int ( * more_fragments ) ( struct io_buffer *iobuf, size_t hdrlen );
 	/** Associated IP statistics */
 	struct ip_statistics *stats;
+	/** Total size of I/O buffers held by all reassembly buffers */
+	size_t size;
 };
 
 extern struct io_buffer *
@@ -13,6 +13,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <assert.h>
 #include <ipxe/list.h>
 
+struct refcnt;
+
 /**
  * Minimum I/O buffer length
  *
@@ -46,6 +48,77 @@ struct io_buffer {
 	void *tail;
 	/** End of the buffer */
         void *end;
+	/** Recycling pool to which this buffer belongs, if any */
+	struct io_buffer_pool *pool;
+	/** Flags */
+	unsigned int flags;
+	/** Start of checksummed region (as offset from start of buffer) */
+	size_t csum_start;
+	/** Offset of checksum field within checksummed region */
+	size_t csum_offset;
+	/** Coalesced continuation buffers
+	 *
+	 * A received packet into which subsequent packets have been
+	 * coalesced (see net_poll_rx()) carries the payloads of those
+	 * subsequent packets as a list of continuation buffers.  The
+	 * continuation buffers are owned by this buffer, and will be
+	 * freed along with it.
+	 */
+	struct list_head chain;
+};
+
+/** Transport-layer checksum is incomplete
+ *
+ * The checksum over the region starting at @c csum_start and ending
+ * at the end of the data has not yet been calculated.  The checksum
+ * field (at @c csum_offset within this region) will be completed
+ * either in software by the network layer or in hardware by a network
+ * device that advertises NETDEV_TX_CSUM.
+ */
+#define IOB_CSUM_PARTIAL 0x0001
+
+/** Transport-layer checksum has been verified by the network device */
+#define IOB_CSUM_VERIFIED 0x0002
+
+/** An I/O buffer recycling pool
+ *
+ * A recycling pool retains freed I/O buffers of a fixed length, so
+ * that they may be reused without returning to the heap allocator.
+ * Buffers allocated from a pool hold a reference to the pool's
+ * containing object for as long as they are in use.
+ */
+struct io_buffer_pool {
+	/** List of all I/O buffer pools */
+	struct list_head list;
+	/** Recycled I/O buffers */
+	struct list_head free;
+	/** Containing object reference counter, or NULL */
+	struct refcnt *refcnt;
+	/** Length of each I/O buffer */
+	size_t len;
+	/** Number of recycled I/O buffers */
+	unsigned int count;
+	/** Maximum number of recycled I/O buffers */
+	unsigned int max;
+	/** Number of allocations satisfied by recycled I/O buffers */
+	unsigned int hits;
+	/** Number of allocations requiring a new I/O buffer */
+	unsigned int misses;
+};
+
+/** A cursor for reading data from a list of I/O buffers
+ *
+ * A cursor allows protocols to parse data which has been received
+ * as a chain of separate I/O buffers, without first having to copy
+ * the whole chain into a single contiguous buffer.
+ */
+struct iob_cursor {
+	/** List of I/O buffers */
+	struct list_head *list;
+	/** Current I/O buffer, or NULL at end of list */
+	struct io_buffer *iobuf;
+	/** Offset within current I/O buffer */
+	size_t offset;
 };
 
 /**
@@ -188,6 +261,37 @@ static inline void iob_populate ( struct io_buffer *iobuf,
 	iobuf->head = iobuf->data = data;
 	iobuf->tail = ( data + len );
 	iobuf->end = ( data + max_len );
+	iobuf->pool = NULL;
+	iobuf->flags = 0;
+	INIT_LIST_HEAD ( &iobuf->chain );
+}
+
+/**
+ * Defer calculation of transport-layer checksum
+ *
+ * @v iobuf		I/O buffer
+ * @v start		Start of checksummed region
+ * @v csum		Checksum field within checksummed region
+ *
+ * The checksum field will be zeroed, and will be completed later
+ * (possibly by the network device).
+ */
+static inline void iob_csum_defer ( struct io_buffer *iobuf, void *start,
+				    uint16_t *csum ) {
+	*csum = 0;
+	iobuf->flags |= IOB_CSUM_PARTIAL;
+	iobuf->csum_start = ( start - iobuf->head );
+	iobuf->csum_offset = ( ( ( void * ) csum ) - start );
+}
+
+/**
+ * Get start of checksummed region
+ *
+ * @v iobuf		I/O buffer
+ * @ret start		Start of checksummed region
+ */
+static inline void * iob_csum_start ( struct io_buffer *iobuf ) {
+	return ( iobuf->head + iobuf->csum_start );
 }
 
 /**
@@ -218,5 +322,18 @@ extern void iob_pad ( struct io_buffer *iobuf, size_t min_len );
 extern int iob_ensure_headroom ( struct io_buffer *iobuf, size_t len );
 extern struct io_buffer * iob_concatenate ( struct list_head *list );
 extern struct io_buffer * iob_split ( struct io_buffer *iobuf, size_t len );
+extern void iob_cursor_init ( struct iob_cursor *cursor,
+			     struct list_head *list );
+extern size_t iob_cursor_len ( struct iob_cursor *cursor );
+extern int iob_cursor_copy ( struct iob_cursor *cursor, void *data,
+			     size_t len );
+extern int iob_cursor_pull ( struct iob_cursor *cursor, size_t len,
+			     const void **data, void **copy );
+extern void iob_pool_init ( struct io_buffer_pool *pool, unsigned int max,
+			    struct refcnt *refcnt );
+extern struct io_buffer * iob_pool_alloc ( struct io_buffer_pool *pool,
+					   size_t len );
+extern void iob_pool_flush ( struct io_buffer_pool *pool );
+extern void iob_pool_fini ( struct io_buffer_pool *pool );
 
 #endif /* _IPXE_IOBUF_H */
@@ -13,6 +13,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/list.h>
 #include <ipxe/tables.h>
 #include <ipxe/refcnt.h>
+#include <ipxe/iobuf.h>
 #include <ipxe/settings.h>
 #include <ipxe/interface.h>
 #include <ipxe/retry.h>
@@ -20,6 +21,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 struct io_buffer;
 struct net_device;
 struct net_protocol;
+struct tcp_header;
 struct ll_protocol;
 struct device;
 
@@ -57,6 +59,30 @@ struct device;
 /** Maximum combined length of a link-layer and network-layer header */
 #define MAX_LL_NET_HEADER_LEN ( MAX_LL_HEADER_LEN + MAX_NET_HEADER_LEN )
 
+/** Minimum configurable MTU
+ *
+ * This is the minimum datagram size that every IPv4 host must be
+ * able to accept (RFC 791).  IPv6 requires a larger MTU of 1280
+ * bytes, but is not used on every link.
+ */
+#define NETDEV_MIN_MTU 576
+
+/** A received packet eligible for receive coalescing */
+struct net_gro {
+	/** Flow identifier (network-layer source and destination) */
+	const void *flow;
+	/** Length of flow identifier */
+	size_t flow_len;
+	/** TCP header */
+	struct tcp_header *tcphdr;
+	/** Length of TCP segment (including TCP header) */
+	size_t len;
+	/** Length of TCP header (including options) */
+	size_t hlen;
+	/** Pseudo-header checksum */
+	uint16_t pshdr_csum;
+};
+
 /**
  * A network-layer protocol
  *
@@ -79,6 +105,21 @@ struct net_protocol {
 	int ( * rx ) ( struct io_buffer *iobuf, struct net_device *netdev,
 		       const void *ll_dest, const void *ll_source,
 		       unsigned int flags );
+	/**
+	 * Identify packet eligible for receive coalescing (optional)
+	 *
+	 * @v iobuf		I/O buffer
+	 * @v gro		Receive coalescing descriptor to fill in
+	 * @ret rc		Return status code
+	 *
+	 * This method should check that the packet is a TCP segment
+	 * that could be delivered directly to the transport layer
+	 * without any further network-layer processing, and fill in
+	 * the flow identifier, TCP header, TCP segment length, and
+	 * pseudo-header checksum.  The I/O buffer must not be
+	 * modified.
+	 */
+	int ( * gro ) ( struct io_buffer *iobuf, struct net_gro *gro );
 	/**
 	 * Transcribe network-layer address
 	 *
@@ -209,6 +250,15 @@ struct ll_protocol {
  */
 #define LL_NAME_ONLY 0x0001
 
+/** Link-layer header depends only upon addresses and protocol
+ *
+ * This flag indicates that the link-layer header constructed by the
+ * push() method depends only upon the source and destination
+ * link-layer addresses and the network-layer protocol, and so may be
+ * constructed once and reused for subsequent packets.
+ */
+#define LL_STATIC_HEADER 0x0002
+
 /** Network device operations */
 struct net_device_operations {
 	/** Open network device
@@ -293,6 +343,24 @@ struct net_device_stats {
 	struct net_device_error errors[NETDEV_MAX_UNIQUE_ERRORS];
 };
 
+/** Network device receive budget statistics */
+struct net_device_budget_stats {
+	/** Number of times device was repolled within a single poll */
+	unsigned int repolls;
+	/** Number of times the receive budget was exhausted */
+	unsigned int exhausted;
+	/** Number of receive ring overruns reported by the driver */
+	unsigned int overruns;
+};
+
+/** Network device receive coalescing statistics */
+struct net_device_gro_stats {
+	/** Number of coalesced packets passed to the network stack */
+	unsigned int packets;
+	/** Number of received segments within coalesced packets */
+	unsigned int segments;
+};
+
 /** A network device configuration */
 struct net_device_configuration {
 	/** Network device */
@@ -397,9 +465,17 @@ struct net_device {
 	struct retry_timer link_block;
 	/** Maximum packet length
 	 *
-	 * This length includes any link-layer headers.
+	 * This is the maximum packet length (including any link-layer
+	 * headers) supported by the hardware.
 	 */
 	size_t max_pkt_len;
+	/** Maximum transmission unit length
+	 *
+	 * This is the maximum packet length (excluding any link-layer
+	 * headers) configured for the link.  Drivers must size their
+	 * receive buffers to accommodate this length.
+	 */
+	size_t mtu;
 	/** TX packet queue */
 	struct list_head tx_queue;
 	/** Deferred TX packet queue */
@@ -410,6 +486,12 @@ struct net_device {
 	struct net_device_stats tx_stats;
 	/** RX statistics */
 	struct net_device_stats rx_stats;
+	/** Receive I/O buffer recycling pool */
+	struct io_buffer_pool rx_pool;
+	/** Receive budget statistics */
+	struct net_device_budget_stats rx_budget;
+	/** Receive coalescing statistics */
+	struct net_device_gro_stats rx_gro;
 
 	/** Configuration settings applicable to this device */
 	struct generic_settings settings;
@@ -421,6 +503,9 @@ struct net_device {
 	struct net_device_configuration configs[0];
 };
 
+/** Maximum number of recycled receive I/O buffers per network device */
+#define NETDEV_RX_POOL_MAX 16
+
 /** Network device is open */
 #define NETDEV_OPEN 0x0001
 
@@ -438,6 +523,21 @@ struct net_device {
  */
 #define NETDEV_IRQ_UNSUPPORTED 0x0008
 
+/** Network device can insert transmit checksums
+ *
+ * This flag can be used by a network device to indicate that it is
+ * able to complete the transport-layer checksum of any I/O buffer
+ * marked with IOB_CSUM_PARTIAL.
+ */
+#define NETDEV_TX_CSUM 0x0010
+
+/** Network device can validate receive checksums
+ *
+ * This flag can be used by a network device to indicate that it may
+ * mark received I/O buffers with IOB_CSUM_VERIFIED.
+ */
+#define NETDEV_RX_CSUM 0x0020
+
 /** Link-layer protocol table */
 #define LL_PROTOCOLS __table ( struct ll_protocol, "ll_protocols" )
 
@@ -658,6 +758,28 @@ netdev_irq_supported ( struct net_device *netdev ) {
 		 ! ( netdev->state & NETDEV_IRQ_UNSUPPORTED ) );
 }
 
+/**
+ * Check whether or not network device can insert transmit checksums
+ *
+ * @v netdev		Network device
+ * @ret tx_csum		Network device can insert transmit checksums
+ */
+static inline __attribute__ (( always_inline )) int
+netdev_tx_csum ( struct net_device *netdev ) {
+	return ( netdev->state & NETDEV_TX_CSUM );
+}
+
+/**
+ * Check whether or not network device can validate receive checksums
+ *
+ * @v netdev		Network device
+ * @ret rx_csum		Network device can validate receive checksums
+ */
+static inline __attribute__ (( always_inline )) int
+netdev_rx_csum ( struct net_device *netdev ) {
+	return ( netdev->state & NETDEV_RX_CSUM );
+}
+
 /**
  * Check whether or not network device interrupts are currently enabled
  *
@@ -696,6 +818,9 @@ extern void netdev_tx_complete_err ( struct net_device *netdev,
 				 struct io_buffer *iobuf, int rc );
 extern void netdev_tx_complete_next_err ( struct net_device *netdev, int rc );
 extern void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf );
+extern void netdev_rx_batch ( struct net_device *netdev,
+			      struct list_head *batch );
+extern void netdev_rx_overrun ( struct net_device *netdev );
 extern void netdev_rx_err ( struct net_device *netdev,
 			    struct io_buffer *iobuf, int rc );
 extern void netdev_poll ( struct net_device *netdev );
@@ -727,6 +852,7 @@ extern int netdev_configure ( struct net_device *netdev,
 extern int netdev_configure_all ( struct net_device *netdev );
 extern int netdev_configuration_in_progress ( struct net_device *netdev );
 extern int netdev_configuration_ok ( struct net_device *netdev );
+extern int netdev_apply_mtu ( struct net_device *netdev );
 
 /**
  * Complete network transmission
@@ -752,6 +878,22 @@ static inline void netdev_tx_complete_next ( struct net_device *netdev ) {
 	netdev_tx_complete_next_err ( netdev, 0 );
 }
 
+/**
+ * Allocate receive I/O buffer
+ *
+ * @v netdev		Network device
+ * @v len		Required length of buffer
+ * @ret iobuf		I/O buffer, or NULL if none available
+ *
+ * The I/O buffer will be drawn from the network device's receive
+ * recycling pool if possible, and will be returned to the pool when
+ * freed.  The buffer is aligned as for alloc_iob().
+ */
+static inline __attribute__ (( always_inline )) struct io_buffer *
+netdev_alloc_rx_iob ( struct net_device *netdev, size_t len ) {
+	return iob_pool_alloc ( &netdev->rx_pool, len );
+}
+
 /**
  * Mark network device as having link up
  *
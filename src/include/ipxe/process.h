@@ -12,6 +12,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/list.h>
 #include <ipxe/refcnt.h>
 #include <ipxe/tables.h>
+#include <ipxe/profile.h>
 
 /** A process */
 struct process {
@@ -41,8 +42,31 @@ struct process_descriptor {
 	void ( * step ) ( void *object );
 	/** Automatically reschedule the process */
 	int reschedule;
+	/** Scheduling priority class */
+	unsigned int priority;
+	/** Step profiler */
+	struct profiler profiler;
+	/** List of profiled process descriptors
+	 *
+	 * This is zero until the process has first been stepped with
+	 * profiling enabled.
+	 */
+	struct list_head list;
 };
 
+/** Normal priority process */
+#define PROC_PRIO_NORMAL 0
+
+/** High priority process
+ *
+ * High priority processes are scheduled on alternate steps, in
+ * preference to normal priority processes.
+ */
+#define PROC_PRIO_HIGH 1
+
+/** Number of process priority classes */
+#define PROC_NUM_PRIO 2
+
 /**
  * Define a process step() method
  *
@@ -81,6 +105,7 @@ struct process_descriptor {
 		.offset = process_offset ( object_type, process ),	      \
 		.step = PROC_STEP ( object_type, _step ),		      \
 		.reschedule = 1,					      \
+		.profiler = { .name = #_step },				      \
 	}
 
 /**
@@ -95,6 +120,7 @@ struct process_descriptor {
 		.offset = process_offset ( object_type, process ),	      \
 		.step = PROC_STEP ( object_type, _step ),		      \
 		.reschedule = 0,					      \
+		.profiler = { .name = #_step },				      \
 	}
 
 /**
@@ -105,16 +131,32 @@ struct process_descriptor {
  * @v step		Process' step() method
  * @ret desc		Object interface descriptor
  */
-#define PROC_DESC_PURE( _step ) {					      \
+#define PROC_DESC_PURE( _step ) \
+	PROC_DESC_PURE_PRIO ( _step, PROC_PRIO_NORMAL )
+
+/**
+ * Define a process descriptor for a pure process with a given priority
+ *
+ * @v step		Process' step() method
+ * @v priority		Scheduling priority class
+ * @ret desc		Object interface descriptor
+ */
+#define PROC_DESC_PURE_PRIO( _step, _priority ) {			      \
 		.offset = 0,						      \
 		.step = PROC_STEP ( struct process, _step ),		      \
 		.reschedule = 1,					      \
+		.priority = _priority,					      \
+		.profiler = { .name = #_step },				      \
 	}
 
+extern struct list_head process_descriptors;
+
 extern void * __attribute__ (( pure ))
 process_object ( struct process *process );
 extern void process_add ( struct process *process );
 extern void process_del ( struct process *process );
+extern void process_activity ( void );
+extern int process_idle ( void );
 extern void step ( void );
 
 /**
@@ -174,7 +216,14 @@ process_running ( struct process *process ) {
  *
  */
 #define PERMANENT_PROCESS( name, step )					      \
-static struct process_descriptor name ## _desc = PROC_DESC_PURE ( step );     \
+	PERMANENT_PROCESS_PRIO ( name, step, PROC_PRIO_NORMAL )
+
+/** Define a permanent process with a given priority
+ *
+ */
+#define PERMANENT_PROCESS_PRIO( name, step, priority )			      \
+static struct process_descriptor name ## _desc =			      \
+	PROC_DESC_PURE_PRIO ( step, priority );				      \
 struct process name __permanent_process = {				      \
 	.list = LIST_HEAD_INIT ( name.list ),				      \
 	.desc = & name ## _desc,					      \
@@ -48,6 +48,8 @@ struct profiler {
 	 * (i.e. one less than would be returned by flsll(raw_accvar)).
 	 */
 	unsigned int accvar_msb;
+	/** Accumulated sample value */
+	unsigned long long total;
 };
 
 /** Profiler table */
@@ -66,6 +68,7 @@ extern void profile_update ( struct profiler *profiler, unsigned long sample );
 extern unsigned long profile_mean ( struct profiler *profiler );
 extern unsigned long profile_variance ( struct profiler *profiler );
 extern unsigned long profile_stddev ( struct profiler *profiler );
+extern void profile_reset ( struct profiler *profiler );
 
 /**
  * Get start time
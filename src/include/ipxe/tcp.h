@@ -12,6 +12,7 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <ipxe/tcpip.h>
+#include <ipxe/settings.h>
 
 /**
  * A TCP header
@@ -138,6 +139,30 @@ struct tcp_timestamp_padded_option {
 /** Code for the TCP timestamp option */
 #define TCP_OPTION_TS 8
 
+/** TCP Fast Open option */
+struct tcp_fastopen_option {
+	uint8_t kind;
+	uint8_t length;
+	uint8_t cookie[0];
+} __attribute__ (( packed ));
+
+/** Maximum total length of TCP options */
+#define TCP_MAX_OPTIONS_LEN 40
+
+/** Code for the TCP Fast Open option */
+#define TCP_OPTION_FASTOPEN 34
+
+/** Minimum TCP Fast Open cookie length (as per RFC 7413) */
+#define TCP_FASTOPEN_COOKIE_MIN 4
+
+/** Maximum usable TCP Fast Open cookie length
+ *
+ * RFC 7413 permits cookies of up to 16 bytes, but the Fast Open
+ * option must fit within the 40 bytes of option space alongside the
+ * other options that we send with a SYN.
+ */
+#define TCP_FASTOPEN_COOKIE_MAX 14
+
 /** Parsed TCP options */
 struct tcp_options {
 	/** Window scale option, if present */
@@ -146,6 +171,12 @@ struct tcp_options {
 	const struct tcp_sack_permitted_option *spopt;
 	/** Timestamp option, if present */
 	const struct tcp_timestamp_option *tsopt;
+	/** Selective acknowledgement option, if present */
+	const struct tcp_sack_option *sackopt;
+	/** Maximum segment size option, if present */
+	const struct tcp_mss_option *mssopt;
+	/** Fast Open option, if present */
+	const struct tcp_fastopen_option *foopt;
 };
 
 /** @} */
@@ -320,6 +351,29 @@ struct tcp_options {
 
 /** @} */
 
+/**
+ * Name TCP state
+ *
+ * @v state		TCP state
+ * @ret name		Name of TCP state
+ */
+static inline __attribute__ (( always_inline )) const char *
+tcp_state ( int state ) {
+	switch ( state ) {
+	case TCP_CLOSED:		return "CLOSED";
+	case TCP_LISTEN:		return "LISTEN";
+	case TCP_SYN_SENT:		return "SYN_SENT";
+	case TCP_SYN_RCVD:		return "SYN_RCVD";
+	case TCP_ESTABLISHED:		return "ESTABLISHED";
+	case TCP_FIN_WAIT_1:		return "FIN_WAIT_1";
+	case TCP_FIN_WAIT_2:		return "FIN_WAIT_2";
+	case TCP_CLOSING_OR_LAST_ACK:	return "CLOSING/LAST_ACK";
+	case TCP_TIME_WAIT:		return "TIME_WAIT";
+	case TCP_CLOSE_WAIT:		return "CLOSE_WAIT";
+	default:			return "INVALID";
+	}
+}
+
 /** Mask for TCP header length field */
 #define TCP_MASK_HLEN	0xf0
 
@@ -333,27 +387,50 @@ struct tcp_options {
  *
  *    max_bandwidth * round_trip_time = tcp_window
  *
- * Some rough expectations for achievable bandwidths over various
- * links are:
- *
- *    a) Gigabit LAN: expected bandwidth 125MB/s, typical RTT 0.5ms,
- *       minimum required window 64kB
- *
- *    b) Home Internet connection: expected bandwidth 10MB/s, typical
- *       RTT 25ms, minimum required window 256kB
+ * The required window therefore varies widely between links, from
+ * around 64kB on a gigabit LAN to several megabytes on a 25 gigabit
+ * link to a remote server.  It is advisable to keep the window size
+ * as small as possible (without limiting bandwidth), since in the
+ * event of a lost packet the window size represents the maximum
+ * amount that may need to be held in the receive queue.
+ *
+ * The advertised window is therefore tuned automatically for each
+ * connection, based on the amount of data received within each
+ * measured round-trip time.  This value is the upper bound for the
+ * tuned window.
+ */
+#define TCP_MAX_WINDOW_SIZE	( 4 * 1024 * 1024 )
+
+/**
+ * Free-memory-independent TCP window size
  *
- *    c) WAN: expected bandwidth 2MB/s, typical RTT 100ms, minimum
- *       required window 200kB.
+ * Once the heap has been grown using external memory, the tuned
+ * window may grow to at least this size (the historical fixed window
+ * size), regardless of the amount of heap memory that is currently
+ * free, since the currently free heap memory then underestimates the
+ * memory that the allocator can actually supply.
+ */
+#define TCP_FLOOR_WINDOW_SIZE	( 256 * 1024 )
+
+/** Initial advertised TCP window size */
+#define TCP_INIT_WINDOW_SIZE	( 64 * 1024 )
+
+/**
+ * Minimum advertised TCP window size
  *
- * The maximum possible value for the TCP window size is 1GB (using
- * the maximum window scale of 2**14).  However, it is advisable to
- * keep the window size as small as possible (without limiting
- * bandwidth), since in the event of a lost packet the window size
- * represents the maximum amount that will need to be retransmitted.
+ * The tuned window will not be reduced below this value in response
+ * to memory pressure.
+ */
+#define TCP_MIN_WINDOW_SIZE	( 16 * 1024 )
+
+/**
+ * TCP window hold time
  *
- * We therefore choose a maximum window size of 256kB.
+ * After the maximum receive window has been reduced in response to
+ * memory pressure, it will not be grown (or reduced further) for at
+ * least this time.
  */
-#define TCP_MAX_WINDOW_SIZE	( 256 * 1024 )
+#define TCP_WINDOW_HOLD ( 1 * TICKS_PER_SEC )
 
 /**
  * Path MTU
@@ -372,6 +449,73 @@ struct tcp_options {
 #define TCP_PATH_MTU							\
 	( 1280 - 40 /* IPv6 */ - 20 /* TCP */ - 12 /* TCP timestamp */ )
 
+/**
+ * Sender maximum segment size
+ *
+ * Equivalent to SMSS in RFC 5681 terminology.  All congestion control
+ * calculations are performed in units of this size.
+ */
+#define TCP_SMSS TCP_PATH_MTU
+
+/**
+ * Initial congestion window
+ *
+ * Ten segments, as per RFC 6928.
+ */
+#define TCP_INIT_CWND ( 10 * TCP_SMSS )
+
+/**
+ * Maximum congestion window
+ *
+ * There is no benefit in allowing the congestion window to grow
+ * beyond the largest window that we would ever advertise to a peer.
+ */
+#define TCP_MAX_CWND TCP_MAX_WINDOW_SIZE
+
+/**
+ * Duplicate acknowledgement threshold
+ *
+ * Fast retransmission is triggered by the third duplicate
+ * acknowledgement, as per RFC 5681.
+ */
+#define TCP_DUPACK_THRESHOLD 3
+
+/**
+ * Maximum number of scoreboard selective acknowledgement blocks
+ *
+ * This is the number of distinct blocks of data acknowledged by the
+ * peer via SACK that we are able to remember.
+ */
+#define TCP_SCOREBOARD_MAX 8
+
+/** Number of cached TCP Fast Open cookies */
+#define TCP_FASTOPEN_CACHE_SIZE 4
+
+/**
+ * Number of TCP connection hash buckets
+ *
+ * Received segments are demultiplexed via a hash table indexed by
+ * local port.  This must be a power of two.
+ */
+#define TCP_HASH_SIZE 64
+
+/**
+ * Maximum length of data sent within a TCP Fast Open SYN
+ *
+ * We allow space within 1280 bytes for an IPv6 header, a TCP header,
+ * and the maximum length of TCP options that may accompany a SYN.
+ */
+#define TCP_FASTOPEN_MAX_DATA						\
+	( 1280 - 40 /* IPv6 */ - 20 /* TCP */ - TCP_MAX_OPTIONS_LEN )
+
+/**
+ * Default peer maximum segment size for TCP Fast Open
+ *
+ * Used when the peer did not specify a maximum segment size along
+ * with its Fast Open cookie, as per RFC 7413.
+ */
+#define TCP_FASTOPEN_DEFAULT_MSS 536
+
 /** TCP maximum segment lifetime
  *
  * Currently set to 2 minutes, as per RFC 793.
@@ -386,6 +530,48 @@ struct tcp_options {
  */
 #define TCP_KEEPALIVE_DELAY ( 15 * TICKS_PER_SEC )
 
+/**
+ * TCP delayed acknowledgement timeout
+ *
+ * We may delay acknowledging in-order data for up to this period, in
+ * the hope of acknowledging several segments (or piggybacking the
+ * acknowledgement onto outgoing data) with a single packet.  RFC 1122
+ * requires this to be less than 0.5 seconds.
+ */
+#define TCP_DELACK_TIMEOUT ( TICKS_PER_SEC / 25 )
+
+/**
+ * TCP delayed acknowledgement segment count
+ *
+ * We always acknowledge at least every second full-sized segment, as
+ * required by RFC 5681.
+ */
+#define TCP_DELACK_SEGMENTS 2
+
+/**
+ * TCP initial retransmission timeout
+ *
+ * Used until a round-trip time has been measured, as per RFC 6298.
+ */
+#define TCP_RTO_INIT ( 1 * TICKS_PER_SEC )
+
+/**
+ * TCP minimum retransmission timeout
+ *
+ * RFC 6298 recommends a conservative minimum of one second; we use a
+ * lower minimum (as do most modern implementations) to allow for
+ * prompt recovery on local networks.
+ */
+#define TCP_RTO_MIN ( TICKS_PER_SEC / 5 )
+
+/**
+ * TCP maximum retransmission timeout
+ *
+ * The connection will be abandoned once the backed-off
+ * retransmission timeout exceeds this value.
+ */
+#define TCP_RTO_MAX ( 10 * TICKS_PER_SEC )
+
 /**
  * TCP maximum header length
  *
@@ -395,7 +581,10 @@ struct tcp_options {
 	  sizeof ( struct tcp_header ) +			\
 	  sizeof ( struct tcp_mss_option ) +			\
 	  sizeof ( struct tcp_window_scale_padded_option ) +	\
-	  sizeof ( struct tcp_timestamp_padded_option ) )
+	  sizeof ( struct tcp_sack_permitted_padded_option ) +	\
+	  sizeof ( struct tcp_timestamp_padded_option ) +	\
+	  sizeof ( struct tcp_fastopen_option ) +		\
+	  TCP_FASTOPEN_COOKIE_MAX )
 
 /**
  * Compare TCP sequence numbers
@@ -433,6 +622,50 @@ static inline int tcp_in_window ( uint32_t seq, uint32_t start,
  */
 #define TCP_FINISH_TIMEOUT ( 1 * TICKS_PER_SEC )
 
+/** TCP connection information */
+struct tcp_info {
+	/** Local port */
+	unsigned int local_port;
+	/** Remote socket address */
+	struct sockaddr_tcpip peer;
+	/** Current state */
+	uint32_t tcp_state;
+	/** Smoothed round-trip time (in ticks) */
+	unsigned long srtt;
+	/** Round-trip time variation (in ticks) */
+	unsigned long rttvar;
+	/** Retransmission timeout (in ticks) */
+	unsigned long rto;
+	/** Most recent round-trip time sample (in ticks) */
+	unsigned long rtt;
+	/** Minimum round-trip time sample (in ticks) */
+	unsigned long rtt_min;
+	/** Number of round-trip time samples */
+	unsigned int rtt_samples;
+	/** Number of retransmission timeouts */
+	unsigned int timeouts;
+	/** Congestion window */
+	uint32_t cwnd;
+	/** Slow start threshold */
+	uint32_t ssthresh;
+	/** Current send window */
+	uint32_t snd_win;
+	/** Number of fast retransmissions */
+	unsigned int fast_retransmits;
+	/** Number of retransmitted segments */
+	unsigned int retransmits;
+	/** Length of data accepted within SYN via TCP Fast Open */
+	uint32_t fastopen;
+	/** Current receive window */
+	uint32_t rcv_win;
+	/** Maximum receive window */
+	uint32_t rcv_win_max;
+};
+
 extern struct tcpip_protocol tcp_protocol __tcpip_protocol;
+extern const struct setting tcp_fastopen_setting __setting ( SETTING_MISC,
+							      tcp-fastopen );
+
+extern int tcp_connection_info ( unsigned int index, struct tcp_info *info );
 
 #endif /* _IPXE_TCP_H */
@@ -10,9 +10,11 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
+#include <string.h>
 #include <ipxe/socket.h>
 #include <ipxe/in.h>
 #include <ipxe/tables.h>
+#include <ipxe/netdevice.h>
 
 extern uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
 						const void *data, size_t len );
@@ -134,6 +136,33 @@ struct tcpip_protocol {
         uint8_t tcpip_proto;
 };
 
+/** A cached transmit route
+ *
+ * A connection with a fixed destination may cache the outcome of
+ * routing and neighbour resolution, rather than repeating this work
+ * for every transmitted packet.
+ *
+ * A cached route remains valid only until the next change to any
+ * routing table entry, neighbour cache entry, or network device
+ * state.
+ */
+struct tcpip_route {
+	/** Route generation for which this route is valid (zero if none) */
+	unsigned long generation;
+	/** Destination network-layer address */
+	uint8_t net_dest[MAX_NET_ADDR_LEN];
+	/** Source network-layer address */
+	uint8_t net_source[MAX_NET_ADDR_LEN];
+	/** Transmitting network device */
+	struct net_device *netdev;
+	/** Destination link-layer address */
+	uint8_t ll_dest[MAX_LL_ADDR_LEN];
+	/** Length of precomputed link-layer header (zero if none) */
+	size_t ll_header_len;
+	/** Precomputed link-layer header */
+	uint8_t ll_header[MAX_LL_HEADER_LEN];
+};
+
 /**
  * A network-layer protocol of the TCP/IP stack (eg. IPV4, IPv6, etc)
  */
@@ -154,6 +183,7 @@ struct tcpip_net_protocol {
 	 * @v st_src		Source address, or NULL to use default
 	 * @v st_dest		Destination address
 	 * @v netdev		Network device (or NULL to route automatically)
+	 * @v route		Cached transmit route, or NULL
 	 * @v trans_csum	Transport-layer checksum to complete, or NULL
 	 * @ret rc		Return status code
 	 *
@@ -164,6 +194,7 @@ struct tcpip_net_protocol {
 		       struct sockaddr_tcpip *st_src,
 		       struct sockaddr_tcpip *st_dest,
 		       struct net_device *netdev,
+		       struct tcpip_route *route,
 		       uint16_t *trans_csum );
 	/**
 	 * Determine transmitting network device
@@ -191,15 +222,56 @@ extern int tcpip_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		      uint8_t tcpip_proto, struct sockaddr_tcpip *st_src,
 		      struct sockaddr_tcpip *st_dest, uint16_t pshdr_csum,
 		      struct ip_statistics *stats );
+extern unsigned long tcpip_route_generation;
+
+/**
+ * Invalidate all cached transmit routes
+ *
+ */
+static inline void tcpip_route_changed ( void ) {
+
+	/* Never allow the generation to become zero */
+	if ( ! ++tcpip_route_generation )
+		tcpip_route_generation++;
+}
+
+/**
+ * Check if cached transmit route is valid
+ *
+ * @v route		Cached transmit route
+ * @v net_dest		Destination network-layer address
+ * @v net_addr_len	Network-layer address length
+ * @ret is_valid	Cached route is valid for this destination
+ */
+static inline int tcpip_route_is_valid ( struct tcpip_route *route,
+					 const void *net_dest,
+					 size_t net_addr_len ) {
+
+	return ( ( route->generation == tcpip_route_generation ) &&
+		 ( memcmp ( route->net_dest, net_dest, net_addr_len ) == 0 ) );
+}
+
 extern int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip,
 		      struct sockaddr_tcpip *st_src,
 		      struct sockaddr_tcpip *st_dest,
-		      struct net_device *netdev,
+		      struct net_device *netdev, struct tcpip_route *route,
 		      uint16_t *trans_csum );
+extern void tcpip_route_update ( struct tcpip_route *route,
+				 struct net_device *netdev,
+				 struct net_protocol *net_protocol,
+				 const void *net_dest, const void *next_hop,
+				 const void *net_source );
+extern int tcpip_route_tx ( struct io_buffer *iobuf, struct tcpip_route *route,
+			    struct net_protocol *net_protocol );
 extern struct tcpip_net_protocol * tcpip_net_protocol ( sa_family_t sa_family );
 extern struct net_device * tcpip_netdev ( struct sockaddr_tcpip *st_dest );
 extern size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest );
 extern uint16_t tcpip_chksum ( const void *data, size_t len );
+extern uint16_t tcpip_copy_chksum ( uint16_t partial, void *dest,
+				    const void *src, size_t len );
+extern int tcpip_tx_csum ( struct io_buffer *iobuf, struct net_device *netdev,
+			   uint16_t *trans_csum, int offload );
+extern void tcpip_csum_complete ( struct io_buffer *iobuf );
 extern int tcpip_bind ( struct sockaddr_tcpip *st_local,
 			int ( * available ) ( int port ) );
 
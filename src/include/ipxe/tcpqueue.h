@@ -0,0 +1,101 @@
+#ifndef _IPXE_TCPQUEUE_H
+#define _IPXE_TCPQUEUE_H
+
+/** @file
+ *
+ * TCP out-of-order receive queue
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/list.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/tcp.h>
+
+/** TCP internal header
+ *
+ * This is the header that replaces the TCP header for packets
+ * enqueued on the receive queue.
+ */
+struct tcp_rx_queued_header {
+	/** SEQ value, in host-endian order
+	 *
+	 * This represents the SEQ value at the time the packet is
+	 * enqueued, and so excludes the SYN, if present.
+	 */
+	uint32_t seq;
+	/** Next SEQ value, in host-endian order */
+	uint32_t nxt;
+	/** Flags
+	 *
+	 * Only FIN is valid within this flags byte; all other flags
+	 * have already been processed by the time the packet is
+	 * enqueued.
+	 */
+	uint8_t flags;
+	/** Reserved */
+	uint8_t reserved[3];
+};
+
+/** A contiguous block of queued TCP data */
+struct tcp_rx_block {
+	/** List of blocks */
+	struct list_head list;
+	/** Queued packets
+	 *
+	 * Each packet starts no later than the end of the data
+	 * covered by all preceding packets within the block, and so
+	 * the packets may be processed in order once the start of
+	 * the block has been reached.
+	 */
+	struct list_head packets;
+	/** Start of block (in host-endian order) */
+	uint32_t left;
+	/** End of block (in host-endian order) */
+	uint32_t right;
+};
+
+/** A TCP out-of-order receive queue */
+struct tcp_rx_queue {
+	/** Contiguous blocks, in sequence order */
+	struct list_head blocks;
+	/** Number of queued packets */
+	unsigned int count;
+};
+
+/**
+ * Initialise TCP receive queue
+ *
+ * @v queue		Receive queue
+ */
+static inline __attribute__ (( always_inline )) void
+tcp_rx_queue_init ( struct tcp_rx_queue *queue ) {
+
+	INIT_LIST_HEAD ( &queue->blocks );
+	queue->count = 0;
+}
+
+/**
+ * Check if TCP receive queue is empty
+ *
+ * @v queue		Receive queue
+ * @ret is_empty	Receive queue is empty
+ */
+static inline __attribute__ (( always_inline )) int
+tcp_rx_queue_empty ( struct tcp_rx_queue *queue ) {
+
+	return list_empty ( &queue->blocks );
+}
+
+extern void tcp_rx_queue_insert ( struct tcp_rx_queue *queue,
+				  struct io_buffer *iobuf );
+extern struct io_buffer * tcp_rx_queue_dequeue ( struct tcp_rx_queue *queue,
+						 uint32_t ack );
+extern uint32_t tcp_rx_queue_sack ( struct tcp_rx_queue *queue, uint32_t seq,
+				    struct tcp_sack_block *sack );
+extern unsigned int tcp_rx_queue_discard ( struct tcp_rx_queue *queue );
+extern void tcp_rx_queue_flush ( struct tcp_rx_queue *queue );
+
+#endif /* _IPXE_TCPQUEUE_H */
@@ -0,0 +1,97 @@
+#ifndef _IPXE_TRACE_H
+#define _IPXE_TRACE_H
+
+/** @file
+ *
+ * Binary event tracing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/profile.h>
+#include <config/trace.h>
+
+/** Number of payload words in a trace event */
+#define TRACE_DATA_WORDS 3
+
+/** A trace event */
+struct trace_event {
+	/** Timestamp (as returned by profile_timestamp()) */
+	unsigned long timestamp;
+	/** Event identifier */
+	unsigned long id;
+	/** Payload */
+	unsigned long data[TRACE_DATA_WORDS];
+};
+
+/** A trace ring */
+struct trace_ring {
+	/** Events */
+	struct trace_event *events;
+	/** Number of events (must be a power of two) */
+	unsigned int size;
+	/** Producer counter
+	 *
+	 * This is the sequence number of the next event to be
+	 * recorded.
+	 */
+	unsigned int prod;
+};
+
+/** Network device transmission (index, length, 0) */
+#define TRACE_NETDEV_TX 0x01
+
+/** Network device reception (index, length, 0) */
+#define TRACE_NETDEV_RX 0x02
+
+/** TCP transmission (sequence number, acknowledgement, length) */
+#define TRACE_TCP_TX 0x03
+
+/** TCP reception (sequence number, acknowledgement, length) */
+#define TRACE_TCP_RX 0x04
+
+/** TLS record transmission (type, length, 0) */
+#define TRACE_TLS_TX 0x05
+
+/** TLS record reception (type, length, 0) */
+#define TRACE_TLS_RX 0x06
+
+/** HTTP content reception (chunked, offset, length) */
+#define TRACE_HTTP_RX 0x07
+
+/** Data transfer buffer delivery (offset, length, buffer length) */
+#define TRACE_XFERBUF 0x08
+
+extern struct trace_ring trace_ring;
+
+extern void trace_ring_record ( struct trace_ring *ring, unsigned int id,
+				unsigned long data0, unsigned long data1,
+				unsigned long data2 );
+extern struct trace_event * trace_ring_event ( struct trace_ring *ring,
+					       unsigned int seq );
+extern unsigned int trace_ring_oldest ( struct trace_ring *ring );
+extern const char * trace_name ( unsigned int id );
+extern int trace_save ( const char *filename );
+
+/**
+ * Record trace event
+ *
+ * @v id		Event identifier
+ * @v data0		First payload word
+ * @v data1		Second payload word
+ * @v data2		Third payload word
+ */
+static inline __attribute__ (( always_inline )) void
+trace ( unsigned int id, unsigned long data0, unsigned long data1,
+	unsigned long data2 ) {
+
+	/* Force dead code elimination in non-tracing builds */
+	if ( TRACE_RING_SIZE == 0 )
+		return;
+
+	trace_ring_record ( &trace_ring, id, data0, data1, data2 );
+}
+
+#endif /* _IPXE_TRACE_H */
@@ -23,6 +23,14 @@ struct sockaddr;
  * UDP constants
  */
 
+/**
+ * Number of UDP connection hash buckets
+ *
+ * Received packets are demultiplexed via a hash table indexed by
+ * local port.  This must be a power of two.
+ */
+#define UDP_HASH_SIZE 64
+
 /**
  * A UDP header
  */
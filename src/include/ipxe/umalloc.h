@@ -31,6 +31,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /* Include all architecture-dependent I/O API headers */
 #include <bits/umalloc.h>
 
+/** External memory is allocated as a stack
+ *
+ * This may be overridden by a user memory allocation API
+ * implementation.
+ */
+#ifndef UMALLOC_STACKLIKE
+#define UMALLOC_STACKLIKE 0
+#endif
+
 /**
  * Reallocate external memory
  *
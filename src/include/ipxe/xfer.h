@@ -77,6 +77,14 @@ extern void xfer_window_changed ( struct interface *intf );
 #define xfer_window_changed_TYPE( object_type ) \
 	typeof ( void ( object_type ) )
 
+extern int xfer_established ( struct interface *intf );
+#define xfer_established_TYPE( object_type ) \
+	typeof ( int ( object_type ) )
+
+extern void xfer_connected ( struct interface *intf, struct sockaddr *peer );
+#define xfer_connected_TYPE( object_type ) \
+	typeof ( void ( object_type, struct sockaddr *peer ) )
+
 extern struct io_buffer * xfer_alloc_iob ( struct interface *intf,
 					   size_t len );
 #define xfer_alloc_iob_TYPE( object_type ) \
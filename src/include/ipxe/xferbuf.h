@@ -21,6 +21,14 @@ struct xfer_buffer {
 	void *data;
 	/** Size of data */
 	size_t len;
+	/** Allocated size of data buffer
+	 *
+	 * This may exceed the size of data, if the buffer operations
+	 * choose to allocate spare capacity to allow for future
+	 * growth.  A value of zero indicates that the allocated size
+	 * is unknown.
+	 */
+	size_t size;
 	/** Current offset within data */
 	size_t pos;
 	/** Data transfer buffer operations */
@@ -34,6 +42,12 @@ struct xfer_buffer_operations {
 	 * @v xferbuf		Data transfer buffer
 	 * @v len		New length (or zero to free buffer)
 	 * @ret rc		Return status code
+	 *
+	 * When growing the buffer, this call may choose to allocate
+	 * more than the requested length, in which case it must
+	 * record the allocated size in @c xferbuf->size.  When
+	 * shrinking the buffer, the allocated size should be reduced
+	 * to exactly the requested length.
 	 */
 	int ( * realloc ) ( struct xfer_buffer *xferbuf, size_t len );
 	/** Write data to buffer
@@ -90,6 +104,7 @@ xferbuf_umalloc_init ( struct xfer_buffer *xferbuf, userptr_t *data ) {
 }
 
 extern void xferbuf_free ( struct xfer_buffer *xferbuf );
+extern int xferbuf_trim ( struct xfer_buffer *xferbuf );
 extern int xferbuf_write ( struct xfer_buffer *xferbuf, size_t offset,
 			   const void *data, size_t len );
 extern int xferbuf_read ( struct xfer_buffer *xferbuf, size_t offset,
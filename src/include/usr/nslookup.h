@@ -10,5 +10,6 @@
 FILE_LICENCE ( GPL2_OR_LATER );
 
 extern int nslookup ( const char *name, const char *setting_name );
+extern void nslookup_stat ( void );
 
 #endif /* _USR_NSLOOKUP_H */
@@ -0,0 +1,16 @@
+#ifndef _USR_TRACEMGMT_H
+#define _USR_TRACEMGMT_H
+
+/** @file
+ *
+ * Binary event trace management
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+extern void trace_show ( void );
+extern void trace_follow ( void );
+extern void trace_clear ( void );
+
+#endif /* _USR_TRACEMGMT_H */
@@ -120,7 +120,7 @@ static void efi_snp_set_mode ( struct efi_snp_device *snpdev ) {
 
 	mode->HwAddressSize = ll_addr_len;
 	mode->MediaHeaderSize = ll_protocol->ll_header_len;
-	mode->MaxPacketSize = netdev->max_pkt_len;
+	mode->MaxPacketSize = ( ll_protocol->ll_header_len + netdev->mtu );
 	mode->ReceiveFilterMask = ( EFI_SIMPLE_NETWORK_RECEIVE_UNICAST |
 				    EFI_SIMPLE_NETWORK_RECEIVE_MULTICAST |
 				    EFI_SIMPLE_NETWORK_RECEIVE_BROADCAST );
@@ -974,7 +974,7 @@ static EFI_STATUS efi_undi_get_init_info ( struct efi_snp_device *snpdev,
 
 	/* Populate structure */
 	memset ( db, 0, sizeof ( *db ) );
-	db->FrameDataLen = ( netdev->max_pkt_len - ll_protocol->ll_header_len );
+	db->FrameDataLen = netdev->mtu;
 	db->MediaHeaderLen = ll_protocol->ll_header_len;
 	db->HWaddrLen = ll_protocol->ll_addr_len;
 	db->IFtype = ntohs ( ll_protocol->ll_proto );
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Linux binary event trace file output
+ *
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include <linux_api.h>
+#include <asm/unistd.h>
+#include <ipxe/linux.h>
+#include <ipxe/trace.h>
+
+/**
+ * Save trace ring to file
+ *
+ * @v filename		Filename
+ * @ret rc		Return status code
+ *
+ * The events are written as an array of raw @c struct @c trace_event
+ * records, oldest first.
+ */
+int trace_save ( const char *filename ) {
+	struct trace_event *event;
+	unsigned int seq;
+	int fd;
+	int rc;
+
+	/* Create file */
+	fd = linux_syscall ( __NR_open, filename,
+			     ( O_WRONLY | O_CREAT | O_TRUNC ), 0644 );
+	if ( fd < 0 ) {
+		rc = -ELINUX ( linux_errno );
+		DBGC ( &trace_ring, "TRACE could not create %s: %s\n",
+		       filename, linux_strerror ( linux_errno ) );
+		goto err_open;
+	}
+
+	/* Write events */
+	for ( seq = trace_ring_oldest ( &trace_ring ) ;
+	      ( event = trace_ring_event ( &trace_ring, seq ) ) ; seq++ ) {
+		if ( linux_write ( fd, event, sizeof ( *event ) ) !=
+		     sizeof ( *event ) ) {
+			rc = -ELINUX ( linux_errno );
+			DBGC ( &trace_ring, "TRACE could not write %s: %s\n",
+			       filename, linux_strerror ( linux_errno ) );
+			goto err_write;
+		}
+	}
+
+	/* Success */
+	rc = 0;
+
+ err_write:
+	linux_close ( fd );
+ err_open:
+	return rc;
+}
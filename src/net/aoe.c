@@ -841,6 +841,30 @@ static struct interface_operation aoedev_config_op[] = {
 static struct interface_descriptor aoedev_config_desc =
 	INTF_DESC ( struct aoe_device, config, aoedev_config_op );
 
+/**
+ * Calculate maximum number of sectors per packet
+ *
+ * @v aoedev		AoE device
+ * @ret max_count	Maximum number of sectors per packet
+ */
+static unsigned int aoedev_max_count ( struct aoe_device *aoedev ) {
+	size_t mtu = aoedev->netdev->mtu;
+	size_t hlen = ( sizeof ( struct aoehdr ) + sizeof ( struct aoeata ) );
+	unsigned int max_count;
+
+	/* Fit as many sectors as possible within the MTU, allowing
+	 * at least one sector per packet so that a command can
+	 * always make progress.
+	 */
+	max_count = 1;
+	if ( mtu > ( hlen + ATA_SECTOR_SIZE ) )
+		max_count = ( ( mtu - hlen ) / ATA_SECTOR_SIZE );
+	if ( max_count > AOE_MAX_COUNT )
+		max_count = AOE_MAX_COUNT;
+
+	return max_count;
+}
+
 /**
  * Open AoE device
  *
@@ -879,7 +903,7 @@ static int aoedev_open ( struct interface *parent, struct net_device *netdev,
 
 	/* Attach ATA device to parent interface */
 	if ( ( rc = ata_open ( parent, &aoedev->ata, ATA_DEV_MASTER,
-			       AOE_MAX_COUNT ) ) != 0 ) {
+			       aoedev_max_count ( aoedev ) ) ) != 0 ) {
 		DBGC ( aoedev, "AoE %s could not create ATA device: %s\n",
 		       aoedev_name ( aoedev ), strerror ( rc ) );
 		goto err_ata_open;
@@ -253,6 +253,7 @@ struct ll_protocol ethernet_protocol __ll_protocol = {
 	.mc_hash	= eth_mc_hash,
 	.eth_addr	= eth_eth_addr,
 	.eui64		= eth_eui64,
+	.flags		= LL_STATIC_HEADER,
 };
 
 /**
@@ -269,6 +270,7 @@ struct net_device * alloc_etherdev ( size_t priv_size ) {
 		netdev->ll_protocol = &ethernet_protocol;
 		netdev->ll_broadcast = eth_broadcast;
 		netdev->max_pkt_len = ETH_FRAME_LEN;
+		netdev->mtu = ETH_MAX_MTU;
 	}
 	return netdev;
 }
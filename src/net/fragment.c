@@ -26,16 +26,108 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <assert.h>
 #include <ipxe/retry.h>
 #include <ipxe/timer.h>
 #include <ipxe/ipstat.h>
+#include <ipxe/netdevice.h>
 #include <ipxe/fragment.h>
 
 /** @file
  *
  * Fragment reassembly
  *
+ * Fragments may arrive in any order, and may overlap or duplicate
+ * fragments already received.  Each reassembly buffer holds the
+ * received fragments in order of offset, trimming any data already
+ * present, so that the holes remaining to be filled are simply the
+ * gaps between consecutive fragments.  The packet is complete once
+ * the final fragment has been received and no holes remain.
+ *
+ * The received fragments are copied into a single buffer exactly
+ * once, when the packet is complete.
+ *
+ */
+
+/**
+ * Get size of I/O buffer held by fragment reassembler
+ *
+ * @v iobuf		I/O buffer
+ * @ret size		Size of I/O buffer
+ */
+static inline size_t fragment_iob_size ( struct io_buffer *iobuf ) {
+	return ( iobuf->end - iobuf->head );
+}
+
+/**
+ * Free fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ */
+static void fragment_free ( struct fragment *fragment ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	list_for_each_entry_safe ( iobuf, tmp, &fragment->chain, list ) {
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
+	fragment->fragments->size -= fragment->size;
+	stop_timer ( &fragment->timer );
+	list_del ( &fragment->list );
+	free ( fragment );
+}
+
+/**
+ * Fail fragment reassembly
+ *
+ * @v fragment		Fragment reassembly buffer
+ */
+static void fragment_fail ( struct fragment *fragment ) {
+
+	fragment->fragments->stats->reasm_fails++;
+	fragment_free ( fragment );
+}
+
+/**
+ * Complete fragment reassembly
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @ret iobuf		Reassembled packet, or NULL on error
+ *
+ * Headroom is reserved to allow for code which modifies and resends
+ * the buffer (e.g. ICMP echo responses).
  */
+static struct io_buffer * fragment_complete ( struct fragment *fragment ) {
+	struct fragment_queued_header *fraghdr;
+	struct io_buffer *iobuf;
+	struct io_buffer *frag;
+	size_t len;
+
+	/* Allocate reassembly buffer */
+	len = ( MAX_LL_HEADER_LEN + fragment->hdrlen + fragment->total );
+	iobuf = alloc_iob ( len );
+	if ( ! iobuf ) {
+		DBGC ( fragment, "FRAG %p could not allocate %zd-byte "
+		       "reassembly buffer\n", fragment, len );
+		return NULL;
+	}
+	iob_reserve ( iobuf, MAX_LL_HEADER_LEN );
+
+	/* Copy non-fragmentable portion and fragments */
+	memcpy ( iob_put ( iobuf, fragment->hdrlen ), fragment->hdr,
+		 fragment->hdrlen );
+	list_for_each_entry ( frag, &fragment->chain, list ) {
+		fraghdr = frag->data;
+		len = ( iob_len ( frag ) - sizeof ( *fraghdr ) );
+		assert ( ( fragment->hdrlen + fraghdr->offset ) ==
+			 iob_len ( iobuf ) );
+		memcpy ( iob_put ( iobuf, len ), ( fraghdr + 1 ), len );
+	}
+
+	return iobuf;
+}
 
 /**
  * Expire fragment reassembly buffer
@@ -48,10 +140,7 @@ static void fragment_expired ( struct retry_timer *timer, int fail __unused ) {
 		container_of ( timer, struct fragment, timer );
 
 	DBGC ( fragment, "FRAG %p expired\n", fragment );
-	free_iob ( fragment->iobuf );
-	list_del ( &fragment->list );
-	fragment->fragments->stats->reasm_fails++;
-	free ( fragment );
+	fragment_fail ( fragment );
 }
 
 /**
@@ -74,6 +163,149 @@ static struct fragment * fragment_find ( struct fragment_reassembler *fragments,
 	return NULL;
 }
 
+/**
+ * Create fragment reassembly buffer
+ *
+ * @v fragments		Fragment reassembler
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret fragment	Fragment reassembly buffer, or NULL on error
+ */
+static struct fragment *
+fragment_create ( struct fragment_reassembler *fragments,
+		  struct io_buffer *iobuf, size_t hdrlen ) {
+	struct fragment *fragment;
+
+	/* Allocate and initialise structure */
+	fragment = zalloc ( sizeof ( *fragment ) + hdrlen );
+	if ( ! fragment )
+		return NULL;
+	fragment->hdr = ( ( ( void * ) fragment ) + sizeof ( *fragment ) );
+	memcpy ( fragment->hdr, iobuf->data, hdrlen );
+	fragment->hdrlen = hdrlen;
+	INIT_LIST_HEAD ( &fragment->chain );
+	timer_init ( &fragment->timer, fragment_expired, NULL );
+	fragment->fragments = fragments;
+	list_add ( &fragment->list, &fragments->list );
+
+	return fragment;
+}
+
+/**
+ * Get end offset of received data
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @ret end		End offset of last received fragment
+ */
+static size_t fragment_end ( struct fragment *fragment ) {
+	struct fragment_queued_header *fraghdr;
+	struct io_buffer *frag;
+
+	frag = list_last_entry ( &fragment->chain, struct io_buffer, list );
+	if ( ! frag )
+		return 0;
+	fraghdr = frag->data;
+	return ( fraghdr->offset + iob_len ( frag ) - sizeof ( *fraghdr ) );
+}
+
+/**
+ * Add fragment to fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer (with non-fragmentable portion removed)
+ * @v offset		Offset of fragment data
+ *
+ * Any data already present within the reassembly buffer is trimmed
+ * from the new fragment, and any existing fragments lying entirely
+ * within the new fragment are discarded.
+ */
+static void fragment_insert ( struct fragment *fragment,
+			      struct io_buffer *iobuf, size_t offset ) {
+	struct fragment_queued_header *fraghdr;
+	struct list_head *prev = &fragment->chain;
+	struct io_buffer *frag;
+	struct io_buffer *tmp;
+	size_t end = ( offset + iob_len ( iobuf ) );
+	size_t frag_start;
+	size_t frag_end;
+
+	/* Find position, trimming any overlapping data */
+	list_for_each_entry_safe ( frag, tmp, &fragment->chain, list ) {
+		fraghdr = frag->data;
+		frag_start = fraghdr->offset;
+		frag_end = ( frag_start + iob_len ( frag ) -
+			     sizeof ( *fraghdr ) );
+		if ( frag_end <= offset ) {
+			/* Existing fragment lies entirely before */
+			prev = &frag->list;
+		} else if ( frag_start >= end ) {
+			/* Existing fragment lies entirely after */
+			break;
+		} else if ( frag_start <= offset ) {
+			/* Existing fragment overlaps start */
+			if ( frag_end >= end ) {
+				DBGC ( fragment, "FRAG %p [%zd,%zd) "
+				       "duplicate\n", fragment, offset, end );
+				free_iob ( iobuf );
+				return;
+			}
+			iob_pull ( iobuf, ( frag_end - offset ) );
+			offset = frag_end;
+			prev = &frag->list;
+		} else if ( frag_end <= end ) {
+			/* Existing fragment lies entirely within */
+			fragment->len -= ( frag_end - frag_start );
+			fragment->size -= fragment_iob_size ( frag );
+			fragment->fragments->size -= fragment_iob_size ( frag );
+			list_del ( &frag->list );
+			free_iob ( frag );
+		} else {
+			/* Existing fragment overlaps end */
+			iob_unput ( iobuf, ( end - frag_start ) );
+			end = frag_start;
+			break;
+		}
+	}
+
+	/* Add to chain of received fragments */
+	DBGC ( fragment, "FRAG %p [%zd,%zd)\n", fragment, offset, end );
+	fraghdr = iob_push ( iobuf, sizeof ( *fraghdr ) );
+	fraghdr->offset = offset;
+	list_add ( &iobuf->list, prev );
+	fragment->len += ( end - offset );
+	fragment->size += fragment_iob_size ( iobuf );
+	fragment->fragments->size += fragment_iob_size ( iobuf );
+}
+
+/**
+ * Make space within fragment reassembly memory budget
+ *
+ * @v fragments		Fragment reassembler
+ * @v fragment		Fragment reassembly buffer to be extended
+ * @v size		Size of I/O buffer to be added
+ * @ret rc		Return status code
+ *
+ * The oldest other incomplete packets are discarded as needed.
+ */
+static int fragment_reserve ( struct fragment_reassembler *fragments,
+			      struct fragment *fragment, size_t size ) {
+	struct fragment *oldest;
+
+	while ( ( fragments->size + size ) > FRAGMENT_BUDGET ) {
+		oldest = list_last_entry ( &fragments->list, struct fragment,
+					   list );
+		if ( oldest == fragment ) {
+			if ( fragment->list.prev == &fragments->list )
+				return -ENOBUFS;
+			oldest = list_entry ( fragment->list.prev,
+					      struct fragment, list );
+		}
+		DBGC ( oldest, "FRAG %p discarded to make space\n", oldest );
+		fragment_fail ( oldest );
+	}
+	return 0;
+}
+
 /**
  * Reassemble packet
  *
@@ -89,94 +321,90 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 					 struct io_buffer *iobuf,
 					 size_t *hdrlen ) {
 	struct fragment *fragment;
-	struct io_buffer *new_iobuf;
-	size_t new_len;
 	size_t offset;
-	size_t expected_offset;
+	size_t end;
 	int more_frags;
 
 	/* Update statistics */
 	fragments->stats->reasm_reqds++;
 
-	/* Find matching fragment reassembly buffer, if any */
-	fragment = fragment_find ( fragments, iobuf, *hdrlen );
-
-	/* Drop out-of-order fragments */
+	/* Parse fragment */
 	offset = fragments->fragment_offset ( iobuf, *hdrlen );
-	expected_offset = ( fragment ? ( iob_len ( fragment->iobuf ) -
-					 fragment->hdrlen ) : 0 );
-	if ( offset != expected_offset ) {
-		DBGC ( fragment, "FRAG %p dropping out-of-sequence fragment "
-		       "[%zd,%zd), expected [%zd,...)\n", fragment, offset,
-		       ( offset + iob_len ( iobuf ) - *hdrlen ),
-		       expected_offset );
-		goto drop;
-	}
+	end = ( offset + iob_len ( iobuf ) - *hdrlen );
+	more_frags = fragments->more_fragments ( iobuf, *hdrlen );
 
-	/* Create or extend fragment reassembly buffer as applicable */
+	/* Find or create matching fragment reassembly buffer */
+	fragment = fragment_find ( fragments, iobuf, *hdrlen );
 	if ( ! fragment ) {
-
-		/* Create new fragment reassembly buffer */
-		fragment = zalloc ( sizeof ( *fragment ) );
+		fragment = fragment_create ( fragments, iobuf, *hdrlen );
 		if ( ! fragment )
 			goto drop;
-		list_add ( &fragment->list, &fragments->list );
-		fragment->iobuf = iobuf;
-		fragment->hdrlen = *hdrlen;
-		timer_init ( &fragment->timer, fragment_expired, NULL );
-		fragment->fragments = fragments;
-		DBGC ( fragment, "FRAG %p [0,%zd)\n", fragment,
-		       ( iob_len ( iobuf ) - *hdrlen ) );
+	}
+	DBGC ( fragment, "FRAG %p received [%zd,%zd)%s\n", fragment,
+	       offset, end, ( more_frags ? "" : " final" ) );
 
-	} else {
+	/* Drop fragments with an inconsistent non-fragmentable portion */
+	if ( *hdrlen != fragment->hdrlen ) {
+		DBGC ( fragment, "FRAG %p header length %zd, expected %zd\n",
+		       fragment, *hdrlen, fragment->hdrlen );
+		goto drop;
+	}
 
-		/* Check if this is the final fragment */
-		more_frags = fragments->more_fragments ( iobuf, *hdrlen );
-		DBGC ( fragment, "FRAG %p [%zd,%zd)%s\n", fragment,
-		       offset, ( offset + iob_len ( iobuf ) - *hdrlen ),
-		       ( more_frags ? "" : " complete" ) );
+	/* Check consistency with any known total length */
+	if ( ! more_frags ) {
+		if ( ( fragment->total && ( end != fragment->total ) ) ||
+		     ( end < fragment_end ( fragment ) ) ) {
+			DBGC ( fragment, "FRAG %p inconsistent final fragment "
+			       "[%zd,%zd)\n", fragment, offset, end );
+			goto fail;
+		}
+		fragment->total = end;
+	} else if ( fragment->total && ( end > fragment->total ) ) {
+		DBGC ( fragment, "FRAG %p fragment [%zd,%zd) beyond end %zd\n",
+		       fragment, offset, end, fragment->total );
+		goto fail;
+	}
 
-		/* Extend fragment reassembly buffer.  Preserve I/O
-		 * buffer headroom to allow for code which modifies
-		 * and resends the buffer (e.g. ICMP echo responses).
-		 */
-		iob_pull ( iobuf, *hdrlen );
-		new_len = ( iob_headroom ( fragment->iobuf ) +
-			    iob_len ( fragment->iobuf ) + iob_len ( iobuf ) );
-		new_iobuf = alloc_iob ( new_len );
-		if ( ! new_iobuf ) {
-			DBGC ( fragment, "FRAG %p could not extend reassembly "
-			       "buffer to %zd bytes\n", fragment, new_len );
-			goto drop;
+	/* Record non-fragmentable portion from first fragment */
+	if ( offset == 0 )
+		memcpy ( fragment->hdr, iobuf->data, *hdrlen );
+
+	/* Add to reassembly buffer, if not empty */
+	if ( end > offset ) {
+		if ( fragment_reserve ( fragments, fragment,
+					fragment_iob_size ( iobuf ) ) != 0 ) {
+			DBGC ( fragment, "FRAG %p exceeds memory budget\n",
+			       fragment );
+			goto fail;
 		}
-		iob_reserve ( new_iobuf, iob_headroom ( fragment->iobuf ) );
-		memcpy ( iob_put ( new_iobuf, iob_len ( fragment->iobuf ) ),
-			 fragment->iobuf->data, iob_len ( fragment->iobuf ) );
-		memcpy ( iob_put ( new_iobuf, iob_len ( iobuf ) ),
-			 iobuf->data, iob_len ( iobuf ) );
-		free_iob ( fragment->iobuf );
-		fragment->iobuf = new_iobuf;
-		free_iob ( iobuf );
+		iob_pull ( iobuf, *hdrlen );
+		fragment_insert ( fragment, iob_disown ( iobuf ), offset );
+	} else {
+		free_iob ( iob_disown ( iobuf ) );
+	}
 
-		/* Stop fragment reassembly timer */
-		stop_timer ( &fragment->timer );
-
-		/* If this is the final fragment, return it */
-		if ( ! more_frags ) {
-			iobuf = fragment->iobuf;
-			*hdrlen = fragment->hdrlen;
-			list_del ( &fragment->list );
-			free ( fragment );
-			fragments->stats->reasm_oks++;
-			return iobuf;
+	/* Complete reassembly if all fragments have been received */
+	if ( fragment->total && ( fragment->len == fragment->total ) ) {
+		DBGC ( fragment, "FRAG %p complete\n", fragment );
+		iobuf = fragment_complete ( fragment );
+		*hdrlen = fragment->hdrlen;
+		if ( ! iobuf ) {
+			fragment_fail ( fragment );
+			return NULL;
 		}
+		fragment_free ( fragment );
+		fragments->stats->reasm_oks++;
+		return iobuf;
 	}
 
 	/* (Re)start fragment reassembly timer */
+	stop_timer ( &fragment->timer );
 	start_timer_fixed ( &fragment->timer, FRAGMENT_TIMEOUT );
 
 	return NULL;
 
+ fail:
+	fragment_free ( fragment );
  drop:
 	fragments->stats->reasm_fails++;
 	free_iob ( iobuf );
@@ -87,7 +87,7 @@ static int icmp_tx_echo ( struct io_buffer *iobuf,
 
 	/* Transmit packet */
 	if ( ( rc = tcpip_tx ( iobuf, echo_protocol->tcpip_protocol, NULL,
-			       st_dest, NULL,
+			       st_dest, NULL, NULL,
 			       ( echo_protocol->net_checksum ?
 				 &echo->icmp.chksum : NULL ) ) ) != 0 )
 		return rc;
@@ -114,6 +114,9 @@ static int add_ipv4_miniroute ( struct net_device *netdev,
 		list_add ( &miniroute->list, &ipv4_miniroutes );
 	}
 
+	/* Invalidate cached routes */
+	tcpip_route_changed();
+
 	return 0;
 }
 
@@ -134,6 +137,9 @@ static void del_ipv4_miniroute ( struct ipv4_miniroute *miniroute ) {
 	netdev_put ( miniroute->netdev );
 	list_del ( &miniroute->list );
 	free ( miniroute );
+
+	/* Invalidate cached routes */
+	tcpip_route_changed();
 }
 
 /**
@@ -219,7 +225,7 @@ static struct net_device * ipv4_netdev ( struct sockaddr_tcpip *st_dest ) {
 static int ipv4_is_fragment ( struct fragment *fragment,
 			      struct io_buffer *iobuf,
 			      size_t hdrlen __unused ) {
-	struct iphdr *frag_iphdr = fragment->iobuf->data;
+	struct iphdr *frag_iphdr = fragment->hdr;
 	struct iphdr *iphdr = iobuf->data;
 
 	return ( ( iphdr->src.s_addr == frag_iphdr->src.s_addr ) &&
@@ -266,21 +272,21 @@ static struct fragment_reassembler ipv4_reassembler = {
 /**
  * Add IPv4 pseudo-header checksum to existing checksum
  *
- * @v iobuf		I/O buffer
+ * @v iphdr		IPv4 header
+ * @v len		Payload length
  * @v csum		Existing checksum
  * @ret csum		Updated checksum
  */
-static uint16_t ipv4_pshdr_chksum ( struct io_buffer *iobuf, uint16_t csum ) {
+static uint16_t ipv4_pshdr_chksum ( struct iphdr *iphdr, size_t len,
+				    uint16_t csum ) {
 	struct ipv4_pseudo_header pshdr;
-	struct iphdr *iphdr = iobuf->data;
-	size_t hdrlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
 
 	/* Build pseudo-header */
 	pshdr.src = iphdr->src;
 	pshdr.dest = iphdr->dest;
 	pshdr.zero_padding = 0x00;
 	pshdr.protocol = iphdr->protocol;
-	pshdr.len = htons ( iob_len ( iobuf ) - hdrlen );
+	pshdr.len = htons ( len );
 
 	/* Update the checksum value */
 	return tcpip_continue_chksum ( csum, &pshdr, sizeof ( pshdr ) );
@@ -294,6 +300,7 @@ static uint16_t ipv4_pshdr_chksum ( struct io_buffer *iobuf, uint16_t csum ) {
  * @v st_src		Source network-layer address
  * @v st_dest		Destination network-layer address
  * @v netdev		Network device to use if no route found, or NULL
+ * @v route		Cached transmit route, or NULL
  * @v trans_csum	Transport-layer checksum to complete, or NULL
  * @ret rc		Status
  *
@@ -304,15 +311,18 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 		     struct sockaddr_tcpip *st_src,
 		     struct sockaddr_tcpip *st_dest,
 		     struct net_device *netdev,
+		     struct tcpip_route *route,
 		     uint16_t *trans_csum ) {
 	struct iphdr *iphdr = iob_push ( iobuf, sizeof ( *iphdr ) );
 	struct sockaddr_in *sin_src = ( ( struct sockaddr_in * ) st_src );
 	struct sockaddr_in *sin_dest = ( ( struct sockaddr_in * ) st_dest );
-	struct ipv4_miniroute *miniroute;
+	struct ipv4_miniroute *miniroute = NULL;
 	struct in_addr next_hop;
 	struct in_addr netmask = { .s_addr = 0 };
 	uint8_t ll_dest_buf[MAX_LL_ADDR_LEN];
 	const void *ll_dest;
+	size_t len;
+	int cached;
 	int rc;
 
 	/* Start profiling */
@@ -330,16 +340,26 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	iphdr->protocol = tcpip_protocol->tcpip_proto;
 	iphdr->dest = sin_dest->sin_addr;
 
-	/* Use routing table to identify next hop and transmitting netdev */
+	/* Use cached route if valid, otherwise use routing table to
+	 * identify next hop and transmitting netdev.
+	 */
 	next_hop = iphdr->dest;
-	if ( sin_src )
-		iphdr->src = sin_src->sin_addr;
-	if ( ( next_hop.s_addr != INADDR_BROADCAST ) &&
-	     ( ( miniroute = ipv4_route ( sin_dest->sin_scope_id,
-					  &next_hop ) ) != NULL ) ) {
-		iphdr->src = miniroute->address;
-		netmask = miniroute->netmask;
-		netdev = miniroute->netdev;
+	cached = ( route && tcpip_route_is_valid ( route, &next_hop,
+						   sizeof ( next_hop ) ) );
+	if ( cached ) {
+		memcpy ( &iphdr->src, route->net_source,
+			 sizeof ( iphdr->src ) );
+		netdev = route->netdev;
+	} else {
+		if ( sin_src )
+			iphdr->src = sin_src->sin_addr;
+		if ( ( next_hop.s_addr != INADDR_BROADCAST ) &&
+		     ( ( miniroute = ipv4_route ( sin_dest->sin_scope_id,
+						  &next_hop ) ) != NULL ) ) {
+			iphdr->src = miniroute->address;
+			netmask = miniroute->netmask;
+			netdev = miniroute->netdev;
+		}
 	}
 	if ( ! netdev ) {
 		DBGC ( sin_dest->sin_addr, "IPv4 has no route to %s\n",
@@ -359,9 +379,16 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 
 	/* Fix up checksums */
 	if ( trans_csum ) {
-		*trans_csum = ipv4_pshdr_chksum ( iobuf, *trans_csum );
-		if ( ! *trans_csum )
-			*trans_csum = tcpip_protocol->zero_csum;
+		len = ( iob_len ( iobuf ) - sizeof ( *iphdr ) );
+		if ( tcpip_tx_csum ( iobuf, netdev, trans_csum, 1 ) ) {
+			*trans_csum = ~ipv4_pshdr_chksum ( iphdr, len,
+							   TCPIP_EMPTY_CSUM );
+		} else {
+			*trans_csum = ipv4_pshdr_chksum ( iphdr, len,
+							  *trans_csum );
+			if ( ! *trans_csum )
+				*trans_csum = tcpip_protocol->zero_csum;
+		}
 	}
 	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
 
@@ -373,7 +400,11 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 		ntohs ( iphdr->chksum ) );
 
 	/* Calculate link-layer destination address, if possible */
-	if ( ( ( next_hop.s_addr ^ INADDR_BROADCAST ) & ~netmask.s_addr ) == 0){
+	if ( cached ) {
+		/* Unicast address with cached route */
+		ll_dest = NULL;
+	} else if ( ( ( next_hop.s_addr ^ INADDR_BROADCAST ) &
+		      ~netmask.s_addr ) == 0 ) {
 		/* Broadcast address */
 		ipv4_stats.out_bcast_pkts++;
 		ll_dest = netdev->ll_broadcast;
@@ -397,23 +428,25 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	ipv4_stats.out_transmits++;
 	ipv4_stats.out_octets += iob_len ( iobuf );
 
-	/* Hand off to link layer (via ARP if applicable) */
-	if ( ll_dest ) {
-		if ( ( rc = net_tx ( iobuf, netdev, &ipv4_protocol, ll_dest,
-				     netdev->ll_addr ) ) != 0 ) {
-			DBGC ( sin_dest->sin_addr, "IPv4 could not transmit "
-			       "packet via %s: %s\n",
-			       netdev->name, strerror ( rc ) );
-			return rc;
-		}
+	/* Hand off to link layer (via cached route or ARP if applicable) */
+	if ( cached ) {
+		rc = tcpip_route_tx ( iobuf, route, &ipv4_protocol );
+	} else if ( ll_dest ) {
+		rc = net_tx ( iobuf, netdev, &ipv4_protocol, ll_dest,
+			      netdev->ll_addr );
 	} else {
-		if ( ( rc = arp_tx ( iobuf, netdev, &ipv4_protocol, &next_hop,
-				     &iphdr->src, netdev->ll_addr ) ) != 0 ) {
-			DBGC ( sin_dest->sin_addr, "IPv4 could not transmit "
-			       "packet via %s: %s\n",
-			       netdev->name, strerror ( rc ) );
-			return rc;
+		if ( route && miniroute ) {
+			tcpip_route_update ( route, netdev, &ipv4_protocol,
+					     &iphdr->dest, &next_hop,
+					     &iphdr->src );
 		}
+		rc = arp_tx ( iobuf, netdev, &ipv4_protocol, &next_hop,
+			      &iphdr->src, netdev->ll_addr );
+	}
+	if ( rc != 0 ) {
+		DBGC ( sin_dest->sin_addr, "IPv4 could not transmit packet "
+		       "via %s: %s\n", netdev->name, strerror ( rc ) );
+		return rc;
 	}
 
 	profile_stop ( &ipv4_tx_profiler );
@@ -581,7 +614,8 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 	memset ( &dest, 0, sizeof ( dest ) );
 	dest.sin.sin_family = AF_INET;
 	dest.sin.sin_addr = iphdr->dest;
-	pshdr_csum = ipv4_pshdr_chksum ( iobuf, TCPIP_EMPTY_CSUM );
+	pshdr_csum = ipv4_pshdr_chksum ( iphdr, ( iob_len ( iobuf ) - hdrlen ),
+					 TCPIP_EMPTY_CSUM );
 	iob_pull ( iobuf, hdrlen );
 	if ( ( rc = tcpip_rx ( iobuf, netdev, iphdr->protocol, &src.st,
 			       &dest.st, pshdr_csum, &ipv4_stats ) ) != 0 ) {
@@ -703,12 +737,52 @@ static int ipv4_sock_aton ( const char *string, struct sockaddr *sa ) {
 	return -EINVAL;
 }
 
+/**
+ * Identify IPv4 packet eligible for receive coalescing
+ *
+ * @v iobuf		I/O buffer
+ * @v gro		Receive coalescing descriptor to fill in
+ * @ret rc		Return status code
+ *
+ * Only unfragmented TCP packets without IPv4 options are eligible.
+ */
+static int ipv4_gro ( struct io_buffer *iobuf, struct net_gro *gro ) {
+	struct iphdr *iphdr = iobuf->data;
+	size_t len;
+
+	/* Check IPv4 header */
+	if ( iob_len ( iobuf ) < sizeof ( *iphdr ) )
+		return -EINVAL;
+	if ( iphdr->verhdrlen != ( IP_VER | ( sizeof ( *iphdr ) / 4 ) ) )
+		return -ENOTSUP;
+	if ( iphdr->protocol != IP_TCP )
+		return -ENOTSUP;
+	if ( iphdr->frags & htons ( IP_MASK_OFFSET | IP_MASK_MOREFRAGS ) )
+		return -ENOTSUP;
+	len = ntohs ( iphdr->len );
+	if ( ( len < sizeof ( *iphdr ) ) || ( len > iob_len ( iobuf ) ) )
+		return -EINVAL;
+	if ( tcpip_chksum ( iphdr, sizeof ( *iphdr ) ) != 0 )
+		return -EINVAL;
+
+	/* Fill in descriptor */
+	len -= sizeof ( *iphdr );
+	gro->flow = &iphdr->src;
+	gro->flow_len = ( sizeof ( iphdr->src ) + sizeof ( iphdr->dest ) );
+	gro->tcphdr = ( iobuf->data + sizeof ( *iphdr ) );
+	gro->len = len;
+	gro->pshdr_csum = ipv4_pshdr_chksum ( iphdr, len, TCPIP_EMPTY_CSUM );
+
+	return 0;
+}
+
 /** IPv4 protocol */
 struct net_protocol ipv4_protocol __net_protocol = {
 	.name = "IP",
 	.net_proto = htons ( ETH_P_IP ),
 	.net_addr_len = sizeof ( struct in_addr ),
 	.rx = ipv4_rx,
+	.gro = ipv4_gro,
 	.ntoa = ipv4_ntoa,
 };
 
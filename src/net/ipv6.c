@@ -281,6 +281,10 @@ int ipv6_add_miniroute ( struct net_device *netdev, struct in6_addr *address,
 	}
 
 	ipv6_dump_miniroute ( miniroute );
+
+	/* Invalidate cached routes */
+	tcpip_route_changed();
+
 	return 0;
 }
 
@@ -294,6 +298,9 @@ void ipv6_del_miniroute ( struct ipv6_miniroute *miniroute ) {
 	netdev_put ( miniroute->netdev );
 	list_del ( &miniroute->list );
 	free ( miniroute );
+
+	/* Invalidate cached routes */
+	tcpip_route_changed();
 }
 
 /**
@@ -434,10 +441,9 @@ static int ipv6_check_options ( struct ipv6_header *iphdr,
  */
 static int ipv6_is_fragment ( struct fragment *fragment,
 			      struct io_buffer *iobuf, size_t hdrlen ) {
-	struct ipv6_header *frag_iphdr = fragment->iobuf->data;
+	struct ipv6_header *frag_iphdr = fragment->hdr;
 	struct ipv6_fragment_header *frag_fhdr =
-		( fragment->iobuf->data + fragment->hdrlen -
-		  sizeof ( *frag_fhdr ) );
+		( fragment->hdr + fragment->hdrlen - sizeof ( *frag_fhdr ) );
 	struct ipv6_header *iphdr = iobuf->data;
 	struct ipv6_fragment_header *fhdr =
 		( iobuf->data + hdrlen - sizeof ( *fhdr ) );
@@ -516,6 +522,7 @@ static uint16_t ipv6_pshdr_chksum ( struct ipv6_header *iphdr, size_t len,
  * @v st_src		Source network-layer address
  * @v st_dest		Destination network-layer address
  * @v netdev		Network device to use if no route found, or NULL
+ * @v route		Cached transmit route, or NULL
  * @v trans_csum	Transport-layer checksum to complete, or NULL
  * @ret rc		Status
  *
@@ -527,16 +534,18 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 		     struct sockaddr_tcpip *st_src,
 		     struct sockaddr_tcpip *st_dest,
 		     struct net_device *netdev,
+		     struct tcpip_route *route,
 		     uint16_t *trans_csum ) {
 	struct sockaddr_in6 *sin6_src = ( ( struct sockaddr_in6 * ) st_src );
 	struct sockaddr_in6 *sin6_dest = ( ( struct sockaddr_in6 * ) st_dest );
-	struct ipv6_miniroute *miniroute;
+	struct ipv6_miniroute *miniroute = NULL;
 	struct ipv6_header *iphdr;
 	struct in6_addr *src = NULL;
 	struct in6_addr *next_hop;
 	uint8_t ll_dest_buf[MAX_LL_ADDR_LEN];
 	const void *ll_dest;
 	size_t len;
+	int cached;
 	int rc;
 
 	/* Update statistics */
@@ -552,10 +561,17 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 	iphdr->hop_limit = IPV6_HOP_LIMIT;
 	memcpy ( &iphdr->dest, &sin6_dest->sin6_addr, sizeof ( iphdr->dest ) );
 
-	/* Use routing table to identify next hop and transmitting netdev */
+	/* Use cached route if valid, otherwise use routing table to
+	 * identify next hop and transmitting netdev.
+	 */
 	next_hop = &iphdr->dest;
-	if ( ( miniroute = ipv6_route ( sin6_dest->sin6_scope_id,
-					&next_hop ) ) != NULL ) {
+	cached = ( route && tcpip_route_is_valid ( route, next_hop,
+						   sizeof ( *next_hop ) ) );
+	if ( cached ) {
+		src = ( ( struct in6_addr * ) route->net_source );
+		netdev = route->netdev;
+	} else if ( ( miniroute = ipv6_route ( sin6_dest->sin6_scope_id,
+					       &next_hop ) ) != NULL ) {
 		src = &miniroute->address;
 		netdev = miniroute->netdev;
 	}
@@ -566,18 +582,31 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 		rc = -ENETUNREACH;
 		goto err;
 	}
-	if ( sin6_src && ! IN6_IS_ADDR_UNSPECIFIED ( &sin6_src->sin6_addr ) )
+	if ( ( ! cached ) && sin6_src &&
+	     ( ! IN6_IS_ADDR_UNSPECIFIED ( &sin6_src->sin6_addr ) ) ) {
 		src = &sin6_src->sin6_addr;
+	}
 	if ( src )
 		memcpy ( &iphdr->src, src, sizeof ( iphdr->src ) );
 
-	/* Fix up checksums */
+	/* Fix up checksums.  Do not allow the network device to
+	 * insert a checksum if a zero checksum would be invalid, since
+	 * the device would not be able to substitute the alternative
+	 * representation of zero.
+	 */
 	if ( trans_csum ) {
-		*trans_csum = ipv6_pshdr_chksum ( iphdr, len,
-						  tcpip_protocol->tcpip_proto,
-						  *trans_csum );
-		if ( ! *trans_csum )
-			*trans_csum = tcpip_protocol->zero_csum;
+		if ( tcpip_tx_csum ( iobuf, netdev, trans_csum,
+				     ( ! tcpip_protocol->zero_csum ) ) ) {
+			*trans_csum = ~ipv6_pshdr_chksum ( iphdr, len,
+					tcpip_protocol->tcpip_proto,
+					TCPIP_EMPTY_CSUM );
+		} else {
+			*trans_csum = ipv6_pshdr_chksum ( iphdr, len,
+					tcpip_protocol->tcpip_proto,
+					*trans_csum );
+			if ( ! *trans_csum )
+				*trans_csum = tcpip_protocol->zero_csum;
+		}
 	}
 
 	/* Print IPv6 header for debugging */
@@ -587,7 +616,10 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 		inet6_ntoa ( &iphdr->dest ), len, iphdr->next_header );
 
 	/* Calculate link-layer destination address, if possible */
-	if ( IN6_IS_ADDR_MULTICAST ( next_hop ) ) {
+	if ( cached ) {
+		/* Unicast address with cached route */
+		ll_dest = NULL;
+	} else if ( IN6_IS_ADDR_MULTICAST ( next_hop ) ) {
 		/* Multicast address */
 		ipv6_stats.out_mcast_pkts++;
 		if ( ( rc = netdev->ll_protocol->mc_hash ( AF_INET6, next_hop,
@@ -607,8 +639,16 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 	ipv6_stats.out_transmits++;
 	ipv6_stats.out_octets += iob_len ( iobuf );
 
-	/* Hand off to link layer (via NDP if applicable) */
-	if ( ll_dest ) {
+	/* Hand off to link layer (via cached route or NDP if applicable) */
+	if ( cached ) {
+		if ( ( rc = tcpip_route_tx ( iobuf, route,
+					     &ipv6_protocol ) ) != 0 ) {
+			DBGC ( ipv6col ( &sin6_dest->sin6_addr ), "IPv6 could "
+			       "not transmit packet via %s: %s\n",
+			       netdev->name, strerror ( rc ) );
+			return rc;
+		}
+	} else if ( ll_dest ) {
 		if ( ( rc = net_tx ( iobuf, netdev, &ipv6_protocol, ll_dest,
 				     netdev->ll_addr ) ) != 0 ) {
 			DBGC ( ipv6col ( &iphdr->dest ), "IPv6 could not "
@@ -617,6 +657,11 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 			return rc;
 		}
 	} else {
+		if ( route && miniroute ) {
+			tcpip_route_update ( route, netdev, &ipv6_protocol,
+					     &iphdr->dest, next_hop,
+					     &iphdr->src );
+		}
 		if ( ( rc = ndp_tx ( iobuf, netdev, next_hop, &iphdr->src,
 				     netdev->ll_addr ) ) != 0 ) {
 			DBGC ( ipv6col ( &iphdr->dest ), "IPv6 could not "
@@ -1044,12 +1089,49 @@ static int ipv6_sock_aton ( const char *string, struct sockaddr *sa ) {
 	return rc;
 }
 
+/**
+ * Identify IPv6 packet eligible for receive coalescing
+ *
+ * @v iobuf		I/O buffer
+ * @v gro		Receive coalescing descriptor to fill in
+ * @ret rc		Return status code
+ *
+ * Only TCP packets without extension headers are eligible.
+ */
+static int ipv6_gro ( struct io_buffer *iobuf, struct net_gro *gro ) {
+	struct ipv6_header *iphdr = iobuf->data;
+	size_t len;
+
+	/* Check IPv6 header */
+	if ( iob_len ( iobuf ) < sizeof ( *iphdr ) )
+		return -EINVAL_LEN;
+	if ( ( iphdr->ver_tc_label & htonl ( IPV6_MASK_VER ) ) !=
+	     htonl ( IPV6_VER ) )
+		return -ENOTSUP_VER;
+	if ( iphdr->next_header != IP_TCP )
+		return -ENOTSUP_HDR;
+	len = ntohs ( iphdr->len );
+	if ( len > ( iob_len ( iobuf ) - sizeof ( *iphdr ) ) )
+		return -EINVAL_LEN;
+
+	/* Fill in descriptor */
+	gro->flow = &iphdr->src;
+	gro->flow_len = ( sizeof ( iphdr->src ) + sizeof ( iphdr->dest ) );
+	gro->tcphdr = ( iobuf->data + sizeof ( *iphdr ) );
+	gro->len = len;
+	gro->pshdr_csum = ipv6_pshdr_chksum ( iphdr, len, IP_TCP,
+					      TCPIP_EMPTY_CSUM );
+
+	return 0;
+}
+
 /** IPv6 protocol */
 struct net_protocol ipv6_protocol __net_protocol = {
 	.name = "IPv6",
 	.net_proto = htons ( ETH_P_IPV6 ),
 	.net_addr_len = sizeof ( struct in6_addr ),
 	.rx = ipv6_rx,
+	.gro = ipv6_gro,
 	.ntoa = ipv6_ntoa,
 };
 
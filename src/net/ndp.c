@@ -92,7 +92,7 @@ static int ndp_tx_ll_addr ( struct net_device *netdev,
 
 	/* Transmit packet */
 	if ( ( rc = tcpip_tx ( iobuf, &icmpv6_protocol, st_src, st_dest,
-			       netdev, &ndp->icmp.chksum ) ) != 0 ) {
+			       netdev, NULL, &ndp->icmp.chksum ) ) != 0 ) {
 		DBGC ( netdev, "NDP %s could not transmit packet: %s\n",
 		       netdev->name, strerror ( rc ) );
 		return rc;
@@ -31,6 +31,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/retry.h>
 #include <ipxe/timer.h>
 #include <ipxe/malloc.h>
+#include <ipxe/tcpip.h>
 #include <ipxe/neighbour.h>
 
 /** @file
@@ -163,6 +164,26 @@ static void neighbour_discover ( struct neighbour *neighbour,
 	       neighbour->discovery->name );
 }
 
+/**
+ * Invalidate cached routes if neighbour link-layer address changes
+ *
+ * @v neighbour		Neighbour cache entry
+ * @v ll_dest		New destination link-layer address
+ *
+ * Cached routes may refer only to neighbour cache entries with a
+ * known link-layer address.
+ */
+static void neighbour_changed ( struct neighbour *neighbour,
+				const void *ll_dest ) {
+	struct ll_protocol *ll_protocol = neighbour->netdev->ll_protocol;
+
+	if ( neighbour_has_ll_dest ( neighbour ) &&
+	     ( memcmp ( neighbour->ll_dest, ll_dest,
+			ll_protocol->ll_addr_len ) != 0 ) ) {
+		tcpip_route_changed();
+	}
+}
+
 /**
  * Complete neighbour discovery
  *
@@ -224,6 +245,9 @@ static void neighbour_destroy ( struct neighbour *neighbour, int rc ) {
 	/* Take ownership from cache */
 	list_del ( &neighbour->list );
 
+	/* Invalidate any cached routes using this entry */
+	tcpip_route_changed();
+
 	/* Stop timer */
 	stop_timer ( &neighbour->timer );
 
@@ -326,6 +350,31 @@ int neighbour_tx ( struct io_buffer *iobuf, struct net_device *netdev,
 	}
 }
 
+/**
+ * Find link-layer address of neighbour
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @ret ll_dest		Destination link-layer address, or NULL if not known
+ */
+const void * neighbour_ll_dest ( struct net_device *netdev,
+				 struct net_protocol *net_protocol,
+				 const void *net_dest ) {
+	struct neighbour *neighbour;
+
+	/* Find neighbour cache entry */
+	neighbour = neighbour_find ( netdev, net_protocol, net_dest );
+	if ( ! neighbour )
+		return NULL;
+
+	/* Check that link-layer address is known */
+	if ( ! neighbour_has_ll_dest ( neighbour ) )
+		return NULL;
+
+	return neighbour->ll_dest;
+}
+
 /**
  * Update existing neighbour cache entry
  *
@@ -346,6 +395,7 @@ int neighbour_update ( struct net_device *netdev,
 		return -ENOENT;
 
 	/* Set destination address */
+	neighbour_changed ( neighbour, ll_dest );
 	neighbour_discovered ( neighbour, ll_dest );
 
 	return 0;
@@ -367,7 +417,9 @@ int neighbour_define ( struct net_device *netdev,
 
 	/* Find or create neighbour cache entry */
 	neighbour = neighbour_find ( netdev, net_protocol, net_dest );
-	if ( ! neighbour ) {
+	if ( neighbour ) {
+		neighbour_changed ( neighbour, ll_dest );
+	} else {
 		neighbour = neighbour_create ( netdev, net_protocol, net_dest );
 		if ( ! neighbour )
 			return -ENOMEM;
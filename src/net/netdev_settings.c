@@ -70,6 +70,12 @@ const struct setting ifname_setting __setting ( SETTING_NETDEV, ifname ) = {
 	.description = "Interface name",
 	.type = &setting_type_string,
 };
+const struct setting mtu_setting __setting ( SETTING_NETDEV, mtu ) = {
+	.name = "mtu",
+	.description = "MTU",
+	.tag = DHCP_MTU,
+	.type = &setting_type_uint16,
+};
 
 /**
  * Store MAC address setting
@@ -377,3 +383,99 @@ static void netdev_redirect_settings_init ( void ) {
 struct init_fn netdev_redirect_settings_init_fn __init_fn ( INIT_LATE ) = {
 	.initialise = netdev_redirect_settings_init,
 };
+
+/**
+ * Apply network device MTU setting
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+int netdev_apply_mtu ( struct net_device *netdev ) {
+	struct settings *settings = netdev_settings ( netdev );
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	size_t max_mtu;
+	size_t mtu;
+	int rc;
+
+	/* Get MTU */
+	mtu = fetch_uintz_setting ( settings, &mtu_setting );
+
+	/* Do nothing unless MTU is specified */
+	if ( ! mtu )
+		return 0;
+
+	/* Ignore MTUs too small to carry a minimum-sized IPv4
+	 * datagram (which would also leave no room for the
+	 * network- and transport-layer headers).
+	 */
+	if ( mtu < NETDEV_MIN_MTU ) {
+		DBGC ( netdev, "NETDEV %s ignoring MTU %zd (min %d)\n",
+		       netdev->name, mtu, NETDEV_MIN_MTU );
+		return 0;
+	}
+
+	/* Limit MTU to maximum supported by hardware */
+	max_mtu = ( netdev->max_pkt_len - ll_protocol->ll_header_len );
+	if ( mtu > max_mtu ) {
+		DBGC ( netdev, "NETDEV %s cannot support MTU %zd (max %zd)\n",
+		       netdev->name, mtu, max_mtu );
+		mtu = max_mtu;
+	}
+
+	/* Do nothing if MTU is unchanged */
+	if ( mtu == netdev->mtu )
+		return 0;
+
+	/* A changed MTU requires the device to be reopened, since
+	 * drivers size their receive buffers (and may program the
+	 * hardware receive buffer size) when the device is opened.
+	 * Defer the change if this would interrupt an ongoing
+	 * configuration (e.g. if the MTU was provided via DHCP); it
+	 * will be applied when the configuration completes.
+	 */
+	if ( netdev_is_open ( netdev ) &&
+	     netdev_configuration_in_progress ( netdev ) ) {
+		DBGC ( netdev, "NETDEV %s deferring MTU %zd until "
+		       "configuration is complete\n", netdev->name, mtu );
+		return 0;
+	}
+
+	/* Update MTU */
+	netdev->mtu = mtu;
+	DBGC ( netdev, "NETDEV %s MTU is %zd\n", netdev->name, mtu );
+
+	/* Close and reopen network device, if open */
+	if ( netdev_is_open ( netdev ) ) {
+		netdev_close ( netdev );
+		if ( ( rc = netdev_open ( netdev ) ) != 0 ) {
+			DBGC ( netdev, "NETDEV %s could not reopen: %s\n",
+			       netdev->name, strerror ( rc ) );
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Apply network device settings
+ *
+ * @ret rc		Return status code
+ */
+static int apply_netdev_settings ( void ) {
+	struct net_device *netdev;
+	int rc;
+
+	/* Process settings for each network device */
+	for_each_netdev ( netdev ) {
+		if ( ( rc = netdev_apply_mtu ( netdev ) ) != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/** Network device settings applicator */
+struct settings_applicator netdev_applicator __settings_applicator = {
+	.apply = apply_netdev_settings,
+};
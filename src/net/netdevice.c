@@ -40,7 +40,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/errortab.h>
 #include <ipxe/profile.h>
 #include <ipxe/fault.h>
+#include <ipxe/trace.h>
 #include <ipxe/vlan.h>
+#include <ipxe/tcp.h>
 #include <ipxe/netdevice.h>
 
 /** @file
@@ -58,6 +60,9 @@ static struct list_head open_net_devices = LIST_HEAD_INIT ( open_net_devices );
 /** Network device index */
 static unsigned int netdev_index = 0;
 
+/* Forward declaration */
+struct process net_process __permanent_process;
+
 /** Network polling profiler */
 static struct profiler net_poll_profiler __profiler = { .name = "net.poll" };
 
@@ -293,6 +298,11 @@ int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	DBGC2 ( netdev, "NETDEV %s transmitting %p (%p+%zx)\n",
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
 	profile_start ( &net_tx_profiler );
+	trace ( TRACE_NETDEV_TX, netdev->index, iob_len ( iobuf ), 0 );
+
+	/* Sanity check */
+	assert ( netdev_tx_csum ( netdev ) ||
+		 ! ( iobuf->flags & IOB_CSUM_PARTIAL ) );
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->tx_queue );
@@ -445,6 +455,38 @@ static void netdev_tx_flush ( struct net_device *netdev ) {
 	assert ( list_empty ( &netdev->tx_deferred ) );
 }
 
+/**
+ * Accept received packet
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ *
+ * The caller retains ownership of the I/O buffer, and must discard
+ * it if an error is returned.
+ */
+static int netdev_rx_accept ( struct net_device *netdev,
+			      struct io_buffer *iobuf ) {
+	int rc;
+
+	DBGC2 ( netdev, "NETDEV %s received %p (%p+%zx)\n",
+		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+	trace ( TRACE_NETDEV_RX, netdev->index, iob_len ( iobuf ), 0 );
+
+	/* Sanity check */
+	assert ( netdev_rx_csum ( netdev ) ||
+		 ! ( iobuf->flags & IOB_CSUM_VERIFIED ) );
+
+	/* Discard packet (for test purposes) if applicable */
+	if ( ( rc = inject_fault ( NETDEV_DISCARD_RATE ) ) != 0 )
+		return rc;
+
+	/* Update statistics counter */
+	netdev_record_stat ( &netdev->rx_stats, 0 );
+
+	return 0;
+}
+
 /**
  * Add packet to receive queue
  *
@@ -457,11 +499,8 @@ static void netdev_tx_flush ( struct net_device *netdev ) {
 void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	int rc;
 
-	DBGC2 ( netdev, "NETDEV %s received %p (%p+%zx)\n",
-		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
-
-	/* Discard packet (for test purposes) if applicable */
-	if ( ( rc = inject_fault ( NETDEV_DISCARD_RATE ) ) != 0 ) {
+	/* Accept packet */
+	if ( ( rc = netdev_rx_accept ( netdev, iobuf ) ) != 0 ) {
 		netdev_rx_err ( netdev, iobuf, rc );
 		return;
 	}
@@ -469,8 +508,54 @@ void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->rx_queue );
 
-	/* Update statistics counter */
-	netdev_record_stat ( &netdev->rx_stats, 0 );
+	/* Wake network stack process, if idle */
+	process_add ( &net_process );
+}
+
+/**
+ * Add a batch of packets to receive queue
+ *
+ * @v netdev		Network device
+ * @v batch		List of I/O buffers
+ *
+ * This function takes ownership of all I/O buffers in the list, and
+ * leaves the list empty.  Drivers may use this to hand a burst of
+ * completed receive buffers to the network stack at once.
+ */
+void netdev_rx_batch ( struct net_device *netdev, struct list_head *batch ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+	int rc;
+
+	/* Accept each packet */
+	list_for_each_entry_safe ( iobuf, tmp, batch, list ) {
+		if ( ( rc = netdev_rx_accept ( netdev, iobuf ) ) != 0 ) {
+			list_del ( &iobuf->list );
+			netdev_rx_err ( netdev, iobuf, rc );
+		}
+	}
+
+	/* Enqueue packets and wake network stack process, if idle */
+	if ( ! list_empty ( batch ) ) {
+		list_splice_tail_init ( batch, &netdev->rx_queue );
+		process_add ( &net_process );
+	}
+}
+
+/**
+ * Record receive ring overrun
+ *
+ * @v netdev		Network device
+ *
+ * Drivers should call this function when they detect that received
+ * packets may have been dropped due to a lack of receive buffers
+ * (e.g. because every buffer in the receive ring was found to be
+ * complete when polled).
+ */
+void netdev_rx_overrun ( struct net_device *netdev ) {
+
+	DBGC2 ( netdev, "NETDEV %s RX ring overrun\n", netdev->name );
+	netdev->rx_budget.overruns++;
 }
 
 /**
@@ -570,6 +655,15 @@ static void netdev_config_close ( struct net_device_configuration *config,
 		DBGC ( netdev, "NETDEV %s configuration via %s failed: %s\n",
 		       netdev->name, configurator->name, strerror ( rc ) );
 	}
+
+	/* Apply any MTU change that was deferred until all
+	 * configurations were complete.  Do not do so if the
+	 * configuration was cancelled, since this happens only as
+	 * part of closing the network device.
+	 */
+	if ( ( rc != -ECANCELED ) &&
+	     ( ! netdev_configuration_in_progress ( netdev ) ) )
+		netdev_apply_mtu ( netdev );
 }
 
 /** Network device configuration interface operations */
@@ -594,6 +688,7 @@ static void free_netdev ( struct refcnt *refcnt ) {
 	stop_timer ( &netdev->link_block );
 	netdev_tx_flush ( netdev );
 	netdev_rx_flush ( netdev );
+	iob_pool_fini ( &netdev->rx_pool );
 	clear_settings ( netdev_settings ( netdev ) );
 	free ( netdev );
 }
@@ -626,6 +721,8 @@ struct net_device * alloc_netdev ( size_t priv_len ) {
 		INIT_LIST_HEAD ( &netdev->tx_queue );
 		INIT_LIST_HEAD ( &netdev->tx_deferred );
 		INIT_LIST_HEAD ( &netdev->rx_queue );
+		iob_pool_init ( &netdev->rx_pool, NETDEV_RX_POOL_MAX,
+				&netdev->refcnt );
 		netdev_settings_init ( netdev );
 		config = netdev->configs;
 		for_each_table_entry ( configurator, NET_DEVICE_CONFIGURATORS ){
@@ -655,6 +752,7 @@ int register_netdev ( struct net_device *netdev ) {
 	struct ll_protocol *ll_protocol = netdev->ll_protocol;
 	struct net_driver *driver;
 	struct net_device *duplicate;
+	size_t max_mtu;
 	uint32_t seed;
 	int rc;
 
@@ -663,6 +761,13 @@ int register_netdev ( struct net_device *netdev ) {
 		ll_protocol->init_addr ( netdev->hw_addr, netdev->ll_addr );
 	}
 
+	/* Set initial MTU, if not already set, and limit to maximum
+	 * supported by hardware.
+	 */
+	max_mtu = ( netdev->max_pkt_len - ll_protocol->ll_header_len );
+	if ( ( ! netdev->mtu ) || ( netdev->mtu > max_mtu ) )
+		netdev->mtu = max_mtu;
+
 	/* Reject network devices that are already available via a
 	 * different hardware device.
 	 */
@@ -764,6 +869,9 @@ int netdev_open ( struct net_device *netdev ) {
 	/* Add to head of open devices list */
 	list_add ( &netdev->open_list, &open_net_devices );
 
+	/* Wake network stack process, if idle */
+	process_add ( &net_process );
+
 	/* Notify drivers of device state change */
 	netdev_notify ( netdev );
 
@@ -813,6 +921,9 @@ void netdev_close ( struct net_device *netdev ) {
 	/* Flush TX and RX queues */
 	netdev_tx_flush ( netdev );
 	netdev_rx_flush ( netdev );
+
+	/* Discard any recycled receive buffers */
+	iob_pool_flush ( &netdev->rx_pool );
 }
 
 /**
@@ -1028,13 +1139,197 @@ int net_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 }
 
 /**
- * Poll the network stack
+ * Identify received packet eligible for coalescing
  *
- * This polls all interfaces for received packets, and processes
- * packets from the RX queue.
+ * @v iobuf		I/O buffer (with link-layer header removed)
+ * @v net_proto		Network-layer protocol, in network-byte order
+ * @v gro		Receive coalescing descriptor to fill in
+ * @ret rc		Return status code
+ *
+ * Only TCP segments carrying data and no flags other than ACK and
+ * PSH are eligible for coalescing.
  */
-void net_poll ( void ) {
-	struct net_device *netdev;
+static int net_gro_parse ( struct io_buffer *iobuf, uint16_t net_proto,
+			   struct net_gro *gro ) {
+	struct net_protocol *net_protocol;
+	struct tcp_header *tcphdr;
+	int rc;
+
+	/* Identify TCP segment via network-layer protocol */
+	rc = -ENOTSUP;
+	for_each_table_entry ( net_protocol, NET_PROTOCOLS ) {
+		if ( ( net_protocol->net_proto == net_proto ) &&
+		     net_protocol->gro ) {
+			rc = net_protocol->gro ( iobuf, gro );
+			break;
+		}
+	}
+	if ( rc != 0 )
+		return rc;
+	tcphdr = gro->tcphdr;
+	if ( gro->len < sizeof ( *tcphdr ) )
+		return -EINVAL;
+	gro->hlen = ( ( tcphdr->hlen & TCP_MASK_HLEN ) / 16 ) * 4;
+	if ( ( gro->hlen < sizeof ( *tcphdr ) ) || ( gro->hlen >= gro->len ) )
+		return -EINVAL;
+	if ( ( tcphdr->flags & ~TCP_PSH ) != TCP_ACK )
+		return -ENOTSUP;
+
+	return 0;
+}
+
+/**
+ * Check if received TCP segment continues a coalesced packet
+ *
+ * @v head		First segment within coalesced packet
+ * @v gro		Received segment
+ * @v seq		Expected sequence number
+ * @ret match		Segment continues coalesced packet
+ *
+ * The segment must belong to the same flow, must immediately follow
+ * the data already coalesced, and must carry exactly the same
+ * acknowledgement, window, and options as the first segment.
+ */
+static int net_gro_match ( struct net_gro *head, struct net_gro *gro,
+			   uint32_t seq ) {
+	struct tcp_header *first = head->tcphdr;
+	struct tcp_header *tcphdr = gro->tcphdr;
+
+	return ( ( gro->flow_len == head->flow_len ) &&
+		 ( memcmp ( gro->flow, head->flow, head->flow_len ) == 0 ) &&
+		 ( tcphdr->src == first->src ) &&
+		 ( tcphdr->dest == first->dest ) &&
+		 ( ntohl ( tcphdr->seq ) == seq ) &&
+		 ( tcphdr->ack == first->ack ) &&
+		 ( tcphdr->win == first->win ) &&
+		 ( gro->hlen == head->hlen ) &&
+		 ( memcmp ( ( tcphdr + 1 ), ( first + 1 ),
+			    ( head->hlen - sizeof ( *first ) ) ) == 0 ) );
+}
+
+/**
+ * Verify checksum of received TCP segment
+ *
+ * @v iobuf		I/O buffer
+ * @v gro		Received segment
+ * @ret rc		Return status code
+ *
+ * Since coalesced segments bypass the usual network-layer and
+ * transport-layer processing, the checksum of each segment must be
+ * verified (unless already verified by the network device) before
+ * coalescing.
+ */
+static int net_gro_verify ( struct io_buffer *iobuf, struct net_gro *gro ) {
+
+	/* Verify checksum, if not already verified */
+	if ( ! ( iobuf->flags & IOB_CSUM_VERIFIED ) ) {
+		if ( tcpip_continue_chksum ( gro->pshdr_csum, gro->tcphdr,
+					     gro->len ) != 0 )
+			return -EINVAL;
+		iobuf->flags |= IOB_CSUM_VERIFIED;
+	}
+
+	return 0;
+}
+
+/**
+ * Coalesce received packets
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer (with link-layer header removed)
+ * @v net_proto		Network-layer protocol, in network-byte order
+ * @v flags		Packet flags
+ * @v budget		Remaining budget
+ * @ret budget		Remaining budget
+ *
+ * Any TCP segments waiting on the receive queue that continue the
+ * received TCP segment (with no intervening packets) are removed
+ * from the queue, reduced to their payloads, and attached to the
+ * received packet as continuation buffers.  The TCP layer can then
+ * process the whole sequence as a single segment.
+ */
+static unsigned int net_gro ( struct net_device *netdev,
+			      struct io_buffer *iobuf, uint16_t net_proto,
+			      unsigned int flags, unsigned int budget ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct io_buffer *next;
+	struct net_gro head;
+	struct net_gro gro;
+	const void *ll_dest;
+	const void *ll_source;
+	uint16_t next_net_proto;
+	unsigned int next_flags;
+	unsigned int count;
+	uint32_t seq;
+	void *data;
+
+	/* Check that packet is eligible for coalescing */
+	if ( net_gro_parse ( iobuf, net_proto, &head ) != 0 )
+		return budget;
+	if ( head.tcphdr->flags & TCP_PSH )
+		return budget;
+	seq = ( ntohl ( head.tcphdr->seq ) + head.len - head.hlen );
+
+	/* Coalesce subsequent segments */
+	for ( count = 1 ; budget && ( count < NET_RX_COALESCE ) ; count++ ) {
+
+		/* Stop unless next packet continues this segment.
+		 * The segment's own checksum is verified only once
+		 * the first continuation has been found.
+		 */
+		next = list_first_entry ( &netdev->rx_queue, struct io_buffer,
+					  list );
+		if ( ! next )
+			break;
+		data = next->data;
+		if ( ( ll_protocol->pull ( netdev, next, &ll_dest, &ll_source,
+					   &next_net_proto,
+					   &next_flags ) != 0 ) ||
+		     ( next_net_proto != net_proto ) ||
+		     ( next_flags != flags ) ||
+		     ( net_gro_parse ( next, net_proto, &gro ) != 0 ) ||
+		     ( ! net_gro_match ( &head, &gro, seq ) ) ||
+		     ( net_gro_verify ( next, &gro ) != 0 ) ||
+		     ( net_gro_verify ( iobuf, &head ) != 0 ) ) {
+			next->data = data;
+			break;
+		}
+
+		/* Attach payload as continuation buffer */
+		list_del ( &next->list );
+		iob_pull ( next, ( ( ( ( void * ) gro.tcphdr ) - next->data ) +
+				   gro.hlen ) );
+		iob_unput ( next, ( iob_len ( next ) - gro.len + gro.hlen ) );
+		list_add_tail ( &next->list, &iobuf->chain );
+		seq += iob_len ( next );
+		budget--;
+
+		/* Stop after a segment carrying PSH */
+		if ( gro.tcphdr->flags & TCP_PSH ) {
+			head.tcphdr->flags |= TCP_PSH;
+			count++;
+			break;
+		}
+	}
+
+	/* Record coalescing statistics */
+	if ( count > 1 ) {
+		netdev->rx_gro.packets++;
+		netdev->rx_gro.segments += count;
+	}
+
+	return budget;
+}
+
+/**
+ * Process received packets
+ *
+ * @v netdev		Network device
+ * @v budget		Maximum number of packets to process
+ * @ret budget		Remaining budget
+ */
+static unsigned int net_poll_rx ( struct net_device *netdev,
+				  unsigned int budget ) {
 	struct io_buffer *iobuf;
 	struct ll_protocol *ll_protocol;
 	const void *ll_dest;
@@ -1043,50 +1338,96 @@ void net_poll ( void ) {
 	unsigned int flags;
 	int rc;
 
-	/* Poll and process each network device */
-	list_for_each_entry ( netdev, &net_devices, list ) {
+	/* Process received packets, up to the budget */
+	while ( budget && ( iobuf = netdev_rx_dequeue ( netdev ) ) ) {
 
-		/* Poll for new packets */
-		profile_start ( &net_poll_profiler );
-		netdev_poll ( netdev );
-		profile_stop ( &net_poll_profiler );
+		/* Consume budget and record activity */
+		budget--;
+		process_activity();
 
-		/* Leave received packets on the queue if receive
-		 * queue processing is currently frozen.  This will
-		 * happen when the raw packets are to be manually
-		 * dequeued using netdev_rx_dequeue(), rather than
-		 * processed via the usual networking stack.
-		 */
-		if ( netdev_rx_frozen ( netdev ) )
+		DBGC2 ( netdev, "NETDEV %s processing %p (%p+%zx)\n",
+			netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+		profile_start ( &net_rx_profiler );
+
+		/* Remove link-layer header */
+		ll_protocol = netdev->ll_protocol;
+		if ( ( rc = ll_protocol->pull ( netdev, iobuf, &ll_dest,
+						&ll_source, &net_proto,
+						&flags ) ) != 0 ) {
+			free_iob ( iobuf );
 			continue;
+		}
+
+		/* Coalesce any following segments of the same flow */
+		budget = net_gro ( netdev, iobuf, net_proto, flags, budget );
 
-		/* Process all received packets */
-		while ( ( iobuf = netdev_rx_dequeue ( netdev ) ) ) {
-
-			DBGC2 ( netdev, "NETDEV %s processing %p (%p+%zx)\n",
-				netdev->name, iobuf, iobuf->data,
-				iob_len ( iobuf ) );
-			profile_start ( &net_rx_profiler );
-
-			/* Remove link-layer header */
-			ll_protocol = netdev->ll_protocol;
-			if ( ( rc = ll_protocol->pull ( netdev, iobuf,
-							&ll_dest, &ll_source,
-							&net_proto,
-							&flags ) ) != 0 ) {
-				free_iob ( iobuf );
-				continue;
-			}
-
-			/* Hand packet to network layer */
-			if ( ( rc = net_rx ( iob_disown ( iobuf ), netdev,
-					     net_proto, ll_dest,
-					     ll_source, flags ) ) != 0 ) {
-				/* Record error for diagnosis */
-				netdev_rx_err ( netdev, NULL, rc );
-			}
-			profile_stop ( &net_rx_profiler );
+		/* Hand packet to network layer */
+		if ( ( rc = net_rx ( iob_disown ( iobuf ), netdev, net_proto,
+				     ll_dest, ll_source, flags ) ) != 0 ) {
+			/* Record error for diagnosis */
+			netdev_rx_err ( netdev, NULL, rc );
 		}
+		profile_stop ( &net_rx_profiler );
+	}
+
+	return budget;
+}
+
+/**
+ * Poll the network stack
+ *
+ * This polls all interfaces for received packets, and processes
+ * packets from the RX queue.  At most NET_RX_BUDGET packets will be
+ * processed from each interface; the interface will be repolled for
+ * as long as it continues to deliver packets and budget remains.
+ * Any packets left unprocessed will be handled in a subsequent poll.
+ */
+void net_poll ( void ) {
+	struct net_device *netdev;
+	unsigned int budget;
+	unsigned int received;
+
+	/* Poll and process each network device */
+	list_for_each_entry ( netdev, &net_devices, list ) {
+
+		for ( budget = NET_RX_BUDGET ; ; netdev->rx_budget.repolls++ ) {
+
+			/* Poll for new packets */
+			received = ( netdev->rx_stats.good +
+				     netdev->rx_stats.bad );
+			profile_start ( &net_poll_profiler );
+			netdev_poll ( netdev );
+			profile_stop ( &net_poll_profiler );
+			received = ( netdev->rx_stats.good +
+				     netdev->rx_stats.bad - received );
+
+			/* Treat pending transmissions as outstanding work */
+			if ( ! list_empty ( &netdev->tx_queue ) )
+				process_activity();
+
+			/* Leave received packets on the queue if
+			 * receive queue processing is currently
+			 * frozen.  This will happen when the raw
+			 * packets are to be manually dequeued using
+			 * netdev_rx_dequeue(), rather than processed
+			 * via the usual networking stack.
+			 */
+			if ( netdev_rx_frozen ( netdev ) )
+				break;
+
+			/* Process received packets */
+			budget = net_poll_rx ( netdev, budget );
+
+			/* Stop unless the driver delivered packets and
+			 * budget remains.
+			 */
+			if ( ! ( received && budget ) )
+				break;
+		}
+
+		/* Record budget exhaustion */
+		if ( ! budget )
+			netdev->rx_budget.exhausted++;
 	}
 }
 
@@ -1096,7 +1437,15 @@ void net_poll ( void ) {
  * @v process		Network stack process
  */
 static void net_step ( struct process *process __unused ) {
+
+	/* Poll the network stack */
 	net_poll();
+
+	/* Go idle if there are no open network devices.  We will be
+	 * woken by netdev_open() or by netdev_rx().
+	 */
+	if ( list_empty ( &open_net_devices ) )
+		process_del ( &net_process );
 }
 
 /**
@@ -1121,8 +1470,12 @@ __weak struct net_device * vlan_find ( struct net_device *trunk __unused,
 	return NULL;
 }
 
-/** Networking stack process */
-PERMANENT_PROCESS ( net_process, net_step );
+/** Networking stack process
+ *
+ * The networking stack is given high priority, so that packets are
+ * processed promptly during bulk transfers.
+ */
+PERMANENT_PROCESS_PRIO ( net_process, net_step, PROC_PRIO_HIGH );
 
 /**
  * Discard some cached network device data
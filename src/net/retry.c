@@ -24,6 +24,8 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stddef.h>
+#include <strings.h>
+#include <assert.h>
 #include <ipxe/timer.h>
 #include <ipxe/list.h>
 #include <ipxe/process.h>
@@ -48,8 +50,132 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define MIN_TIMEOUT 7
 
-/** List of running timers */
-static LIST_HEAD ( timers );
+/** Number of timer wheel slots (log2) */
+#define TIMER_WHEEL_BITS 8
+
+/** Number of timer wheel slots */
+#define TIMER_WHEEL_SIZE ( 1 << TIMER_WHEEL_BITS )
+
+/** Number of timer cascade slots (log2) */
+#define TIMER_CASCADE_BITS 6
+
+/** Number of timer cascade slots */
+#define TIMER_CASCADE_SIZE ( 1 << TIMER_CASCADE_BITS )
+
+/** Maximum timer wheel slot resolution (log2 of slots per second) */
+#define TIMER_SLOT_RATE_LOG2 10
+
+/**
+ * Timer wheel
+ *
+ * Running timers are held in a two-level hierarchical timer wheel.
+ * Each slot of the wheel holds the timers which expire within a
+ * single slot period (of approximately one millisecond, or one tick
+ * if ticks are longer than this).  Each slot of the cascade holds the
+ * timers which expire within a single revolution of the wheel, and
+ * is redistributed into the wheel when the wheel reaches the start
+ * of that revolution.  Timers too far in the future to fit within
+ * the cascade are simply left in place for subsequent revolutions.
+ *
+ * This allows retry_poll() to find an expired timer without walking
+ * the list of all running timers.
+ */
+static struct list_head timer_wheel[TIMER_WHEEL_SIZE];
+
+/** Timer cascade */
+static struct list_head timer_cascade[TIMER_CASCADE_SIZE];
+
+/** Index of current timer wheel slot */
+static unsigned int timer_slot;
+
+/** Start time of current timer wheel slot (in ticks) */
+static unsigned long timer_slot_start;
+
+/** Timer wheel slot period (log2 of ticks) */
+static unsigned int timer_slot_shift;
+
+/** Number of running timers */
+static unsigned int timer_count;
+
+/* Forward declaration */
+struct process retry_process __permanent_process;
+
+/**
+ * Add timer to timer wheel
+ *
+ * @v timer		Retry timer
+ */
+static void timer_insert ( struct retry_timer *timer ) {
+	unsigned long delta;
+	unsigned long slots;
+
+	/* Calculate number of slots until expiry (treating timers
+	 * which have already expired as expiring in the current slot).
+	 */
+	delta = ( timer->start + timer->timeout - timer_slot_start );
+	if ( ( ( signed long ) delta ) < 0 )
+		delta = 0;
+	slots = ( delta >> timer_slot_shift );
+
+	/* Add to wheel or to cascade as applicable */
+	if ( slots < TIMER_WHEEL_SIZE ) {
+		list_add_tail ( &timer->list,
+				&timer_wheel[ ( timer_slot + slots ) %
+					      TIMER_WHEEL_SIZE ] );
+	} else {
+		list_add_tail ( &timer->list,
+				&timer_cascade[ ( ( timer_slot + slots ) >>
+						  TIMER_WHEEL_BITS ) %
+						TIMER_CASCADE_SIZE ] );
+	}
+}
+
+/**
+ * Redistribute timer cascade slot into timer wheel
+ *
+ */
+static void timer_cascade_slot ( void ) {
+	struct list_head *slot;
+	struct retry_timer *timer;
+	struct retry_timer *tmp;
+	LIST_HEAD ( cascade );
+
+	/* Reinsert all timers from the current cascade slot */
+	slot = &timer_cascade[ ( timer_slot >> TIMER_WHEEL_BITS ) %
+			       TIMER_CASCADE_SIZE ];
+	list_splice_init ( slot, &cascade );
+	list_for_each_entry_safe ( timer, tmp, &cascade, list ) {
+		list_del ( &timer->list );
+		timer_insert ( timer );
+	}
+}
+
+/**
+ * Initialise empty timer wheel
+ *
+ * @v now		Current time
+ */
+static void timer_wheel_reset ( unsigned long now ) {
+	unsigned long ticks_per_slot;
+	unsigned int i;
+
+	/* Initialise slots, if not already done */
+	if ( ! timer_wheel[0].next ) {
+		for ( i = 0 ; i < TIMER_WHEEL_SIZE ; i++ )
+			INIT_LIST_HEAD ( &timer_wheel[i] );
+		for ( i = 0 ; i < TIMER_CASCADE_SIZE ; i++ )
+			INIT_LIST_HEAD ( &timer_cascade[i] );
+	}
+
+	/* Choose slot period.  This is done only while there are no
+	 * running timers, since the tick rate may not be known until
+	 * some time after startup.
+	 */
+	ticks_per_slot = ( TICKS_PER_SEC >> TIMER_SLOT_RATE_LOG2 );
+	timer_slot_shift = ( ticks_per_slot ?
+			     ( fls ( ticks_per_slot ) - 1 ) : 0 );
+	timer_slot_start = now;
+}
 
 /**
  * Start timer with a specified timeout
@@ -63,19 +189,29 @@ static LIST_HEAD ( timers );
  */
 void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 
-	/* Add to list of running timers (if applicable) */
-	if ( ! timer->running ) {
-		list_add ( &timer->list, &timers );
+	unsigned long now = currticks();
+
+	/* Mark as running (if applicable) */
+	if ( timer->running ) {
+		list_del ( &timer->list );
+	} else {
+		if ( ! timer_count++ ) {
+			timer_wheel_reset ( now );
+			process_add ( &retry_process );
+		}
 		ref_get ( timer->refcnt );
 		timer->running = 1;
 	}
 
 	/* Record start time */
-	timer->start = currticks();
+	timer->start = now;
 
 	/* Record timeout */
 	timer->timeout = timeout;
 
+	/* Add to timer wheel */
+	timer_insert ( timer );
+
 	DBGC2 ( timer, "Timer %p started at time %ld (expires at %ld)\n",
 		timer, timer->start, ( timer->start + timer->timeout ) );
 }
@@ -124,6 +260,7 @@ void stop_timer ( struct retry_timer *timer ) {
 		return;
 
 	list_del ( &timer->list );
+	timer_count--;
 	runtime = ( now - timer->start );
 	timer->running = 0;
 	DBGC2 ( timer, "Timer %p stopped at time %ld (ran for %ld)\n",
@@ -173,6 +310,7 @@ static void timer_expired ( struct retry_timer *timer ) {
 		timer, currticks() );
 	assert ( timer->running );
 	list_del ( &timer->list );
+	timer_count--;
 	timer->running = 0;
 	timer->count++;
 
@@ -183,6 +321,9 @@ static void timer_expired ( struct retry_timer *timer ) {
 	DBGC ( timer, "Timer %p timeout backed off to %ld\n",
 	       timer, timer->timeout );
 
+	/* Record activity */
+	process_activity();
+
 	/* Call expiry callback */
 	timer->expired ( timer, fail );
 	/* If refcnt is NULL, then timer may already have been freed */
@@ -195,21 +336,45 @@ static void timer_expired ( struct retry_timer *timer ) {
  *
  */
 void retry_poll ( void ) {
+	struct list_head *slot;
 	struct retry_timer *timer;
 	unsigned long now = currticks();
 	unsigned long used;
 
+	/* Do nothing unless there are running timers */
+	if ( ! timer_count )
+		return;
+
 	/* Process at most one timer expiry.  We cannot process
 	 * multiple expiries in one pass, because one timer expiring
 	 * may end up triggering another timer's deletion from the
 	 * list.
 	 */
-	list_for_each_entry ( timer, &timers, list ) {
-		used = ( now - timer->start );
-		if ( used >= timer->timeout ) {
-			timer_expired ( timer );
-			break;
+	while ( ( ( signed long ) ( now - timer_slot_start ) ) >= 0 ) {
+
+		/* Check for an expired timer in the current slot */
+		slot = &timer_wheel[ timer_slot % TIMER_WHEEL_SIZE ];
+		list_for_each_entry ( timer, slot, list ) {
+			used = ( now - timer->start );
+			if ( used >= timer->timeout ) {
+				timer_expired ( timer );
+				return;
+			}
 		}
+
+		/* Stop if the current slot has not yet finished */
+		if ( ( now - timer_slot_start ) < ( 1UL << timer_slot_shift ) )
+			break;
+
+		/* Move to next slot, redistributing the next cascade
+		 * slot into the wheel if we have started a new
+		 * revolution.
+		 */
+		assert ( list_empty ( slot ) );
+		timer_slot++;
+		timer_slot_start += ( 1UL << timer_slot_shift );
+		if ( ( timer_slot % TIMER_WHEEL_SIZE ) == 0 )
+			timer_cascade_slot();
 	}
 }
 
@@ -219,7 +384,15 @@ void retry_poll ( void ) {
  * @v process		Retry timer process
  */
 static void retry_step ( struct process *process __unused ) {
+
+	/* Poll the retry timer list */
 	retry_poll();
+
+	/* Go idle if there are no running timers.  We will be woken
+	 * by start_timer_fixed().
+	 */
+	if ( ! timer_count )
+		process_del ( &retry_process );
 }
 
 /** Retry timer process */
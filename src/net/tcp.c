@@ -14,11 +14,15 @@
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/uri.h>
+#include <ipxe/in.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/profile.h>
+#include <ipxe/trace.h>
 #include <ipxe/process.h>
+#include <ipxe/settings.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/tcp.h>
+#include <ipxe/tcpqueue.h>
 
 /** @file
  *
@@ -34,6 +38,8 @@ struct tcp_connection {
 	struct refcnt refcnt;
 	/** List of TCP connections */
 	struct list_head list;
+	/** List of TCP connections within hash bucket */
+	struct list_head hash;
 
 	/** Flags */
 	unsigned int flags;
@@ -45,6 +51,8 @@ struct tcp_connection {
 	struct sockaddr_tcpip peer;
 	/** Local port */
 	unsigned int local_port;
+	/** Cached transmit route */
+	struct tcpip_route route;
 	/** Maximum segment size */
 	size_t mss;
 
@@ -65,6 +73,13 @@ struct tcp_connection {
 	 * Equivalent to (SND.NXT-SND.UNA) in RFC 793 terminology.
 	 */
 	uint32_t snd_sent;
+	/** Highest unacknowledged sequence count ever sent
+	 *
+	 * Equivalent to (SND.MAX-SND.UNA).  This differs from
+	 * snd_sent only after a retransmission timeout has caused us
+	 * to go back and resend data starting from SND.UNA.
+	 */
+	uint32_t snd_max;
 	/** Send window
 	 *
 	 * Equivalent to SND.WND in RFC 793 terminology
@@ -101,14 +116,131 @@ struct tcp_connection {
 	 * Equivalent to Rcv.Wind.Scale in RFC 1323 terminology
 	 */
 	uint8_t rcv_win_scale;
+	/** Maximum receive window
+	 *
+	 * This is tuned automatically according to the measured
+	 * bandwidth-delay product.
+	 */
+	uint32_t rcv_win_max;
+	/** Time at which maximum receive window was last reduced */
+	unsigned long rcv_win_shrunk;
+	/** Maximum receive window has been reduced */
+	int rcv_win_held;
+	/** Start time of current receive window tuning period */
+	unsigned long rcv_tune_start;
+	/** Sequence space received within current tuning period */
+	uint32_t rcv_tune_len;
+	/** Number of received data segments not yet acknowledged */
+	unsigned int rcv_unacked;
+	/** Delayed acknowledgement timeout (or zero to disable) */
+	unsigned long delack_timeout;
+
+	/** Smoothed round-trip time (in ticks, scaled by 8)
+	 *
+	 * Equivalent to SRTT in RFC 6298 terminology.
+	 */
+	unsigned long srtt;
+	/** Round-trip time variation (in ticks, scaled by 4)
+	 *
+	 * Equivalent to RTTVAR in RFC 6298 terminology.
+	 */
+	unsigned long rttvar;
+	/** Retransmission timeout (in ticks)
+	 *
+	 * Equivalent to RTO in RFC 6298 terminology, including any
+	 * backoff applied due to retransmission timer expiry.
+	 */
+	unsigned long rto;
+	/** Start time of round-trip time measurement (in ticks)
+	 *
+	 * Used only when timestamps are not enabled.
+	 */
+	unsigned long rtt_start;
+	/** Most recent round-trip time sample (in ticks) */
+	unsigned long rtt;
+	/** Minimum round-trip time sample (in ticks) */
+	unsigned long rtt_min;
+	/** Number of round-trip time samples */
+	unsigned int rtt_samples;
+	/** Number of retransmission timeouts */
+	unsigned int timeouts;
+	/** Sequence number used for round-trip time measurement
+	 *
+	 * Used only when timestamps are not enabled.
+	 */
+	uint32_t rtt_seq;
+
+	/** Congestion window
+	 *
+	 * Equivalent to cwnd in RFC 5681 terminology.
+	 */
+	uint32_t cwnd;
+	/** Slow start threshold
+	 *
+	 * Equivalent to ssthresh in RFC 5681 terminology.
+	 */
+	uint32_t ssthresh;
+	/** Number of consecutive duplicate acknowledgements */
+	unsigned int dupacks;
+	/** Fast recovery point
+	 *
+	 * Equivalent to SND.NXT at the time of entering fast
+	 * recovery, i.e. one greater than "recover" in RFC 6582
+	 * terminology.
+	 */
+	uint32_t recover;
+	/** Next sequence number to be considered for retransmission
+	 *
+	 * Equivalent to HighRxt in RFC 6675 terminology.  All
+	 * unacknowledged data before this point has already been
+	 * retransmitted during the current fast recovery.
+	 */
+	uint32_t snd_rxt;
+	/** Number of pending retransmissions */
+	unsigned int rxt_pending;
+	/** Number of fast retransmissions */
+	unsigned int fast_retransmits;
+	/** Number of retransmitted segments */
+	unsigned int retransmits;
+	/** Selective acknowledgement scoreboard (in host-endian order)
+	 *
+	 * Blocks of data acknowledged by the peer via SACK, sorted by
+	 * sequence number.
+	 */
+	struct tcp_sack_block scoreboard[TCP_SCOREBOARD_MAX];
+	/** Number of blocks in selective acknowledgement scoreboard */
+	unsigned int scoreboard_count;
+
+	/** Fast Open cookie */
+	uint8_t fastopen_cookie[TCP_FASTOPEN_COOKIE_MAX];
+	/** Length of Fast Open cookie (or zero if no cookie is known) */
+	size_t fastopen_len;
+	/** Maximum length of data that may be sent within SYN */
+	size_t fastopen_max;
+	/** Length of data accepted within SYN */
+	uint32_t fastopen_acked;
 
 	/** Selective acknowledgement list (in host-endian order) */
 	struct tcp_sack_block sack[TCP_SACK_MAX];
 
 	/** Transmit queue */
 	struct list_head tx_queue;
+	/** Length of data in transmit queue */
+	size_t tx_len;
+	/** Transmit queue position cache
+	 *
+	 * The I/O buffer within the transmit queue that was most
+	 * recently used to construct a segment, or NULL.
+	 */
+	struct io_buffer *tx_pos;
+	/** Offset of cached transmit queue position
+	 *
+	 * This is the offset (relative to SND.UNA) of the start of
+	 * the data in the cached I/O buffer.
+	 */
+	size_t tx_pos_offset;
 	/** Receive queue */
-	struct list_head rx_queue;
+	struct tcp_rx_queue rx_queue;
 	/** Transmission process */
 	struct process process;
 	/** Retransmission timer */
@@ -117,6 +249,8 @@ struct tcp_connection {
 	struct retry_timer keepalive;
 	/** Shutdown (TIME_WAIT) timer */
 	struct retry_timer wait;
+	/** Delayed acknowledgement timer */
+	struct retry_timer delack;
 
 	/** Pending operations for SYN and FIN */
 	struct pending_operation pending_flags;
@@ -134,38 +268,43 @@ enum tcp_flags {
 	TCP_ACK_PENDING = 0x0004,
 	/** TCP selective acknowledgement is enabled */
 	TCP_SACK_ENABLED = 0x0008,
+	/** TCP round-trip time measurement is in progress */
+	TCP_RTT_TIMING = 0x0010,
+	/** TCP fast recovery is in progress */
+	TCP_RECOVERY = 0x0020,
+	/** TCP Fast Open option should be sent with SYN */
+	TCP_FASTOPEN = 0x0040,
 };
 
-/** TCP internal header
- *
- * This is the header that replaces the TCP header for packets
- * enqueued on the receive queue.
- */
-struct tcp_rx_queued_header {
-	/** SEQ value, in host-endian order
-	 *
-	 * This represents the SEQ value at the time the packet is
-	 * enqueued, and so excludes the SYN, if present.
-	 */
-	uint32_t seq;
-	/** Next SEQ value, in host-endian order */
-	uint32_t nxt;
-	/** Flags
-	 *
-	 * Only FIN is valid within this flags byte; all other flags
-	 * have already been processed by the time the packet is
-	 * enqueued.
-	 */
-	uint8_t flags;
-	/** Reserved */
-	uint8_t reserved[3];
+/** A cached TCP Fast Open cookie */
+struct tcp_fastopen_cookie {
+	/** Peer socket address (port is ignored) */
+	struct sockaddr_tcpip peer;
+	/** Maximum length of data that may be sent within SYN */
+	size_t max;
+	/** Length of cookie (or zero if entry is unused) */
+	size_t len;
+	/** Cookie */
+	uint8_t cookie[TCP_FASTOPEN_COOKIE_MAX];
 };
 
+/** TCP Fast Open cookie cache */
+static struct tcp_fastopen_cookie tcp_fastopen_cache[TCP_FASTOPEN_CACHE_SIZE];
+
+/** Next TCP Fast Open cookie cache entry to be replaced */
+static unsigned int tcp_fastopen_next;
+
 /**
  * List of registered TCP connections
  */
 static LIST_HEAD ( tcp_conns );
 
+/** TCP connection hash buckets (indexed by local port) */
+static struct list_head tcp_hash[TCP_HASH_SIZE];
+
+/** Most recently demultiplexed TCP connection */
+static struct tcp_connection *tcp_demux_cache;
+
 /** Transmit profiler */
 static struct profiler tcp_tx_profiler __profiler = { .name = "tcp.tx" };
 
@@ -181,32 +320,11 @@ static struct interface_descriptor tcp_xfer_desc;
 static void tcp_expired ( struct retry_timer *timer, int over );
 static void tcp_keepalive_expired ( struct retry_timer *timer, int over );
 static void tcp_wait_expired ( struct retry_timer *timer, int over );
+static void tcp_delack_expired ( struct retry_timer *timer, int over );
 static struct tcp_connection * tcp_demux ( unsigned int local_port );
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
-			uint32_t win );
-
-/**
- * Name TCP state
- *
- * @v state		TCP state
- * @ret name		Name of TCP state
- */
-static inline __attribute__ (( always_inline )) const char *
-tcp_state ( int state ) {
-	switch ( state ) {
-	case TCP_CLOSED:		return "CLOSED";
-	case TCP_LISTEN:		return "LISTEN";
-	case TCP_SYN_SENT:		return "SYN_SENT";
-	case TCP_SYN_RCVD:		return "SYN_RCVD";
-	case TCP_ESTABLISHED:		return "ESTABLISHED";
-	case TCP_FIN_WAIT_1:		return "FIN_WAIT_1";
-	case TCP_FIN_WAIT_2:		return "FIN_WAIT_2";
-	case TCP_CLOSING_OR_LAST_ACK:	return "CLOSING/LAST_ACK";
-	case TCP_TIME_WAIT:		return "TIME_WAIT";
-	case TCP_CLOSE_WAIT:		return "CLOSE_WAIT";
-	default:			return "INVALID";
-	}
-}
+			uint32_t win, uint32_t seq_len,
+			struct tcp_options *options );
 
 /**
  * Dump TCP state transition
@@ -243,6 +361,126 @@ tcp_dump_flags ( struct tcp_connection *tcp, unsigned int flags ) {
 		DBGC2 ( tcp, " ACK" );
 }
 
+/***************************************************************************
+ *
+ * Fast Open cookie cache
+ *
+ ***************************************************************************
+ */
+
+/**
+ * Check if TCP Fast Open cookie cache entry matches peer
+ *
+ * @v cookie		Cached cookie
+ * @v peer		Peer socket address
+ * @ret match		Cookie belongs to this peer
+ *
+ * Cookies are associated with the peer's address, regardless of port,
+ * as per RFC 7413.
+ */
+static int tcp_fastopen_match ( struct tcp_fastopen_cookie *cookie,
+				struct sockaddr_tcpip *peer ) {
+	struct sockaddr_in *sin = ( ( struct sockaddr_in * ) peer );
+	struct sockaddr_in6 *sin6 = ( ( struct sockaddr_in6 * ) peer );
+	struct sockaddr_in *cached_sin =
+		( ( struct sockaddr_in * ) &cookie->peer );
+	struct sockaddr_in6 *cached_sin6 =
+		( ( struct sockaddr_in6 * ) &cookie->peer );
+
+	/* Ignore unused entries and entries for other address families */
+	if ( ! cookie->len )
+		return 0;
+	if ( cookie->peer.st_family != peer->st_family )
+		return 0;
+
+	/* Compare addresses */
+	switch ( peer->st_family ) {
+	case AF_INET:
+		return ( sin->sin_addr.s_addr == cached_sin->sin_addr.s_addr );
+	case AF_INET6:
+		return ( ( sin6->sin6_scope_id == cached_sin6->sin6_scope_id ) &&
+			 ( memcmp ( &sin6->sin6_addr, &cached_sin6->sin6_addr,
+				    sizeof ( sin6->sin6_addr ) ) == 0 ) );
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Find cached TCP Fast Open cookie
+ *
+ * @v peer		Peer socket address
+ * @ret cookie		Cached cookie, or NULL if not found
+ */
+static struct tcp_fastopen_cookie *
+tcp_fastopen_find ( struct sockaddr_tcpip *peer ) {
+	struct tcp_fastopen_cookie *cookie;
+	unsigned int i;
+
+	for ( i = 0 ; i < TCP_FASTOPEN_CACHE_SIZE ; i++ ) {
+		cookie = &tcp_fastopen_cache[i];
+		if ( tcp_fastopen_match ( cookie, peer ) )
+			return cookie;
+	}
+	return NULL;
+}
+
+/**
+ * Record TCP Fast Open cookie
+ *
+ * @v peer		Peer socket address
+ * @v data		Cookie
+ * @v len		Length of cookie
+ * @v mss		Peer's maximum segment size
+ */
+static void tcp_fastopen_store ( struct sockaddr_tcpip *peer,
+				 const void *data, size_t len, size_t mss ) {
+	struct tcp_fastopen_cookie *cookie;
+	unsigned int i;
+
+	/* Sanity check */
+	assert ( len <= sizeof ( cookie->cookie ) );
+
+	/* Reuse any existing entry for this peer, or any unused
+	 * entry, otherwise replace entries in turn.
+	 */
+	cookie = tcp_fastopen_find ( peer );
+	for ( i = 0 ; ( ! cookie ) && ( i < TCP_FASTOPEN_CACHE_SIZE ) ; i++ ) {
+		if ( ! tcp_fastopen_cache[i].len )
+			cookie = &tcp_fastopen_cache[i];
+	}
+	if ( ! cookie ) {
+		cookie = &tcp_fastopen_cache[tcp_fastopen_next];
+		tcp_fastopen_next = ( ( tcp_fastopen_next + 1 ) %
+				      TCP_FASTOPEN_CACHE_SIZE );
+	}
+
+	/* Record cookie.  The data sent within a SYN is limited by
+	 * the peer's maximum segment size less the space occupied by
+	 * our SYN options.
+	 */
+	memcpy ( &cookie->peer, peer, sizeof ( cookie->peer ) );
+	memcpy ( cookie->cookie, data, len );
+	cookie->len = len;
+	cookie->max = ( ( mss > TCP_MAX_OPTIONS_LEN ) ?
+			( mss - TCP_MAX_OPTIONS_LEN ) : 0 );
+	if ( cookie->max > TCP_FASTOPEN_MAX_DATA )
+		cookie->max = TCP_FASTOPEN_MAX_DATA;
+}
+
+/**
+ * Forget TCP Fast Open cookie
+ *
+ * @v peer		Peer socket address
+ */
+static void tcp_fastopen_forget ( struct sockaddr_tcpip *peer ) {
+	struct tcp_fastopen_cookie *cookie;
+
+	cookie = tcp_fastopen_find ( peer );
+	if ( cookie )
+		cookie->len = 0;
+}
+
 /***************************************************************************
  *
  * Open and close
@@ -250,6 +488,24 @@ tcp_dump_flags ( struct tcp_connection *tcp, unsigned int flags ) {
  ***************************************************************************
  */
 
+/**
+ * Get TCP connection hash bucket
+ *
+ * @v local_port	Local port
+ * @ret bucket		Hash bucket
+ */
+static struct list_head * tcp_bucket ( unsigned int local_port ) {
+	unsigned int i;
+
+	/* Initialise buckets, if not already done */
+	if ( ! tcp_hash[0].next ) {
+		for ( i = 0 ; i < TCP_HASH_SIZE ; i++ )
+			INIT_LIST_HEAD ( &tcp_hash[i] );
+	}
+
+	return &tcp_hash[ local_port & ( TCP_HASH_SIZE - 1 ) ];
+}
+
 /**
  * Check if local TCP port is available
  *
@@ -261,6 +517,42 @@ static int tcp_port_available ( int port ) {
 	return ( tcp_demux ( port ) ? -EADDRINUSE : port );
 }
 
+/** TCP delayed acknowledgement timeout setting */
+const struct setting tcp_delack_setting __setting ( SETTING_MISC,
+						      tcp-delack ) = {
+	.name = "tcp-delack",
+	.description = "TCP delayed ACK timeout (in ms)",
+	.type = &setting_type_uint16,
+};
+
+/**
+ * Get delayed acknowledgement timeout
+ *
+ * @ret timeout		Delayed acknowledgement timeout (or zero if disabled)
+ */
+static unsigned long tcp_delack_timeout ( void ) {
+	unsigned long ms;
+	unsigned long timeout;
+
+	/* Use default timeout unless explicitly configured */
+	if ( fetch_uint_setting ( NULL, &tcp_delack_setting, &ms ) < 0 )
+		return TCP_DELACK_TIMEOUT;
+
+	/* Convert to ticks, rounding up any non-zero timeout */
+	timeout = ( ( ms * TICKS_PER_SEC ) / 1000 );
+	if ( ms && ! timeout )
+		timeout = 1;
+	return timeout;
+}
+
+/** TCP Fast Open setting */
+const struct setting tcp_fastopen_setting __setting ( SETTING_MISC,
+							tcp-fastopen ) = {
+	.name = "tcp-fastopen",
+	.description = "Use TCP Fast Open",
+	.type = &setting_type_uint8,
+};
+
 /**
  * Open a TCP connection
  *
@@ -274,6 +566,7 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	struct sockaddr_tcpip *st_peer = ( struct sockaddr_tcpip * ) peer;
 	struct sockaddr_tcpip *st_local = ( struct sockaddr_tcpip * ) local;
 	struct tcp_connection *tcp;
+	struct tcp_fastopen_cookie *cookie;
 	size_t mtu;
 	int port;
 	int rc;
@@ -289,12 +582,18 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	timer_init ( &tcp->timer, tcp_expired, &tcp->refcnt );
 	timer_init ( &tcp->keepalive, tcp_keepalive_expired, &tcp->refcnt );
 	timer_init ( &tcp->wait, tcp_wait_expired, &tcp->refcnt );
+	timer_init ( &tcp->delack, tcp_delack_expired, &tcp->refcnt );
 	tcp->prev_tcp_state = TCP_CLOSED;
 	tcp->tcp_state = TCP_STATE_SENT ( TCP_SYN );
 	tcp_dump_state ( tcp );
 	tcp->snd_seq = random();
+	tcp->rto = TCP_RTO_INIT;
+	tcp->rcv_win_max = TCP_INIT_WINDOW_SIZE;
+	tcp->cwnd = TCP_INIT_CWND;
+	tcp->ssthresh = TCP_MAX_CWND;
+	tcp->recover = tcp->snd_seq;
 	INIT_LIST_HEAD ( &tcp->tx_queue );
-	INIT_LIST_HEAD ( &tcp->rx_queue );
+	tcp_rx_queue_init ( &tcp->rx_queue );
 	memcpy ( &tcp->peer, st_peer, sizeof ( tcp->peer ) );
 
 	/* Calculate MSS */
@@ -307,6 +606,9 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	}
 	tcp->mss = ( mtu - sizeof ( struct tcp_header ) );
 
+	/* Determine delayed acknowledgement timeout */
+	tcp->delack_timeout = tcp_delack_timeout();
+
 	/* Bind to local port */
 	port = tcpip_bind ( st_local, tcp_port_available );
 	if ( port < 0 ) {
@@ -318,6 +620,22 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	tcp->local_port = port;
 	DBGC ( tcp, "TCP %p bound to port %d\n", tcp, tcp->local_port );
 
+	/* Use Fast Open if explicitly enabled, with any cached cookie
+	 * for this peer
+	 */
+	if ( fetch_intz_setting ( NULL, &tcp_fastopen_setting ) ) {
+		tcp->flags |= TCP_FASTOPEN;
+		cookie = tcp_fastopen_find ( &tcp->peer );
+		if ( cookie ) {
+			memcpy ( tcp->fastopen_cookie, cookie->cookie,
+				 cookie->len );
+			tcp->fastopen_len = cookie->len;
+			tcp->fastopen_max = cookie->max;
+			DBGC ( tcp, "TCP %p using Fast Open cookie for up to "
+			       "%zd bytes\n", tcp, tcp->fastopen_max );
+		}
+	}
+
 	/* Start timer to initiate SYN */
 	start_timer_nodelay ( &tcp->timer );
 
@@ -329,6 +647,7 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	 */
 	intf_plug_plug ( &tcp->xfer, xfer );
 	list_add ( &tcp->list, &tcp_conns );
+	list_add ( &tcp->hash, tcp_bucket ( tcp->local_port ) );
 	return 0;
 
  err:
@@ -364,10 +683,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 		tcp_dump_state ( tcp );
 
 		/* Free any unprocessed I/O buffers */
-		list_for_each_entry_safe ( iobuf, tmp, &tcp->rx_queue, list ) {
-			list_del ( &iobuf->list );
-			free_iob ( iobuf );
-		}
+		tcp_rx_queue_flush ( &tcp->rx_queue );
 
 		/* Free any unsent I/O buffers */
 		list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
@@ -376,6 +692,8 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 			pending_put ( &tcp->pending_data );
 		}
 		assert ( ! is_pending ( &tcp->pending_data ) );
+		tcp->tx_len = 0;
+		tcp->tx_pos = NULL;
 
 		/* Remove pending operations for SYN and FIN, if applicable */
 		pending_put ( &tcp->pending_flags );
@@ -386,7 +704,11 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 		stop_timer ( &tcp->timer );
 		stop_timer ( &tcp->keepalive );
 		stop_timer ( &tcp->wait );
+		stop_timer ( &tcp->delack );
 		list_del ( &tcp->list );
+		list_del ( &tcp->hash );
+		if ( tcp_demux_cache == tcp )
+			tcp_demux_cache = NULL;
 		ref_put ( &tcp->refcnt );
 		DBGC ( tcp, "TCP %p connection deleted\n", tcp );
 		return;
@@ -397,7 +719,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 	 * can send a FIN without breaking things.
 	 */
 	if ( ! ( tcp->tcp_state & TCP_STATE_ACKED ( TCP_SYN ) ) )
-		tcp_rx_ack ( tcp, ( tcp->snd_seq + 1 ), 0 );
+		tcp_rx_ack ( tcp, ( tcp->snd_seq + 1 ), 0, 0, NULL );
 
 	/* Stop keepalive timer */
 	stop_timer ( &tcp->keepalive );
@@ -426,7 +748,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
  * Calculate transmission window
  *
  * @v tcp		TCP connection
- * @ret len		Maximum length that can be sent in a single packet
+ * @ret len		Maximum length of sequence space that may be in flight
  */
 static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
 	size_t len;
@@ -435,68 +757,79 @@ static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
 	if ( ! TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
 		return 0;
 
-	/* Length is the minimum of the receiver's window and the path MTU */
+	/* Length is the minimum of the receiver's window and the
+	 * congestion window.
+	 */
 	len = tcp->snd_win;
-	if ( len > TCP_PATH_MTU )
-		len = TCP_PATH_MTU;
+	if ( len > tcp->cwnd )
+		len = tcp->cwnd;
 
 	return len;
 }
 
 /**
- * Check data-transfer flow control window
+ * Calculate Fast Open transmission window
  *
  * @v tcp		TCP connection
- * @ret len		Length of window
+ * @ret len		Maximum length of data that may be sent within SYN
  */
-static size_t tcp_xfer_window ( struct tcp_connection *tcp ) {
+static size_t tcp_fastopen_window ( struct tcp_connection *tcp ) {
 
-	/* Not ready if data queue is non-empty.  This imposes a limit
-	 * of only one unACKed packet in the TX queue at any time; we
-	 * do this to conserve memory usage.
+	/* Not ready unless we have a usable cookie and have not yet
+	 * sent our SYN.
 	 */
-	if ( ! list_empty ( &tcp->tx_queue ) )
+	if ( ! ( ( tcp->flags & TCP_FASTOPEN ) && tcp->fastopen_len ) )
+		return 0;
+	if ( ( tcp->tcp_state != TCP_SYN_SENT ) || tcp->snd_sent )
 		return 0;
 
-	/* Return TCP window length */
-	return tcp_xmit_win ( tcp );
+	return tcp->fastopen_max;
 }
 
 /**
- * Find selective acknowledgement block
+ * Calculate maximum receive window
  *
  * @v tcp		TCP connection
- * @v seq		SEQ value in SACK block (in host-endian order)
- * @v sack		SACK block to fill in (in host-endian order)
- * @ret len		Length of SACK block
+ * @ret max_rcv_win	Maximum receive window
  */
-static uint32_t tcp_sack_block ( struct tcp_connection *tcp, uint32_t seq,
-				 struct tcp_sack_block *sack ) {
-	struct io_buffer *iobuf;
-	struct tcp_rx_queued_header *tcpqhdr;
-	uint32_t left = tcp->rcv_ack;
-	uint32_t right = left;
+static uint32_t tcp_max_rcv_win ( struct tcp_connection *tcp ) {
+	uint32_t max_rcv_win;
+	uint32_t max_representable_win;
 
-	/* Find highest block which does not start after SEQ */
-	list_for_each_entry ( iobuf, &tcp->rx_queue, list ) {
-		tcpqhdr = iobuf->data;
-		if ( tcp_cmp ( tcpqhdr->seq, right ) > 0 ) {
-			if ( tcp_cmp ( tcpqhdr->seq, seq ) > 0 )
-				break;
-			left = tcpqhdr->seq;
-		}
-		if ( tcp_cmp ( tcpqhdr->nxt, right ) > 0 )
-			right = tcpqhdr->nxt;
-	}
+	/* Limit to the data-transfer window, the tuned window, and
+	 * the representable window.
+	 */
+	max_rcv_win = xfer_window ( &tcp->xfer );
+	if ( max_rcv_win > tcp->rcv_win_max )
+		max_rcv_win = tcp->rcv_win_max;
+	max_representable_win = ( 0xffff << tcp->rcv_win_scale );
+	if ( max_rcv_win > max_representable_win )
+		max_rcv_win = max_representable_win;
+	max_rcv_win &= ~0x03; /* Keep everything dword-aligned */
 
-	/* Fail if this block does not contain SEQ */
-	if ( tcp_cmp ( right, seq ) < 0 )
-		return 0;
+	return max_rcv_win;
+}
+
+/**
+ * Check data-transfer flow control window
+ *
+ * @v tcp		TCP connection
+ * @ret len		Length of window
+ */
+static size_t tcp_xfer_window ( struct tcp_connection *tcp ) {
+	size_t win;
 
-	/* Populate SACK block */
-	sack->left = left;
-	sack->right = right;
-	return ( right - left );
+	/* Allow the transmit queue to fill the transmission window
+	 * (or the space available within a Fast Open SYN), but no
+	 * further.  This limits the amount of memory consumed by
+	 * unsent data.
+	 */
+	win = tcp_xmit_win ( tcp );
+	if ( ! win )
+		win = tcp_fastopen_window ( tcp );
+	if ( tcp->tx_len >= win )
+		return 0;
+	return ( win - tcp->tx_len );
 }
 
 /**
@@ -514,7 +847,7 @@ static unsigned int tcp_sack ( struct tcp_connection *tcp, uint32_t seq ) {
 	uint32_t len;
 
 	/* Populate first new SACK block */
-	len = tcp_sack_block ( tcp, seq, &sack[0] );
+	len = tcp_rx_queue_sack ( &tcp->rx_queue, seq, &sack[0] );
 	if ( len )
 		new++;
 
@@ -530,7 +863,8 @@ static unsigned int tcp_sack ( struct tcp_connection *tcp, uint32_t seq ) {
 			continue;
 
 		/* Populate new SACK block */
-		len = tcp_sack_block ( tcp, tcp->sack[old].left, &sack[new] );
+		len = tcp_rx_queue_sack ( &tcp->rx_queue, tcp->sack[old].left,
+					  &sack[new] );
 		if ( len == 0 )
 			continue;
 
@@ -551,61 +885,233 @@ static unsigned int tcp_sack ( struct tcp_connection *tcp, uint32_t seq ) {
 }
 
 /**
- * Process TCP transmit queue
+ * Add block to selective acknowledgement scoreboard
+ *
+ * @v tcp		TCP connection
+ * @v left		Left edge of block (in host-endian order)
+ * @v right		Right edge of block (in host-endian order)
+ */
+static void tcp_scoreboard_add ( struct tcp_connection *tcp, uint32_t left,
+				 uint32_t right ) {
+	struct tcp_sack_block *scoreboard = tcp->scoreboard;
+	unsigned int count = tcp->scoreboard_count;
+	unsigned int i;
+
+	/* Ignore empty blocks, duplicate SACK blocks (which lie at or
+	 * before SND.UNA), and blocks covering data never sent.
+	 */
+	if ( ( tcp_cmp ( right, left ) <= 0 ) ||
+	     ( tcp_cmp ( left, tcp->snd_seq ) <= 0 ) ||
+	     ( tcp_cmp ( right, ( tcp->snd_seq + tcp->snd_max ) ) > 0 ) )
+		return;
+
+	/* Merge with any overlapping or adjacent blocks */
+	for ( i = 0 ; i < count ; ) {
+		if ( ( tcp_cmp ( scoreboard[i].left, right ) > 0 ) ||
+		     ( tcp_cmp ( scoreboard[i].right, left ) < 0 ) ) {
+			i++;
+			continue;
+		}
+		if ( tcp_cmp ( scoreboard[i].left, left ) < 0 )
+			left = scoreboard[i].left;
+		if ( tcp_cmp ( scoreboard[i].right, right ) > 0 )
+			right = scoreboard[i].right;
+		count--;
+		memmove ( &scoreboard[i], &scoreboard[ i + 1 ],
+			  ( ( count - i ) * sizeof ( scoreboard[0] ) ) );
+	}
+
+	/* Find insertion point */
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( tcp_cmp ( scoreboard[i].left, left ) > 0 )
+			break;
+	}
+
+	/* Discard highest block if scoreboard is full */
+	if ( count == TCP_SCOREBOARD_MAX ) {
+		if ( i == count ) {
+			tcp->scoreboard_count = count;
+			return;
+		}
+		count--;
+	}
+
+	/* Insert block */
+	memmove ( &scoreboard[ i + 1 ], &scoreboard[i],
+		  ( ( count - i ) * sizeof ( scoreboard[0] ) ) );
+	scoreboard[i].left = left;
+	scoreboard[i].right = right;
+	tcp->scoreboard_count = ( count + 1 );
+}
+
+/**
+ * Remove acknowledged data from selective acknowledgement scoreboard
  *
  * @v tcp		TCP connection
- * @v max_len		Maximum length to process
- * @v dest		I/O buffer to fill with data, or NULL
- * @v remove		Remove data from queue
- * @ret len		Length of data processed
- *
- * This processes at most @c max_len bytes from the TCP connection's
- * transmit queue.  Data will be copied into the @c dest I/O buffer
- * (if provided) and, if @c remove is true, removed from the transmit
- * queue.
- */
-static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
-				     struct io_buffer *dest, int remove ) {
+ */
+static void tcp_scoreboard_trim ( struct tcp_connection *tcp ) {
+	struct tcp_sack_block *scoreboard = tcp->scoreboard;
+	unsigned int count = tcp->scoreboard_count;
+	unsigned int discard;
+
+	/* Discard any blocks lying entirely before SND.UNA */
+	for ( discard = 0 ; discard < count ; discard++ ) {
+		if ( tcp_cmp ( scoreboard[discard].right, tcp->snd_seq ) > 0 )
+			break;
+	}
+	count -= discard;
+	memmove ( &scoreboard[0], &scoreboard[discard],
+		  ( count * sizeof ( scoreboard[0] ) ) );
+	tcp->scoreboard_count = count;
+
+	/* Truncate any block straddling SND.UNA */
+	if ( count && ( tcp_cmp ( scoreboard[0].left, tcp->snd_seq ) < 0 ) )
+		scoreboard[0].left = tcp->snd_seq;
+}
+
+/**
+ * Find next unacknowledged hole in selective acknowledgement scoreboard
+ *
+ * @v tcp		TCP connection
+ * @v seq		Starting sequence number, updated to start of hole
+ * @ret len		Length of hole, or zero if no SACKed data lies beyond
+ */
+static uint32_t tcp_scoreboard_hole ( struct tcp_connection *tcp,
+				      uint32_t *seq ) {
+	struct tcp_sack_block *block;
+	unsigned int i;
+
+	for ( i = 0 ; i < tcp->scoreboard_count ; i++ ) {
+		block = &tcp->scoreboard[i];
+		if ( tcp_cmp ( *seq, block->left ) < 0 )
+			return ( block->left - *seq );
+		if ( tcp_cmp ( *seq, block->right ) < 0 )
+			*seq = block->right;
+	}
+	return 0;
+}
+
+/**
+ * Copy data from TCP transmit queue
+ *
+ * @v tcp		TCP connection
+ * @v offset		Offset within transmit queue
+ * @v len		Length of data to copy
+ * @v dest		I/O buffer to fill with data
+ * @v chksum		Calculate checksum of copied data
+ * @ret csum		Checksum of copied data (if calculated)
+ *
+ * The position within the transmit queue is cached, so that
+ * constructing successive segments does not require repeatedly
+ * walking the queue from the start.
+ */
+static uint16_t tcp_copy_tx_queue ( struct tcp_connection *tcp,
+				    size_t offset, size_t len,
+				    struct io_buffer *dest, int chksum ) {
 	struct io_buffer *iobuf;
-	struct io_buffer *tmp;
+	uint16_t csum = TCPIP_EMPTY_CSUM;
+	void *frag;
+	size_t start;
+	size_t frag_offset;
 	size_t frag_len;
-	size_t len = 0;
 
-	list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
+	/* Sanity check */
+	assert ( ( offset + len ) <= tcp->tx_len );
+
+	/* Start from cached position, if applicable */
+	if ( tcp->tx_pos && ( offset >= tcp->tx_pos_offset ) ) {
+		iobuf = tcp->tx_pos;
+		start = tcp->tx_pos_offset;
+	} else {
+		iobuf = list_first_entry ( &tcp->tx_queue, struct io_buffer,
+					   list );
+		start = 0;
+	}
+
+	/* Copy data */
+	while ( len ) {
+		assert ( &iobuf->list != &tcp->tx_queue );
 		frag_len = iob_len ( iobuf );
-		if ( frag_len > max_len )
-			frag_len = max_len;
-		if ( dest ) {
-			memcpy ( iob_put ( dest, frag_len ), iobuf->data,
-				 frag_len );
-		}
-		if ( remove ) {
-			iob_pull ( iobuf, frag_len );
-			if ( ! iob_len ( iobuf ) ) {
-				list_del ( &iobuf->list );
-				free_iob ( iobuf );
-				pending_put ( &tcp->pending_data );
+		if ( offset < ( start + frag_len ) ) {
+			frag_offset = ( offset - start );
+			frag_len -= frag_offset;
+			if ( frag_len > len )
+				frag_len = len;
+			frag = ( iobuf->data + frag_offset );
+			if ( ! chksum ) {
+				memcpy ( iob_put ( dest, frag_len ), frag,
+					 frag_len );
+			} else if ( iob_len ( dest ) & 1 ) {
+				/* Continue checksum at an odd offset */
+				csum = bswap_16 ( tcpip_copy_chksum (
+					bswap_16 ( csum ),
+					iob_put ( dest, frag_len ),
+					frag, frag_len ) );
+			} else {
+				csum = tcpip_copy_chksum ( csum,
+					iob_put ( dest, frag_len ),
+					frag, frag_len );
 			}
+			tcp->tx_pos = iobuf;
+			tcp->tx_pos_offset = start;
+			offset += frag_len;
+			len -= frag_len;
+			if ( ! len )
+				break;
 		}
-		len += frag_len;
-		max_len -= frag_len;
+		start += iob_len ( iobuf );
+		iobuf = list_entry ( iobuf->list.next, struct io_buffer, list );
 	}
-	return len;
+
+	return csum;
 }
 
 /**
- * Transmit any outstanding data (with selective acknowledgement)
+ * Remove acknowledged data from TCP transmit queue
  *
  * @v tcp		TCP connection
- * @v sack_seq		SEQ for first selective acknowledgement (if any)
- * 
- * Transmits any outstanding data on the connection.
+ * @v len		Length of data to remove
+ */
+static void tcp_trim_tx_queue ( struct tcp_connection *tcp, size_t len ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+	size_t frag_len;
+
+	/* Update cached position */
+	tcp->tx_pos_offset = ( ( tcp->tx_pos_offset > len ) ?
+			       ( tcp->tx_pos_offset - len ) : 0 );
+
+	/* Remove data, freeing any completely acknowledged buffers */
+	list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
+		frag_len = iob_len ( iobuf );
+		if ( frag_len > len )
+			frag_len = len;
+		iob_pull ( iobuf, frag_len );
+		tcp->tx_len -= frag_len;
+		len -= frag_len;
+		if ( iob_len ( iobuf ) )
+			break;
+		if ( iobuf == tcp->tx_pos )
+			tcp->tx_pos = NULL;
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+		pending_put ( &tcp->pending_data );
+	}
+}
+
+/**
+ * Transmit segment
  *
- * Note that even if an error is returned, the retransmission timer
- * will have been started if necessary, and so the stack will
- * eventually attempt to retransmit the failed packet.
+ * @v tcp		TCP connection
+ * @v offset		Offset within unacknowledged sequence space
+ * @v len		Length of data payload
+ * @v flags		TCP flags
+ * @v sack_seq		SEQ for first selective acknowledgement (if any)
+ * @ret rc		Return status code
  */
-static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
+static int tcp_xmit_segment ( struct tcp_connection *tcp, uint32_t offset,
+			      size_t len, unsigned int flags,
+			      uint32_t sack_seq ) {
 	struct io_buffer *iobuf;
 	struct tcp_header *tcphdr;
 	struct tcp_mss_option *mssopt;
@@ -614,73 +1120,48 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	struct tcp_sack_permitted_padded_option *spopt;
 	struct tcp_sack_padded_option *sackopt;
 	struct tcp_sack_block *sack;
+	struct tcp_fastopen_option *foopt;
+	struct net_device *netdev;
 	void *payload;
-	unsigned int flags;
 	unsigned int sack_count;
 	unsigned int i;
-	size_t len = 0;
 	size_t sack_len;
+	size_t foopt_len;
+	size_t pad_len;
+	uint32_t seq = ( tcp->snd_seq + offset );
 	uint32_t seq_len;
 	uint32_t max_rcv_win;
-	uint32_t max_representable_win;
+	uint16_t csum;
+	int offload;
 	int rc;
 
-	/* Start profiling */
-	profile_start ( &tcp_tx_profiler );
-
-	/* If retransmission timer is already running, do nothing */
-	if ( timer_running ( &tcp->timer ) )
-		return;
-
-	/* Calculate both the actual (payload) and sequence space
-	 * lengths that we wish to transmit.
-	 */
-	if ( TCP_CAN_SEND_DATA ( tcp->tcp_state ) ) {
-		len = tcp_process_tx_queue ( tcp, tcp_xmit_win ( tcp ),
-					     NULL, 0 );
-	}
+	/* Calculate sequence space length */
 	seq_len = len;
-	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
 	if ( flags & ( TCP_SYN | TCP_FIN ) ) {
 		/* SYN or FIN consume one byte, and we can never send both */
 		assert ( ! ( ( flags & TCP_SYN ) && ( flags & TCP_FIN ) ) );
 		seq_len++;
 	}
-	tcp->snd_sent = seq_len;
-
-	/* If we have nothing to transmit, stop now */
-	if ( ( seq_len == 0 ) && ! ( tcp->flags & TCP_ACK_PENDING ) )
-		return;
-
-	/* If we are transmitting anything that requires
-	 * acknowledgement (i.e. consumes sequence space), start the
-	 * retransmission timer.  Do this before attempting to
-	 * allocate the I/O buffer, in case allocation itself fails.
-	 */
-	if ( seq_len )
-		start_timer ( &tcp->timer );
 
 	/* Allocate I/O buffer */
 	iobuf = alloc_iob ( len + TCP_MAX_HEADER_LEN );
 	if ( ! iobuf ) {
 		DBGC ( tcp, "TCP %p could not allocate iobuf for %08x..%08x "
-		       "%08x\n", tcp, tcp->snd_seq, ( tcp->snd_seq + seq_len ),
-		       tcp->rcv_ack );
-		return;
+		       "%08x\n", tcp, seq, ( seq + seq_len ), tcp->rcv_ack );
+		return -ENOMEM;
 	}
 	iob_reserve ( iobuf, TCP_MAX_HEADER_LEN );
 
-	/* Fill data payload from transmit queue */
-	tcp_process_tx_queue ( tcp, len, iobuf, 0 );
+	/* Fill data payload from transmit queue.  Calculate the
+	 * payload checksum while copying, unless the checksum will be
+	 * inserted by the network device.
+	 */
+	netdev = tcpip_netdev ( &tcp->peer );
+	offload = ( netdev && netdev_tx_csum ( netdev ) );
+	csum = tcp_copy_tx_queue ( tcp, offset, len, iobuf, ( ! offload ) );
 
 	/* Expand receive window if possible */
-	max_rcv_win = xfer_window ( &tcp->xfer );
-	if ( max_rcv_win > TCP_MAX_WINDOW_SIZE )
-		max_rcv_win = TCP_MAX_WINDOW_SIZE;
-	max_representable_win = ( 0xffff << tcp->rcv_win_scale );
-	if ( max_rcv_win > max_representable_win )
-		max_rcv_win = max_representable_win;
-	max_rcv_win &= ~0x03; /* Keep everything dword-aligned */
+	max_rcv_win = tcp_max_rcv_win ( tcp );
 	if ( tcp->rcv_win < max_rcv_win )
 		tcp->rcv_win = max_rcv_win;
 
@@ -701,6 +1182,17 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 		spopt->spopt.kind = TCP_OPTION_SACK_PERMITTED;
 		spopt->spopt.length = sizeof ( spopt->spopt );
 	}
+	if ( ( flags & TCP_SYN ) && ( tcp->flags & TCP_FASTOPEN ) ) {
+		foopt_len = ( sizeof ( *foopt ) + tcp->fastopen_len );
+		pad_len = ( ( 4 - ( foopt_len & 3 ) ) & 3 );
+		foopt = iob_push ( iobuf, ( pad_len + foopt_len ) );
+		memset ( foopt, TCP_OPTION_NOP, pad_len );
+		foopt = ( ( ( void * ) foopt ) + pad_len );
+		foopt->kind = TCP_OPTION_FASTOPEN;
+		foopt->length = foopt_len;
+		memcpy ( foopt->cookie, tcp->fastopen_cookie,
+			 tcp->fastopen_len );
+	}
 	if ( ( flags & TCP_SYN ) || ( tcp->flags & TCP_TS_ENABLED ) ) {
 		tsopt = iob_push ( iobuf, sizeof ( *tsopt ) );
 		memset ( tsopt->nop, TCP_OPTION_NOP, sizeof ( tsopt->nop ) );
@@ -710,7 +1202,7 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 		tsopt->tsopt.tsecr = htonl ( tcp->ts_recent );
 	}
 	if ( ( tcp->flags & TCP_SACK_ENABLED ) &&
-	     ( ! list_empty ( &tcp->rx_queue ) ) &&
+	     ( ! tcp_rx_queue_empty ( &tcp->rx_queue ) ) &&
 	     ( ( sack_count = tcp_sack ( tcp, sack_seq ) ) != 0 ) ) {
 		sack_len = ( sack_count * sizeof ( *sack ) );
 		sackopt = iob_push ( iobuf, ( sizeof ( *sackopt ) + sack_len ));
@@ -724,38 +1216,209 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 			sack->right = htonl ( tcp->sack[i].right );
 		}
 	}
-	if ( len != 0 )
-		flags |= TCP_PSH;
-	tcphdr = iob_push ( iobuf, sizeof ( *tcphdr ) );
-	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
-	tcphdr->src = htons ( tcp->local_port );
-	tcphdr->dest = tcp->peer.st_port;
-	tcphdr->seq = htonl ( tcp->snd_seq );
-	tcphdr->ack = htonl ( tcp->rcv_ack );
-	tcphdr->hlen = ( ( payload - iobuf->data ) << 2 );
-	tcphdr->flags = flags;
-	tcphdr->win = htons ( tcp->rcv_win >> tcp->rcv_win_scale );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	if ( len && ( ( offset + len ) == tcp->tx_len ) )
+		flags |= TCP_PSH;
+	tcphdr = iob_push ( iobuf, sizeof ( *tcphdr ) );
+	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
+	tcphdr->src = htons ( tcp->local_port );
+	tcphdr->dest = tcp->peer.st_port;
+	tcphdr->seq = htonl ( seq );
+	tcphdr->ack = htonl ( tcp->rcv_ack );
+	tcphdr->hlen = ( ( payload - iobuf->data ) << 2 );
+	tcphdr->flags = flags;
+	tcphdr->win = htons ( tcp->rcv_win >> tcp->rcv_win_scale );
+	if ( offload ) {
+		iob_csum_defer ( iobuf, tcphdr, &tcphdr->csum );
+	} else {
+		tcphdr->csum = tcpip_continue_chksum ( csum, tcphdr,
+						       ( payload - iobuf->data ) );
+	}
+
+	/* Dump header */
+	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4zd",
+		tcp, ntohs ( tcphdr->src ), ntohs ( tcphdr->dest ),
+		ntohl ( tcphdr->seq ), ( ntohl ( tcphdr->seq ) + seq_len ),
+		ntohl ( tcphdr->ack ), len );
+	tcp_dump_flags ( tcp, tcphdr->flags );
+	DBGC2 ( tcp, "\n" );
+	trace ( TRACE_TCP_TX, seq, tcp->rcv_ack, len );
+
+	/* Transmit packet */
+	if ( ( rc = tcpip_tx ( iobuf, &tcp_protocol, NULL, &tcp->peer, NULL,
+			       &tcp->route, &tcphdr->csum ) ) != 0 ) {
+		DBGC ( tcp, "TCP %p could not transmit %08x..%08x %08x: %s\n",
+		       tcp, seq, ( seq + seq_len ), tcp->rcv_ack,
+		       strerror ( rc ) );
+		return rc;
+	}
+
+	/* Clear ACK-pending flag and any delayed acknowledgement */
+	tcp->flags &= ~TCP_ACK_PENDING;
+	tcp->rcv_unacked = 0;
+	stop_timer ( &tcp->delack );
+
+	return 0;
+}
+
+/**
+ * Retransmit data considered lost during fast recovery
+ *
+ * @v tcp		TCP connection
+ * @v flags		TCP flags
+ * @v sack_seq		SEQ for first selective acknowledgement (if any)
+ * @ret count		Number of segments retransmitted
+ *
+ * Each pending retransmission fills the next hole identified by the
+ * selective acknowledgement scoreboard.  The segment at SND.UNA may
+ * always be retransmitted (as required for fast retransmission and
+ * for NewReno partial acknowledgements); any other pending
+ * retransmission for which no hole exists is instead used to inflate
+ * the congestion window.
+ */
+static unsigned int tcp_xmit_rxt ( struct tcp_connection *tcp,
+				   unsigned int flags, uint32_t sack_seq ) {
+	unsigned int count = 0;
+	uint32_t offset;
+	uint32_t seq;
+	uint32_t len;
+
+	while ( tcp->rxt_pending ) {
+		tcp->rxt_pending--;
+
+		/* Find next hole */
+		seq = tcp->snd_rxt;
+		len = tcp_scoreboard_hole ( tcp, &seq );
+		offset = ( seq - tcp->snd_seq );
+		if ( offset >= tcp->snd_sent )
+			len = 0;
+		if ( ( ! len ) && ( offset == 0 ) )
+			len = tcp->snd_sent;
+		if ( ! len ) {
+			tcp->cwnd += TCP_SMSS;
+			continue;
+		}
+		if ( len > ( tcp->snd_sent - offset ) )
+			len = ( tcp->snd_sent - offset );
+		if ( len > TCP_SMSS )
+			len = TCP_SMSS;
+		DBGC2 ( tcp, "TCP %p retransmitting %08x..%08x\n",
+			tcp, seq, ( seq + len ) );
+
+		/* Retransmit segment (abandoning any round-trip time
+		 * measurement, as per Karn's algorithm).
+		 */
+		tcp->snd_rxt = ( seq + len );
+		tcp->flags &= ~TCP_RTT_TIMING;
+		tcp->retransmits++;
+		if ( ! timer_running ( &tcp->timer ) )
+			start_timer_fixed ( &tcp->timer, tcp->rto );
+		tcp_xmit_segment ( tcp, offset, len, flags, sack_seq );
+		count++;
+	}
+
+	return count;
+}
+
+/**
+ * Transmit any outstanding data (with selective acknowledgement)
+ *
+ * @v tcp		TCP connection
+ * @v sack_seq		SEQ for first selective acknowledgement (if any)
+ *
+ * Transmits any outstanding data on the connection, subject to the
+ * send and congestion windows.
+ *
+ * Note that even if a transmission fails, the retransmission timer
+ * will have been started if necessary, and so the stack will
+ * eventually attempt to retransmit the failed packet.
+ */
+static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
+	unsigned int flags;
+	unsigned int sent = 0;
+	uint32_t avail;
+	uint32_t win;
+	uint32_t offset;
+	uint32_t seq_len;
+	size_t len;
+
+	/* Start profiling */
+	profile_start ( &tcp_tx_profiler );
+
+	/* Calculate the sequence space available for transmission.
+	 * This is either data (limited by the transmission window),
+	 * or a SYN or FIN (which may be sent alongside data only
+	 * when using Fast Open).
+	 */
+	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
+	if ( TCP_CAN_SEND_DATA ( tcp->tcp_state ) ) {
+		avail = tcp->tx_len;
+		win = tcp_xmit_win ( tcp );
+		sent += tcp_xmit_rxt ( tcp, flags, sack_seq );
+	} else {
+		avail = win = ( ( flags & ( TCP_SYN | TCP_FIN ) ) ? 1 : 0 );
+		if ( flags & TCP_SYN ) {
+			len = tcp_fastopen_window ( tcp );
+			if ( len > tcp->tx_len )
+				len = tcp->tx_len;
+			avail = win = ( 1 + len );
+		}
+	}
 
-	/* Dump header */
-	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4zd",
-		tcp, ntohs ( tcphdr->src ), ntohs ( tcphdr->dest ),
-		ntohl ( tcphdr->seq ), ( ntohl ( tcphdr->seq ) + seq_len ),
-		ntohl ( tcphdr->ack ), len );
-	tcp_dump_flags ( tcp, tcphdr->flags );
-	DBGC2 ( tcp, "\n" );
+	/* Transmit as many new segments as the window allows */
+	while ( ( tcp->snd_sent < avail ) && ( tcp->snd_sent < win ) ) {
 
-	/* Transmit packet */
-	if ( ( rc = tcpip_tx ( iobuf, &tcp_protocol, NULL, &tcp->peer, NULL,
-			       &tcphdr->csum ) ) != 0 ) {
-		DBGC ( tcp, "TCP %p could not transmit %08x..%08x %08x: %s\n",
-		       tcp, tcp->snd_seq, ( tcp->snd_seq + tcp->snd_sent ),
-		       tcp->rcv_ack, strerror ( rc ) );
-		return;
+		/* Calculate segment length */
+		offset = tcp->snd_sent;
+		seq_len = ( ( ( avail < win ) ? avail : win ) - offset );
+		if ( seq_len > TCP_SMSS )
+			seq_len = TCP_SMSS;
+
+		/* Avoid sending a runt segment while we still have
+		 * data in flight (sender-side silly window avoidance).
+		 */
+		if ( offset && ( seq_len < TCP_SMSS ) &&
+		     ( seq_len < ( avail - offset ) ) )
+			break;
+		len = seq_len;
+		if ( flags & ( TCP_SYN | TCP_FIN ) )
+			len--;
+
+		/* Start the retransmission timer, if not already
+		 * running (or if it is running only to initiate the
+		 * SYN).  Start measuring the round-trip time unless we
+		 * are already doing so, or unless this is a
+		 * retransmission (as per Karn's algorithm).
+		 */
+		if ( ( ! offset ) || ( ! timer_running ( &tcp->timer ) ) )
+			start_timer_fixed ( &tcp->timer, tcp->rto );
+		if ( offset < tcp->snd_max ) {
+			tcp->retransmits++;
+		} else if ( ! ( tcp->flags & TCP_RTT_TIMING ) ) {
+			tcp->flags |= TCP_RTT_TIMING;
+			tcp->rtt_start = currticks();
+			tcp->rtt_seq = ( tcp->snd_seq + offset + seq_len );
+		}
+
+		/* Treat the segment as sent even if transmission
+		 * fails, since the retransmission timer will recover.
+		 */
+		tcp->snd_sent += seq_len;
+		if ( tcp->snd_max < tcp->snd_sent )
+			tcp->snd_max = tcp->snd_sent;
+		sent++;
+		if ( tcp_xmit_segment ( tcp, offset, len, flags,
+					sack_seq ) != 0 )
+			break;
 	}
 
-	/* Clear ACK-pending flag */
-	tcp->flags &= ~TCP_ACK_PENDING;
+	/* Send a pure ACK if required (unless deliberately delayed) */
+	if ( ( ! sent ) && ( flags & TCP_ACK ) &&
+	     ( tcp->flags & TCP_ACK_PENDING ) &&
+	     ( ! timer_running ( &tcp->delack ) ) ) {
+		tcp_xmit_segment ( tcp, tcp->snd_sent, 0,
+				   ( flags & ~( TCP_SYN | TCP_FIN ) ),
+				   sack_seq );
+	}
 
 	profile_stop ( &tcp_tx_profiler );
 }
@@ -775,6 +1438,49 @@ static void tcp_xmit ( struct tcp_connection *tcp ) {
 static struct process_descriptor tcp_process_desc =
 	PROC_DESC_ONCE ( struct tcp_connection, process, tcp_xmit );
 
+/**
+ * Calculate slow start threshold following congestion
+ *
+ * @v tcp		TCP connection
+ * @ret ssthresh	Slow start threshold
+ */
+static uint32_t tcp_ssthresh ( struct tcp_connection *tcp ) {
+	uint32_t ssthresh;
+
+	/* Use half of the amount of data in flight, as per RFC 5681 */
+	ssthresh = ( tcp->snd_sent / 2 );
+	if ( ssthresh < ( 2 * TCP_SMSS ) )
+		ssthresh = ( 2 * TCP_SMSS );
+	return ssthresh;
+}
+
+/**
+ * Handle loss detected by retransmission timeout
+ *
+ * @v tcp		TCP connection
+ *
+ * Reduce the congestion window to a single segment (as per RFC 5681)
+ * and abandon any fast recovery in progress.  The slow start
+ * threshold is left unchanged by repeated timeouts, since the amount
+ * of data in flight no longer reflects the path capacity.
+ *
+ * Any selective acknowledgement information is also discarded, since
+ * the receiver is permitted to discard data that it has SACKed.
+ */
+static void tcp_loss ( struct tcp_connection *tcp ) {
+
+	if ( tcp->cwnd > TCP_SMSS )
+		tcp->ssthresh = tcp_ssthresh ( tcp );
+	tcp->cwnd = TCP_SMSS;
+	tcp->flags &= ~TCP_RECOVERY;
+	tcp->recover = ( tcp->snd_seq + tcp->snd_max );
+	tcp->dupacks = 0;
+	tcp->rxt_pending = 0;
+	tcp->scoreboard_count = 0;
+	DBGC ( tcp, "TCP %p timeout: cwnd %#x ssthresh %#x\n",
+	       tcp, tcp->cwnd, tcp->ssthresh );
+}
+
 /**
  * Retransmission timer expired
  *
@@ -804,7 +1510,47 @@ static void tcp_expired ( struct retry_timer *timer, int over ) {
 		tcp_dump_state ( tcp );
 		tcp_close ( tcp, -ETIMEDOUT );
 	} else {
-		/* Otherwise, retransmit the packet */
+		/* Otherwise, back off the retransmission timeout and
+		 * abandon any round-trip time measurement (unless
+		 * this is the initial expiry used to send the first
+		 * SYN), and go back to retransmit from SND.UNA.
+		 */
+		if ( tcp->snd_sent ) {
+			tcp->timeouts++;
+			tcp->rto <<= 1;
+			if ( tcp->rto > TCP_RTO_MAX )
+				tcp->rto = TCP_RTO_MAX;
+			tcp->flags &= ~TCP_RTT_TIMING;
+			if ( TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
+				tcp_loss ( tcp );
+			tcp->snd_sent = 0;
+
+			/* Abandon Fast Open if our SYN was lost, since
+			 * it may have been dropped by a middlebox that
+			 * objects to the option or to the data, as per
+			 * RFC 7413.
+			 */
+			if ( ( tcp->tcp_state == TCP_SYN_SENT ) &&
+			     ( tcp->flags & TCP_FASTOPEN ) ) {
+				DBGC ( tcp, "TCP %p abandoning Fast Open\n",
+				       tcp );
+				tcp->flags &= ~TCP_FASTOPEN;
+				if ( tcp->fastopen_len )
+					tcp_fastopen_forget ( &tcp->peer );
+			}
+
+		} else if ( tcp_fastopen_window ( tcp ) ) {
+
+			/* Allow the application to provide data to be
+			 * sent within the initial SYN.  Defer sending
+			 * the SYN until any processes scheduled by the
+			 * application have had a chance to run.
+			 */
+			xfer_window_changed ( &tcp->xfer );
+			if ( ! ( tcp->flags & TCP_XFER_CLOSED ) )
+				process_add ( &tcp->process );
+			return;
+		}
 		tcp_xmit ( tcp );
 	}
 }
@@ -835,6 +1581,24 @@ static void tcp_keepalive_expired ( struct retry_timer *timer,
 	tcp_xmit ( tcp );
 }
 
+/**
+ * Delayed acknowledgement timer expired
+ *
+ * @v timer		Delayed acknowledgement timer
+ * @v over		Failure indicator
+ */
+static void tcp_delack_expired ( struct retry_timer *timer,
+				 int over __unused ) {
+	struct tcp_connection *tcp =
+		container_of ( timer, struct tcp_connection, delack );
+
+	DBGC2 ( tcp, "TCP %p sending delayed ACK for %08x\n",
+		tcp, tcp->rcv_ack );
+
+	/* Send acknowledgement */
+	tcp_xmit ( tcp );
+}
+
 /**
  * Shutdown timer expired
  *
@@ -889,7 +1653,7 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
 	tcphdr->hlen = ( ( sizeof ( *tcphdr ) / 4 ) << 4 );
 	tcphdr->flags = ( TCP_RST | TCP_ACK );
 	tcphdr->win = htons ( 0 );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	iob_csum_defer ( iobuf, tcphdr, &tcphdr->csum );
 
 	/* Dump header */
 	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4d",
@@ -901,7 +1665,7 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
 
 	/* Transmit packet */
 	if ( ( rc = tcpip_tx ( iobuf, &tcp_protocol, NULL, st_dest,
-			       NULL, &tcphdr->csum ) ) != 0 ) {
+			       NULL, NULL, &tcphdr->csum ) ) != 0 ) {
 		DBGC ( tcp, "TCP %p could not transmit RST %08x..%08x %08x: "
 		       "%s\n", tcp, ntohl ( in_tcphdr->ack ),
 		       ntohl ( in_tcphdr->ack ), ntohl ( in_tcphdr->seq ),
@@ -924,13 +1688,26 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
  *
  * @v local_port	Local port
  * @ret tcp		TCP connection, or NULL
+ *
+ * Each TCP connection has a unique local port, so the local port
+ * alone is sufficient to identify the connection.  The most recently
+ * identified connection is checked first, since received segments
+ * tend to arrive in long runs belonging to a single bulk transfer.
  */
 static struct tcp_connection * tcp_demux ( unsigned int local_port ) {
 	struct tcp_connection *tcp;
 
-	list_for_each_entry ( tcp, &tcp_conns, list ) {
-		if ( tcp->local_port == local_port )
+	/* Check most recently identified connection */
+	tcp = tcp_demux_cache;
+	if ( tcp && ( tcp->local_port == local_port ) )
+		return tcp;
+
+	/* Search hash bucket */
+	list_for_each_entry ( tcp, tcp_bucket ( local_port ), hash ) {
+		if ( tcp->local_port == local_port ) {
+			tcp_demux_cache = tcp;
 			return tcp;
+		}
 	}
 	return NULL;
 }
@@ -977,7 +1754,8 @@ static int tcp_rx_opts ( struct tcp_connection *tcp,
 		min = sizeof ( *option );
 		switch ( kind ) {
 		case TCP_OPTION_MSS:
-			/* Ignore received MSS */
+			options->mssopt = data;
+			min = sizeof ( *options->mssopt );
 			break;
 		case TCP_OPTION_WS:
 			options->wsopt = data;
@@ -988,12 +1766,17 @@ static int tcp_rx_opts ( struct tcp_connection *tcp,
 			min = sizeof ( *options->spopt );
 			break;
 		case TCP_OPTION_SACK:
-			/* Ignore received SACKs */
+			options->sackopt = data;
+			min = sizeof ( *options->sackopt );
 			break;
 		case TCP_OPTION_TS:
 			options->tsopt = data;
 			min = sizeof ( *options->tsopt );
 			break;
+		case TCP_OPTION_FASTOPEN:
+			options->foopt = data;
+			min = sizeof ( *options->foopt );
+			break;
 		default:
 			DBGC ( tcp, "TCP %p received unknown option %d\n",
 			       tcp, kind );
@@ -1020,6 +1803,61 @@ static int tcp_rx_opts ( struct tcp_connection *tcp,
 	return 0;
 }
 
+/**
+ * Tune maximum receive window
+ *
+ * @v tcp		TCP connection
+ * @v seq_len		Sequence space length received
+ *
+ * Measure the amount of data received within each round-trip time,
+ * and grow the maximum receive window to twice this amount (to allow
+ * the sender's congestion window to continue to grow), subject to
+ * the amount of free heap memory available to hold any out-of-order
+ * data.  Once the heap has been grown using external memory, the
+ * window is allowed to grow to at least TCP_FLOOR_WINDOW_SIZE; any
+ * further growth in the heap will then allow the window to grow
+ * further.  The window is not grown while it is being held following
+ * a reduction due to memory pressure.
+ */
+static void tcp_rx_tune ( struct tcp_connection *tcp, uint32_t seq_len ) {
+	unsigned long now = currticks();
+	unsigned long rtt;
+	uint32_t max;
+	uint32_t len;
+
+	/* Wait until a round-trip time has elapsed */
+	tcp->rcv_tune_len += seq_len;
+	rtt = ( tcp->srtt >> 3 );
+	if ( ( now - tcp->rcv_tune_start ) <= rtt )
+		return;
+	len = tcp->rcv_tune_len;
+	tcp->rcv_tune_start = now;
+	tcp->rcv_tune_len = 0;
+
+	/* Do not grow a window that is being held after a reduction */
+	if ( tcp->rcv_win_held ) {
+		if ( ( now - tcp->rcv_win_shrunk ) < TCP_WINDOW_HOLD )
+			return;
+		tcp->rcv_win_held = 0;
+	}
+
+	/* Calculate new maximum window */
+	max = ( freemem / 2 );
+	if ( heapregions && ( max < TCP_FLOOR_WINDOW_SIZE ) )
+		max = TCP_FLOOR_WINDOW_SIZE;
+	if ( max > TCP_MAX_WINDOW_SIZE )
+		max = TCP_MAX_WINDOW_SIZE;
+	if ( len > ( max / 2 ) )
+		len = ( max / 2 );
+	len *= 2;
+
+	/* Grow window, if applicable */
+	if ( len > tcp->rcv_win_max ) {
+		DBGC ( tcp, "TCP %p maximum window grown to %#x\n", tcp, len );
+		tcp->rcv_win_max = len;
+	}
+}
+
 /**
  * Consume received sequence space
  *
@@ -1035,6 +1873,9 @@ static void tcp_rx_seq ( struct tcp_connection *tcp, uint32_t seq_len ) {
 	/* Update acknowledgement number */
 	tcp->rcv_ack += seq_len;
 
+	/* Tune maximum receive window */
+	tcp_rx_tune ( tcp, seq_len );
+
 	/* Update window */
 	if ( tcp->rcv_win > seq_len ) {
 		tcp->rcv_win -= seq_len;
@@ -1103,26 +1944,278 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 	return 0;
 }
 
+/**
+ * Handle TCP received Fast Open response
+ *
+ * @v tcp		TCP connection
+ * @v ack		ACK value (in host-endian order)
+ * @v options		TCP options
+ *
+ * Record any cookie provided by the peer, and arrange for any data
+ * sent within our SYN but not acknowledged by the peer to be
+ * retransmitted immediately.
+ */
+static void tcp_rx_fastopen ( struct tcp_connection *tcp, uint32_t ack,
+			      struct tcp_options *options ) {
+	const struct tcp_fastopen_option *foopt = options->foopt;
+	uint32_t ack_len = ( ack - tcp->snd_seq );
+	size_t len;
+	size_t mss;
+
+	/* Do nothing unless this acknowledges our Fast Open SYN */
+	if ( ! ( tcp->flags & TCP_FASTOPEN ) )
+		return;
+	if ( tcp->tcp_state != TCP_SYN_SENT )
+		return;
+	if ( ( ack_len == 0 ) || ( ack_len > tcp->snd_sent ) )
+		return;
+
+	/* Record any cookie provided by the peer, or forget our
+	 * cookie if the peer has rejected our data without providing
+	 * a new cookie.
+	 */
+	len = ( foopt ? ( foopt->length - sizeof ( *foopt ) ) : 0 );
+	if ( ( len >= TCP_FASTOPEN_COOKIE_MIN ) &&
+	     ( len <= TCP_FASTOPEN_COOKIE_MAX ) ) {
+		mss = ( options->mssopt ? ntohs ( options->mssopt->mss ) :
+			TCP_FASTOPEN_DEFAULT_MSS );
+		DBGC ( tcp, "TCP %p received %zd-byte Fast Open cookie\n",
+		       tcp, len );
+		tcp_fastopen_store ( &tcp->peer, foopt->cookie, len, mss );
+	} else if ( ( ack_len == 1 ) && ( tcp->snd_sent > 1 ) ) {
+		tcp_fastopen_forget ( &tcp->peer );
+	}
+
+	/* Record length of data accepted */
+	tcp->fastopen_acked = ( ack_len - 1 );
+	if ( tcp->snd_sent > 1 ) {
+		DBGC ( tcp, "TCP %p Fast Open accepted %d of %d bytes\n",
+		       tcp, tcp->fastopen_acked, ( tcp->snd_sent - 1 ) );
+	}
+
+	/* Retransmit any unacknowledged data immediately */
+	tcp->snd_sent = ack_len;
+}
+
+/**
+ * Update round-trip time estimate
+ *
+ * @v tcp		TCP connection
+ * @v rtt		Round-trip time sample (in ticks)
+ *
+ * Update the smoothed round-trip time and variation, and recalculate
+ * the retransmission timeout as per RFC 6298.
+ */
+static void tcp_rtt_update ( struct tcp_connection *tcp, unsigned long rtt ) {
+	unsigned long err;
+
+	/* Record sample */
+	tcp->rtt = rtt;
+	if ( ( ! tcp->rtt_samples ) || ( rtt < tcp->rtt_min ) )
+		tcp->rtt_min = rtt;
+
+	/* Update estimators.  We store SRTT scaled by 8 and RTTVAR
+	 * scaled by 4, so that the RFC 6298 updates
+	 *
+	 *   RTTVAR := 3/4 RTTVAR + 1/4 | SRTT - R |
+	 *   SRTT   := 7/8 SRTT   + 1/8 R
+	 *
+	 * can be calculated without loss of precision.
+	 */
+	if ( tcp->rtt_samples++ ) {
+		err = ( ( rtt > ( tcp->srtt >> 3 ) ) ?
+			( rtt - ( tcp->srtt >> 3 ) ) :
+			( ( tcp->srtt >> 3 ) - rtt ) );
+		tcp->rttvar = ( tcp->rttvar - ( tcp->rttvar >> 2 ) + err );
+		tcp->srtt = ( tcp->srtt - ( tcp->srtt >> 3 ) + rtt );
+	} else {
+		tcp->srtt = ( rtt << 3 );
+		tcp->rttvar = ( rtt << 1 );
+	}
+
+	/* Calculate RTO := SRTT + max ( G, 4 RTTVAR ), with a clock
+	 * granularity G of one tick.
+	 */
+	tcp->rto = ( ( tcp->srtt >> 3 ) + ( tcp->rttvar ? tcp->rttvar : 1 ) );
+	if ( tcp->rto < TCP_RTO_MIN )
+		tcp->rto = TCP_RTO_MIN;
+	if ( tcp->rto > TCP_RTO_MAX )
+		tcp->rto = TCP_RTO_MAX;
+	DBGC2 ( tcp, "TCP %p RTT %ld SRTT %ld RTTVAR %ld RTO %ld\n", tcp, rtt,
+		( tcp->srtt >> 3 ), ( tcp->rttvar >> 2 ), tcp->rto );
+}
+
+/**
+ * Handle TCP received selective acknowledgements
+ *
+ * @v tcp		TCP connection
+ * @v sackopt		Selective acknowledgement option
+ */
+static void tcp_rx_sack ( struct tcp_connection *tcp,
+			  const struct tcp_sack_option *sackopt ) {
+	const struct tcp_sack_block *sack =
+		( ( ( const void * ) sackopt ) + sizeof ( *sackopt ) );
+	unsigned int count;
+
+	/* Ignore SACKs unless negotiated */
+	if ( ! ( tcp->flags & TCP_SACK_ENABLED ) )
+		return;
+
+	/* Add each block to the scoreboard */
+	count = ( ( sackopt->length - sizeof ( *sackopt ) ) /
+		  sizeof ( *sack ) );
+	for ( ; count-- ; sack++ ) {
+		tcp_scoreboard_add ( tcp, ntohl ( sack->left ),
+				     ntohl ( sack->right ) );
+	}
+}
+
+/**
+ * Handle TCP received duplicate ACK
+ *
+ * @v tcp		TCP connection
+ *
+ * The third duplicate acknowledgement triggers a fast retransmission
+ * and entry into fast recovery, as per RFC 5681 and RFC 6582.  Each
+ * further duplicate acknowledgement indicates that another segment
+ * has left the network, and is used either to retransmit the next
+ * hole identified by selective acknowledgements or (if there is no
+ * such hole) to inflate the congestion window.
+ */
+static void tcp_rx_dupack ( struct tcp_connection *tcp ) {
+	uint32_t seq;
+
+	/* Count duplicate ACKs */
+	tcp->dupacks++;
+
+	/* Retransmit next hole or inflate window, if in fast recovery */
+	if ( tcp->flags & TCP_RECOVERY ) {
+		seq = tcp->snd_rxt;
+		if ( tcp_scoreboard_hole ( tcp, &seq ) ) {
+			tcp->rxt_pending++;
+		} else {
+			tcp->cwnd += TCP_SMSS;
+		}
+		return;
+	}
+
+	/* Do nothing more until the threshold is reached */
+	if ( tcp->dupacks != TCP_DUPACK_THRESHOLD )
+		return;
+
+	/* Do not enter fast recovery again until all data outstanding
+	 * at the time of the previous fast recovery (or timeout) has
+	 * been acknowledged, as per RFC 6582.
+	 */
+	if ( tcp_cmp ( tcp->snd_seq, tcp->recover ) < 0 )
+		return;
+
+	/* Enter fast recovery and retransmit segment at SND.UNA */
+	tcp->ssthresh = tcp_ssthresh ( tcp );
+	tcp->cwnd = ( tcp->ssthresh + ( TCP_DUPACK_THRESHOLD * TCP_SMSS ) );
+	tcp->recover = ( tcp->snd_seq + tcp->snd_sent );
+	tcp->snd_rxt = tcp->snd_seq;
+	tcp->rxt_pending = 1;
+	tcp->fast_retransmits++;
+	tcp->flags |= TCP_RECOVERY;
+	DBGC ( tcp, "TCP %p fast retransmit at %08x: cwnd %#x ssthresh %#x\n",
+	       tcp, tcp->snd_seq, tcp->cwnd, tcp->ssthresh );
+}
+
+/**
+ * Update congestion window for newly acknowledged data
+ *
+ * @v tcp		TCP connection
+ * @v ack		ACK value (in host-endian order)
+ * @v len		Length of newly acknowledged data
+ */
+static void tcp_rx_cwnd ( struct tcp_connection *tcp, uint32_t ack,
+			  uint32_t len ) {
+	uint32_t flight;
+	uint32_t incr;
+
+	/* Reset duplicate ACK counter */
+	tcp->dupacks = 0;
+
+	/* Handle acknowledgements during fast recovery */
+	if ( tcp->flags & TCP_RECOVERY ) {
+
+		if ( tcp_cmp ( ack, tcp->recover ) >= 0 ) {
+
+			/* Full acknowledgement: exit fast recovery,
+			 * avoiding a burst of transmissions (RFC 6582
+			 * section 3.2 step 3 option 1).
+			 */
+			flight = ( tcp->snd_sent - ( ack - tcp->snd_seq ) );
+			if ( flight < TCP_SMSS )
+				flight = TCP_SMSS;
+			tcp->cwnd = ( flight + TCP_SMSS );
+			if ( tcp->cwnd > tcp->ssthresh )
+				tcp->cwnd = tcp->ssthresh;
+			tcp->flags &= ~TCP_RECOVERY;
+			tcp->rxt_pending = 0;
+			DBGC ( tcp, "TCP %p recovered at %08x: cwnd %#x\n",
+			       tcp, ack, tcp->cwnd );
+
+		} else {
+
+			/* Partial acknowledgement: deflate congestion
+			 * window by the amount of new data acknowledged,
+			 * and retransmit the first unacknowledged segment
+			 * (unless already retransmitted).
+			 */
+			tcp->cwnd = ( ( tcp->cwnd > len ) ?
+				      ( tcp->cwnd - len ) : 0 );
+			if ( ( len >= TCP_SMSS ) || ( tcp->cwnd < TCP_SMSS ) )
+				tcp->cwnd += TCP_SMSS;
+			if ( tcp_cmp ( tcp->snd_rxt, ack ) <= 0 ) {
+				tcp->snd_rxt = ack;
+				tcp->rxt_pending++;
+			}
+		}
+		return;
+	}
+
+	/* Grow congestion window using slow start or congestion
+	 * avoidance, as per RFC 5681.
+	 */
+	if ( tcp->cwnd < tcp->ssthresh ) {
+		incr = ( ( len < TCP_SMSS ) ? len : TCP_SMSS );
+	} else {
+		incr = ( ( TCP_SMSS * TCP_SMSS ) / tcp->cwnd );
+		if ( ! incr )
+			incr = 1;
+	}
+	tcp->cwnd += incr;
+	if ( tcp->cwnd > TCP_MAX_CWND )
+		tcp->cwnd = TCP_MAX_CWND;
+}
+
 /**
  * Handle TCP received ACK
  *
  * @v tcp		TCP connection
  * @v ack		ACK value (in host-endian order)
  * @v win		WIN value (in host-endian order)
+ * @v seq_len		Sequence space length of received packet
+ * @v options		TCP options, or NULL
  * @ret rc		Return status code
  */
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
-			uint32_t win ) {
+			uint32_t win, uint32_t seq_len,
+			struct tcp_options *options ) {
 	uint32_t ack_len = ( ack - tcp->snd_seq );
+	uint32_t old_win = tcp->snd_win;
+	int32_t rtt;
 	size_t len;
 	unsigned int acked_flags;
 
 	/* Check for out-of-range or old duplicate ACKs */
-	if ( ack_len > tcp->snd_sent ) {
+	if ( ack_len > tcp->snd_max ) {
 		DBGC ( tcp, "TCP %p received ACK for %08x..%08x, "
 		       "sent only %08x..%08x\n", tcp, tcp->snd_seq,
 		       ( tcp->snd_seq + ack_len ), tcp->snd_seq,
-		       ( tcp->snd_seq + tcp->snd_sent ) );
+		       ( tcp->snd_seq + tcp->snd_max ) );
 
 		if ( TCP_HAS_BEEN_ESTABLISHED ( tcp->tcp_state ) ) {
 			/* Just ignore what might be old duplicate ACKs */
@@ -1143,17 +2236,44 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 	if ( ! ( tcp->tcp_state & TCP_STATE_SENT ( TCP_FIN ) ) )
 		start_timer_fixed ( &tcp->keepalive, TCP_KEEPALIVE_DELAY );
 
-	/* Ignore ACKs that don't actually acknowledge any new data.
+	/* Record any selective acknowledgements */
+	if ( options && options->sackopt )
+		tcp_rx_sack ( tcp, options->sackopt );
+
+	/* Handle ACKs that don't actually acknowledge any new data.
 	 * (In particular, do not stop the retransmission timer; this
 	 * avoids creating a sorceror's apprentice syndrome when a
 	 * duplicate ACK is received and we still have data in our
-	 * transmit queue.)
+	 * transmit queue.)  Count duplicate ACKs as defined by RFC
+	 * 5681: those carrying no data and no window update, received
+	 * while data is outstanding.
 	 */
-	if ( ack_len == 0 )
+	if ( ack_len == 0 ) {
+		if ( ( seq_len == 0 ) && ( win == old_win ) &&
+		     tcp->snd_sent && TCP_CAN_SEND_DATA ( tcp->tcp_state ) ) {
+			tcp_rx_dupack ( tcp );
+		}
 		return 0;
+	}
 
-	/* Stop the retransmission timer */
-	stop_timer ( &tcp->timer );
+	/* Sample round-trip time, if possible.  Use the echoed
+	 * timestamp if present (as per RFC 7323), otherwise use the
+	 * measurement started when the timed data was first
+	 * transmitted.
+	 */
+	if ( options && options->tsopt ) {
+		rtt = ( ( ( uint32_t ) currticks() ) -
+			ntohl ( options->tsopt->tsecr ) );
+	} else if ( options && ( tcp->flags & TCP_RTT_TIMING ) &&
+		    ( tcp_cmp ( ack, tcp->rtt_seq ) >= 0 ) ) {
+		rtt = ( currticks() - tcp->rtt_start );
+	} else {
+		rtt = -1;
+	}
+	if ( rtt >= 0 )
+		tcp_rtt_update ( tcp, rtt );
+	if ( tcp_cmp ( ack, tcp->rtt_seq ) >= 0 )
+		tcp->flags &= ~TCP_RTT_TIMING;
 
 	/* Determine acknowledged flags and data length */
 	len = ack_len;
@@ -1164,13 +2284,29 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 		pending_put ( &tcp->pending_flags );
 	}
 
+	/* Update congestion window */
+	if ( len )
+		tcp_rx_cwnd ( tcp, ack, len );
+
 	/* Update SEQ and sent counters */
 	tcp->snd_seq = ack;
-	tcp->snd_sent = 0;
+	tcp->snd_sent = ( ( tcp->snd_sent > ack_len ) ?
+			  ( tcp->snd_sent - ack_len ) : 0 );
+	tcp->snd_max -= ack_len;
+	if ( tcp_cmp ( tcp->snd_rxt, ack ) < 0 )
+		tcp->snd_rxt = ack;
+	tcp_scoreboard_trim ( tcp );
 
 	/* Remove any acknowledged data from transmit queue */
-	tcp_process_tx_queue ( tcp, len, NULL, 1 );
-		
+	tcp_trim_tx_queue ( tcp, len );
+
+	/* Restart the retransmission timer if data remains
+	 * outstanding, otherwise stop it (as per RFC 6298).
+	 */
+	stop_timer ( &tcp->timer );
+	if ( tcp->snd_sent )
+		start_timer_fixed ( &tcp->timer, tcp->rto );
+
 	/* Mark SYN/FIN as acknowledged if applicable. */
 	if ( acked_flags )
 		tcp->tcp_state |= TCP_STATE_ACKED ( acked_flags );
@@ -1294,7 +2430,6 @@ static int tcp_rx_rst ( struct tcp_connection *tcp, uint32_t seq ) {
 static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 			     uint8_t flags, struct io_buffer *iobuf ) {
 	struct tcp_rx_queued_header *tcpqhdr;
-	struct io_buffer *queued;
 	size_t len;
 	uint32_t seq_len;
 	uint32_t nxt;
@@ -1329,12 +2464,7 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 	tcpqhdr->flags = flags;
 
 	/* Add to RX queue */
-	list_for_each_entry ( queued, &tcp->rx_queue, list ) {
-		tcpqhdr = queued->data;
-		if ( tcp_cmp ( seq, tcpqhdr->seq ) < 0 )
-			break;
-	}
-	list_add_tail ( &iobuf->list, &queued->list );
+	tcp_rx_queue_insert ( &tcp->rx_queue, iobuf );
 }
 
 /**
@@ -1349,21 +2479,16 @@ static void tcp_process_rx_queue ( struct tcp_connection *tcp ) {
 	unsigned int flags;
 	size_t len;
 
-	/* Process all applicable received buffers.  Note that we
-	 * cannot use list_for_each_entry() to iterate over the RX
-	 * queue, since tcp_discard() may remove packets from the RX
+	/* Process all applicable received buffers, stopping when we
+	 * hit the first gap.  Note that we must dequeue each buffer
+	 * afresh, since tcp_discard() may remove packets from the RX
 	 * queue while we are processing.
 	 */
-	while ( ( iobuf = list_first_entry ( &tcp->rx_queue, struct io_buffer,
-					     list ) ) ) {
+	while ( ( iobuf = tcp_rx_queue_dequeue ( &tcp->rx_queue,
+						 tcp->rcv_ack ) ) ) {
 
-		/* Stop processing when we hit the first gap */
+		/* Strip internal header */
 		tcpqhdr = iobuf->data;
-		if ( tcp_cmp ( tcpqhdr->seq, tcp->rcv_ack ) > 0 )
-			break;
-
-		/* Strip internal header and remove from RX queue */
-		list_del ( &iobuf->list );
 		seq = tcpqhdr->seq;
 		flags = tcpqhdr->flags;
 		iob_pull ( iobuf, sizeof ( *tcpqhdr ) );
@@ -1381,6 +2506,46 @@ static void tcp_process_rx_queue ( struct tcp_connection *tcp ) {
 	}
 }
 
+/**
+ * Schedule acknowledgement of received packet
+ *
+ * @v tcp		TCP connection
+ * @v flags		TCP flags
+ * @v segments		Number of received data segments
+ * @v in_order		Packet was received in order
+ *
+ * In-order data on an established connection is acknowledged after
+ * every second segment or after the delayed acknowledgement timeout,
+ * whichever comes first.  Anything else (including data that fills a
+ * gap in the receive queue, data carrying PSH, and any packet that
+ * allows the receive window to be substantially reopened) is
+ * acknowledged immediately.
+ */
+static void tcp_rx_delack ( struct tcp_connection *tcp, unsigned int flags,
+			    unsigned int segments, int in_order ) {
+
+	/* Do nothing unless an acknowledgement is pending */
+	if ( ! ( tcp->flags & TCP_ACK_PENDING ) )
+		return;
+
+	/* Count unacknowledged data segments */
+	tcp->rcv_unacked += segments;
+
+	/* Delay acknowledgement if applicable, otherwise ensure that
+	 * the acknowledgement is not held back.
+	 */
+	if ( tcp->delack_timeout && in_order && segments &&
+	     ( tcp->tcp_state == TCP_ESTABLISHED ) &&
+	     ( ! ( flags & TCP_PSH ) ) &&
+	     ( tcp->rcv_unacked < TCP_DELACK_SEGMENTS ) &&
+	     ( tcp->rcv_win >= ( tcp_max_rcv_win ( tcp ) / 2 ) ) ) {
+		if ( ! timer_running ( &tcp->delack ) )
+			start_timer_fixed ( &tcp->delack, tcp->delack_timeout );
+	} else {
+		stop_timer ( &tcp->delack );
+	}
+}
+
 /**
  * Process received packet
  *
@@ -1399,6 +2564,12 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	struct tcp_header *tcphdr = iobuf->data;
 	struct tcp_connection *tcp;
 	struct tcp_options options;
+	struct io_buffer *frag;
+	struct io_buffer *tmp;
+	LIST_HEAD ( chain );
+	unsigned int segments;
+	uint32_t frag_seq;
+	size_t frag_len;
 	size_t hlen;
 	uint16_t csum;
 	uint32_t seq;
@@ -1409,6 +2580,8 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	size_t len;
 	uint32_t seq_len;
 	size_t old_xfer_window;
+	int old_established;
+	int in_order;
 	int rc;
 
 	/* Start profiling */
@@ -1434,13 +2607,15 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto discard;
 	}
-	csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
-				       iob_len ( iobuf ) );
-	if ( csum != 0 ) {
-		DBG ( "TCP checksum incorrect (is %04x including checksum "
-		      "field, should be 0000)\n", csum );
-		rc = -EINVAL;
-		goto discard;
+	if ( ! ( iobuf->flags & IOB_CSUM_VERIFIED ) ) {
+		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
+					       iob_len ( iobuf ) );
+		if ( csum != 0 ) {
+			DBG ( "TCP checksum incorrect (is %04x including "
+			      "checksum field, should be 0000)\n", csum );
+			rc = -EINVAL;
+			goto discard;
+		}
 	}
 	
 	/* Parse parameters from header and strip header */
@@ -1455,6 +2630,14 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		tcp->ts_val = ntohl ( options.tsopt->tsval );
 	iob_pull ( iobuf, hlen );
 	len = iob_len ( iobuf );
+
+	/* Detach any segments coalesced by the network device layer */
+	list_splice_init ( &iobuf->chain, &chain );
+	segments = ( len ? 1 : 0 );
+	list_for_each_entry ( frag, &chain, list ) {
+		len += iob_len ( frag );
+		segments++;
+	}
 	seq_len = ( len + ( ( flags & TCP_SYN ) ? 1 : 0 ) +
 		    ( ( flags & TCP_FIN ) ? 1 : 0 ) );
 
@@ -1465,6 +2648,7 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		( ntohl ( tcphdr->seq ) + seq_len ), len );
 	tcp_dump_flags ( tcp, tcphdr->flags );
 	DBGC2 ( tcp, "\n" );
+	trace ( TRACE_TCP_RX, seq, ack, len );
 
 	/* If no connection was found, silently drop packet */
 	if ( ! tcp ) {
@@ -1472,13 +2656,17 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		goto discard;
 	}
 
-	/* Record old data-transfer window */
+	/* Record old data-transfer window and establishment status */
 	old_xfer_window = tcp_xfer_window ( tcp );
+	old_established = TCP_HAS_BEEN_ESTABLISHED ( tcp->tcp_state );
 
 	/* Handle ACK, if present */
 	if ( flags & TCP_ACK ) {
+		if ( flags & TCP_SYN )
+			tcp_rx_fastopen ( tcp, ack, &options );
 		win = ( raw_win << tcp->snd_win_scale );
-		if ( ( rc = tcp_rx_ack ( tcp, ack, win ) ) != 0 ) {
+		if ( ( rc = tcp_rx_ack ( tcp, ack, win, seq_len,
+					 &options ) ) != 0 ) {
 			tcp_xmit_reset ( tcp, st_src, tcphdr );
 			goto discard;
 		}
@@ -1502,8 +2690,19 @@ static int tcp_rx ( struct io_buffer *iobuf,
 			goto discard;
 	}
 
-	/* Enqueue received data */
+	/* Check whether or not data can be processed immediately */
+	in_order = ( ( seq == tcp->rcv_ack ) &&
+		     tcp_rx_queue_empty ( &tcp->rx_queue ) );
+
+	/* Enqueue received data, including any coalesced segments */
+	frag_seq = ( seq + iob_len ( iobuf ) );
 	tcp_rx_enqueue ( tcp, seq, flags, iob_disown ( iobuf ) );
+	list_for_each_entry_safe ( frag, tmp, &chain, list ) {
+		list_del ( &frag->list );
+		frag_len = iob_len ( frag );
+		tcp_rx_enqueue ( tcp, frag_seq, flags, frag );
+		frag_seq += frag_len;
+	}
 
 	/* Process receive queue */
 	tcp_process_rx_queue ( tcp );
@@ -1515,10 +2714,13 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	 * have received any out-of-order packets (i.e. if the receive
 	 * queue remains non-empty after processing) then send the ACK
 	 * immediately in order to trigger Fast Retransmission.
+	 * Otherwise, the ACK may be delayed.
 	 */
-	if ( list_empty ( &tcp->rx_queue ) ) {
+	if ( tcp_rx_queue_empty ( &tcp->rx_queue ) ) {
+		tcp_rx_delack ( tcp, flags, segments, in_order );
 		process_add ( &tcp->process );
 	} else {
+		stop_timer ( &tcp->delack );
 		tcp_xmit_sack ( tcp, seq );
 	}
 
@@ -1530,19 +2732,69 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		start_timer_fixed ( &tcp->wait, ( 2 * TCP_MSL ) );
 	}
 
-	/* Notify application if window has changed */
-	if ( tcp_xfer_window ( tcp ) != old_xfer_window )
+	/* Notify application if window or establishment status has
+	 * changed
+	 */
+	if ( ( tcp_xfer_window ( tcp ) != old_xfer_window ) ||
+	     ( TCP_HAS_BEEN_ESTABLISHED ( tcp->tcp_state ) !=
+	       old_established ) ) {
 		xfer_window_changed ( &tcp->xfer );
+	}
 
 	profile_stop ( &tcp_rx_profiler );
 	return 0;
 
  discard:
-	/* Free received packet */
+	/* Free received packet and any coalesced segments */
+	list_for_each_entry_safe ( frag, tmp, &chain, list ) {
+		list_del ( &frag->list );
+		free_iob ( frag );
+	}
 	free_iob ( iobuf );
 	return rc;
 }
 
+/**
+ * Get TCP connection information
+ *
+ * @v index		Connection index
+ * @v info		Connection information to fill in
+ * @ret rc		Return status code
+ */
+int tcp_connection_info ( unsigned int index, struct tcp_info *info ) {
+	struct tcp_connection *tcp;
+
+	/* Find connection */
+	list_for_each_entry ( tcp, &tcp_conns, list ) {
+		if ( index-- )
+			continue;
+
+		/* Fill in information */
+		memset ( info, 0, sizeof ( *info ) );
+		info->local_port = tcp->local_port;
+		memcpy ( &info->peer, &tcp->peer, sizeof ( info->peer ) );
+		info->tcp_state = tcp->tcp_state;
+		info->srtt = ( tcp->srtt >> 3 );
+		info->rttvar = ( tcp->rttvar >> 2 );
+		info->rto = tcp->rto;
+		info->rtt = tcp->rtt;
+		info->rtt_min = tcp->rtt_min;
+		info->rtt_samples = tcp->rtt_samples;
+		info->timeouts = tcp->timeouts;
+		info->cwnd = tcp->cwnd;
+		info->ssthresh = tcp->ssthresh;
+		info->snd_win = tcp->snd_win;
+		info->fast_retransmits = tcp->fast_retransmits;
+		info->retransmits = tcp->retransmits;
+		info->fastopen = tcp->fastopen_acked;
+		info->rcv_win = tcp->rcv_win;
+		info->rcv_win_max = tcp->rcv_win_max;
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
 /** TCP protocol */
 struct tcpip_protocol tcp_protocol __tcpip_protocol = {
 	.name = "TCP",
@@ -1557,20 +2809,32 @@ struct tcpip_protocol tcp_protocol __tcpip_protocol = {
  */
 static unsigned int tcp_discard ( void ) {
 	struct tcp_connection *tcp;
-	struct io_buffer *iobuf;
 	unsigned int discarded = 0;
 
-	/* Try to drop one queued RX packet from each connection */
+	/* Try to drop one queued RX packet from each connection, and
+	 * reduce the maximum receive window to limit the amount of
+	 * data that the peer may send.  A reduced window is held for
+	 * TCP_WINDOW_HOLD, so that it is neither grown straight back
+	 * by tuning nor collapsed by repeated discards within a
+	 * single allocation.  Each reduction is reported as progress,
+	 * since it limits the memory that the connection will consume.
+	 */
 	list_for_each_entry ( tcp, &tcp_conns, list ) {
-		list_for_each_entry_reverse ( iobuf, &tcp->rx_queue, list ) {
-
-			/* Remove packet from queue */
-			list_del ( &iobuf->list );
-			free_iob ( iobuf );
-
-			/* Report discard */
+		discarded += tcp_rx_queue_discard ( &tcp->rx_queue );
+		if ( tcp->rcv_win_held &&
+		     ( ( currticks() - tcp->rcv_win_shrunk ) <
+		       TCP_WINDOW_HOLD ) ) {
+			continue;
+		}
+		if ( tcp->rcv_win_max > TCP_MIN_WINDOW_SIZE ) {
+			tcp->rcv_win_max /= 2;
+			if ( tcp->rcv_win_max < TCP_MIN_WINDOW_SIZE )
+				tcp->rcv_win_max = TCP_MIN_WINDOW_SIZE;
+			tcp->rcv_win_shrunk = currticks();
+			tcp->rcv_win_held = 1;
+			DBGC ( tcp, "TCP %p maximum window shrunk to %#x\n",
+			       tcp, tcp->rcv_win_max );
 			discarded++;
-			break;
 		}
 	}
 
@@ -1693,6 +2957,7 @@ static int tcp_xfer_deliver ( struct tcp_connection *tcp,
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &tcp->tx_queue );
+	tcp->tx_len += iob_len ( iobuf );
 
 	/* Each enqueued packet is a pending operation */
 	pending_get ( &tcp->pending_data );
@@ -1703,10 +2968,23 @@ static int tcp_xfer_deliver ( struct tcp_connection *tcp,
 	return 0;
 }
 
+/**
+ * Check if TCP connection is established
+ *
+ * @v tcp		TCP connection
+ * @ret established	Connection is established
+ */
+static int tcp_xfer_established ( struct tcp_connection *tcp ) {
+
+	return TCP_HAS_BEEN_ESTABLISHED ( tcp->tcp_state );
+}
+
 /** TCP data transfer interface operations */
 static struct interface_operation tcp_xfer_operations[] = {
 	INTF_OP ( xfer_deliver, struct tcp_connection *, tcp_xfer_deliver ),
 	INTF_OP ( xfer_window, struct tcp_connection *, tcp_xfer_window ),
+	INTF_OP ( xfer_established, struct tcp_connection *,
+		  tcp_xfer_established ),
 	INTF_OP ( intf_close, struct tcp_connection *, tcp_xfer_close ),
 };
 
@@ -54,6 +54,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/version.h>
 #include <ipxe/params.h>
 #include <ipxe/profile.h>
+#include <ipxe/trace.h>
 #include <ipxe/vsprintf.h>
 #include <ipxe/http.h>
 
@@ -1558,6 +1559,7 @@ static int http_rx_transfer_identity ( struct http_transaction *http,
 	int rc;
 
 	/* Update lengths */
+	trace ( TRACE_HTTP_RX, 0, http->len, len );
 	http->len += len;
 
 	/* Fail if this transfer would overrun the expected content
@@ -1706,6 +1708,7 @@ static int http_rx_chunk_len ( struct http_transaction *http,
 static int http_rx_chunk_data ( struct http_transaction *http,
 				struct io_buffer **iobuf ) {
 	struct io_buffer *payload;
+	struct io_buffer *tmp;
 	uint8_t *crlf;
 	size_t len;
 	int rc;
@@ -1721,6 +1724,7 @@ static int http_rx_chunk_data ( struct http_transaction *http,
 			iob_unput ( (*iobuf), 2 /* CRLF */ );
 	}
 	len = iob_len ( *iobuf );
+	trace ( TRACE_HTTP_RX, 1, http->len, len );
 
 	/* Use whole/partial buffer as applicable */
 	if ( len <= http->remaining ) {
@@ -1732,10 +1736,31 @@ static int http_rx_chunk_data ( struct http_transaction *http,
 		http->len += len;
 		http->remaining -= len;
 
+	} else if ( ( len - http->remaining ) < http->remaining ) {
+
+		/* Most of buffer is to be consumed: copy the trailing
+		 * data to a new I/O buffer, and use the original I/O
+		 * buffer (truncated) as payload.
+		 */
+		payload = alloc_iob ( len - http->remaining );
+		if ( ! payload ) {
+			rc = -ENOMEM;
+			goto err;
+		}
+		memcpy ( iob_put ( payload, ( len - http->remaining ) ),
+			 ( (*iobuf)->data + http->remaining ),
+			 ( len - http->remaining ) );
+		iob_unput ( *iobuf, ( len - http->remaining ) );
+		tmp = *iobuf;
+		*iobuf = payload;
+		payload = tmp;
+		http->len += http->remaining;
+		http->remaining = 0;
+
 	} else {
 
-		/* Partial buffer is to be consumed: copy data to a
-		 * temporary I/O buffer.
+		/* Small part of buffer is to be consumed: copy data
+		 * to a temporary I/O buffer.
 		 */
 		payload = alloc_iob ( http->remaining );
 		if ( ! payload ) {
@@ -1698,6 +1698,21 @@ static int iscsi_socket_deliver ( struct iscsi_session *iscsi,
 	return rc;
 }
 
+/**
+ * Record target socket address
+ *
+ * @v iscsi		iSCSI session
+ * @v peer		Peer socket address
+ *
+ * The target socket address is recorded for the iBFT.
+ */
+static void iscsi_connected ( struct iscsi_session *iscsi,
+			      struct sockaddr *peer ) {
+
+	memcpy ( &iscsi->target_sockaddr, peer,
+		 sizeof ( iscsi->target_sockaddr ) );
+}
+
 /**
  * Handle redirection event
  *
@@ -1721,8 +1736,7 @@ static int iscsi_vredirect ( struct iscsi_session *iscsi, int type,
 		va_copy ( tmp, args );
 		( void ) va_arg ( tmp, int ); /* Discard "semantics" */
 		peer = va_arg ( tmp, struct sockaddr * );
-		memcpy ( &iscsi->target_sockaddr, peer,
-			 sizeof ( iscsi->target_sockaddr ) );
+		iscsi_connected ( iscsi, peer );
 		va_end ( tmp );
 	}
 
@@ -1743,6 +1757,7 @@ static struct interface_operation iscsi_socket_operations[] = {
 	INTF_OP ( xfer_window_changed, struct iscsi_session *,
 		  iscsi_tx_resume ),
 	INTF_OP ( xfer_vredirect, struct iscsi_session *, iscsi_vredirect ),
+	INTF_OP ( xfer_connected, struct iscsi_session *, iscsi_connected ),
 	INTF_OP ( intf_close, struct iscsi_session *, iscsi_close ),
 };
 
@@ -7,6 +7,7 @@
 #include <ipxe/tables.h>
 #include <ipxe/ipstat.h>
 #include <ipxe/netdevice.h>
+#include <ipxe/neighbour.h>
 #include <ipxe/tcpip.h>
 
 /** @file
@@ -19,6 +20,14 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+/** Current route generation
+ *
+ * This is incremented whenever a change occurs that may invalidate
+ * a cached transmit route.  Cached routes initialised to zero are
+ * never valid.
+ */
+unsigned long tcpip_route_generation = 1;
+
 /**
  * Process a received TCP/IP packet
  *
@@ -85,12 +94,18 @@ struct tcpip_net_protocol * tcpip_net_protocol ( sa_family_t sa_family ) {
  * @v st_src		Source address, or NULL to use route default
  * @v st_dest		Destination address
  * @v netdev		Network device to use if no route found, or NULL
+ * @v route		Cached transmit route, or NULL
  * @v trans_csum	Transport-layer checksum to complete, or NULL
  * @ret rc		Return status code
+ *
+ * A cached transmit route may be provided only if the destination
+ * (and source, if specified) addresses will remain constant for all
+ * packets transmitted using that cached route.
  */
 int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip_protocol,
 	       struct sockaddr_tcpip *st_src, struct sockaddr_tcpip *st_dest,
-	       struct net_device *netdev, uint16_t *trans_csum ) {
+	       struct net_device *netdev, struct tcpip_route *route,
+	       uint16_t *trans_csum ) {
 	struct tcpip_net_protocol *tcpip_net;
 
 	/* Hand off packet to the appropriate network-layer protocol */
@@ -98,13 +113,121 @@ int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip_protocol,
 	if ( tcpip_net ) {
 		DBG ( "TCP/IP sending %s packet\n", tcpip_net->name );
 		return tcpip_net->tx ( iobuf, tcpip_protocol, st_src, st_dest,
-				       netdev, trans_csum );
+				       netdev, route, trans_csum );
 	}
 
 	free_iob ( iobuf );
 	return -EAFNOSUPPORT;
 }
 
+/**
+ * Update cached transmit route
+ *
+ * @v route		Cached transmit route
+ * @v netdev		Transmitting network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @v next_hop		Next hop network-layer address
+ * @v net_source	Source network-layer address
+ *
+ * The route will be cached only if the link-layer address of the
+ * next hop is already known.
+ */
+void tcpip_route_update ( struct tcpip_route *route,
+			  struct net_device *netdev,
+			  struct net_protocol *net_protocol,
+			  const void *net_dest, const void *next_hop,
+			  const void *net_source ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct io_buffer iobuf;
+	const void *ll_dest;
+	size_t len;
+
+	/* Invalidate any existing cached route */
+	route->generation = 0;
+
+	/* Do nothing unless next hop link-layer address is known */
+	ll_dest = neighbour_ll_dest ( netdev, net_protocol, next_hop );
+	if ( ! ll_dest )
+		return;
+
+	/* Record route */
+	memcpy ( route->net_dest, net_dest, net_protocol->net_addr_len );
+	memcpy ( route->net_source, net_source, net_protocol->net_addr_len );
+	route->netdev = netdev;
+	memcpy ( route->ll_dest, ll_dest, ll_protocol->ll_addr_len );
+
+	/* Precompute link-layer header, if possible */
+	route->ll_header_len = 0;
+	if ( ll_protocol->flags & LL_STATIC_HEADER ) {
+		iob_populate ( &iobuf, route->ll_header, 0,
+			       sizeof ( route->ll_header ) );
+		iob_reserve ( &iobuf, sizeof ( route->ll_header ) );
+		if ( ll_protocol->push ( netdev, &iobuf, route->ll_dest,
+					 netdev->ll_addr,
+					 net_protocol->net_proto ) == 0 ) {
+			len = iob_len ( &iobuf );
+			memmove ( route->ll_header, iobuf.data, len );
+			route->ll_header_len = len;
+		}
+	}
+
+	/* Mark route as valid */
+	route->generation = tcpip_route_generation;
+	DBGC ( route, "TCP/IP %p cached %s route to %s via %s\n", route,
+	       net_protocol->name, net_protocol->ntoa ( net_dest ),
+	       netdev->name );
+}
+
+/**
+ * Transmit network-layer packet via cached transmit route
+ *
+ * @v iobuf		I/O buffer
+ * @v route		Cached transmit route
+ * @v net_protocol	Network-layer protocol
+ * @ret rc		Return status code
+ *
+ * This function takes ownership of the I/O buffer.
+ */
+int tcpip_route_tx ( struct io_buffer *iobuf, struct tcpip_route *route,
+		     struct net_protocol *net_protocol ) {
+	struct net_device *netdev = route->netdev;
+	uint8_t *ll_header;
+	unsigned int i;
+
+	/* Use precomputed link-layer header, if available.  The
+	 * header is short enough that a simple loop is faster than a
+	 * general-purpose memcpy().
+	 */
+	if ( route->ll_header_len ) {
+		ll_header = iob_push ( iobuf, route->ll_header_len );
+		for ( i = 0 ; i < route->ll_header_len ; i++ )
+			ll_header[i] = route->ll_header[i];
+		return netdev_tx ( netdev, iobuf );
+	}
+
+	/* Otherwise, construct link-layer header */
+	return net_tx ( iobuf, netdev, net_protocol, route->ll_dest,
+			netdev->ll_addr );
+}
+
+/**
+ * Invalidate cached transmit routes on network device state change
+ *
+ * @v netdev		Network device
+ */
+static void tcpip_route_flush ( struct net_device *netdev __unused ) {
+
+	tcpip_route_changed();
+}
+
+/** Cached transmit route driver (for net device notifications) */
+struct net_driver tcpip_route_net_driver __net_driver = {
+	.name = "Route cache",
+	.notify = tcpip_route_flush,
+	.remove = tcpip_route_flush,
+};
+
 /**
  * Determine transmitting network device
  *
@@ -143,13 +266,39 @@ size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest ) {
 	if ( ! netdev )
 		return 0;
 
+	/* Fail if link MTU leaves no room for any payload */
+	if ( netdev->mtu <= tcpip_net->header_len )
+		return 0;
+
 	/* Calculate MTU */
-	mtu = ( netdev->max_pkt_len - netdev->ll_protocol->ll_header_len -
-		tcpip_net->header_len );
+	mtu = ( netdev->mtu - tcpip_net->header_len );
 
 	return mtu;
 }
 
+/** Block length used when copying and checksumming data
+ *
+ * This must be even, so that each block starts on an even offset
+ * within the checksummed data.
+ */
+#define TCPIP_COPY_BLOCK_LEN 4096
+
+/**
+ * Fold wide checksum accumulator to 16 bits
+ *
+ * @v sum		Wide checksum accumulator
+ * @ret sum		Folded checksum (not inverted)
+ */
+static inline unsigned int tcpip_fold ( uint64_t sum ) {
+
+	sum = ( ( sum & 0xffffffffUL ) + ( sum >> 32 ) );
+	sum = ( ( sum & 0xffffffffUL ) + ( sum >> 32 ) );
+	sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+	sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+	sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+	return sum;
+}
+
 /**
  * Calculate continued TCP/IP checkum
  *
@@ -170,25 +319,100 @@ size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest ) {
  */
 uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
 					 const void *data, size_t len ) {
-	unsigned int cksum = ( ( ~partial ) & 0xffff );
-	unsigned int value;
-	unsigned int i;
-	
-	for ( i = 0 ; i < len ; i++ ) {
-		value = * ( ( uint8_t * ) data + i );
-		if ( i & 1 ) {
-			/* Odd bytes: swap on little-endian systems */
-			value = be16_to_cpu ( value );
-		} else {
-			/* Even bytes: swap on big-endian systems */
-			value = le16_to_cpu ( value );
-		}
-		cksum += value;
-		if ( cksum > 0xffff )
-			cksum -= 0xffff;
+	const uint8_t *bytes = data;
+	const uint32_t *words;
+	uint64_t sum = 0;
+	unsigned int odd;
+	unsigned int folded;
+	size_t count;
+
+	/* Sum leading byte, if needed to reach 16-bit alignment.
+	 * Data starting on an odd address is summed as though it were
+	 * rotated by one byte, and the result is byte-swapped
+	 * accordingly.
+	 */
+	odd = ( ( ( intptr_t ) bytes ) & 1 );
+	if ( odd && len ) {
+		sum += le16_to_cpu ( *(bytes++) << 8 );
+		len--;
+	}
+
+	/* Sum leading 16-bit word, if needed to reach 32-bit alignment */
+	if ( ( ( ( intptr_t ) bytes ) & 2 ) && ( len >= 2 ) ) {
+		sum += *( ( const uint16_t * ) bytes );
+		bytes += 2;
+		len -= 2;
+	}
+
+	/* Sum aligned 32-bit words into a 64-bit accumulator, so that
+	 * carries need to be folded back in only once at the end.
+	 */
+	words = ( ( const uint32_t * ) bytes );
+	count = ( len / sizeof ( *words ) );
+	bytes += ( count * sizeof ( *words ) );
+	len -= ( count * sizeof ( *words ) );
+	for ( ; count >= 4 ; count -= 4, words += 4 ) {
+		sum += words[0];
+		sum += words[1];
+		sum += words[2];
+		sum += words[3];
+	}
+	while ( count-- )
+		sum += *(words++);
+
+	/* Sum trailing 16-bit word, if present */
+	if ( len >= 2 ) {
+		sum += *( ( const uint16_t * ) bytes );
+		bytes += 2;
+		len -= 2;
 	}
-	
-	return ( ~cksum );
+
+	/* Sum trailing byte, if present */
+	if ( len )
+		sum += le16_to_cpu ( *bytes );
+
+	/* Fold, undo rotation, and add in existing checksum */
+	folded = tcpip_fold ( sum );
+	if ( odd )
+		folded = bswap_16 ( folded );
+	folded = tcpip_fold ( folded + ( ( ~partial ) & 0xffff ) );
+
+	return ( ~folded );
+}
+
+/**
+ * Copy data and calculate continued TCP/IP checksum
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v dest		Destination buffer
+ * @v src		Source buffer
+ * @v len		Length of data
+ * @ret cksum		Updated checksum, in network byte order
+ *
+ * This is equivalent to a memcpy() followed by tcpip_continue_chksum(),
+ * but requires only a single pass over the data in memory: the data
+ * is copied in blocks small enough to remain within the L1 cache, and
+ * each block is checksummed immediately after being copied.
+ */
+uint16_t tcpip_copy_chksum ( uint16_t partial, void *dest, const void *src,
+			     size_t len ) {
+	size_t offset;
+	size_t frag_len;
+
+	for ( offset = 0 ; offset < len ; offset += frag_len ) {
+
+		/* Copy block */
+		frag_len = ( len - offset );
+		if ( frag_len > TCPIP_COPY_BLOCK_LEN )
+			frag_len = TCPIP_COPY_BLOCK_LEN;
+		memcpy ( ( dest + offset ), ( src + offset ), frag_len );
+
+		/* Checksum block while still hot in the cache */
+		partial = tcpip_continue_chksum ( partial, ( dest + offset ),
+						  frag_len );
+	}
+
+	return partial;
 }
 
 /**
@@ -205,6 +429,57 @@ uint16_t tcpip_chksum ( const void *data, size_t len ) {
 	return tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, len );
 }
 
+/**
+ * Prepare deferred transport-layer checksum for transmission
+ *
+ * @v iobuf		I/O buffer
+ * @v netdev		Transmitting network device
+ * @v trans_csum	Transport-layer checksum to complete
+ * @v offload		Checksum may be completed by network device
+ * @ret offloaded	Checksum will be completed by network device
+ *
+ * If the transport-layer checksum has been deferred and the network
+ * device is able to insert transmit checksums, then the caller must
+ * fill in only the pseudo-header checksum.  Otherwise, any deferred
+ * checksum is calculated here and the caller must complete it using
+ * the pseudo-header checksum as normal.
+ */
+int tcpip_tx_csum ( struct io_buffer *iobuf, struct net_device *netdev,
+		    uint16_t *trans_csum, int offload ) {
+	void *start;
+
+	/* Do nothing unless checksum has been deferred */
+	if ( ! ( iobuf->flags & IOB_CSUM_PARTIAL ) )
+		return 0;
+
+	/* Leave checksum to network device, if possible */
+	if ( offload && netdev_tx_csum ( netdev ) )
+		return 1;
+
+	/* Otherwise, calculate deferred checksum now */
+	start = iob_csum_start ( iobuf );
+	*trans_csum = tcpip_chksum ( start, ( iobuf->tail - start ) );
+	iobuf->flags &= ~IOB_CSUM_PARTIAL;
+	return 0;
+}
+
+/**
+ * Complete transport-layer checksum in software
+ *
+ * @v iobuf		I/O buffer
+ *
+ * This function may be used by a network device driver that
+ * advertises NETDEV_TX_CSUM but is unable to insert the checksum for
+ * a particular I/O buffer.
+ */
+void tcpip_csum_complete ( struct io_buffer *iobuf ) {
+	void *start = iob_csum_start ( iobuf );
+	uint16_t *csum = ( start + iobuf->csum_offset );
+
+	*csum = tcpip_chksum ( start, ( iobuf->tail - start ) );
+	iobuf->flags &= ~IOB_CSUM_PARTIAL;
+}
+
 /**
  * Bind to local TCP/IP port
  *
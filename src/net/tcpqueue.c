@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/tcp.h>
+#include <ipxe/tcpqueue.h>
+
+/** @file
+ *
+ * TCP out-of-order receive queue
+ *
+ * Received packets that cannot yet be processed are held in a list of
+ * contiguous blocks, each of which is merged with its neighbours as
+ * the gaps between them are filled.  The cost of enqueueing a packet
+ * therefore depends upon the number of gaps rather than the number of
+ * queued packets, and the common cases (extending the final block, or
+ * filling the first gap) are handled in constant time.  Since each
+ * block is a maximal range of received data, the blocks may be used
+ * directly as selective acknowledgement blocks.
+ */
+
+/**
+ * Find last block not starting after a given sequence number
+ *
+ * @v queue		Receive queue
+ * @v seq		SEQ value (in host-endian order)
+ * @ret block		Block, or NULL
+ */
+static struct tcp_rx_block * tcp_rx_queue_find ( struct tcp_rx_queue *queue,
+						 uint32_t seq ) {
+	struct tcp_rx_block *block;
+
+	/* Packets are most likely to arrive at or near the end of the
+	 * queue, so search backwards.
+	 */
+	list_for_each_entry_reverse ( block, &queue->blocks, list ) {
+		if ( tcp_cmp ( block->left, seq ) <= 0 )
+			return block;
+	}
+	return NULL;
+}
+
+/**
+ * Insert packet into receive queue
+ *
+ * @v queue		Receive queue
+ * @v iobuf		I/O buffer (starting with internal header)
+ *
+ * This function takes ownership of the I/O buffer.  Packets that
+ * contain no data beyond that already queued will be discarded.
+ */
+void tcp_rx_queue_insert ( struct tcp_rx_queue *queue,
+			   struct io_buffer *iobuf ) {
+	struct tcp_rx_queued_header *tcpqhdr = iobuf->data;
+	uint32_t seq = tcpqhdr->seq;
+	uint32_t nxt = tcpqhdr->nxt;
+	struct tcp_rx_block *block;
+	struct tcp_rx_block *new;
+	struct tcp_rx_block *next;
+
+	/* Find block that this packet may extend */
+	block = tcp_rx_queue_find ( queue, seq );
+
+	if ( block && ( tcp_cmp ( seq, block->right ) <= 0 ) ) {
+
+		/* Discard packets containing no new data */
+		if ( tcp_cmp ( nxt, block->right ) <= 0 ) {
+			free_iob ( iobuf );
+			return;
+		}
+
+		/* Extend existing block */
+		block->right = nxt;
+
+	} else {
+
+		/* Allocate new block.  This may cause cached packets
+		 * to be discarded from the queue (which can only
+		 * shrink blocks), so find the preceding block again
+		 * after allocation.
+		 */
+		new = malloc ( sizeof ( *new ) );
+		if ( ! new ) {
+			free_iob ( iobuf );
+			return;
+		}
+		INIT_LIST_HEAD ( &new->packets );
+		new->left = seq;
+		new->right = nxt;
+		block = tcp_rx_queue_find ( queue, seq );
+		list_add ( &new->list, ( block ? &block->list : &queue->blocks ));
+		block = new;
+	}
+
+	/* Add packet to block */
+	list_add_tail ( &iobuf->list, &block->packets );
+	queue->count++;
+
+	/* Merge any following blocks that are now contiguous */
+	while ( ! list_is_last ( &block->list, &queue->blocks ) ) {
+		next = list_entry ( block->list.next, struct tcp_rx_block,
+				    list );
+		if ( tcp_cmp ( next->left, block->right ) > 0 )
+			break;
+		if ( tcp_cmp ( next->right, block->right ) > 0 )
+			block->right = next->right;
+		list_splice_tail_init ( &next->packets, &block->packets );
+		list_del ( &next->list );
+		free ( next );
+	}
+}
+
+/**
+ * Dequeue next packet from receive queue
+ *
+ * @v queue		Receive queue
+ * @v ack		Current acknowledgement number (in host-endian order)
+ * @ret iobuf		I/O buffer (starting with internal header), or NULL
+ *
+ * Only a packet that starts no later than the current acknowledgement
+ * number will be returned.
+ */
+struct io_buffer * tcp_rx_queue_dequeue ( struct tcp_rx_queue *queue,
+					  uint32_t ack ) {
+	struct tcp_rx_queued_header *tcpqhdr;
+	struct tcp_rx_block *block;
+	struct io_buffer *iobuf;
+
+	/* Get first packet in first block, if any */
+	block = list_first_entry ( &queue->blocks, struct tcp_rx_block, list );
+	if ( ! block )
+		return NULL;
+	iobuf = list_first_entry ( &block->packets, struct io_buffer, list );
+	assert ( iobuf != NULL );
+
+	/* Stop when we hit the first gap */
+	tcpqhdr = iobuf->data;
+	if ( tcp_cmp ( tcpqhdr->seq, ack ) > 0 )
+		return NULL;
+
+	/* Remove from queue, freeing block if now empty */
+	list_del ( &iobuf->list );
+	queue->count--;
+	if ( list_empty ( &block->packets ) ) {
+		list_del ( &block->list );
+		free ( block );
+	} else if ( tcp_cmp ( tcpqhdr->nxt, block->left ) > 0 ) {
+		block->left = tcpqhdr->nxt;
+	}
+
+	return iobuf;
+}
+
+/**
+ * Find selective acknowledgement block
+ *
+ * @v queue		Receive queue
+ * @v seq		SEQ value in SACK block (in host-endian order)
+ * @v sack		SACK block to fill in (in host-endian order)
+ * @ret len		Length of SACK block
+ */
+uint32_t tcp_rx_queue_sack ( struct tcp_rx_queue *queue, uint32_t seq,
+			     struct tcp_sack_block *sack ) {
+	struct tcp_rx_block *block;
+
+	/* Find block containing SEQ */
+	list_for_each_entry ( block, &queue->blocks, list ) {
+		if ( tcp_cmp ( block->left, seq ) > 0 )
+			break;
+		if ( tcp_cmp ( block->right, seq ) >= 0 ) {
+			sack->left = block->left;
+			sack->right = block->right;
+			return ( block->right - block->left );
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Discard most recently queued packet from receive queue
+ *
+ * @v queue		Receive queue
+ * @ret discarded	Number of packets discarded
+ */
+unsigned int tcp_rx_queue_discard ( struct tcp_rx_queue *queue ) {
+	struct tcp_rx_queued_header *tcpqhdr;
+	struct tcp_rx_block *block;
+	struct io_buffer *iobuf;
+
+	/* Remove last packet in last block, if any */
+	block = list_last_entry ( &queue->blocks, struct tcp_rx_block, list );
+	if ( ! block )
+		return 0;
+	iobuf = list_last_entry ( &block->packets, struct io_buffer, list );
+	assert ( iobuf != NULL );
+	list_del ( &iobuf->list );
+	free_iob ( iobuf );
+	queue->count--;
+
+	/* Free block if now empty, otherwise recalculate end of block */
+	if ( list_empty ( &block->packets ) ) {
+		list_del ( &block->list );
+		free ( block );
+	} else {
+		block->right = block->left;
+		list_for_each_entry ( iobuf, &block->packets, list ) {
+			tcpqhdr = iobuf->data;
+			if ( tcp_cmp ( tcpqhdr->nxt, block->right ) > 0 )
+				block->right = tcpqhdr->nxt;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Discard all packets from receive queue
+ *
+ * @v queue		Receive queue
+ */
+void tcp_rx_queue_flush ( struct tcp_rx_queue *queue ) {
+
+	while ( tcp_rx_queue_discard ( queue ) ) {}
+}
@@ -47,6 +47,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/certstore.h>
 #include <ipxe/rbg.h>
 #include <ipxe/validator.h>
+#include <ipxe/trace.h>
 #include <ipxe/tls.h>
 
 /* Disambiguate the various error causes */
@@ -1606,44 +1607,52 @@ static int tls_new_finished ( struct tls_session *tls,
  * Receive new Handshake record
  *
  * @v tls		TLS session
- * @v data		Plaintext record
- * @v len		Length of plaintext record
+ * @v cursor		Plaintext record cursor
  * @ret rc		Return status code
+ *
+ * Handshake messages are parsed directly from the list of received
+ * I/O buffers.  A temporary copy is made only for those messages
+ * which happen to straddle a buffer boundary.
  */
 static int tls_new_handshake ( struct tls_session *tls,
-			       const void *data, size_t len ) {
-	size_t remaining = len;
+			       struct iob_cursor *cursor ) {
+	struct {
+		uint8_t type;
+		tls24_t length;
+	} __attribute__ (( packed )) handshake;
+	const void *payload;
+	void *copy;
+	size_t remaining;
+	size_t payload_len;
 	int rc;
 
-	while ( remaining ) {
-		const struct {
-			uint8_t type;
-			tls24_t length;
-			uint8_t payload[0];
-		} __attribute__ (( packed )) *handshake = data;
-		const void *payload;
-		size_t payload_len;
-		size_t record_len;
+	while ( ( remaining = iob_cursor_len ( cursor ) ) ) {
 
 		/* Parse header */
-		if ( sizeof ( *handshake ) > remaining ) {
+		if ( sizeof ( handshake ) > remaining ) {
 			DBGC ( tls, "TLS %p received underlength Handshake\n",
 			       tls );
-			DBGC_HD ( tls, data, remaining );
 			return -EINVAL_HANDSHAKE;
 		}
-		payload_len = tls_uint24 ( &handshake->length );
-		if ( payload_len > ( remaining - sizeof ( *handshake ) ) ) {
+		iob_cursor_copy ( cursor, &handshake, sizeof ( handshake ) );
+		payload_len = tls_uint24 ( &handshake.length );
+		if ( payload_len > ( remaining - sizeof ( handshake ) ) ) {
 			DBGC ( tls, "TLS %p received overlength Handshake\n",
 			       tls );
-			DBGC_HD ( tls, data, len );
+			DBGC_HD ( tls, &handshake, sizeof ( handshake ) );
 			return -EINVAL_HANDSHAKE;
 		}
-		payload = &handshake->payload;
-		record_len = ( sizeof ( *handshake ) + payload_len );
+
+		/* Obtain contiguous payload */
+		if ( ( rc = iob_cursor_pull ( cursor, payload_len, &payload,
+					      &copy ) ) != 0 ) {
+			DBGC ( tls, "TLS %p could not linearise Handshake: "
+			       "%s\n", tls, strerror ( rc ) );
+			return -ENOMEM_RX_CONCAT;
+		}
 
 		/* Handle payload */
-		switch ( handshake->type ) {
+		switch ( handshake.type ) {
 		case TLS_SERVER_HELLO:
 			rc = tls_new_server_hello ( tls, payload, payload_len );
 			break;
@@ -1663,7 +1672,7 @@ static int tls_new_handshake ( struct tls_session *tls,
 			break;
 		default:
 			DBGC ( tls, "TLS %p ignoring handshake type %d\n",
-			       tls, handshake->type );
+			       tls, handshake.type );
 			rc = 0;
 			break;
 		}
@@ -1671,16 +1680,18 @@ static int tls_new_handshake ( struct tls_session *tls,
 		/* Add to handshake digest (except for Hello Requests,
 		 * which are explicitly excluded).
 		 */
-		if ( handshake->type != TLS_HELLO_REQUEST )
-			tls_add_handshake ( tls, data, record_len );
+		if ( handshake.type != TLS_HELLO_REQUEST ) {
+			tls_add_handshake ( tls, &handshake,
+					    sizeof ( handshake ) );
+			tls_add_handshake ( tls, payload, payload_len );
+		}
+
+		/* Free any temporary copy */
+		free ( copy );
 
 		/* Abort on failure */
 		if ( rc != 0 )
 			return rc;
-
-		/* Move to next handshake record */
-		data += record_len;
-		remaining -= record_len;
 	}
 
 	return 0;
@@ -1696,9 +1707,14 @@ static int tls_new_handshake ( struct tls_session *tls,
  */
 static int tls_new_record ( struct tls_session *tls, unsigned int type,
 			    struct list_head *rx_data ) {
+	struct iob_cursor cursor;
 	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
 	int ( * handler ) ( struct tls_session *tls, const void *data,
 			    size_t len );
+	const void *data;
+	void *copy;
+	size_t len;
 	int rc;
 
 	/* Deliver data records to the plainstream interface */
@@ -1722,15 +1738,12 @@ static int tls_new_record ( struct tls_session *tls, unsigned int type,
 		return 0;
 	}
 
-	/* For all other records, merge into a single I/O buffer */
-	iobuf = iob_concatenate ( rx_data );
-	if ( ! iobuf ) {
-		DBGC ( tls, "TLS %p could not concatenate non-data record "
-		       "type %d\n", tls, type );
-		return -ENOMEM_RX_CONCAT;
-	}
-
-	/* Determine handler */
+	/* For all other records, read directly from the list of
+	 * received data buffers.
+	 */
+	iob_cursor_init ( &cursor, rx_data );
+	handler = NULL;
+	rc = 0;
 	switch ( type ) {
 	case TLS_TYPE_CHANGE_CIPHER:
 		handler = tls_new_change_cipher;
@@ -1739,20 +1752,36 @@ static int tls_new_record ( struct tls_session *tls, unsigned int type,
 		handler = tls_new_alert;
 		break;
 	case TLS_TYPE_HANDSHAKE:
-		handler = tls_new_handshake;
+		rc = tls_new_handshake ( tls, &cursor );
 		break;
 	default:
 		/* RFC4346 says that we should just ignore unknown
 		 * record types.
 		 */
-		handler = NULL;
 		DBGC ( tls, "TLS %p ignoring record type %d\n", tls, type );
 		break;
 	}
 
-	/* Handle record and free I/O buffer */
-	rc = ( handler ? handler ( tls, iobuf->data, iob_len ( iobuf ) ) : 0 );
-	free_iob ( iobuf );
+	/* Obtain contiguous record for simple handlers */
+	if ( handler ) {
+		len = iob_cursor_len ( &cursor );
+		if ( ( rc = iob_cursor_pull ( &cursor, len, &data,
+					      &copy ) ) != 0 ) {
+			DBGC ( tls, "TLS %p could not concatenate non-data "
+			       "record type %d\n", tls, type );
+			rc = -ENOMEM_RX_CONCAT;
+			goto done;
+		}
+		rc = handler ( tls, data, len );
+		free ( copy );
+	}
+
+ done:
+	/* Free I/O buffers */
+	list_for_each_entry_safe ( iobuf, tmp, rx_data, list ) {
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
 	return rc;
 }
 
@@ -1939,6 +1968,7 @@ static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 	int rc;
 
 	/* Construct header */
+	trace ( TRACE_TLS_TX, type, len, 0 );
 	plaintext_tlshdr.type = type;
 	plaintext_tlshdr.version = htons ( tls->version );
 	plaintext_tlshdr.length = htons ( len );
@@ -2152,6 +2182,7 @@ static int tls_new_ciphertext ( struct tls_session *tls,
 	}
 
 	/* Process plaintext record */
+	trace ( TRACE_TLS_RX, tlshdr->type, len, 0 );
 	if ( ( rc = tls_new_record ( tls, tlshdr->type, rx_data ) ) != 0 )
 		return rc;
 
@@ -26,7 +26,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 struct udp_connection {
 	/** Reference counter */
 	struct refcnt refcnt;
-	/** List of UDP connections */
+	/** List of UDP connections within hash bucket */
 	struct list_head list;
 
 	/** Data transfer interface */
@@ -36,17 +36,45 @@ struct udp_connection {
 	struct sockaddr_tcpip local;
 	/** Remote socket address */
 	struct sockaddr_tcpip peer;
+	/** Cached transmit route */
+	struct tcpip_route route;
 };
 
 /**
- * List of registered UDP connections
+ * Registered UDP connections bound to a local port
+ *
+ * Connections are hashed by local port.
  */
-static LIST_HEAD ( udp_conns );
+static struct list_head udp_conns[UDP_HASH_SIZE];
+
+/** Registered promiscuous UDP connections */
+static LIST_HEAD ( udp_promisc_conns );
+
+/** Most recently demultiplexed UDP connection */
+static struct udp_connection *udp_demux_cache;
 
 /* Forward declatations */
 static struct interface_descriptor udp_xfer_desc;
 struct tcpip_protocol udp_protocol __tcpip_protocol;
 
+/**
+ * Get UDP connection hash bucket
+ *
+ * @v port		Local port (in network-endian order)
+ * @ret bucket		Hash bucket
+ */
+static struct list_head * udp_bucket ( uint16_t port ) {
+	unsigned int i;
+
+	/* Initialise buckets, if not already done */
+	if ( ! udp_conns[0].next ) {
+		for ( i = 0 ; i < UDP_HASH_SIZE ; i++ )
+			INIT_LIST_HEAD ( &udp_conns[i] );
+	}
+
+	return &udp_conns[ ntohs ( port ) & ( UDP_HASH_SIZE - 1 ) ];
+}
+
 /**
  * Check if local UDP port is available
  *
@@ -56,7 +84,7 @@ struct tcpip_protocol udp_protocol __tcpip_protocol;
 static int udp_port_available ( int port ) {
 	struct udp_connection *udp;
 
-	list_for_each_entry ( udp, &udp_conns, list ) {
+	list_for_each_entry ( udp, udp_bucket ( htons ( port ) ), list ) {
 		if ( udp->local.st_port == htons ( port ) )
 			return -EADDRINUSE;
 	}
@@ -111,7 +139,8 @@ static int udp_open_common ( struct interface *xfer,
 	 * list and return
 	 */
 	intf_plug_plug ( &udp->xfer, xfer );
-	list_add ( &udp->list, &udp_conns );
+	list_add ( &udp->list, ( promisc ? &udp_promisc_conns :
+				 udp_bucket ( udp->local.st_port ) ) );
 	return 0;
 
  err:
@@ -158,6 +187,8 @@ static void udp_close ( struct udp_connection *udp, int rc ) {
 
 	/* Remove from list of connections and drop list's reference */
 	list_del ( &udp->list );
+	if ( udp_demux_cache == udp )
+		udp_demux_cache = NULL;
 	ref_put ( &udp->refcnt );
 
 	DBGC ( udp, "UDP %p closed\n", udp );
@@ -177,6 +208,7 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 		    struct sockaddr_tcpip *src, struct sockaddr_tcpip *dest,
 		    struct net_device *netdev ) {
        	struct udp_header *udphdr;
+	struct tcpip_route *route;
 	size_t len;
 	int rc;
 
@@ -187,6 +219,9 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 		return rc;
 	}
 
+	/* Use cached route only if no explicit values are provided */
+	route = ( ( src || dest || netdev ) ? NULL : &udp->route );
+
 	/* Fill in default values if not explicitly provided */
 	if ( ! src )
 		src = &udp->local;
@@ -199,8 +234,7 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 	udphdr->dest = dest->st_port;
 	udphdr->src = src->st_port;
 	udphdr->len = htons ( len );
-	udphdr->chksum = 0;
-	udphdr->chksum = tcpip_chksum ( udphdr, len );
+	iob_csum_defer ( iobuf, udphdr, &udphdr->chksum );
 
 	/* Dump debugging information */
 	DBGC2 ( udp, "UDP %p TX %d->%d len %d\n", udp,
@@ -209,7 +243,7 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 
 	/* Send it to the next layer for processing */
 	if ( ( rc = tcpip_tx ( iobuf, &udp_protocol, src, dest, netdev,
-			       &udphdr->chksum ) ) != 0 ) {
+			       route, &udphdr->chksum ) ) != 0 ) {
 		DBGC ( udp, "UDP %p could not transmit packet: %s\n",
 		       udp, strerror ( rc ) );
 		return rc;
@@ -218,28 +252,60 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 	return 0;
 }
 
+/**
+ * Check if UDP connection matches local address
+ *
+ * @v udp		UDP connection
+ * @v local		Local address
+ * @ret match		Connection matches local address
+ */
+static int udp_demux_match ( struct udp_connection *udp,
+			     struct sockaddr_tcpip *local ) {
+	static const struct sockaddr_tcpip empty_sockaddr = { .pad = { 0, } };
+
+	return ( ( ( udp->local.st_family == local->st_family ) ||
+		   ( udp->local.st_family == 0 ) ) &&
+		 ( ( udp->local.st_port == local->st_port ) ||
+		   ( udp->local.st_port == 0 ) ) &&
+		 ( ( memcmp ( udp->local.pad, local->pad,
+			      sizeof ( udp->local.pad ) ) == 0 ) ||
+		   ( memcmp ( udp->local.pad, empty_sockaddr.pad,
+			      sizeof ( udp->local.pad ) ) == 0 ) ) );
+}
+
 /**
  * Identify UDP connection by local address
  *
  * @v local		Local address
  * @ret udp		UDP connection, or NULL
+ *
+ * Connections bound to the local port take precedence over
+ * promiscuous connections.  The most recently identified bound
+ * connection is checked first, since received packets tend to arrive
+ * in runs belonging to a single transfer.
  */
 static struct udp_connection * udp_demux ( struct sockaddr_tcpip *local ) {
-	static const struct sockaddr_tcpip empty_sockaddr = { .pad = { 0, } };
 	struct udp_connection *udp;
 
-	list_for_each_entry ( udp, &udp_conns, list ) {
-		if ( ( ( udp->local.st_family == local->st_family ) ||
-		       ( udp->local.st_family == 0 ) ) &&
-		     ( ( udp->local.st_port == local->st_port ) ||
-		       ( udp->local.st_port == 0 ) ) &&
-		     ( ( memcmp ( udp->local.pad, local->pad,
-				  sizeof ( udp->local.pad ) ) == 0 ) ||
-		       ( memcmp ( udp->local.pad, empty_sockaddr.pad,
-				  sizeof ( udp->local.pad ) ) == 0 ) ) ) {
+	/* Check most recently identified connection */
+	udp = udp_demux_cache;
+	if ( udp && udp_demux_match ( udp, local ) )
+		return udp;
+
+	/* Search hash bucket */
+	list_for_each_entry ( udp, udp_bucket ( local->st_port ), list ) {
+		if ( udp_demux_match ( udp, local ) ) {
+			udp_demux_cache = udp;
 			return udp;
 		}
 	}
+
+	/* Search promiscuous connections */
+	list_for_each_entry ( udp, &udp_promisc_conns, list ) {
+		if ( udp_demux_match ( udp, local ) )
+			return udp;
+	}
+
 	return NULL;
 }
 
@@ -285,7 +351,7 @@ static int udp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto done;
 	}
-	if ( udphdr->chksum ) {
+	if ( udphdr->chksum && ! ( iobuf->flags & IOB_CSUM_VERIFIED ) ) {
 		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data, ulen );
 		if ( csum != 0 ) {
 			DBG ( "UDP checksum incorrect (is %04x including "
@@ -29,6 +29,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <errno.h>
@@ -44,6 +45,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/features.h>
 #include <ipxe/dhcp.h>
 #include <ipxe/dhcpv6.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
+#include <ipxe/malloc.h>
 #include <ipxe/dns.h>
 
 /** @file
@@ -62,21 +66,35 @@ FEATURE ( FEATURE_PROTOCOL, "DNS", DHCP_EB_FEATURE_DNS, 1 );
 #define EINFO_ENXIO_NO_NAMESERVER \
 	__einfo_uniqify ( EINFO_ENXIO, 0x02, "No DNS servers available" )
 
-/** The DNS server */
-static union {
+/** A DNS server address */
+union dns_server {
 	struct sockaddr sa;
 	struct sockaddr_tcpip st;
 	struct sockaddr_in sin;
 	struct sockaddr_in6 sin6;
-} nameserver = {
-	.st = {
-		.st_port = htons ( DNS_PORT ),
-	},
 };
 
+/** The DNS servers (with IPv6 servers first) */
+static union dns_server nameservers[DNS_MAX_SERVERS];
+
+/** Number of DNS servers */
+static unsigned int dns_servers;
+
 /** The DNS search list */
 static struct dns_name dns_search;
 
+/** The DNS cache */
+LIST_HEAD ( dns_cache );
+
+/** Number of DNS cache entries */
+static unsigned int dns_cache_count;
+
+/** DNS cache statistics */
+struct dns_cache_statistics dns_cache_stats;
+
+/** Maximum DNS cache entry lifetime (in seconds) */
+static unsigned long dns_cache_max_ttl = DNS_CACHE_MAX_TTL;
+
 /**
  * Encode a DNS name using RFC1035 encoding
  *
@@ -431,18 +449,193 @@ static const char * dns_type ( uint16_t type ) {
 	case htons ( DNS_TYPE_A ):	return "A";
 	case htons ( DNS_TYPE_AAAA ):	return "AAAA";
 	case htons ( DNS_TYPE_CNAME ):	return "CNAME";
+	case htons ( DNS_TYPE_SOA ):	return "SOA";
 	default:			return "<UNKNOWN>";
 	}
 }
 
-/** A DNS request */
-struct dns_request {
-	/** Reference counter */
-	struct refcnt refcnt;
-	/** Name resolution interface */
-	struct interface resolv;
-	/** Data transfer interface */
-	struct interface socket;
+/******************************************************************************
+ *
+ * DNS cache
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Delete DNS cache entry
+ *
+ * @v entry		DNS cache entry
+ */
+static void dns_cache_del ( struct dns_cache_entry *entry ) {
+
+	list_del ( &entry->list );
+	dns_cache_count--;
+	free ( entry );
+}
+
+/**
+ * Calculate remaining lifetime of DNS cache entry
+ *
+ * @v entry		DNS cache entry
+ * @ret remaining	Remaining lifetime (in seconds), or zero if expired
+ *
+ * The record time to live is capped by the current maximum lifetime,
+ * so that lowering the "dnsttl" setting takes effect immediately.
+ */
+unsigned long dns_cache_remaining ( struct dns_cache_entry *entry ) {
+	unsigned long ttl = entry->ttl;
+	unsigned long elapsed;
+
+	if ( ttl > dns_cache_max_ttl )
+		ttl = dns_cache_max_ttl;
+	elapsed = ( ( currticks() - entry->created ) / TICKS_PER_SEC );
+	return ( ( elapsed < ttl ) ? ( ttl - elapsed ) : 0 );
+}
+
+/**
+ * Find DNS cache entry
+ *
+ * @v name		Name as originally requested
+ * @v qtype		Query type (in network byte order)
+ * @ret entry		DNS cache entry, or NULL if not found
+ *
+ * Expired entries are discarded as they are encountered.  A found
+ * entry is moved to the head of the cache, so that the cache is
+ * maintained in least-recently-used order.
+ */
+struct dns_cache_entry * dns_cache_find ( const char *name,
+					  unsigned int qtype ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list ) {
+
+		/* Skip non-matching entries */
+		if ( ( entry->qtype != qtype ) ||
+		     ( strcasecmp ( entry->name, name ) != 0 ) )
+			continue;
+
+		/* Discard expired entry */
+		if ( ! dns_cache_remaining ( entry ) ) {
+			DBG ( "DNS cache entry for %s type %s expired\n",
+			      entry->name, dns_type ( entry->qtype ) );
+			dns_cache_del ( entry );
+			return NULL;
+		}
+
+		/* Move to head of cache */
+		list_del ( &entry->list );
+		list_add ( &entry->list, &dns_cache );
+		return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * Add DNS cache entry
+ *
+ * @v name		Name as originally requested
+ * @v qtype		Query type (in network byte order)
+ * @v sa		Resolved address (for a positive entry)
+ * @v rc		Status code (zero for a positive entry)
+ * @v ttl		Time to live (in seconds)
+ *
+ * Any existing entry for the same name and query type is replaced.
+ * Failure to create an entry is not an error, since the cache is
+ * purely an optimisation.
+ */
+void dns_cache_add ( const char *name, unsigned int qtype,
+		     struct sockaddr *sa, int rc, unsigned long ttl ) {
+	struct dns_cache_entry *entry;
+	size_t name_len;
+
+	/* Replace any existing entry */
+	entry = dns_cache_find ( name, qtype );
+	if ( entry )
+		dns_cache_del ( entry );
+
+	/* Do not create entries which would expire immediately */
+	if ( ( ttl == 0 ) || ( dns_cache_max_ttl == 0 ) )
+		return;
+
+	/* Discard least recently used entry if cache is full */
+	if ( dns_cache_count >= DNS_CACHE_MAX_ENTRIES ) {
+		dns_cache_del ( list_last_entry ( &dns_cache,
+						  struct dns_cache_entry,
+						  list ) );
+	}
+
+	/* Allocate and populate entry */
+	name_len = ( strlen ( name ) + 1 /* NUL */ );
+	entry = zalloc ( sizeof ( *entry ) + name_len );
+	if ( ! entry )
+		return;
+	entry->qtype = qtype;
+	entry->rc = rc;
+	if ( rc == 0 )
+		memcpy ( &entry->address, sa, sizeof ( entry->address.sa ) );
+	entry->created = currticks();
+	entry->ttl = ttl;
+	memcpy ( entry->name, name, name_len );
+	list_add ( &entry->list, &dns_cache );
+	dns_cache_count++;
+
+	DBG ( "DNS cache added %s type %s %s for %lds\n", name,
+	      dns_type ( qtype ), ( rc ? strerror ( rc ) : sock_ntoa ( sa ) ),
+	      ttl );
+}
+
+/**
+ * Flush DNS cache
+ *
+ */
+void dns_cache_flush ( void ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list )
+		dns_cache_del ( entry );
+}
+
+/**
+ * Discard some cached DNS entries
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int dns_cache_discard ( void ) {
+	struct dns_cache_entry *entry;
+
+	/* Drop least recently used cache entry, if any */
+	entry = list_last_entry ( &dns_cache, struct dns_cache_entry, list );
+	if ( entry ) {
+		dns_cache_del ( entry );
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/**
+ * DNS cache discarder
+ *
+ * A discarded DNS cache entry costs at most a further query.
+ */
+struct cache_discarder dns_cache_discarder __cache_discarder ( CACHE_NORMAL )={
+	.discard = dns_cache_discard,
+};
+
+/******************************************************************************
+ *
+ * Name resolution
+ *
+ ******************************************************************************
+ */
+
+/** A DNS query for a single address family */
+struct dns_query {
+	/** DNS request */
+	struct dns_request *dns;
 	/** Retry timer */
 	struct retry_timer timer;
 
@@ -475,6 +668,37 @@ struct dns_request {
 	struct dns_name search;
 	/** Recursion counter */
 	unsigned int recursion;
+	/** Minimum time to live of records used (in seconds) */
+	unsigned long ttl;
+	/** Minimum negative caching lifetime (in seconds) */
+	unsigned long negative_ttl;
+	/** Status code (or -EINPROGRESS while query is running) */
+	int rc;
+	/** Resolved address has been reported */
+	int reported;
+};
+
+/** A DNS request */
+struct dns_request {
+	/** Reference counter */
+	struct refcnt refcnt;
+	/** Name resolution interface */
+	struct interface resolv;
+	/** Data transfer interface */
+	struct interface socket;
+	/** Resolution delay timer */
+	struct retry_timer delay;
+	/** Resolution delay has expired */
+	int impatient;
+	/** Cached result process */
+	struct process process;
+
+	/** Queries, in order of preference */
+	struct dns_query query[DNS_MAX_QUERIES];
+	/** Number of queries */
+	unsigned int count;
+	/** Name as originally requested (used as the cache key) */
+	char *cache_name;
 };
 
 /**
@@ -484,9 +708,16 @@ struct dns_request {
  * @v rc		Return status code
  */
 static void dns_done ( struct dns_request *dns, int rc ) {
+	unsigned int i;
 
-	/* Stop the retry timer */
-	stop_timer ( &dns->timer );
+	/* Stop the retry timers and cached result process */
+	for ( i = 0 ; i < dns->count ; i++ )
+		stop_timer ( &dns->query[i].timer );
+	stop_timer ( &dns->delay );
+	process_del ( &dns->process );
+
+	/* Prevent any further progress */
+	dns->count = 0;
 
 	/* Shut down interfaces */
 	intf_shutdown ( &dns->socket, rc );
@@ -494,35 +725,206 @@ static void dns_done ( struct dns_request *dns, int rc ) {
 }
 
 /**
- * Mark DNS request as resolved and complete
+ * Report resolved addresses and complete DNS request if possible
  *
  * @v dns		DNS request
+ *
+ * Resolved addresses are reported in order of preference.  A less
+ * preferred address (e.g. an IPv4 address) is held back until all
+ * more preferred queries have completed, or until the resolution
+ * delay expires (RFC 8305 section 3).
+ */
+static void dns_progress ( struct dns_request *dns ) {
+	struct dns_query *query;
+	unsigned int running = 0;
+	unsigned int held = 0;
+	unsigned int found = 0;
+	unsigned int i;
+	int rc = -ENXIO_NO_RECORD;
+
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->query[i];
+
+		/* Skip queries still in progress */
+		if ( query->rc == -EINPROGRESS ) {
+			running++;
+			continue;
+		}
+
+		/* Record failures, preferring errors other than the
+		 * absence of a record.
+		 */
+		if ( query->rc != 0 ) {
+			if ( rc == -ENXIO_NO_RECORD )
+				rc = query->rc;
+			continue;
+		}
+		found++;
+
+		/* Skip addresses already reported */
+		if ( query->reported )
+			continue;
+
+		/* Hold back address while more preferred queries are
+		 * still running, until the resolution delay expires.
+		 */
+		if ( running && ( ! dns->impatient ) ) {
+			if ( ! timer_running ( &dns->delay ) )
+				start_timer_fixed ( &dns->delay,
+						    DNS_RESOLUTION_DELAY );
+			held++;
+			continue;
+		}
+
+		/* Report resolved address.  This may cause the
+		 * request to be closed.
+		 */
+		DBGC ( dns, "DNS %p found address %s\n",
+		       dns, sock_ntoa ( &query->address.sa ) );
+		query->reported = 1;
+		resolv_done ( &dns->resolv, &query->address.sa );
+		if ( ! dns->count )
+			return;
+	}
+
+	/* Complete request once all queries have completed */
+	if ( running || held )
+		return;
+	dns_done ( dns, ( found ? 0 : rc ) );
+}
+
+/**
+ * Handle DNS resolution delay timer expiry
+ *
+ * @v timer		Resolution delay timer
+ * @v fail		Failure indicator
+ */
+static void dns_delay_expired ( struct retry_timer *timer, int fail __unused ){
+	struct dns_request *dns =
+		container_of ( timer, struct dns_request, delay );
+
+	DBGC ( dns, "DNS %p resolution delay expired\n", dns );
+	dns->impatient = 1;
+	dns_progress ( dns );
+}
+
+/**
+ * Mark DNS query as complete
+ *
+ * @v query		DNS query
  * @v rc		Return status code
  */
-static void dns_resolved ( struct dns_request *dns ) {
+static void dns_query_done ( struct dns_query *query, int rc ) {
+
+	/* Stop the retry timer */
+	stop_timer ( &query->timer );
+
+	/* Record status and update request */
+	query->rc = rc;
+	dns_progress ( query->dns );
+}
+
+/**
+ * Mark DNS query as resolved and complete
+ *
+ * @v query		DNS query
+ */
+static void dns_resolved ( struct dns_query *query ) {
+
+	/* Add to cache */
+	dns_cache_add ( query->dns->cache_name, query->qtype,
+			&query->address.sa, 0, query->ttl );
+
+	/* Mark query as complete */
+	dns_query_done ( query, 0 );
+}
+
+/**
+ * Mark DNS query as having no record and complete
+ *
+ * @v query		DNS query
+ */
+static void dns_no_record ( struct dns_query *query ) {
+	unsigned long ttl = query->negative_ttl;
+	int rc = -ENXIO_NO_RECORD;
 
-	DBGC ( dns, "DNS %p found address %s\n",
-	       dns, sock_ntoa ( &dns->address.sa ) );
+	/* Add to cache.  The negative caching lifetime is taken from
+	 * the SOA record(s) in the authority section (RFC 2308
+	 * section 5), and is limited by any CNAME records followed.
+	 */
+	if ( ttl == ~0UL )
+		ttl = DNS_CACHE_NEGATIVE_TTL;
+	if ( ttl > query->ttl )
+		ttl = query->ttl;
+	dns_cache_add ( query->dns->cache_name, query->qtype, NULL, rc, ttl );
+
+	/* Mark query as complete */
+	dns_query_done ( query, rc );
+}
 
-	/* Return resolved address */
-	resolv_done ( &dns->resolv, &dns->address.sa );
+/**
+ * Record time to live of a resource record used in resolution
+ *
+ * @v ttl		Minimum time to live to update
+ * @v rr_ttl		Time to live (in network byte order)
+ */
+static void dns_ttl ( unsigned long *ttl, uint32_t rr_ttl ) {
 
-	/* Mark operation as complete */
-	dns_done ( dns, 0 );
+	if ( *ttl > ntohl ( rr_ttl ) )
+		*ttl = ntohl ( rr_ttl );
+}
+
+/**
+ * Record negative caching lifetime from an SOA record
+ *
+ * @v query		DNS query
+ * @v buf		DNS response
+ * @v offset		Offset of resource record
+ * @v next_offset	Offset of next resource record
+ */
+static void dns_soa ( struct dns_query *query, struct dns_name *buf,
+		      size_t offset, size_t next_offset ) {
+	union dns_rr *rr = ( buf->data + offset );
+	struct dns_soa_timers *timers;
+	unsigned int i;
+	int skip;
+
+	/* Skip MNAME and RNAME fields */
+	buf->offset = ( offset + sizeof ( rr->soa ) );
+	for ( i = 0 ; i < 2 ; i++ ) {
+		skip = dns_skip ( buf );
+		if ( skip < 0 )
+			return;
+		buf->offset = skip;
+	}
+
+	/* Ignore malformed records */
+	if ( ( buf->offset + sizeof ( *timers ) ) > next_offset ) {
+		DBGC ( query->dns, "DNS %p ignoring underlength SOA\n",
+		       query->dns );
+		return;
+	}
+	timers = ( buf->data + buf->offset );
+
+	/* Negative caching lifetime is the lesser of the SOA record's
+	 * own TTL and its MINIMUM field.
+	 */
+	dns_ttl ( &query->negative_ttl, rr->common.ttl );
+	dns_ttl ( &query->negative_ttl, timers->minimum );
 }
 
 /**
  * Construct DNS question
  *
- * @v dns		DNS request
+ * @v query		DNS query
  * @ret rc		Return status code
  */
-static int dns_question ( struct dns_request *dns ) {
+static int dns_question ( struct dns_query *query ) {
 	static struct dns_name search_root = {
 		.data = "",
 		.len = 1,
 	};
-	struct dns_name *search = &dns->search;
+	struct dns_name *search = &query->search;
 	int len;
 	size_t offset;
 
@@ -531,31 +933,32 @@ static int dns_question ( struct dns_request *dns ) {
 		search = &search_root;
 
 	/* Overwrite current suffix */
-	dns->name.offset = dns->offset;
-	len = dns_copy ( search, &dns->name );
+	query->name.offset = query->offset;
+	len = dns_copy ( search, &query->name );
 	if ( len < 0 )
 		return len;
 
 	/* Sanity check */
-	offset = ( dns->name.offset + len );
-	if ( offset > dns->name.len ) {
-		DBGC ( dns, "DNS %p name is too long\n", dns );
+	offset = ( query->name.offset + len );
+	if ( offset > query->name.len ) {
+		DBGC ( query->dns, "DNS %p name is too long\n", query->dns );
 		return -EINVAL;
 	}
 
 	/* Construct question */
-	dns->question = ( ( ( void * ) &dns->buf ) + offset );
-	dns->question->qtype = dns->qtype;
-	dns->question->qclass = htons ( DNS_CLASS_IN );
+	query->question = ( ( ( void * ) &query->buf ) + offset );
+	query->question->qtype = query->qtype;
+	query->question->qclass = htons ( DNS_CLASS_IN );
 
 	/* Store length */
-	dns->len = ( offset + sizeof ( *(dns->question) ) );
+	query->len = ( offset + sizeof ( *(query->question) ) );
 
 	/* Restore name */
-	dns->name.offset = offsetof ( typeof ( dns->buf ), name );
+	query->name.offset = offsetof ( typeof ( query->buf ), name );
 
-	DBGC2 ( dns, "DNS %p question is %s type %s\n", dns,
-		dns_name ( &dns->name ), dns_type ( dns->question->qtype ) );
+	DBGC2 ( query->dns, "DNS %p question is %s type %s\n", query->dns,
+		dns_name ( &query->name ),
+		dns_type ( query->question->qtype ) );
 
 	return 0;
 }
@@ -563,25 +966,56 @@ static int dns_question ( struct dns_request *dns ) {
 /**
  * Send DNS query
  *
- * @v dns		DNS request
+ * @v query		DNS query
  * @ret rc		Return status code
+ *
+ * The query is sent to all configured DNS servers simultaneously,
+ * and the first response received is used.
  */
-static int dns_send_packet ( struct dns_request *dns ) {
-	struct dns_header *query = &dns->buf.query;
+static int dns_send_packet ( struct dns_query *query ) {
+	struct dns_request *dns = query->dns;
+	struct dns_header *header = &query->buf.query;
+	struct xfer_metadata meta;
+	unsigned int sent = 0;
+	unsigned int i;
+	int rc = -ENXIO_NO_NAMESERVER;
 
 	/* Start retransmission timer */
-	start_timer ( &dns->timer );
+	start_timer ( &query->timer );
 
-	/* Generate query identifier */
-	query->id = random();
+	/* Generate query identifier, distinct from any other query
+	 * within this request.
+	 */
+	do {
+		header->id = random();
+		for ( i = 0 ; i < dns->count ; i++ ) {
+			if ( ( &dns->query[i] != query ) &&
+			     ( dns->query[i].buf.query.id == header->id ) )
+				break;
+		}
+	} while ( i < dns->count );
 
 	/* Send query */
 	DBGC ( dns, "DNS %p sending query ID %#04x for %s type %s\n", dns,
-	       ntohs ( query->id ), dns_name ( &dns->name ),
-	       dns_type ( dns->question->qtype ) );
+	       ntohs ( header->id ), dns_name ( &query->name ),
+	       dns_type ( query->question->qtype ) );
+
+	/* Send the data to each DNS server */
+	for ( i = 0 ; i < dns_servers ; i++ ) {
+		memset ( &meta, 0, sizeof ( meta ) );
+		meta.dest = &nameservers[i].sa;
+		if ( ( rc = xfer_deliver_raw_meta ( &dns->socket, header,
+						    query->len,
+						    &meta ) ) != 0 ) {
+			DBGC ( dns, "DNS %p could not send to %s: %s\n",
+			       dns, sock_ntoa ( &nameservers[i].sa ),
+			       strerror ( rc ) );
+			continue;
+		}
+		sent++;
+	}
 
-	/* Send the data */
-	return xfer_deliver_raw ( &dns->socket, query, dns->len );
+	return ( sent ? 0 : rc );
 }
 
 /**
@@ -591,13 +1025,13 @@ static int dns_send_packet ( struct dns_request *dns ) {
  * @v fail		Failure indicator
  */
 static void dns_timer_expired ( struct retry_timer *timer, int fail ) {
-	struct dns_request *dns =
-		container_of ( timer, struct dns_request, timer );
+	struct dns_query *query =
+		container_of ( timer, struct dns_query, timer );
 
 	if ( fail ) {
-		dns_done ( dns, -ETIMEDOUT );
+		dns_query_done ( query, -ETIMEDOUT );
 	} else {
-		dns_send_packet ( dns );
+		dns_send_packet ( query );
 	}
 }
 
@@ -611,10 +1045,10 @@ static void dns_timer_expired ( struct retry_timer *timer, int fail ) {
  */
 static int dns_xfer_deliver ( struct dns_request *dns,
 			      struct io_buffer *iobuf,
-			      struct xfer_metadata *meta __unused ) {
+			      struct xfer_metadata *meta ) {
 	struct dns_header *response = iobuf->data;
-	struct dns_header *query = &dns->buf.query;
-	unsigned int qtype = dns->question->qtype;
+	struct dns_query *query;
+	unsigned int qtype;
 	struct dns_name buf;
 	union dns_rr *rr;
 	int offset;
@@ -622,6 +1056,7 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 	size_t next_offset;
 	size_t rdlength;
 	size_t name_len;
+	unsigned int i;
 	int rc;
 
 	/* Sanity check */
@@ -632,16 +1067,23 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		goto done;
 	}
 
-	/* Check response ID matches query ID */
-	if ( response->id != query->id ) {
-		DBGC ( dns, "DNS %p received unexpected response ID %#04x "
-		       "(wanted %d)\n", dns, ntohs ( response->id ),
-		       ntohs ( query->id ) );
+	/* Identify query by response ID */
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->query[i];
+		if ( ( query->rc == -EINPROGRESS ) &&
+		     ( response->id == query->buf.query.id ) )
+			break;
+	}
+	if ( i == dns->count ) {
+		DBGC ( dns, "DNS %p received unexpected response ID %#04x\n",
+		       dns, ntohs ( response->id ) );
 		rc = -EINVAL;
 		goto done;
 	}
-	DBGC ( dns, "DNS %p received response ID %#04x\n",
-	       dns, ntohs ( response->id ) );
+	qtype = query->question->qtype;
+	DBGC ( dns, "DNS %p received response ID %#04x from %s\n",
+	       dns, ntohs ( response->id ),
+	       ( meta->src ? sock_ntoa ( meta->src ) : "<unknown>" ) );
 
 	/* Check that we have exactly one question */
 	if ( response->qdcount != htons ( 1 ) ) {
@@ -698,8 +1140,14 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			goto done;
 		}
 
+		/* Record negative caching lifetime from any SOA */
+		if ( rr->common.type == htons ( DNS_TYPE_SOA ) ) {
+			dns_soa ( query, &buf, offset, next_offset );
+			continue;
+		}
+
 		/* Skip non-matching names */
-		if ( dns_compare ( &buf, &dns->name ) != 0 ) {
+		if ( dns_compare ( &buf, &query->name ) != 0 ) {
 			DBGC2 ( dns, "DNS %p ignoring response for %s type "
 				"%s\n", dns, dns_name ( &buf ),
 				dns_type ( rr->common.type ) );
@@ -711,57 +1159,68 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 
 		case htons ( DNS_TYPE_AAAA ):
 
+			/* Ignore records of the other address family */
+			if ( query->qtype != htons ( DNS_TYPE_AAAA ) )
+				break;
+
 			/* Found the target AAAA record */
-			if ( rdlength < sizeof ( dns->address.sin6.sin6_addr )){
+			if ( rdlength < sizeof ( query->address.sin6.sin6_addr)){
 				DBGC ( dns, "DNS %p received response with "
 				       "underlength AAAA\n", dns );
 				rc = -EINVAL;
 				goto done;
 			}
-			dns->address.sin6.sin6_family = AF_INET6;
-			memcpy ( &dns->address.sin6.sin6_addr,
+			query->address.sin6.sin6_family = AF_INET6;
+			memcpy ( &query->address.sin6.sin6_addr,
 				 &rr->aaaa.in6_addr,
-				 sizeof ( dns->address.sin6.sin6_addr ) );
-			dns_resolved ( dns );
+				 sizeof ( query->address.sin6.sin6_addr ) );
+			dns_ttl ( &query->ttl, rr->common.ttl );
+			dns_resolved ( query );
 			rc = 0;
 			goto done;
 
 		case htons ( DNS_TYPE_A ):
 
+			/* Ignore records of the other address family */
+			if ( query->qtype != htons ( DNS_TYPE_A ) )
+				break;
+
 			/* Found the target A record */
-			if ( rdlength < sizeof ( dns->address.sin.sin_addr ) ) {
+			if ( rdlength < sizeof ( query->address.sin.sin_addr ) ){
 				DBGC ( dns, "DNS %p received response with "
 				       "underlength A\n", dns );
 				rc = -EINVAL;
 				goto done;
 			}
-			dns->address.sin.sin_family = AF_INET;
-			dns->address.sin.sin_addr = rr->a.in_addr;
-			dns_resolved ( dns );
+			query->address.sin.sin_family = AF_INET;
+			query->address.sin.sin_addr = rr->a.in_addr;
+			dns_ttl ( &query->ttl, rr->common.ttl );
+			dns_resolved ( query );
 			rc = 0;
 			goto done;
 
 		case htons ( DNS_TYPE_CNAME ):
 
-			/* Terminate the operation if we recurse too far */
-			if ( ++dns->recursion > DNS_MAX_CNAME_RECURSION ) {
+			/* Terminate the query if we recurse too far */
+			if ( ++query->recursion > DNS_MAX_CNAME_RECURSION ) {
 				DBGC ( dns, "DNS %p recursion exceeded\n",
 				       dns );
 				rc = -ELOOP;
-				dns_done ( dns, rc );
+				dns_query_done ( query, rc );
 				goto done;
 			}
 
 			/* Found a CNAME record; update query and recurse */
+			dns_ttl ( &query->ttl, rr->common.ttl );
 			buf.offset = ( offset + sizeof ( rr->cname ) );
 			DBGC ( dns, "DNS %p found CNAME %s\n",
 			       dns, dns_name ( &buf ) );
-			dns->search.offset = dns->search.len;
-			name_len = dns_copy ( &buf, &dns->name );
-			dns->offset = ( offsetof ( typeof ( dns->buf ), name ) +
-					name_len - 1 /* Strip root label */ );
-			if ( ( rc = dns_question ( dns ) ) != 0 ) {
-				dns_done ( dns, rc );
+			query->search.offset = query->search.len;
+			name_len = dns_copy ( &buf, &query->name );
+			query->offset = ( offsetof ( typeof ( query->buf ), name )
+					  + name_len - 1 /* Strip root label */ );
+			if ( ( rc = dns_question ( query ) ) != 0 ) {
+				dns_query_done ( query, rc );
 				goto done;
 			}
 			next_offset = answer_offset;
@@ -776,10 +1235,10 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 
 	/* Stop the retry timer.  After this point, each code path
 	 * must either restart the timer by calling dns_send_packet(),
-	 * or mark the DNS operation as complete by calling
-	 * dns_done()
+	 * or mark the DNS query as complete by calling
+	 * dns_query_done()
 	 */
-	stop_timer ( &dns->timer );
+	stop_timer ( &query->timer );
 
 	/* Determine what to do next based on the type of query we
 	 * issued and the response we received
@@ -787,22 +1246,14 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 	switch ( qtype ) {
 
 	case htons ( DNS_TYPE_AAAA ):
-		/* We asked for an AAAA record and got nothing; try
-		 * the A.
-		 */
-		DBGC ( dns, "DNS %p found no AAAA record; trying A\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_A );
-		dns_send_packet ( dns );
-		rc = 0;
-		goto done;
-
 	case htons ( DNS_TYPE_A ):
-		/* We asked for an A record and got nothing;
+		/* We asked for an address record and got nothing;
 		 * try the CNAME.
 		 */
-		DBGC ( dns, "DNS %p found no A record; trying CNAME\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_CNAME );
-		dns_send_packet ( dns );
+		DBGC ( dns, "DNS %p found no %s record; trying CNAME\n",
+		       dns, dns_type ( qtype ) );
+		query->question->qtype = htons ( DNS_TYPE_CNAME );
+		dns_send_packet ( query );
 		rc = 0;
 		goto done;
 
@@ -811,19 +1262,19 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		 * (i.e. if the next AAAA/A query is already set up),
 		 * then issue it.
 		 */
-		if ( qtype == dns->qtype ) {
-			dns_send_packet ( dns );
+		if ( query->question->qtype == query->qtype ) {
+			dns_send_packet ( query );
 			rc = 0;
 			goto done;
 		}
 
 		/* If we have already reached the end of the search list,
-		 * then terminate lookup.
+		 * then terminate query.
 		 */
-		if ( dns->search.offset == dns->search.len ) {
+		if ( query->search.offset == query->search.len ) {
 			DBGC ( dns, "DNS %p found no CNAME record\n", dns );
 			rc = -ENXIO_NO_RECORD;
-			dns_done ( dns, rc );
+			dns_no_record ( query );
 			goto done;
 		}
 
@@ -832,18 +1283,18 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		 */
 		DBGC ( dns, "DNS %p found no CNAME record; trying next "
 		       "suffix\n", dns );
-		dns->search.offset = dns_skip_search ( &dns->search );
-		if ( ( rc = dns_question ( dns ) ) != 0 ) {
-			dns_done ( dns, rc );
+		query->search.offset = dns_skip_search ( &query->search );
+		if ( ( rc = dns_question ( query ) ) != 0 ) {
+			dns_query_done ( query, rc );
 			goto done;
 		}
-		dns_send_packet ( dns );
+		dns_send_packet ( query );
 		goto done;
 
 	default:
 		assert ( 0 );
 		rc = -EINVAL;
-		dns_done ( dns, rc );
+		dns_query_done ( query, rc );
 		goto done;
 	}
 
@@ -886,6 +1337,118 @@ static struct interface_operation dns_resolv_op[] = {
 static struct interface_descriptor dns_resolv_desc =
 	INTF_DESC ( struct dns_request, resolv, dns_resolv_op );
 
+/** DNS cached result process descriptor */
+static struct process_descriptor dns_process_desc =
+	PROC_DESC_ONCE ( struct dns_request, process, dns_progress );
+
+/**
+ * Use cached result for DNS query, if available
+ *
+ * @v query		DNS query
+ * @ret found		Cached result was found
+ */
+static int dns_cached ( struct dns_query *query ) {
+	struct dns_cache_entry *entry;
+
+	/* Look up cache entry */
+	entry = dns_cache_find ( query->dns->cache_name, query->qtype );
+	if ( ! entry ) {
+		dns_cache_stats.misses++;
+		return 0;
+	}
+	DBGC ( query->dns, "DNS %p using cached type %s %s\n", query->dns,
+	       dns_type ( query->qtype ), ( entry->rc ? strerror ( entry->rc ) :
+					  sock_ntoa ( &entry->address.sa ) ) );
+
+	/* Record cached result.  Only the address is copied, so that
+	 * the caller's port number is preserved.
+	 */
+	query->rc = entry->rc;
+	if ( entry->rc != 0 ) {
+		dns_cache_stats.negative++;
+	} else {
+		dns_cache_stats.hits++;
+		query->address.sa.sa_family = entry->address.sa.sa_family;
+		if ( entry->address.sa.sa_family == AF_INET6 ) {
+			memcpy ( &query->address.sin6.sin6_addr,
+				 &entry->address.sin6.sin6_addr,
+				 sizeof ( query->address.sin6.sin6_addr ) );
+		} else {
+			query->address.sin.sin_addr =
+				entry->address.sin.sin_addr;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Start DNS query
+ *
+ * @v dns		DNS request
+ * @v qtype		Query type (in network byte order)
+ * @v name		Name to resolve
+ * @v sa		Socket address to fill in
+ * @v search		Search list
+ * @ret rc		Return status code
+ */
+static int dns_query ( struct dns_request *dns, unsigned int qtype,
+		       const char *name, struct sockaddr *sa,
+		       struct dns_name *search ) {
+	struct dns_query *query = &dns->query[ dns->count++ ];
+	struct dns_header *header;
+	int name_len;
+	int rc;
+
+	/* Initialise query */
+	query->dns = dns;
+	timer_init ( &query->timer, dns_timer_expired, &dns->refcnt );
+	memcpy ( &query->address.sa, sa, sizeof ( query->address.sa ) );
+	memcpy ( &query->search, search, sizeof ( query->search ) );
+	query->qtype = qtype;
+	query->ttl = ~0UL;
+	query->negative_ttl = ~0UL;
+	query->rc = -EINPROGRESS;
+
+	/* Use cached result, if available */
+	if ( dns_cached ( query ) ) {
+		process_add ( &dns->process );
+		return 0;
+	}
+
+	/* Construct query */
+	header = &query->buf.query;
+	header->flags = htons ( DNS_FLAG_RD );
+	header->qdcount = htons ( 1 );
+	query->name.data = &query->buf;
+	query->name.offset = offsetof ( typeof ( query->buf ), name );
+	query->name.len = offsetof ( typeof ( query->buf ), padding );
+	name_len = dns_encode ( name, &query->name );
+	if ( name_len < 0 )
+		return name_len;
+	query->offset = ( offsetof ( typeof ( query->buf ), name ) +
+			  name_len - 1 /* Strip root label */ );
+	if ( ( rc = dns_question ( query ) ) != 0 )
+		return rc;
+
+	/* Open UDP connection, if not already open.  The socket is
+	 * connected to the first DNS server, but queries are sent to
+	 * all DNS servers.
+	 */
+	if ( ( dns->socket.dest == &null_intf ) &&
+	     ( ( rc = xfer_open_socket ( &dns->socket, SOCK_DGRAM,
+					 &nameservers[0].sa, NULL ) ) != 0 ) ){
+		DBGC ( dns, "DNS %p could not open socket: %s\n",
+		       dns, strerror ( rc ) );
+		return rc;
+	}
+
+	/* Start timer to trigger first packet */
+	start_timer_nodelay ( &query->timer );
+
+	return 0;
+}
+
 /**
  * Resolve name using DNS
  *
@@ -893,17 +1456,21 @@ static struct interface_descriptor dns_resolv_desc =
  * @v name		Name to resolve
  * @v sa		Socket address to fill in
  * @ret rc		Return status code
+ *
+ * If an IPv6 DNS server is configured, then AAAA and A queries are
+ * issued in parallel, and each resolved address is reported (with
+ * IPv6 preferred) as soon as it becomes available.
  */
 static int dns_resolv ( struct interface *resolv,
 			const char *name, struct sockaddr *sa ) {
 	struct dns_request *dns;
-	struct dns_header *query;
+	struct dns_name search;
 	size_t search_len;
-	int name_len;
+	size_t cache_name_len;
 	int rc;
 
 	/* Fail immediately if no DNS servers */
-	if ( ! nameserver.sa.sa_family ) {
+	if ( ! dns_servers ) {
 		DBG ( "DNS not attempting to resolve \"%s\": "
 		      "no DNS servers\n", name );
 		rc = -ENXIO_NO_NAMESERVER;
@@ -914,7 +1481,8 @@ static int dns_resolv ( struct interface *resolv,
 	search_len = ( strchr ( name, '.' ) ? 0 : dns_search.len );
 
 	/* Allocate DNS structure */
-	dns = zalloc ( sizeof ( *dns ) + search_len );
+	cache_name_len = ( strlen ( name ) + 1 /* NUL */ );
+	dns = zalloc ( sizeof ( *dns ) + search_len + cache_name_len );
 	if ( ! dns ) {
 		rc = -ENOMEM;
 		goto err_alloc_dns;
@@ -922,62 +1490,36 @@ static int dns_resolv ( struct interface *resolv,
 	ref_init ( &dns->refcnt, NULL );
 	intf_init ( &dns->resolv, &dns_resolv_desc, &dns->refcnt );
 	intf_init ( &dns->socket, &dns_socket_desc, &dns->refcnt );
-	timer_init ( &dns->timer, dns_timer_expired, &dns->refcnt );
-	memcpy ( &dns->address.sa, sa, sizeof ( dns->address.sa ) );
-	dns->search.data = ( ( ( void * ) dns ) + sizeof ( *dns ) );
-	dns->search.len = search_len;
-	memcpy ( dns->search.data, dns_search.data, search_len );
-
-	/* Determine initial query type */
-	switch ( nameserver.sa.sa_family ) {
-	case AF_INET:
-		dns->qtype = htons ( DNS_TYPE_A );
-		break;
-	case AF_INET6:
-		dns->qtype = htons ( DNS_TYPE_AAAA );
-		break;
-	default:
-		rc = -ENOTSUP;
-		goto err_type;
-	}
-
-	/* Construct query */
-	query = &dns->buf.query;
-	query->flags = htons ( DNS_FLAG_RD );
-	query->qdcount = htons ( 1 );
-	dns->name.data = &dns->buf;
-	dns->name.offset = offsetof ( typeof ( dns->buf ), name );
-	dns->name.len = offsetof ( typeof ( dns->buf ), padding );
-	name_len = dns_encode ( name, &dns->name );
-	if ( name_len < 0 ) {
-		rc = name_len;
-		goto err_encode;
-	}
-	dns->offset = ( offsetof ( typeof ( dns->buf ), name ) +
-			name_len - 1 /* Strip root label */ );
-	if ( ( rc = dns_question ( dns ) ) != 0 )
-		goto err_question;
-
-	/* Open UDP connection */
-	if ( ( rc = xfer_open_socket ( &dns->socket, SOCK_DGRAM,
-				       &nameserver.sa, NULL ) ) != 0 ) {
-		DBGC ( dns, "DNS %p could not open socket: %s\n",
-		       dns, strerror ( rc ) );
-		goto err_open_socket;
-	}
+	timer_init ( &dns->delay, dns_delay_expired, &dns->refcnt );
+	process_init_stopped ( &dns->process, &dns_process_desc,
+			       &dns->refcnt );
+	memset ( &search, 0, sizeof ( search ) );
+	search.data = ( ( ( void * ) dns ) + sizeof ( *dns ) );
+	search.len = search_len;
+	memcpy ( search.data, dns_search.data, search_len );
+	dns->cache_name = ( search.data + search_len );
+	memcpy ( dns->cache_name, name, cache_name_len );
+
+	/* Start AAAA query if an IPv6 DNS server is configured.  (DNS
+	 * servers are ordered with IPv6 servers first.)
+	 */
+	if ( ( nameservers[0].sa.sa_family == AF_INET6 ) &&
+	     ( ( rc = dns_query ( dns, htons ( DNS_TYPE_AAAA ), name, sa,
+				  &search ) ) != 0 ) )
+		goto err_query;
 
-	/* Start timer to trigger first packet */
-	start_timer_nodelay ( &dns->timer );
+	/* Start A query */
+	if ( ( rc = dns_query ( dns, htons ( DNS_TYPE_A ), name, sa,
+				&search ) ) != 0 )
+		goto err_query;
 
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dns->resolv, resolv );
 	ref_put ( &dns->refcnt );
-	return 0;	
+	return 0;
 
- err_open_socket:
- err_question:
- err_encode:
- err_type:
+ err_query:
+	dns_done ( dns, rc );
 	ref_put ( &dns->refcnt );
  err_alloc_dns:
  err_no_nameserver:
@@ -1072,18 +1614,22 @@ const struct setting dnssl_setting __setting ( SETTING_IP_EXTRA, dnssl ) = {
 	.type = &setting_type_dnssl,
 };
 
+/** DNS cache maximum lifetime setting */
+const struct setting dnsttl_setting __setting ( SETTING_IP_EXTRA, dnsttl ) = {
+	.name = "dnsttl",
+	.description = "DNS cache maximum lifetime",
+	.tag = DHCP_EB_DNS_TTL,
+	.type = &setting_type_uint32,
+};
+
 /**
- * Apply DNS search list
+ * Fetch DNS search list
  *
  */
-static void apply_dns_search ( void ) {
+static void fetch_dns_search ( void ) {
 	char *localdomain;
 	int len;
 
-	/* Free existing search list */
-	free ( dns_search.data );
-	memset ( &dns_search, 0, sizeof ( dns_search ) );
-
 	/* Fetch DNS search list */
 	len = fetch_setting_copy ( NULL, &dnssl_setting, NULL, NULL,
 				   &dns_search.data );
@@ -1108,29 +1654,110 @@ static void apply_dns_search ( void ) {
 	}
 }
 
+/**
+ * Apply DNS search list
+ *
+ * @ret changed		Search list has changed
+ */
+static int apply_dns_search ( void ) {
+	struct dns_name old;
+	int changed;
+
+	/* Take ownership of existing search list */
+	memcpy ( &old, &dns_search, sizeof ( old ) );
+	memset ( &dns_search, 0, sizeof ( dns_search ) );
+
+	/* Fetch new search list */
+	fetch_dns_search();
+
+	/* Compare against existing search list */
+	changed = ( ( dns_search.len != old.len ) ||
+		    ( memcmp ( dns_search.data, old.data, old.len ) != 0 ) );
+
+	/* Free existing search list */
+	free ( old.data );
+
+	return changed;
+}
+
+/**
+ * Add DNS server
+ *
+ * @v family		Address family
+ * @v addr		Address
+ * @v len		Length of address
+ */
+static void add_dns_server ( sa_family_t family, const void *addr,
+			     size_t len ) {
+	union dns_server *server;
+
+	/* Ignore servers beyond the maximum number */
+	if ( dns_servers >= DNS_MAX_SERVERS )
+		return;
+	server = &nameservers[ dns_servers++ ];
+
+	/* Construct server address */
+	server->st.st_port = htons ( DNS_PORT );
+	server->sa.sa_family = family;
+	if ( family == AF_INET6 ) {
+		memcpy ( &server->sin6.sin6_addr, addr, len );
+	} else {
+		memcpy ( &server->sin.sin_addr, addr, len );
+	}
+	DBG ( "DNS using nameserver %s\n", sock_ntoa ( &server->sa ) );
+}
+
+/**
+ * Apply DNS servers
+ *
+ * @ret changed		DNS servers have changed
+ */
+static int apply_dns_servers ( void ) {
+	union dns_server old[DNS_MAX_SERVERS];
+	unsigned int old_count = dns_servers;
+	struct in6_addr in6[DNS_MAX_SERVERS];
+	struct in_addr in[DNS_MAX_SERVERS];
+	unsigned int count;
+	unsigned int i;
+	int len;
+
+	/* Record existing DNS servers */
+	memcpy ( old, nameservers, sizeof ( old ) );
+	memset ( nameservers, 0, sizeof ( nameservers ) );
+	dns_servers = 0;
+
+	/* Fetch IPv6 DNS servers */
+	len = fetch_ipv6_array_setting ( NULL, &dns6_setting, in6,
+					 DNS_MAX_SERVERS );
+	count = ( ( len > 0 ) ? ( len / sizeof ( in6[0] ) ) : 0 );
+	for ( i = 0 ; ( i < count ) && ( i < DNS_MAX_SERVERS ) ; i++ )
+		add_dns_server ( AF_INET6, &in6[i], sizeof ( in6[i] ) );
+
+	/* Fetch IPv4 DNS servers */
+	len = fetch_ipv4_array_setting ( NULL, &dns_setting, in,
+					 DNS_MAX_SERVERS );
+	count = ( ( len > 0 ) ? ( len / sizeof ( in[0] ) ) : 0 );
+	for ( i = 0 ; ( i < count ) && ( i < DNS_MAX_SERVERS ) ; i++ )
+		add_dns_server ( AF_INET, &in[i], sizeof ( in[i] ) );
+
+	return ( ( dns_servers != old_count ) ||
+		 ( memcmp ( old, nameservers, sizeof ( old ) ) != 0 ) );
+}
+
 /**
  * Apply DNS settings
  *
  * @ret rc		Return status code
  */
 static int apply_dns_settings ( void ) {
+	unsigned long max_ttl;
+	int changed;
 
-	/* Fetch DNS server address */
-	nameserver.sa.sa_family = 0;
-	if ( fetch_ipv6_setting ( NULL, &dns6_setting,
-				  &nameserver.sin6.sin6_addr ) >= 0 ) {
-		nameserver.sin6.sin6_family = AF_INET6;
-	} else if ( fetch_ipv4_setting ( NULL, &dns_setting,
-					 &nameserver.sin.sin_addr ) >= 0 ) {
-		nameserver.sin.sin_family = AF_INET;
-	}
-	if ( nameserver.sa.sa_family ) {
-		DBG ( "DNS using nameserver %s\n",
-		      sock_ntoa ( &nameserver.sa ) );
-	}
+	/* Fetch DNS servers */
+	changed = apply_dns_servers();
 
 	/* Fetch DNS search list */
-	apply_dns_search();
+	changed |= apply_dns_search();
 	if ( DBG_LOG && ( dns_search.len != 0 ) ) {
 		struct dns_name name;
 		int offset;
@@ -1147,6 +1774,17 @@ static int apply_dns_settings ( void ) {
 		DBG ( "\n" );
 	}
 
+	/* Flush DNS cache if DNS servers or search list have changed */
+	if ( changed ) {
+		DBG ( "DNS flushing cache\n" );
+		dns_cache_flush();
+	}
+
+	/* Fetch DNS cache maximum lifetime */
+	if ( fetch_uint_setting ( NULL, &dnsttl_setting, &max_ttl ) < 0 )
+		max_ttl = DNS_CACHE_MAX_TTL;
+	dns_cache_max_ttl = max_ttl;
+
 	return 0;
 }
 
@@ -178,6 +178,13 @@ static void vlan_sync ( struct net_device *netdev ) {
 	struct vlan_device *vlan = netdev->priv;
 	struct net_device *trunk = vlan->trunk;
 
+	/* Synchronise receive checksum capability, since received
+	 * packets are handed to the VLAN device with any checksum
+	 * verification already performed by the trunk device.
+	 */
+	netdev->state &= ~NETDEV_RX_CSUM;
+	netdev->state |= ( trunk->state & NETDEV_RX_CSUM );
+
 	/* Synchronise link status */
 	if ( netdev->link_rc != trunk->link_rc )
 		netdev_link_err ( netdev, trunk->link_rc );
@@ -379,6 +386,8 @@ int vlan_create ( struct net_device *trunk, unsigned int tag,
 	}
 	netdev_init ( netdev, &vlan_operations );
 	netdev->dev = trunk->dev;
+	netdev->max_pkt_len = trunk->max_pkt_len;
+	netdev->mtu = trunk->mtu;
 	memcpy ( netdev->hw_addr, trunk->ll_addr, ETH_ALEN );
 	vlan = netdev->priv;
 	vlan->trunk = netdev_get ( trunk );
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TCP and UDP demultiplexing self-tests
+ *
+ * These tests open several hundred TCP and UDP sockets, check that
+ * received packets are delivered to the correct socket, and measure
+ * the cost of delivering packets both to a single socket and to each
+ * socket in turn.
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/settings.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/socket.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipstat.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
+#include <ipxe/udp.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+#include "testnet.h"
+
+/** Number of open sockets of each type */
+#define DEMUX_TEST_COUNT 256
+
+/** First local TCP port */
+#define DEMUX_TEST_TCP_PORT 20000
+
+/** First local UDP port */
+#define DEMUX_TEST_UDP_PORT 30000
+
+/** Number of iterations used for benchmarking */
+#define DEMUX_TEST_ITERATIONS 16
+
+/** A test socket */
+struct demux_test_socket {
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Number of packets received */
+	unsigned int received;
+};
+
+/** Test TCP sockets */
+static struct demux_test_socket demux_test_tcp[DEMUX_TEST_COUNT];
+
+/** Test UDP sockets */
+static struct demux_test_socket demux_test_udp[DEMUX_TEST_COUNT];
+
+/** Test promiscuous UDP socket */
+static struct demux_test_socket demux_test_promisc;
+
+/** Local IPv4 address */
+static const struct in_addr demux_test_local = {
+	.s_addr = htonl ( 0xc0a86501UL ), /* 192.168.101.1 */
+};
+
+/** Peer IPv4 address */
+static const struct in_addr demux_test_remote = {
+	.s_addr = htonl ( 0xc0a86502UL ), /* 192.168.101.2 */
+};
+
+/** IPv4 netmask */
+static const struct in_addr demux_test_netmask = {
+	.s_addr = htonl ( 0xffffff00UL ),
+};
+
+/**
+ * Receive data on test socket
+ *
+ * @v socket		Test socket
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int demux_test_deliver ( struct demux_test_socket *socket,
+				struct io_buffer *iobuf,
+				struct xfer_metadata *meta __unused ) {
+
+	socket->received++;
+	free_iob ( iobuf );
+	return 0;
+}
+
+/**
+ * Close test socket
+ *
+ * @v socket		Test socket
+ * @v rc		Reason for close
+ */
+static void demux_test_socket_close ( struct demux_test_socket *socket,
+				      int rc ) {
+
+	intf_shutdown ( &socket->xfer, rc );
+}
+
+/** Test socket data transfer interface operations */
+static struct interface_operation demux_test_socket_operations[] = {
+	INTF_OP ( xfer_deliver, struct demux_test_socket *,
+		  demux_test_deliver ),
+	INTF_OP ( intf_close, struct demux_test_socket *,
+		  demux_test_socket_close ),
+};
+
+/** Test socket data transfer interface descriptor */
+static struct interface_descriptor demux_test_socket_desc =
+	INTF_DESC ( struct demux_test_socket, xfer,
+		    demux_test_socket_operations );
+
+/**
+ * Open test socket
+ *
+ * @v socket		Test socket
+ * @v semantics		Communication semantics (e.g. SOCK_STREAM)
+ * @v port		Local port, or zero for a promiscuous UDP socket
+ * @ret rc		Return status code
+ */
+static int demux_test_socket_open ( struct demux_test_socket *socket,
+				    int semantics, unsigned int port ) {
+	struct sockaddr_in peer;
+	struct sockaddr_in local;
+
+	memset ( socket, 0, sizeof ( *socket ) );
+	intf_init ( &socket->xfer, &demux_test_socket_desc, NULL );
+	if ( ! port )
+		return udp_open_promisc ( &socket->xfer );
+	memset ( &peer, 0, sizeof ( peer ) );
+	peer.sin_family = AF_INET;
+	peer.sin_addr = demux_test_remote;
+	peer.sin_port = htons ( 80 );
+	memset ( &local, 0, sizeof ( local ) );
+	local.sin_family = AF_INET;
+	local.sin_port = htons ( port );
+	return xfer_open_socket ( &socket->xfer, semantics,
+				  ( struct sockaddr * ) &peer,
+				  ( struct sockaddr * ) &local );
+}
+
+/**
+ * Receive packet from peer
+ *
+ * @v netdev		Network device
+ * @v tcpip_proto	Transport-layer protocol
+ * @v port		Local port
+ * @ret rc		Return status code
+ *
+ * TCP segments carry no flags and are therefore ignored by the
+ * (not yet established) TCP connection.  UDP packets are delivered
+ * to the receiving socket.
+ */
+static int demux_test_rx ( struct net_device *netdev, uint8_t tcpip_proto,
+			   unsigned int port ) {
+	struct io_buffer *iobuf;
+	struct tcp_header *tcphdr;
+	struct udp_header *udphdr;
+	struct sockaddr_in src;
+	struct sockaddr_in dest;
+	struct ip_statistics stats;
+
+	/* Construct packet */
+	iobuf = alloc_iob ( sizeof ( *tcphdr ) );
+	if ( ! iobuf )
+		return -ENOMEM;
+	if ( tcpip_proto == IP_TCP ) {
+		tcphdr = iob_put ( iobuf, sizeof ( *tcphdr ) );
+		memset ( tcphdr, 0, sizeof ( *tcphdr ) );
+		tcphdr->src = htons ( 80 );
+		tcphdr->dest = htons ( port );
+		tcphdr->hlen = ( ( sizeof ( *tcphdr ) / 4 ) << 4 );
+		tcphdr->win = htons ( 1024 );
+	} else {
+		udphdr = iob_put ( iobuf, sizeof ( *udphdr ) );
+		udphdr->src = htons ( 80 );
+		udphdr->dest = htons ( port );
+		udphdr->len = htons ( sizeof ( *udphdr ) );
+		udphdr->chksum = 0;
+	}
+	iobuf->flags |= IOB_CSUM_VERIFIED;
+
+	/* Hand packet to transport layer */
+	memset ( &src, 0, sizeof ( src ) );
+	src.sin_family = AF_INET;
+	src.sin_addr = demux_test_remote;
+	memset ( &dest, 0, sizeof ( dest ) );
+	dest.sin_family = AF_INET;
+	dest.sin_addr = demux_test_local;
+	memset ( &stats, 0, sizeof ( stats ) );
+	return tcpip_rx ( iobuf, netdev, tcpip_proto,
+			  ( struct sockaddr_tcpip * ) &src,
+			  ( struct sockaddr_tcpip * ) &dest, 0, &stats );
+}
+
+/**
+ * Measure cost of receiving packets
+ *
+ * @v netdev		Network device
+ * @v tcpip_proto	Transport-layer protocol
+ * @v port		First local port
+ */
+static void demux_test_benchmark ( struct net_device *netdev,
+				   uint8_t tcpip_proto, unsigned int port ) {
+	struct profiler single;
+	struct profiler rotating;
+	unsigned int i;
+	unsigned int j;
+
+	/* Measure packets all received by the first-opened socket,
+	 * and packets received by each socket in turn.
+	 */
+	memset ( &single, 0, sizeof ( single ) );
+	memset ( &rotating, 0, sizeof ( rotating ) );
+	for ( i = 0 ; i < DEMUX_TEST_ITERATIONS ; i++ ) {
+		for ( j = 0 ; j < DEMUX_TEST_COUNT ; j++ ) {
+			profile_start ( &single );
+			demux_test_rx ( netdev, tcpip_proto, port );
+			profile_stop ( &single );
+		}
+		for ( j = 0 ; j < DEMUX_TEST_COUNT ; j++ ) {
+			profile_start ( &rotating );
+			demux_test_rx ( netdev, tcpip_proto, ( port + j ) );
+			profile_stop ( &rotating );
+		}
+	}
+	DBG ( "%s demux with %d sockets: single %ld +/- %ld ticks, rotating "
+	      "%ld +/- %ld ticks\n", ( ( tcpip_proto == IP_TCP ) ?
+				       "TCP" : "UDP" ), DEMUX_TEST_COUNT,
+	      profile_mean ( &single ), profile_stddev ( &single ),
+	      profile_mean ( &rotating ), profile_stddev ( &rotating ) );
+}
+
+/**
+ * Perform demultiplexing self-tests
+ *
+ */
+static void demux_test_exec ( void ) {
+	struct net_device *netdev;
+	struct settings *settings;
+	unsigned int total;
+	unsigned int i;
+
+	/* Create and open test network device */
+	netdev = testnet_create ( 0, NULL, NULL );
+	ok ( netdev != NULL );
+	if ( ! netdev )
+		return;
+	settings = netdev_settings ( netdev );
+	ok ( store_setting ( settings, &ip_setting, &demux_test_local,
+			     sizeof ( demux_test_local ) ) == 0 );
+	ok ( store_setting ( settings, &netmask_setting, &demux_test_netmask,
+			     sizeof ( demux_test_netmask ) ) == 0 );
+
+	/* Open sockets */
+	for ( i = 0 ; i < DEMUX_TEST_COUNT ; i++ ) {
+		ok ( demux_test_socket_open ( &demux_test_tcp[i], SOCK_STREAM,
+					      ( DEMUX_TEST_TCP_PORT + i ) ) == 0 );
+		ok ( demux_test_socket_open ( &demux_test_udp[i], SOCK_DGRAM,
+					      ( DEMUX_TEST_UDP_PORT + i ) ) == 0 );
+	}
+
+	/* Ports already in use should be refused */
+	ok ( demux_test_socket_open ( &demux_test_promisc, SOCK_STREAM,
+				      DEMUX_TEST_TCP_PORT ) != 0 );
+	ok ( demux_test_socket_open ( &demux_test_promisc, SOCK_DGRAM,
+				      DEMUX_TEST_UDP_PORT ) != 0 );
+
+	/* Segments should reach only open TCP connections */
+	for ( i = 0 ; i < DEMUX_TEST_COUNT ; i++ ) {
+		ok ( demux_test_rx ( netdev, IP_TCP,
+				     ( DEMUX_TEST_TCP_PORT + i ) ) == 0 );
+	}
+	ok ( demux_test_rx ( netdev, IP_TCP,
+			     ( DEMUX_TEST_TCP_PORT - 1 ) ) != 0 );
+	ok ( demux_test_rx ( netdev, IP_TCP,
+			     ( DEMUX_TEST_TCP_PORT + DEMUX_TEST_COUNT ) ) != 0 );
+
+	/* Packets should reach only the matching UDP socket */
+	for ( i = 0 ; i < DEMUX_TEST_COUNT ; i++ ) {
+		ok ( demux_test_rx ( netdev, IP_UDP,
+				     ( DEMUX_TEST_UDP_PORT + i ) ) == 0 );
+		ok ( demux_test_rx ( netdev, IP_UDP,
+				     ( DEMUX_TEST_UDP_PORT + i ) ) == 0 );
+	}
+	for ( i = 0 ; i < DEMUX_TEST_COUNT ; i++ )
+		ok ( demux_test_udp[i].received == 2 );
+	ok ( demux_test_rx ( netdev, IP_UDP, DEMUX_TEST_TCP_PORT ) != 0 );
+
+	/* Bound UDP sockets should take precedence over a promiscuous
+	 * socket, which should receive everything else.
+	 */
+	ok ( demux_test_socket_open ( &demux_test_promisc, SOCK_DGRAM,
+				      0 ) == 0 );
+	ok ( demux_test_rx ( netdev, IP_UDP, DEMUX_TEST_UDP_PORT ) == 0 );
+	ok ( demux_test_udp[0].received == 3 );
+	ok ( demux_test_promisc.received == 0 );
+	ok ( demux_test_rx ( netdev, IP_UDP, DEMUX_TEST_TCP_PORT ) == 0 );
+	ok ( demux_test_promisc.received == 1 );
+	intf_shutdown ( &demux_test_promisc.xfer, 0 );
+
+	/* Measure demultiplexing cost */
+	demux_test_benchmark ( netdev, IP_TCP, DEMUX_TEST_TCP_PORT );
+	demux_test_benchmark ( netdev, IP_UDP, DEMUX_TEST_UDP_PORT );
+	for ( total = 0, i = 0 ; i < DEMUX_TEST_COUNT ; i++ )
+		total += demux_test_udp[i].received;
+	ok ( total == ( ( 2 * DEMUX_TEST_COUNT ) + 1 +
+			( 2 * DEMUX_TEST_ITERATIONS * DEMUX_TEST_COUNT ) ) );
+
+	/* Closed sockets should no longer receive packets, even if
+	 * most recently used.
+	 */
+	for ( i = 0 ; i < DEMUX_TEST_COUNT ; i++ ) {
+		intf_shutdown ( &demux_test_tcp[i].xfer, 0 );
+		ok ( demux_test_rx ( netdev, IP_TCP,
+				     ( DEMUX_TEST_TCP_PORT + i ) ) != 0 );
+		ok ( demux_test_rx ( netdev, IP_UDP,
+				     ( DEMUX_TEST_UDP_PORT + i ) ) == 0 );
+		intf_shutdown ( &demux_test_udp[i].xfer, 0 );
+		ok ( demux_test_rx ( netdev, IP_UDP,
+				     ( DEMUX_TEST_UDP_PORT + i ) ) != 0 );
+	}
+
+	/* Close and remove test network device */
+	testnet_remove ( netdev );
+}
+
+/** Demultiplexing self-test */
+struct self_test demux_test __self_test = {
+	.name = "demux",
+	.exec = demux_test_exec,
+};
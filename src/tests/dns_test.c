@@ -32,8 +32,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /* Forcibly enable assertions */
 #undef NDEBUG
 
+#include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <assert.h>
+#include <byteswap.h>
 #include <ipxe/dns.h>
 #include <ipxe/test.h>
 
@@ -556,6 +559,88 @@ DNS_LIST ( search,
 	   DATA ( "ipxe.org", "boot.ipxe.org", "dev.boot.ipxe.org",
 		  "networkboot.org" ) );
 
+/**
+ * Perform DNS cache self-tests
+ *
+ */
+static void dns_cache_test ( void ) {
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl ( 0xc0000201 ),
+	};
+	struct sockaddr *sa = ( ( struct sockaddr * ) &sin );
+	struct dns_cache_entry *entry;
+	unsigned int count;
+	unsigned int i;
+	char name[32];
+
+	/* Start with an empty cache */
+	dns_cache_flush();
+	ok ( list_empty ( &dns_cache ) );
+
+	/* Positive entry is found case-insensitively, by type */
+	dns_cache_add ( "boot.ipxe.org", htons ( DNS_TYPE_A ), sa, 0, 60 );
+	entry = dns_cache_find ( "BOOT.ipxe.org", htons ( DNS_TYPE_A ) );
+	ok ( entry != NULL );
+	ok ( entry->rc == 0 );
+	ok ( entry->address.sin.sin_family == AF_INET );
+	ok ( entry->address.sin.sin_addr.s_addr == sin.sin_addr.s_addr );
+	ok ( dns_cache_remaining ( entry ) > 0 );
+	ok ( dns_cache_remaining ( entry ) <= 60 );
+	ok ( dns_cache_find ( "boot.ipxe.org",
+			      htons ( DNS_TYPE_AAAA ) ) == NULL );
+	ok ( dns_cache_find ( "boot", htons ( DNS_TYPE_A ) ) == NULL );
+
+	/* Negative entry records status code */
+	dns_cache_add ( "missing.ipxe.org", htons ( DNS_TYPE_A ), NULL,
+			-ENOENT, 30 );
+	entry = dns_cache_find ( "missing.ipxe.org", htons ( DNS_TYPE_A ) );
+	ok ( entry != NULL );
+	ok ( entry->rc == -ENOENT );
+
+	/* Long time to live is capped */
+	dns_cache_add ( "long.ipxe.org", htons ( DNS_TYPE_A ), sa, 0, 86400 );
+	entry = dns_cache_find ( "long.ipxe.org", htons ( DNS_TYPE_A ) );
+	ok ( entry != NULL );
+	ok ( dns_cache_remaining ( entry ) <= DNS_CACHE_MAX_TTL );
+
+	/* Zero time to live replaces existing entry but is not cached */
+	dns_cache_add ( "boot.ipxe.org", htons ( DNS_TYPE_A ), sa, 0, 0 );
+	ok ( dns_cache_find ( "boot.ipxe.org",
+			      htons ( DNS_TYPE_A ) ) == NULL );
+
+	/* Least recently used entries are evicted when cache is full */
+	for ( i = 0 ; i < ( DNS_CACHE_MAX_ENTRIES + 4 ) ; i++ ) {
+		snprintf ( name, sizeof ( name ), "host%d.ipxe.org", i );
+		dns_cache_add ( name, htons ( DNS_TYPE_A ), sa, 0, 60 );
+		if ( i == 8 ) {
+			ok ( dns_cache_find ( "long.ipxe.org",
+					      htons ( DNS_TYPE_A ) ) != NULL );
+		}
+	}
+	count = 0;
+	list_for_each_entry ( entry, &dns_cache, list )
+		count++;
+	ok ( count == DNS_CACHE_MAX_ENTRIES );
+	ok ( dns_cache_find ( "missing.ipxe.org",
+			      htons ( DNS_TYPE_A ) ) == NULL );
+	ok ( dns_cache_find ( "host0.ipxe.org",
+			      htons ( DNS_TYPE_A ) ) == NULL );
+	ok ( dns_cache_find ( "host4.ipxe.org",
+			      htons ( DNS_TYPE_A ) ) == NULL );
+	ok ( dns_cache_find ( "host5.ipxe.org",
+			      htons ( DNS_TYPE_A ) ) != NULL );
+	ok ( dns_cache_find ( "long.ipxe.org",
+			      htons ( DNS_TYPE_A ) ) != NULL );
+	snprintf ( name, sizeof ( name ), "host%d.ipxe.org",
+		   ( DNS_CACHE_MAX_ENTRIES + 3 ) );
+	ok ( dns_cache_find ( name, htons ( DNS_TYPE_A ) ) != NULL );
+
+	/* Flush empties cache */
+	dns_cache_flush();
+	ok ( list_empty ( &dns_cache ) );
+}
+
 /**
  * Perform DNS self-test
  *
@@ -600,6 +685,9 @@ static void dns_test_exec ( void ) {
 
 	/* Search list tets */
 	dns_list_ok ( &search );
+
+	/* Cache tests */
+	dns_cache_test();
 }
 
 /** DNS self-test */
@@ -0,0 +1,587 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Fragment reassembly self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
+#include <ipxe/ipstat.h>
+#include <ipxe/fragment.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+
+/** Length of a 64kB UDP datagram (including UDP header) */
+#define FRAGMENT_TEST_LEN ( 65535 - 20 )
+
+/** Length of fragment data (as for an IPv4 MTU of 1500 bytes) */
+#define FRAGMENT_TEST_MTU 1480
+
+/** Maximum number of fragments in a test packet */
+#define FRAGMENT_TEST_MAX 256
+
+/** Number of iterations used for benchmarking */
+#define FRAGMENT_TEST_ITERATIONS 64
+
+/** A test fragment header (the non-fragmentable portion) */
+struct fragment_test_header {
+	/** Packet identifier */
+	uint32_t ident;
+	/** Fragment offset */
+	uint32_t offset;
+	/** More fragments exist */
+	uint8_t more;
+	/** Padding */
+	uint8_t pad[3];
+} __attribute__ (( packed ));
+
+/** A test fragment */
+struct fragment_test_fragment {
+	/** Offset */
+	size_t offset;
+	/** Length */
+	size_t len;
+};
+
+/** Test fragments */
+static struct fragment_test_fragment fragment_test_frags[FRAGMENT_TEST_MAX];
+
+/** Test IP statistics */
+static struct ip_statistics fragment_test_stats;
+
+/**
+ * Check if test fragment matches fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret is_fragment	Fragment matches this reassembly buffer
+ */
+static int fragment_test_is_fragment ( struct fragment *fragment,
+				       struct io_buffer *iobuf,
+				       size_t hdrlen __unused ) {
+	struct fragment_test_header *frag_hdr = fragment->hdr;
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return ( hdr->ident == frag_hdr->ident );
+}
+
+/**
+ * Get test fragment offset
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret offset		Offset
+ */
+static size_t fragment_test_offset ( struct io_buffer *iobuf,
+				     size_t hdrlen __unused ) {
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return hdr->offset;
+}
+
+/**
+ * Check if more test fragments exist
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret more_frags	More fragments exist
+ */
+static int fragment_test_more ( struct io_buffer *iobuf,
+				size_t hdrlen __unused ) {
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return hdr->more;
+}
+
+/** Test fragment reassembler */
+static struct fragment_reassembler fragment_test_reassembler = {
+	.list = LIST_HEAD_INIT ( fragment_test_reassembler.list ),
+	.is_fragment = fragment_test_is_fragment,
+	.fragment_offset = fragment_test_offset,
+	.more_fragments = fragment_test_more,
+	.stats = &fragment_test_stats,
+};
+
+/**
+ * Get expected packet content
+ *
+ * @v ident		Packet identifier
+ * @v offset		Offset within packet
+ * @ret byte		Expected data byte
+ */
+static uint8_t fragment_test_byte ( uint32_t ident, size_t offset ) {
+
+	return ( ( ( offset + ident ) * 0x9e3779b1UL ) >> 24 );
+}
+
+/**
+ * Construct fragment
+ *
+ * @v ident		Packet identifier
+ * @v offset		Fragment offset
+ * @v len		Fragment length
+ * @v more		More fragments exist
+ * @ret iobuf		I/O buffer, or NULL
+ */
+static struct io_buffer * fragment_test_frag ( uint32_t ident, size_t offset,
+					       size_t len, int more ) {
+	struct fragment_test_header *hdr;
+	struct io_buffer *iobuf;
+	uint8_t *data;
+	size_t i;
+
+	iobuf = alloc_iob ( sizeof ( *hdr ) + len );
+	if ( ! iobuf )
+		return NULL;
+	hdr = iob_put ( iobuf, sizeof ( *hdr ) );
+	hdr->ident = ident;
+	hdr->offset = offset;
+	hdr->more = more;
+	data = iob_put ( iobuf, len );
+	for ( i = 0 ; i < len ; i++ )
+		data[i] = fragment_test_byte ( ident, ( offset + i ) );
+	return iobuf;
+}
+
+/**
+ * Receive fragment
+ *
+ * @v ident		Packet identifier
+ * @v offset		Fragment offset
+ * @v len		Fragment length
+ * @v more		More fragments exist
+ * @v hdrlen		Length of non-fragmentable portion to fill in
+ * @ret iobuf		Reassembled packet, or NULL
+ */
+static struct io_buffer * fragment_test_rx ( uint32_t ident, size_t offset,
+					     size_t len, int more,
+					     size_t *hdrlen ) {
+	struct io_buffer *iobuf;
+
+	iobuf = fragment_test_frag ( ident, offset, len, more );
+	if ( ! iobuf )
+		return NULL;
+	*hdrlen = sizeof ( struct fragment_test_header );
+	return fragment_reassemble ( &fragment_test_reassembler, iobuf,
+				     hdrlen );
+}
+
+/**
+ * Check reassembled packet
+ *
+ * @v iobuf		Reassembled packet
+ * @v hdrlen		Length of non-fragmentable portion
+ * @v ident		Packet identifier
+ * @v len		Expected packet length
+ * @ret ok		Packet is correct
+ */
+static int fragment_test_check ( struct io_buffer *iobuf, size_t hdrlen,
+				 uint32_t ident, size_t len ) {
+	struct fragment_test_header *hdr = iobuf->data;
+	const uint8_t *data = ( iobuf->data + hdrlen );
+	size_t i;
+
+	if ( hdrlen != sizeof ( *hdr ) )
+		return 0;
+	if ( iob_len ( iobuf ) != ( hdrlen + len ) )
+		return 0;
+	if ( ( hdr->ident != ident ) || ( hdr->offset != 0 ) )
+		return 0;
+	for ( i = 0 ; i < len ; i++ ) {
+		if ( data[i] != fragment_test_byte ( ident, i ) )
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * Split packet into fragments
+ *
+ * @v len		Packet length
+ * @v mtu		Maximum fragment length
+ * @v overlap		Maximum overlap between adjacent fragments
+ * @ret count		Number of fragments
+ */
+static unsigned int fragment_test_split ( size_t len, size_t mtu,
+					  size_t overlap ) {
+	struct fragment_test_fragment *frag = fragment_test_frags;
+	size_t offset = 0;
+	unsigned int count = 0;
+	size_t back;
+
+	while ( offset < len ) {
+		assert ( count < FRAGMENT_TEST_MAX );
+		back = ( ( overlap && offset ) ?
+			 ( random() % ( overlap + 1 ) ) : 0 );
+		if ( back > offset )
+			back = offset;
+		frag->offset = ( offset - back );
+		frag->len = ( len - frag->offset );
+		if ( frag->len > mtu )
+			frag->len = mtu;
+		offset = ( frag->offset + frag->len );
+		frag++;
+		count++;
+	}
+	return count;
+}
+
+/**
+ * Shuffle fragments
+ *
+ * @v count		Number of fragments
+ */
+static void fragment_test_shuffle ( unsigned int count ) {
+	struct fragment_test_fragment tmp;
+	unsigned int i;
+	unsigned int j;
+
+	for ( i = ( count - 1 ) ; i > 0 ; i-- ) {
+		j = ( random() % ( i + 1 ) );
+		memcpy ( &tmp, &fragment_test_frags[i], sizeof ( tmp ) );
+		memcpy ( &fragment_test_frags[i], &fragment_test_frags[j],
+			 sizeof ( fragment_test_frags[i] ) );
+		memcpy ( &fragment_test_frags[j], &tmp,
+			 sizeof ( fragment_test_frags[j] ) );
+	}
+}
+
+/**
+ * Report packet reassembly test result
+ *
+ * @v ident		Packet identifier
+ * @v len		Packet length
+ * @v mtu		Maximum fragment length
+ * @v overlap		Maximum overlap between adjacent fragments
+ * @v shuffle		Shuffle fragments
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void fragment_reassemble_okx ( uint32_t ident, size_t len, size_t mtu,
+				      size_t overlap, int shuffle,
+				      const char *file, unsigned int line ) {
+	struct fragment_test_fragment *frag;
+	struct io_buffer *iobuf = NULL;
+	size_t hdrlen = 0;
+	unsigned int count;
+	unsigned int i;
+
+	/* Construct fragments */
+	count = fragment_test_split ( len, mtu, overlap );
+	if ( shuffle )
+		fragment_test_shuffle ( count );
+
+	/* Receive fragments */
+	for ( i = 0 ; i < count ; i++ ) {
+		okx ( iobuf == NULL, file, line );
+		frag = &fragment_test_frags[i];
+		iobuf = fragment_test_rx ( ident, frag->offset, frag->len,
+					   ( ( frag->offset + frag->len ) < len ),
+					   &hdrlen );
+	}
+
+	/* Check reassembled packet */
+	okx ( iobuf != NULL, file, line );
+	if ( ! iobuf )
+		return;
+	okx ( fragment_test_check ( iobuf, hdrlen, ident, len ), file, line );
+	okx ( iob_headroom ( iobuf ) >= MAX_LL_HEADER_LEN, file, line );
+	free_iob ( iobuf );
+}
+#define fragment_reassemble_ok( ident, len, mtu, overlap, shuffle )	\
+	fragment_reassemble_okx ( ident, len, mtu, overlap, shuffle,	\
+				  __FILE__, __LINE__ )
+
+/**
+ * Check reassembly with duplicated and superseded fragments
+ *
+ */
+static void fragment_duplicate_test ( void ) {
+	static const struct fragment_test_fragment frags[] = {
+		{ 1000, 1000 }, { 1000, 1000 }, { 1200, 300 }, { 500, 2000 },
+		{ 2500, 500 }, { 0, 3000 },
+	};
+	struct io_buffer *iobuf = NULL;
+	size_t hdrlen = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( frags ) / sizeof ( frags[0] ) ) ; i++ ) {
+		ok ( iobuf == NULL );
+		iobuf = fragment_test_rx ( 0x200, frags[i].offset, frags[i].len,
+					   ( ( frags[i].offset + frags[i].len )
+					     < 3000 ), &hdrlen );
+	}
+	ok ( iobuf != NULL );
+	if ( iobuf ) {
+		ok ( fragment_test_check ( iobuf, hdrlen, 0x200, 3000 ) );
+		free_iob ( iobuf );
+	}
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+	ok ( fragment_test_reassembler.size == 0 );
+}
+
+/**
+ * Check reassembly of several interleaved packets
+ *
+ */
+static void fragment_interleave_test ( void ) {
+	struct fragment_test_fragment *frag;
+	struct io_buffer *iobuf;
+	size_t hdrlen;
+	unsigned int count;
+	unsigned int done = 0;
+	unsigned int i;
+	uint32_t ident;
+
+	/* Send each fragment of eight packets in turn, in reverse */
+	count = fragment_test_split ( 8000, 1000, 0 );
+	for ( i = count ; i-- ; ) {
+		frag = &fragment_test_frags[i];
+		for ( ident = 0 ; ident < 8 ; ident++ ) {
+			iobuf = fragment_test_rx ( ident, frag->offset,
+						   frag->len, ( i != ( count - 1 ) ),
+						   &hdrlen );
+			if ( ! iobuf )
+				continue;
+			ok ( i == 0 );
+			ok ( fragment_test_check ( iobuf, hdrlen, ident,
+						   8000 ) );
+			free_iob ( iobuf );
+			done++;
+		}
+	}
+	ok ( done == 8 );
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+}
+
+/**
+ * Check rejection of inconsistent fragments
+ *
+ */
+static void fragment_inconsistent_test ( void ) {
+	unsigned long fails = fragment_test_stats.reasm_fails;
+	size_t hdrlen;
+
+	/* Final fragment ending before received data */
+	ok ( fragment_test_rx ( 1, 2000, 1000, 1, &hdrlen ) == NULL );
+	ok ( fragment_test_rx ( 1, 1000, 500, 0, &hdrlen ) == NULL );
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+
+	/* Conflicting final fragments */
+	ok ( fragment_test_rx ( 2, 1000, 1000, 0, &hdrlen ) == NULL );
+	ok ( fragment_test_rx ( 2, 1000, 500, 0, &hdrlen ) == NULL );
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+
+	/* Fragment beyond final fragment */
+	ok ( fragment_test_rx ( 3, 1000, 1000, 0, &hdrlen ) == NULL );
+	ok ( fragment_test_rx ( 3, 1500, 1000, 1, &hdrlen ) == NULL );
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+
+	ok ( fragment_test_stats.reasm_fails == ( fails + 3 ) );
+}
+
+/**
+ * Wait for incomplete packets to expire
+ *
+ */
+static void fragment_expire_test ( void ) {
+	unsigned long start;
+
+	start = currticks();
+	while ( ( ! list_empty ( &fragment_test_reassembler.list ) ) &&
+		( ( currticks() - start ) < ( 4 * FRAGMENT_TIMEOUT ) ) ) {
+		step();
+	}
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+	ok ( fragment_test_reassembler.size == 0 );
+}
+
+/**
+ * Check enforcement of memory budget
+ *
+ */
+static void fragment_budget_test ( void ) {
+	struct io_buffer *iobuf;
+	unsigned long fails = fragment_test_stats.reasm_fails;
+	unsigned int count;
+	size_t hdrlen;
+	uint32_t ident;
+
+	/* Start more incomplete packets than can fit in the budget */
+	for ( count = 0 ; fragment_test_stats.reasm_fails == fails ;
+	      count++ ) {
+		if ( count > ( FRAGMENT_BUDGET / FRAGMENT_TEST_MTU ) )
+			break;
+		ok ( fragment_test_reassembler.size <= FRAGMENT_BUDGET );
+		ok ( fragment_test_rx ( count, 0, FRAGMENT_TEST_MTU, 1,
+					&hdrlen ) == NULL );
+	}
+	ok ( fragment_test_stats.reasm_fails == ( fails + 1 ) );
+	ok ( fragment_test_reassembler.size <= FRAGMENT_BUDGET );
+
+	/* The oldest packet should have been discarded, and the
+	 * newest packet should still be completable.
+	 */
+	ident = ( count - 1 );
+	iobuf = fragment_test_rx ( 0, FRAGMENT_TEST_MTU, 1, 0, &hdrlen );
+	ok ( iobuf == NULL );
+	iobuf = fragment_test_rx ( ident, FRAGMENT_TEST_MTU, 1, 0, &hdrlen );
+	ok ( iobuf != NULL );
+	if ( iobuf ) {
+		ok ( fragment_test_check ( iobuf, hdrlen, ident,
+					   ( FRAGMENT_TEST_MTU + 1 ) ) );
+		free_iob ( iobuf );
+	}
+
+	/* Incomplete packets should expire */
+	fragment_expire_test();
+
+	/* A single packet too large for the budget should fail */
+	fails = fragment_test_stats.reasm_fails;
+	for ( count = 0 ; fragment_test_stats.reasm_fails == fails ;
+	      count++ ) {
+		if ( count > ( FRAGMENT_BUDGET / FRAGMENT_TEST_MTU ) )
+			break;
+		ok ( fragment_test_reassembler.size <= FRAGMENT_BUDGET );
+		ok ( fragment_test_rx ( 0x1000, ( count * FRAGMENT_TEST_MTU ),
+					FRAGMENT_TEST_MTU, 1,
+					&hdrlen ) == NULL );
+	}
+	ok ( fragment_test_stats.reasm_fails == ( fails + 1 ) );
+	ok ( count > ( FRAGMENT_BUDGET / ( 2 * FRAGMENT_TEST_MTU ) ) );
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+	ok ( fragment_test_reassembler.size == 0 );
+}
+
+/**
+ * Measure cost of reassembling 64kB datagrams
+ *
+ * @v shuffle		Shuffle fragments
+ */
+static void fragment_benchmark ( int shuffle ) {
+	struct fragment_test_fragment *frag;
+	struct io_buffer *iobufs[FRAGMENT_TEST_MAX];
+	struct io_buffer *iobuf = NULL;
+	struct profiler profiler;
+	unsigned long elapsed;
+	size_t hdrlen;
+	unsigned int count;
+	unsigned int i;
+	unsigned int j;
+
+	/* Construct fragments */
+	count = fragment_test_split ( FRAGMENT_TEST_LEN, FRAGMENT_TEST_MTU, 0 );
+	if ( shuffle )
+		fragment_test_shuffle ( count );
+
+	/* Measure reassembly, excluding fragment construction */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < FRAGMENT_TEST_ITERATIONS ; i++ ) {
+		for ( j = 0 ; j < count ; j++ ) {
+			frag = &fragment_test_frags[j];
+			iobufs[j] = fragment_test_frag ( i, frag->offset,
+							 frag->len,
+							 ( ( frag->offset +
+							     frag->len ) <
+							   FRAGMENT_TEST_LEN ) );
+			assert ( iobufs[j] != NULL );
+		}
+		profile_start ( &profiler );
+		for ( j = 0 ; j < count ; j++ ) {
+			hdrlen = sizeof ( struct fragment_test_header );
+			iobuf = fragment_reassemble ( &fragment_test_reassembler,
+						      iobufs[j], &hdrlen );
+		}
+		profile_stop ( &profiler );
+		ok ( iobuf != NULL );
+		if ( iobuf ) {
+			ok ( fragment_test_check ( iobuf, hdrlen, i,
+						   FRAGMENT_TEST_LEN ) );
+			free_iob ( iobuf );
+		}
+	}
+	elapsed = profile_mean ( &profiler );
+	DBG ( "FRAGMENT reassembled %d-byte datagram from %d %sfragments in "
+	      "%ld +/- %ld ticks\n", FRAGMENT_TEST_LEN, count,
+	      ( shuffle ? "shuffled " : "" ), elapsed,
+	      profile_stddev ( &profiler ) );
+}
+
+/**
+ * Perform fragment reassembly self-tests
+ *
+ */
+static void fragment_test_exec ( void ) {
+
+	/* Use a fixed seed for reproducibility */
+	srandom ( 0x3f4a );
+
+	/* In-order, shuffled, and overlapping fragments */
+	fragment_reassemble_ok ( 0x100, 3000, 1480, 0, 0 );
+	fragment_reassemble_ok ( 0x101, FRAGMENT_TEST_LEN, 1480, 0, 0 );
+	fragment_reassemble_ok ( 0x102, FRAGMENT_TEST_LEN, 1480, 0, 1 );
+	fragment_reassemble_ok ( 0x103, FRAGMENT_TEST_LEN, 512, 0, 1 );
+	fragment_reassemble_ok ( 0x104, FRAGMENT_TEST_LEN, 1480, 400, 0 );
+	fragment_reassemble_ok ( 0x105, FRAGMENT_TEST_LEN, 1480, 400, 1 );
+	fragment_reassemble_ok ( 0x106, 20000, 1000, 500, 1 );
+	fragment_reassemble_ok ( 0x107, 7, 1, 0, 1 );
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+	ok ( fragment_test_reassembler.size == 0 );
+
+	/* Duplicated and superseded fragments */
+	fragment_duplicate_test();
+
+	/* Interleaved packets */
+	fragment_interleave_test();
+
+	/* Inconsistent fragments */
+	fragment_inconsistent_test();
+
+	/* Memory budget */
+	fragment_budget_test();
+
+	/* Benchmark */
+	fragment_benchmark ( 0 );
+	fragment_benchmark ( 1 );
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+}
+
+/** Fragment reassembly self-test */
+struct self_test fragment_test __self_test = {
+	.name = "fragment",
+	.exec = fragment_test_exec,
+};
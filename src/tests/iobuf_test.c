@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef NDEBUG
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <ipxe/iobuf.h>
@@ -99,6 +100,132 @@ static inline void alloc_iob_fail_okx ( size_t len, size_t align, size_t offset,
 #define alloc_iob_fail_ok( len, align, offset ) \
 	alloc_iob_fail_okx ( len, align, offset, __FILE__, __LINE__ )
 
+/**
+ * Perform I/O buffer recycling pool self-tests
+ *
+ */
+static void iob_pool_test_exec ( void ) {
+	struct io_buffer_pool pool;
+	struct io_buffer *first;
+	struct io_buffer *second;
+	struct io_buffer *iobuf;
+
+	/* Initialise pool */
+	memset ( &pool, 0, sizeof ( pool ) );
+	iob_pool_init ( &pool, 1, NULL );
+
+	/* Allocate two buffers from an empty pool */
+	first = iob_pool_alloc ( &pool, 1536 );
+	ok ( first != NULL );
+	ok ( iob_tailroom ( first ) >= 1536 );
+	second = iob_pool_alloc ( &pool, 1536 );
+	ok ( second != NULL );
+	ok ( pool.hits == 0 );
+	ok ( pool.misses == 2 );
+
+	/* Free both buffers; only one should be retained */
+	iob_put ( first, 100 );
+	free_iob ( first );
+	free_iob ( second );
+	ok ( pool.count == 1 );
+
+	/* Reallocate a buffer; it should be recycled and empty */
+	iobuf = iob_pool_alloc ( &pool, 1536 );
+	ok ( iobuf == first );
+	ok ( iob_len ( iobuf ) == 0 );
+	ok ( iob_headroom ( iobuf ) == 0 );
+	ok ( pool.hits == 1 );
+	ok ( pool.count == 0 );
+	free_iob ( iobuf );
+	ok ( pool.count == 1 );
+
+	/* Changing length should discard recycled buffers */
+	iobuf = iob_pool_alloc ( &pool, 64 );
+	ok ( iobuf != NULL );
+	ok ( pool.hits == 1 );
+	ok ( pool.misses == 3 );
+	free_iob ( iobuf );
+
+	/* Shut down pool */
+	iob_pool_fini ( &pool );
+	ok ( pool.count == 0 );
+}
+
+/**
+ * Perform I/O buffer cursor self-tests
+ *
+ */
+static void iob_cursor_test_exec ( void ) {
+	static const char text[] = "Hello world, this is a test";
+	struct iob_cursor cursor;
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+	LIST_HEAD ( list );
+	char buf[ sizeof ( text ) ];
+	const void *data;
+	void *copy;
+	static const size_t splits[] = { 5, 0, 7, 15 };
+	const char *pos = text;
+	unsigned int i;
+
+	/* Construct list of buffers (including an empty buffer) */
+	for ( i = 0 ; i < ( sizeof ( splits ) / sizeof ( splits[0] ) ) ; i++ ){
+		iobuf = alloc_iob ( splits[i] );
+		ok ( iobuf != NULL );
+		memcpy ( iob_put ( iobuf, splits[i] ), pos, splits[i] );
+		pos += splits[i];
+		list_add_tail ( &iobuf->list, &list );
+	}
+	ok ( ( ( size_t ) ( pos - text ) ) == ( sizeof ( text ) - 1 ) );
+
+	/* Check remaining length */
+	iob_cursor_init ( &cursor, &list );
+	ok ( iob_cursor_len ( &cursor ) == ( sizeof ( text ) - 1 ) );
+
+	/* Pull data within a single buffer: should not copy */
+	ok ( iob_cursor_pull ( &cursor, 3, &data, &copy ) == 0 );
+	ok ( copy == NULL );
+	ok ( memcmp ( data, "Hel", 3 ) == 0 );
+
+	/* Pull data spanning buffers: should copy */
+	ok ( iob_cursor_pull ( &cursor, 6, &data, &copy ) == 0 );
+	ok ( copy != NULL );
+	ok ( memcmp ( data, "lo wor", 6 ) == 0 );
+	free ( copy );
+	ok ( iob_cursor_len ( &cursor ) == ( sizeof ( text ) - 10 ) );
+
+	/* Skip data */
+	ok ( iob_cursor_copy ( &cursor, NULL, 4 ) == 0 );
+
+	/* Copy remaining data */
+	memset ( buf, 0, sizeof ( buf ) );
+	ok ( iob_cursor_copy ( &cursor, buf, ( sizeof ( text ) - 14 ) ) == 0 );
+	ok ( strcmp ( buf, ( text + 13 ) ) == 0 );
+	ok ( iob_cursor_len ( &cursor ) == 0 );
+
+	/* Reading beyond end of data should fail */
+	ok ( iob_cursor_copy ( &cursor, buf, 1 ) != 0 );
+	ok ( iob_cursor_pull ( &cursor, 1, &data, &copy ) != 0 );
+	ok ( copy == NULL );
+
+	/* Reading beyond end of data should fail from start of list */
+	iob_cursor_init ( &cursor, &list );
+	ok ( iob_cursor_pull ( &cursor, sizeof ( text ), &data, &copy ) != 0 );
+	ok ( copy == NULL );
+
+	/* Free buffers */
+	list_for_each_entry_safe ( iobuf, tmp, &list, list ) {
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
+
+	/* Check empty list */
+	iob_cursor_init ( &cursor, &list );
+	ok ( iob_cursor_len ( &cursor ) == 0 );
+	ok ( iob_cursor_copy ( &cursor, buf, 0 ) == 0 );
+	ok ( iob_cursor_copy ( &cursor, buf, 1 ) != 0 );
+}
+
 /**
  * Perform I/O buffer self-tests
  *
@@ -127,6 +254,12 @@ static void iobuf_test_exec ( void ) {
 	alloc_iob_fail_ok ( -1UL, 1024, 0 );
 	alloc_iob_fail_ok ( 0, -1UL, 0 );
 	alloc_iob_fail_ok ( 1024, -1UL, 0 );
+
+	/* Check recycling pools */
+	iob_pool_test_exec();
+
+	/* Check cursors */
+	iob_cursor_test_exec();
 }
 
 /** I/O buffer self-test */
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Dynamic memory allocation self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/malloc.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/io.h>
+#include <ipxe/test.h>
+#include <ipxe/profile.h>
+
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 16
+
+/** Number of blocks used to fragment the heap */
+#define FRAGMENT_COUNT 64
+
+/** Size of large blocks used to fragment the heap */
+#define FRAGMENT_SIZE 3000
+
+/** Size of blocks used to force the heap to grow */
+#define GROWTH_SIZE ( 1024 * 1024 )
+
+/** Large blocks used to fragment the heap */
+static void *fragments[FRAGMENT_COUNT];
+
+/** Small blocks used to fragment the heap */
+static void *small_fragments[FRAGMENT_COUNT];
+
+/**
+ * Report a memory block allocation test result
+ *
+ * @v size		Requested size
+ * @v align		Physical alignment
+ * @v offset		Offset from physical alignment
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void malloc_dma_okx ( size_t size, size_t align, size_t offset,
+			     const char *file, unsigned int line ) {
+	uint8_t *ptr;
+	uint8_t *other;
+
+	/* Allocate two blocks, to check that they do not overlap */
+	ptr = malloc_dma_offset ( size, align, offset );
+	okx ( ptr != NULL, file, line );
+	other = malloc_dma_offset ( size, align, offset );
+	okx ( other != NULL, file, line );
+	okx ( ( ( ptr + size ) <= other ) || ( ( other + size ) <= ptr ),
+	      file, line );
+
+	/* Validate alignment */
+	okx ( ( virt_to_phys ( ptr ) & ( align - 1 ) ) ==
+	      ( offset & ( align - 1 ) ), file, line );
+	okx ( ( virt_to_phys ( other ) & ( align - 1 ) ) ==
+	      ( offset & ( align - 1 ) ), file, line );
+
+	/* Check that contents are preserved */
+	memset ( ptr, 0xa5, size );
+	memset ( other, 0x5a, size );
+	okx ( ptr[0] == 0xa5, file, line );
+	okx ( ptr[ size - 1 ] == 0xa5, file, line );
+	okx ( other[0] == 0x5a, file, line );
+	okx ( other[ size - 1 ] == 0x5a, file, line );
+
+	/* Free blocks */
+	free_dma ( ptr, size );
+	free_dma ( other, size );
+}
+#define malloc_dma_ok( size, align, offset ) \
+	malloc_dma_okx ( size, align, offset, __FILE__, __LINE__ )
+
+/**
+ * Test memory block allocation and free speed
+ *
+ * @v size		Block size
+ * @v align		Physical alignment
+ * @v state		Heap state description
+ */
+static void malloc_test_speed ( size_t size, size_t align,
+				const char *state ) {
+	struct profiler alloc_profiler;
+	struct profiler free_profiler;
+	void *ptr[PROFILE_COUNT];
+	unsigned int i;
+
+	/* Profile allocations and frees */
+	memset ( &alloc_profiler, 0, sizeof ( alloc_profiler ) );
+	memset ( &free_profiler, 0, sizeof ( free_profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &alloc_profiler );
+		ptr[i] = malloc_dma ( size, align );
+		profile_stop ( &alloc_profiler );
+		ok ( ptr[i] != NULL );
+	}
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &free_profiler );
+		free_dma ( ptr[i], size );
+		profile_stop ( &free_profiler );
+	}
+
+	DBG ( "MALLOC %s %#zx (align %#zx) alloc %ld +/- %ld ticks, free %ld "
+	      "+/- %ld ticks\n", state, size, align,
+	      profile_mean ( &alloc_profiler ),
+	      profile_stddev ( &alloc_profiler ),
+	      profile_mean ( &free_profiler ),
+	      profile_stddev ( &free_profiler ) );
+}
+
+/**
+ * Test speed of a representative set of allocations
+ *
+ * @v state		Heap state description
+ */
+static void malloc_test_speeds ( const char *state ) {
+
+	malloc_test_speed ( 64, 1, state );
+	malloc_test_speed ( 200, 1, state );
+	malloc_test_speed ( ( IOB_ZLEN + sizeof ( struct io_buffer ) ),
+			    128, state );
+	malloc_test_speed ( 1600, 2048, state );
+	malloc_test_speed ( 4096, 1, state );
+	malloc_test_speed ( 8192, 1, state );
+}
+
+/**
+ * Perform heap growth self-tests
+ *
+ */
+static void malloc_growth_test_exec ( void ) {
+	unsigned int regions = heapregions;
+	size_t used = ( heapmem - freemem );
+	unsigned int grown;
+	size_t grown_used;
+	uint8_t *first;
+	uint8_t *second;
+
+	/* Allocate blocks larger than the initial heap.  The first
+	 * block may reuse a retained idle region, and cheaply
+	 * replaced cached data (e.g. empty slab pages) may be
+	 * discarded before the heap is grown, so measure the second
+	 * growth relative to the first.
+	 */
+	first = malloc ( GROWTH_SIZE );
+	ok ( first != NULL );
+	grown = heapregions;
+	grown_used = ( heapmem - freemem );
+	second = malloc ( GROWTH_SIZE );
+	ok ( second != NULL );
+	ok ( heapregions == ( grown + 1 ) );
+	ok ( ( heapmem - freemem ) >= ( grown_used + GROWTH_SIZE ) );
+	ok ( maxusedmem >= ( heapmem - freemem ) );
+	memset ( first, 0xaa, GROWTH_SIZE );
+	memset ( second, 0xbb, GROWTH_SIZE );
+	ok ( first[ GROWTH_SIZE - 1 ] == 0xaa );
+	ok ( second[0] == 0xbb );
+
+	/* Free blocks: at most one idle region should be retained */
+	free ( first );
+	free ( second );
+	ok ( heapregions <= ( regions + 1 ) );
+	ok ( ( heapmem - freemem ) <= used );
+
+	/* Reallocate: should not leave more than one region in use */
+	first = malloc ( GROWTH_SIZE );
+	ok ( first != NULL );
+	free ( first );
+	ok ( heapregions <= ( regions + 1 ) );
+}
+
+/**
+ * Perform dynamic memory allocation self-tests
+ *
+ */
+static void malloc_test_exec ( void ) {
+	void *ptr;
+	unsigned int i;
+
+	/* Check small allocations */
+	malloc_dma_ok ( 1, 1, 0 );
+	malloc_dma_ok ( 24, 8, 0 );
+	malloc_dma_ok ( 64, 64, 0 );
+	malloc_dma_ok ( 100, 128, 0 );
+	malloc_dma_ok ( 1500, 2048, 0 );
+	malloc_dma_ok ( 2048, 2048, 0 );
+
+	/* Check small allocations not naturally aligned by size */
+	malloc_dma_ok ( 64, 4096, 0 );
+	malloc_dma_ok ( 256, 1024, 19 );
+	malloc_dma_ok ( 2048, 2048, -10 );
+
+	/* Check large allocations */
+	malloc_dma_ok ( 2049, 1, 0 );
+	malloc_dma_ok ( 8192, 4096, 0 );
+
+	/* Check reallocation across size classes */
+	ptr = malloc ( 10 );
+	ok ( ptr != NULL );
+	memset ( ptr, 0x33, 10 );
+	ptr = realloc ( ptr, 5000 );
+	ok ( ptr != NULL );
+	ok ( ( ( uint8_t * ) ptr )[9] == 0x33 );
+	ptr = realloc ( ptr, 3 );
+	ok ( ptr != NULL );
+	ok ( ( ( uint8_t * ) ptr )[2] == 0x33 );
+	free ( ptr );
+
+	/* Check heap growth */
+	malloc_growth_test_exec();
+
+	/* Speed tests with an unfragmented heap */
+	malloc_test_speeds ( "unfragmented" );
+
+	/* Fragment the heap by freeing every other block */
+	for ( i = 0 ; i < FRAGMENT_COUNT ; i++ ) {
+		fragments[i] = malloc ( FRAGMENT_SIZE );
+		ok ( fragments[i] != NULL );
+		small_fragments[i] = malloc ( 40 + ( ( i % 7 ) * 100 ) );
+		ok ( small_fragments[i] != NULL );
+	}
+	for ( i = 0 ; i < FRAGMENT_COUNT ; i += 2 ) {
+		free ( fragments[i] );
+		fragments[i] = NULL;
+		free ( small_fragments[i] );
+		small_fragments[i] = NULL;
+	}
+
+	/* Speed tests with a fragmented heap */
+	malloc_test_speeds ( "fragmented" );
+
+	/* Free remaining fragments */
+	for ( i = 0 ; i < FRAGMENT_COUNT ; i++ ) {
+		free ( fragments[i] );
+		free ( small_fragments[i] );
+	}
+}
+
+/** Dynamic memory allocation self-test */
+struct self_test malloc_test __self_test = {
+	.name = "malloc",
+	.exec = malloc_test_exec,
+};
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Network device MTU self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/settings.h>
+#include <ipxe/interface.h>
+#include <ipxe/test.h>
+#include "testnet.h"
+
+/** Maximum MTU supported by test network device */
+#define MTU_TEST_MAX 9000
+
+/** Network device to which the test configurator applies */
+static struct net_device *mtu_test_netdev;
+
+/** Test configuration job control interface */
+static struct interface mtu_test_job;
+
+/**
+ * Close test configuration
+ *
+ * @v job		Job control interface
+ * @v rc		Reason for close
+ */
+static void mtu_test_close ( struct interface *job, int rc ) {
+
+	/* Report completion back to the network device, as a real
+	 * configurator (e.g. DHCP) would do.
+	 */
+	intf_shutdown ( job, rc );
+}
+
+/** Test configuration job control interface operations */
+static struct interface_operation mtu_test_job_op[] = {
+	INTF_OP ( intf_close, struct interface *, mtu_test_close ),
+};
+
+/** Test configuration job control interface descriptor */
+static struct interface_descriptor mtu_test_job_desc =
+	INTF_DESC_PURE ( mtu_test_job_op );
+
+/**
+ * Check applicability of test configurator
+ *
+ * @v netdev		Network device
+ * @ret applies		Configurator applies to this network device
+ */
+static int mtu_test_applies ( struct net_device *netdev ) {
+
+	return ( netdev == mtu_test_netdev );
+}
+
+/**
+ * Start test configuration
+ *
+ * @v job		Job control interface
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int mtu_test_start ( struct interface *job,
+			    struct net_device *netdev __unused ) {
+
+	intf_init ( &mtu_test_job, &mtu_test_job_desc, NULL );
+	intf_plug_plug ( &mtu_test_job, job );
+	return 0;
+}
+
+/** Test network device configurator */
+struct net_device_configurator mtu_test_configurator
+	__net_device_configurator = {
+	.name = "mtutest",
+	.applies = mtu_test_applies,
+	.start = mtu_test_start,
+};
+
+/**
+ * Enqueue marker packet to detect network device reopening
+ *
+ * @v netdev		Network device
+ *
+ * Closing the network device will discard the marker packet.
+ */
+static void mtu_test_mark ( struct net_device *netdev ) {
+	struct io_buffer *iobuf;
+
+	iobuf = alloc_iob ( ETH_ZLEN );
+	ok ( iobuf != NULL );
+	if ( ! iobuf )
+		return;
+	memset ( iob_put ( iobuf, ETH_ZLEN ), 0, ETH_ZLEN );
+	netdev_rx ( netdev, iobuf );
+}
+
+/**
+ * Check whether network device was reopened since being marked
+ *
+ * @v netdev		Network device
+ * @ret reopened	Network device was reopened
+ */
+static int mtu_test_reopened ( struct net_device *netdev ) {
+	struct io_buffer *iobuf;
+
+	iobuf = netdev_rx_dequeue ( netdev );
+	free_iob ( iobuf );
+	return ( ( iobuf == NULL ) && netdev_is_open ( netdev ) );
+}
+
+/**
+ * Report MTU setting test result
+ *
+ * @v netdev		Network device
+ * @v value		MTU setting value
+ * @v mtu		Expected resulting MTU
+ * @v reopen		Network device is expected to be reopened
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void mtu_store_okx ( struct net_device *netdev, const char *value,
+			    size_t mtu, int reopen, const char *file,
+			    unsigned int line ) {
+
+	mtu_test_mark ( netdev );
+	okx ( storef_setting ( netdev_settings ( netdev ), &mtu_setting,
+			       value ) == 0, file, line );
+	okx ( netdev->mtu == mtu, file, line );
+	okx ( mtu_test_reopened ( netdev ) == reopen, file, line );
+}
+#define mtu_store_ok( netdev, value, mtu, reopen ) \
+	mtu_store_okx ( netdev, value, mtu, reopen, __FILE__, __LINE__ )
+
+/**
+ * Perform network device MTU self-tests
+ *
+ */
+static void mtu_test_exec ( void ) {
+	struct net_device *netdev;
+
+	/* Create and open test network device */
+	netdev = testnet_create ( 0, NULL, NULL );
+	ok ( netdev != NULL );
+	if ( ! netdev )
+		return;
+	netdev->max_pkt_len = ( MTU_TEST_MAX + ETH_HLEN );
+	mtu_test_netdev = netdev;
+	ok ( netdev->mtu == ETH_MAX_MTU );
+
+	/* MTU set directly should be applied immediately */
+	mtu_store_ok ( netdev, "9000", 9000, 1 );
+	mtu_store_ok ( netdev, "1000", 1000, 1 );
+	mtu_store_ok ( netdev, "1000", 1000, 0 );
+
+	/* MTU below the minimum should be ignored */
+	mtu_store_ok ( netdev, "500", 1000, 0 );
+
+	/* MTU above the hardware maximum should be limited */
+	mtu_store_ok ( netdev, "65000", MTU_TEST_MAX, 1 );
+
+	/* MTU set during configuration should be deferred until the
+	 * configuration completes.
+	 */
+	ok ( netdev_configure ( netdev, &mtu_test_configurator ) == 0 );
+	ok ( netdev_configuration_in_progress ( netdev ) );
+	mtu_store_ok ( netdev, "4000", MTU_TEST_MAX, 0 );
+	mtu_test_mark ( netdev );
+	intf_shutdown ( &mtu_test_job, 0 );
+	ok ( ! netdev_configuration_in_progress ( netdev ) );
+	ok ( netdev_configuration_ok ( netdev ) == 1 );
+	ok ( netdev->mtu == 4000 );
+	ok ( mtu_test_reopened ( netdev ) );
+
+	/* Deferred MTU should not be applied if the configuration is
+	 * cancelled by closing the network device.
+	 */
+	ok ( netdev_configure ( netdev, &mtu_test_configurator ) == 0 );
+	mtu_store_ok ( netdev, "2000", 4000, 0 );
+	netdev_close ( netdev );
+	ok ( ! netdev_configuration_in_progress ( netdev ) );
+	ok ( ! netdev_is_open ( netdev ) );
+	ok ( netdev->mtu == 4000 );
+
+	/* Remove test network device */
+	mtu_test_netdev = NULL;
+	testnet_remove ( netdev );
+}
+
+/** Network device MTU self-test */
+struct self_test mtu_test __self_test = {
+	.name = "mtu",
+	.exec = mtu_test_exec,
+};
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Network device self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <config/general.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/test.h>
+#include "testnet.h"
+
+/** Number of packets delivered by the test device in each poll */
+#define NETDEV_TEST_BURST 8
+
+/** A test network device */
+struct netdev_test {
+	/** Number of packets remaining to be delivered */
+	unsigned int pending;
+	/** Number of packets delivered per poll */
+	unsigned int burst;
+};
+
+/**
+ * Poll test network device
+ *
+ * @v netdev		Network device
+ */
+static void netdev_test_poll ( struct net_device *netdev ) {
+	struct netdev_test *test = netdev->priv;
+	struct io_buffer *iobuf;
+	struct ethhdr *ethhdr;
+	LIST_HEAD ( batch );
+	unsigned int i;
+
+	/* Deliver a burst of packets with an unknown protocol */
+	for ( i = 0 ; ( i < test->burst ) && test->pending ; i++ ) {
+		iobuf = alloc_iob ( sizeof ( *ethhdr ) );
+		if ( ! iobuf )
+			break;
+		ethhdr = iob_put ( iobuf, sizeof ( *ethhdr ) );
+		memset ( ethhdr->h_dest, 0xff, sizeof ( ethhdr->h_dest ) );
+		memcpy ( ethhdr->h_source, netdev->ll_addr,
+			 sizeof ( ethhdr->h_source ) );
+		ethhdr->h_protocol = htons ( 0x88b5 );
+		list_add_tail ( &iobuf->list, &batch );
+		test->pending--;
+	}
+	netdev_rx_batch ( netdev, &batch );
+	ok ( list_empty ( &batch ) );
+}
+
+/**
+ * Perform network device receive budget self-tests
+ *
+ */
+static void netdev_budget_test_exec ( void ) {
+	struct net_device *netdev;
+	struct netdev_test *test;
+	unsigned int received;
+
+	/* Create and open test network device */
+	netdev = testnet_create ( sizeof ( *test ), NULL, netdev_test_poll );
+	ok ( netdev != NULL );
+	if ( ! netdev )
+		return;
+	test = netdev->priv;
+
+	/* Small bursts should be repolled until the budget is exhausted */
+	test->burst = NETDEV_TEST_BURST;
+	test->pending = ( 2 * NET_RX_BUDGET ) + 1;
+	received = netdev->rx_stats.good;
+	net_poll();
+	ok ( ( netdev->rx_stats.good - received ) == NET_RX_BUDGET );
+	ok ( netdev->rx_budget.repolls ==
+	     ( ( NET_RX_BUDGET / NETDEV_TEST_BURST ) - 1 ) );
+	ok ( netdev->rx_budget.exhausted == 1 );
+	ok ( list_empty ( &netdev->rx_queue ) );
+
+	/* Remaining packets should be delivered in subsequent polls */
+	net_poll();
+	net_poll();
+	ok ( test->pending == 0 );
+	ok ( ( netdev->rx_stats.good - received ) ==
+	     ( ( 2 * NET_RX_BUDGET ) + 1 ) );
+	ok ( netdev->rx_budget.exhausted == 2 );
+	ok ( list_empty ( &netdev->rx_queue ) );
+
+	/* A burst larger than the budget should be left on the queue */
+	test->burst = ( NET_RX_BUDGET + 1 );
+	test->pending = test->burst;
+	net_poll();
+	ok ( netdev->rx_budget.exhausted == 3 );
+	ok ( ! list_empty ( &netdev->rx_queue ) );
+	net_poll();
+	ok ( netdev->rx_budget.exhausted == 3 );
+	ok ( list_empty ( &netdev->rx_queue ) );
+
+	/* Record an overrun */
+	netdev_rx_overrun ( netdev );
+	ok ( netdev->rx_budget.overruns == 1 );
+
+	/* Close and remove test network device */
+	testnet_remove ( netdev );
+}
+
+/**
+ * Perform network device self-tests
+ *
+ */
+static void netdev_test_exec ( void ) {
+
+	netdev_budget_test_exec();
+}
+
+/** Network device self-test */
+struct self_test netdev_test __self_test = {
+	.name = "netdev",
+	.exec = netdev_test_exec,
+};
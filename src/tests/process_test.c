@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Process scheduler self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/process.h>
+#include <ipxe/test.h>
+
+/** Number of steps used to test scheduling */
+#define PROCESS_TEST_STEPS 64
+
+/** Maximum number of steps to wait for the scheduler to become idle */
+#define PROCESS_TEST_MAX_STEPS 1024
+
+/** A process test */
+struct process_test {
+	/** Process */
+	struct process process;
+	/** Number of times process has been stepped */
+	unsigned int count;
+	/** Process reports activity when stepped */
+	int busy;
+};
+
+/**
+ * Single-step test process
+ *
+ * @v test		Process test
+ */
+static void process_test_step ( struct process_test *test ) {
+
+	test->count++;
+	if ( test->busy )
+		process_activity();
+}
+
+/** Normal priority test process descriptor */
+static struct process_descriptor process_test_desc =
+	PROC_DESC ( struct process_test, process, process_test_step );
+
+/** High priority test process descriptor */
+static struct process_descriptor process_test_high_desc = {
+	.offset = process_offset ( struct process_test, process ),
+	.step = PROC_STEP ( struct process_test, process_test_step ),
+	.reschedule = 1,
+	.priority = PROC_PRIO_HIGH,
+	.profiler = { .name = "process_test_step" },
+};
+
+/**
+ * Perform process scheduler self-tests
+ *
+ */
+static void process_test_exec ( void ) {
+	struct process_test normal;
+	struct process_test high;
+	unsigned int i;
+
+	/* Start one normal and one high priority process */
+	memset ( &normal, 0, sizeof ( normal ) );
+	memset ( &high, 0, sizeof ( high ) );
+	process_init ( &normal.process, &process_test_desc, NULL );
+	process_init ( &high.process, &process_test_high_desc, NULL );
+	ok ( process_running ( &normal.process ) );
+	ok ( process_running ( &high.process ) );
+
+	/* High priority process should receive around half of all
+	 * steps, and normal priority process should not be starved.
+	 */
+	high.busy = 1;
+	for ( i = 0 ; i < PROCESS_TEST_STEPS ; i++ )
+		step();
+	ok ( high.count >= ( PROCESS_TEST_STEPS / 4 ) );
+	ok ( high.count <= ( ( PROCESS_TEST_STEPS / 2 ) + 1 ) );
+	ok ( normal.count > 0 );
+
+	/* Scheduler should not be idle while a process is busy */
+	ok ( ! process_idle() );
+
+	/* Scheduler should become idle once no process is busy */
+	high.busy = 0;
+	for ( i = 0 ; ( i < PROCESS_TEST_MAX_STEPS ) && ! process_idle() ; i++ )
+		step();
+	ok ( process_idle() );
+
+	/* An idle process should not be stepped */
+	process_del ( &high.process );
+	ok ( ! process_running ( &high.process ) );
+	high.count = 0;
+	for ( i = 0 ; i < PROCESS_TEST_STEPS ; i++ )
+		step();
+	ok ( high.count == 0 );
+	ok ( process_idle() );
+
+	/* Waking a process should leave the scheduler non-idle */
+	process_add ( &high.process );
+	ok ( ! process_idle() );
+	step();
+	ok ( high.count == 1 );
+
+	/* Stop processes */
+	process_del ( &normal.process );
+	process_del ( &high.process );
+	ok ( ! process_running ( &normal.process ) );
+	ok ( ! process_running ( &high.process ) );
+}
+
+/** Process scheduler self-test */
+struct self_test process_test __self_test = {
+	.name = "process",
+	.exec = process_test_exec,
+};
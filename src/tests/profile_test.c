@@ -103,14 +103,17 @@ static void profile_okx ( struct profile_test *test, const char *file,
 	struct profiler profiler;
 	unsigned long mean;
 	unsigned long stddev;
+	unsigned long long total = 0;
 	unsigned int i;
 
 	/* Initialise profiler */
 	memset ( &profiler, 0, sizeof ( profiler ) );
 
 	/* Record sample values */
-	for ( i = 0 ; i < test->count ; i++ )
+	for ( i = 0 ; i < test->count ; i++ ) {
 		profile_update ( &profiler, test->samples[i] );
+		total += test->samples[i];
+	}
 
 	/* Check resulting statistics */
 	mean = profile_mean ( &profiler );
@@ -118,6 +121,15 @@ static void profile_okx ( struct profile_test *test, const char *file,
 	DBGC ( test, "PROFILE calculated mean %ld stddev %ld\n", mean, stddev );
 	okx ( mean == test->mean, file, line );
 	okx ( stddev == test->stddev, file, line );
+	okx ( profiler.total == total, file, line );
+
+	/* Reset profiler */
+	profiler.name = "test";
+	profile_reset ( &profiler );
+	okx ( profiler.count == 0, file, line );
+	okx ( profiler.total == 0, file, line );
+	okx ( profile_mean ( &profiler ) == 0, file, line );
+	okx ( strcmp ( profiler.name, "test" ) == 0, file, line );
 }
 #define profile_ok( test ) profile_okx ( test, __FILE__, __LINE__ )
 
@@ -0,0 +1,960 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Name resolution and named socket self-tests
+ *
+ * These tests resolve names via simulated DNS servers attached to a
+ * test network device, and open named stream sockets to simulated
+ * TCP peers reached via the same device.
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/neighbour.h>
+#include <ipxe/settings.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/socket.h>
+#include <ipxe/resolv.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipv6.h>
+#include <ipxe/udp.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
+#include <ipxe/dns.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
+#include <ipxe/test.h>
+#include "testnet.h"
+
+/** Maximum time allowed for each test */
+#define RESOLV_TEST_TIMEOUT ( 5 * TICKS_PER_SEC )
+
+/** Connection attempt delay used by named sockets */
+#define RESOLV_TEST_ATTEMPT_DELAY ( TICKS_PER_SEC / 4 )
+
+/** Peer port */
+#define RESOLV_TEST_PORT 4242
+
+/** Peer initial sequence number */
+#define RESOLV_TEST_ISN 0x12345678UL
+
+/** Response delay indicating that a server never responds */
+#define RESOLV_TEST_NEVER ( ~0UL )
+
+/** Maximum number of delayed packets */
+#define RESOLV_TEST_MAX_PENDING 16
+
+/** Maximum number of resolved addresses recorded */
+#define RESOLV_TEST_MAX_RESULTS 4
+
+/** Number of simulated DNS servers */
+#define RESOLV_TEST_SERVERS 2
+
+/** A simulated DNS server */
+struct resolv_test_server {
+	/** IPv4 address to report, or zero for no A record */
+	struct in_addr in;
+	/** IPv6 address to report, or zero for no AAAA record */
+	struct in6_addr in6;
+	/** Delay before responding to A queries */
+	unsigned long delay_a;
+	/** Delay before responding to AAAA queries */
+	unsigned long delay_aaaa;
+};
+
+/** A delayed packet */
+struct resolv_test_pending {
+	/** I/O buffer, or NULL if unused */
+	struct io_buffer *iobuf;
+	/** Time at which packet should be received */
+	unsigned long due;
+};
+
+/** A simulated network */
+struct resolv_test_net {
+	/** Simulated DNS servers */
+	struct resolv_test_server server[RESOLV_TEST_SERVERS];
+	/** Delayed packets */
+	struct resolv_test_pending pending[RESOLV_TEST_MAX_PENDING];
+	/** Number of DNS queries received by each server */
+	unsigned int queries[RESOLV_TEST_SERVERS];
+	/** Time at which accepting peer first received a SYN */
+	unsigned long syn_time;
+	/** Accepting peer has received a SYN */
+	int syn;
+};
+
+/** A test name resolution consumer */
+struct resolv_test_resolver {
+	/** Name resolution interface */
+	struct interface resolv;
+	/** Resolved addresses */
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} results[RESOLV_TEST_MAX_RESULTS];
+	/** Time at which each address was resolved */
+	unsigned long times[RESOLV_TEST_MAX_RESULTS];
+	/** Number of resolved addresses */
+	unsigned int count;
+	/** Completion status (if closed) */
+	int rc;
+	/** Resolution has completed */
+	int closed;
+};
+
+/** A test application */
+struct resolv_test_app {
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Connected peer address */
+	struct sockaddr_in peer;
+	/** Application was redirected to peer address */
+	int redirected;
+	/** Application was notified of connected peer address */
+	int connected;
+	/** Connection is ready for data */
+	int ready;
+	/** Time at which connection became ready */
+	unsigned long ready_time;
+	/** Connection close status (if closed) */
+	int rc;
+	/** Connection has been closed */
+	int closed;
+};
+
+/** Local IPv4 address */
+static const struct in_addr resolv_test_local = {
+	.s_addr = htonl ( 0xc0a8c801UL ), /* 192.168.200.1 */
+};
+
+/** IPv4 netmask */
+static const struct in_addr resolv_test_netmask = {
+	.s_addr = htonl ( 0xffffff00UL ),
+};
+
+/** IPv4 DNS servers */
+static const struct in_addr resolv_test_dns[RESOLV_TEST_SERVERS] = {
+	{ .s_addr = htonl ( 0xc0a8c835UL ) }, /* 192.168.200.53 */
+	{ .s_addr = htonl ( 0xc0a8c836UL ) }, /* 192.168.200.54 */
+};
+
+/** IPv4 peer that accepts connections */
+static const struct in_addr resolv_test_accept = {
+	.s_addr = htonl ( 0xc0a8c80aUL ), /* 192.168.200.10 */
+};
+
+/** IPv4 peer that refuses connections */
+static const struct in_addr resolv_test_refuse = {
+	.s_addr = htonl ( 0xc0a8c80bUL ), /* 192.168.200.11 */
+};
+
+/** Alternative IPv4 address */
+static const struct in_addr resolv_test_other = {
+	.s_addr = htonl ( 0xc0a8c80cUL ), /* 192.168.200.12 */
+};
+
+/** Local IPv6 address */
+static const struct in6_addr resolv_test_local6 = {
+	.s6_addr = { 0xfd, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 },
+};
+
+/** Local IPv6 prefix length */
+static const uint8_t resolv_test_len6 = 64;
+
+/** IPv6 DNS server (which never responds) */
+static const struct in6_addr resolv_test_dns6 = {
+	.s6_addr = { 0xfd, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x53 },
+};
+
+/** On-link IPv6 peer (which never responds) */
+static const struct in6_addr resolv_test_stall6 = {
+	.s6_addr = { 0xfd, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+};
+
+/** Unreachable IPv6 peer */
+static const struct in6_addr resolv_test_unreachable6 = {
+	.s6_addr = { 0x20, 0x01, 0x0d, 0xb8, 0x00, 0x00, 0x00, 0x00,
+		     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+};
+
+/** Simulated peer MAC address */
+static const uint8_t resolv_test_remote_mac[ETH_ALEN] = {
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x53
+};
+
+/**
+ * Transmit IPv4 packet from simulated network
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer containing transport-layer packet
+ * @v src		Source address
+ * @v protocol		Transport-layer protocol
+ * @v csum		Transport-layer checksum field
+ * @v delay		Delay before packet is received
+ */
+static void resolv_test_tx ( struct net_device *netdev,
+			     struct io_buffer *iobuf, struct in_addr src,
+			     unsigned int protocol, uint16_t *csum,
+			     unsigned long delay ) {
+	struct resolv_test_net *net = netdev->priv;
+	struct ipv4_pseudo_header pshdr;
+	struct ethhdr *ethhdr;
+	struct iphdr *iphdr;
+	unsigned int i;
+	uint16_t sum;
+
+	/* Calculate transport-layer checksum */
+	pshdr.src = src;
+	pshdr.dest = resolv_test_local;
+	pshdr.zero_padding = 0;
+	pshdr.protocol = protocol;
+	pshdr.len = htons ( iob_len ( iobuf ) );
+	sum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	*csum = tcpip_continue_chksum ( sum, &pshdr, sizeof ( pshdr ) );
+
+	/* Construct IPv4 header */
+	iphdr = iob_push ( iobuf, sizeof ( *iphdr ) );
+	memset ( iphdr, 0, sizeof ( *iphdr ) );
+	iphdr->verhdrlen = ( IP_VER | ( sizeof ( *iphdr ) / 4 ) );
+	iphdr->len = htons ( iob_len ( iobuf ) );
+	iphdr->ttl = 64;
+	iphdr->protocol = protocol;
+	iphdr->src = src;
+	iphdr->dest = resolv_test_local;
+	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+
+	/* Construct Ethernet header */
+	ethhdr = iob_push ( iobuf, sizeof ( *ethhdr ) );
+	memcpy ( ethhdr->h_dest, netdev->ll_addr, ETH_ALEN );
+	memcpy ( ethhdr->h_source, resolv_test_remote_mac, ETH_ALEN );
+	ethhdr->h_protocol = htons ( ETH_P_IP );
+
+	/* Hand packet to network device immediately, if applicable */
+	if ( ! delay ) {
+		netdev_rx ( netdev, iobuf );
+		return;
+	}
+
+	/* Otherwise, hold packet until it is due */
+	for ( i = 0 ; i < RESOLV_TEST_MAX_PENDING ; i++ ) {
+		if ( ! net->pending[i].iobuf ) {
+			net->pending[i].iobuf = iobuf;
+			net->pending[i].due = ( currticks() + delay );
+			return;
+		}
+	}
+	free_iob ( iobuf );
+}
+
+/**
+ * Receive DNS query at simulated DNS server
+ *
+ * @v netdev		Network device
+ * @v index		DNS server index
+ * @v udphdr		UDP header
+ * @v len		Length of UDP packet
+ */
+static void resolv_test_dns_rx ( struct net_device *netdev,
+				 unsigned int index,
+				 struct udp_header *udphdr, size_t len ) {
+	struct resolv_test_net *net = netdev->priv;
+	struct resolv_test_server *server = &net->server[index];
+	static const struct in6_addr none6;
+	struct dns_header *query = ( ( ( void * ) udphdr ) +
+				     sizeof ( *udphdr ) );
+	struct dns_question *question;
+	struct dns_header *response;
+	struct udp_header *rsphdr;
+	struct io_buffer *iobuf;
+	union dns_rr *rr = NULL;
+	uint16_t *ptr;
+	unsigned long delay = 0;
+	size_t qlen = ( len - sizeof ( *udphdr ) );
+
+	/* Identify query type */
+	net->queries[index]++;
+	question = ( ( ( void * ) query ) + qlen - sizeof ( *question ) );
+
+	/* Allocate I/O buffer */
+	iobuf = alloc_iob ( 128 + qlen + sizeof ( *rr ) );
+	if ( ! iobuf )
+		return;
+	iob_reserve ( iobuf, ( sizeof ( struct ethhdr ) +
+			       sizeof ( struct iphdr ) ) );
+
+	/* Construct response, echoing the question */
+	rsphdr = iob_put ( iobuf, sizeof ( *rsphdr ) );
+	response = iob_put ( iobuf, qlen );
+	memcpy ( response, query, qlen );
+	response->flags = htons ( 0x8180 );
+	response->ancount = 0;
+
+	/* Add answer, if applicable */
+	if ( question->qtype == htons ( DNS_TYPE_A ) ) {
+		delay = server->delay_a;
+		if ( server->in.s_addr ) {
+			ptr = iob_put ( iobuf, sizeof ( *ptr ) );
+			*ptr = htons ( 0xc000 | sizeof ( *query ) );
+			rr = iob_put ( iobuf, sizeof ( rr->a ) );
+			rr->a.in_addr = server->in;
+			rr->common.rdlength = htons ( sizeof ( rr->a.in_addr ) );
+			response->ancount = htons ( 1 );
+		}
+	} else if ( question->qtype == htons ( DNS_TYPE_AAAA ) ) {
+		delay = server->delay_aaaa;
+		if ( memcmp ( &server->in6, &none6, sizeof ( none6 ) ) != 0 ) {
+			ptr = iob_put ( iobuf, sizeof ( *ptr ) );
+			*ptr = htons ( 0xc000 | sizeof ( *query ) );
+			rr = iob_put ( iobuf, sizeof ( rr->aaaa ) );
+			memcpy ( &rr->aaaa.in6_addr, &server->in6,
+				 sizeof ( rr->aaaa.in6_addr ) );
+			rr->common.rdlength =
+				htons ( sizeof ( rr->aaaa.in6_addr ) );
+			response->ancount = htons ( 1 );
+		}
+	}
+	if ( response->ancount ) {
+		rr->common.type = question->qtype;
+		rr->common.class = htons ( DNS_CLASS_IN );
+		rr->common.ttl = htonl ( 60 );
+	}
+
+	/* Discard response if server never responds */
+	if ( delay == RESOLV_TEST_NEVER ) {
+		free_iob ( iobuf );
+		return;
+	}
+
+	/* Construct UDP header */
+	rsphdr->src = udphdr->dest;
+	rsphdr->dest = udphdr->src;
+	rsphdr->len = htons ( iob_len ( iobuf ) );
+	rsphdr->chksum = 0;
+	resolv_test_tx ( netdev, iobuf, resolv_test_dns[index], IP_UDP,
+			 &rsphdr->chksum, delay );
+}
+
+/**
+ * Receive TCP packet at simulated peer
+ *
+ * @v netdev		Network device
+ * @v dest		Peer address
+ * @v tcphdr		TCP header
+ * @v len		Length of TCP packet
+ */
+static void resolv_test_tcp_rx ( struct net_device *netdev,
+				 struct in_addr dest,
+				 struct tcp_header *tcphdr, size_t len ) {
+	struct resolv_test_net *net = netdev->priv;
+	struct tcp_header *rsphdr;
+	struct io_buffer *iobuf;
+	unsigned int flags;
+	uint32_t seq;
+	uint32_t ack;
+	size_t hlen;
+
+	/* Ignore RSTs */
+	if ( tcphdr->flags & TCP_RST )
+		return;
+
+	/* Determine response */
+	hlen = ( ( ( tcphdr->hlen & TCP_MASK_HLEN ) / 16 ) * 4 );
+	ack = ( ntohl ( tcphdr->seq ) + len - hlen );
+	if ( tcphdr->flags & ( TCP_SYN | TCP_FIN ) )
+		ack++;
+	if ( ( tcphdr->flags & TCP_SYN ) &&
+	     ( dest.s_addr == resolv_test_accept.s_addr ) ) {
+		/* Accept connection */
+		if ( ! net->syn ) {
+			net->syn = 1;
+			net->syn_time = currticks();
+		}
+		flags = ( TCP_SYN | TCP_ACK );
+		seq = RESOLV_TEST_ISN;
+	} else if ( tcphdr->flags & TCP_SYN ) {
+		/* Refuse connection */
+		flags = ( TCP_RST | TCP_ACK );
+		seq = 0;
+	} else if ( tcphdr->flags & TCP_FIN ) {
+		/* Reset connection on close */
+		flags = TCP_RST;
+		seq = ( RESOLV_TEST_ISN + 1 );
+	} else {
+		return;
+	}
+
+	/* Construct response */
+	iobuf = alloc_iob ( 128 );
+	if ( ! iobuf )
+		return;
+	iob_reserve ( iobuf, ( sizeof ( struct ethhdr ) +
+			       sizeof ( struct iphdr ) ) );
+	rsphdr = iob_put ( iobuf, sizeof ( *rsphdr ) );
+	memset ( rsphdr, 0, sizeof ( *rsphdr ) );
+	rsphdr->src = tcphdr->dest;
+	rsphdr->dest = tcphdr->src;
+	rsphdr->seq = htonl ( seq );
+	rsphdr->ack = htonl ( ack );
+	rsphdr->hlen = ( sizeof ( *rsphdr ) << 2 );
+	rsphdr->flags = flags;
+	rsphdr->win = htons ( 0xffff );
+	resolv_test_tx ( netdev, iobuf, dest, IP_TCP, &rsphdr->csum, 0 );
+}
+
+/**
+ * Transmit packet via test network device
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ */
+static void resolv_test_transmit ( struct net_device *netdev,
+				   struct io_buffer *iobuf ) {
+	struct ethhdr *ethhdr = iobuf->data;
+	struct iphdr *iphdr;
+	struct udp_header *udphdr;
+	void *payload;
+	unsigned int i;
+	size_t hlen;
+	size_t len;
+
+	/* Complete checksum, if applicable */
+	if ( iobuf->flags & IOB_CSUM_PARTIAL )
+		tcpip_csum_complete ( iobuf );
+
+	/* Ignore anything other than IPv4 (e.g. IPv6 neighbour
+	 * solicitations, which are never answered).
+	 */
+	if ( ethhdr->h_protocol != htons ( ETH_P_IP ) )
+		return;
+	iphdr = ( ( ( void * ) ethhdr ) + sizeof ( *ethhdr ) );
+	hlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	payload = ( ( ( void * ) iphdr ) + hlen );
+	len = ( ntohs ( iphdr->len ) - hlen );
+
+	/* Hand packet to simulated DNS server or TCP peer */
+	if ( iphdr->protocol == IP_UDP ) {
+		udphdr = payload;
+		for ( i = 0 ; i < RESOLV_TEST_SERVERS ; i++ ) {
+			if ( ( iphdr->dest.s_addr ==
+			       resolv_test_dns[i].s_addr ) &&
+			     ( udphdr->dest == htons ( DNS_PORT ) ) ) {
+				resolv_test_dns_rx ( netdev, i, udphdr, len );
+			}
+		}
+	} else if ( iphdr->protocol == IP_TCP ) {
+		resolv_test_tcp_rx ( netdev, iphdr->dest, payload, len );
+	}
+}
+
+/**
+ * Poll test network device
+ *
+ * @v netdev		Network device
+ */
+static void resolv_test_poll ( struct net_device *netdev ) {
+	struct resolv_test_net *net = netdev->priv;
+	struct resolv_test_pending *pending;
+	unsigned int i;
+
+	/* Receive any delayed packets that are now due */
+	for ( i = 0 ; i < RESOLV_TEST_MAX_PENDING ; i++ ) {
+		pending = &net->pending[i];
+		if ( pending->iobuf &&
+		     ( ( long ) ( currticks() - pending->due ) >= 0 ) ) {
+			netdev_rx ( netdev, pending->iobuf );
+			pending->iobuf = NULL;
+		}
+	}
+}
+
+/**
+ * Record resolved address
+ *
+ * @v resolver		Test name resolution consumer
+ * @v sa		Resolved socket address
+ */
+static void resolv_test_resolver_done ( struct resolv_test_resolver *resolver,
+					struct sockaddr *sa ) {
+
+	if ( resolver->count >= RESOLV_TEST_MAX_RESULTS )
+		return;
+	memcpy ( &resolver->results[resolver->count], sa,
+		 sizeof ( resolver->results[0] ) );
+	resolver->times[resolver->count] = currticks();
+	resolver->count++;
+}
+
+/**
+ * Record name resolution completion
+ *
+ * @v resolver		Test name resolution consumer
+ * @v rc		Reason for completion
+ */
+static void resolv_test_resolver_close ( struct resolv_test_resolver *resolver,
+					 int rc ) {
+
+	intf_shutdown ( &resolver->resolv, rc );
+	resolver->rc = rc;
+	resolver->closed = 1;
+}
+
+/** Test name resolution consumer interface operations */
+static struct interface_operation resolv_test_resolver_operations[] = {
+	INTF_OP ( resolv_done, struct resolv_test_resolver *,
+		  resolv_test_resolver_done ),
+	INTF_OP ( intf_close, struct resolv_test_resolver *,
+		  resolv_test_resolver_close ),
+};
+
+/** Test name resolution consumer interface descriptor */
+static struct interface_descriptor resolv_test_resolver_desc =
+	INTF_DESC ( struct resolv_test_resolver, resolv,
+		    resolv_test_resolver_operations );
+
+/**
+ * Check for readiness of test application connection
+ *
+ * @v app		Test application
+ */
+static void resolv_test_app_window_changed ( struct resolv_test_app *app ) {
+
+	if ( xfer_window ( &app->xfer ) && ! app->ready ) {
+		app->ready = 1;
+		app->ready_time = currticks();
+	}
+}
+
+/**
+ * Handle redirection of test application
+ *
+ * @v app		Test application
+ * @v type		Location type
+ * @v args		Remaining arguments depend upon location type
+ * @ret rc		Return status code
+ */
+static int resolv_test_app_vredirect ( struct resolv_test_app *app, int type,
+				       va_list args ) {
+	va_list tmp;
+
+	/* Record peer address, as done by iSCSI */
+	if ( type == LOCATION_SOCKET ) {
+		va_copy ( tmp, args );
+		( void ) va_arg ( tmp, int ); /* Discard "semantics" */
+		memcpy ( &app->peer, va_arg ( tmp, struct sockaddr * ),
+			 sizeof ( app->peer ) );
+		va_end ( tmp );
+		app->redirected = 1;
+	}
+
+	return xfer_vreopen ( &app->xfer, type, args );
+}
+
+/**
+ * Record connected peer address
+ *
+ * @v app		Test application
+ * @v peer		Peer socket address
+ */
+static void resolv_test_app_connected ( struct resolv_test_app *app,
+					struct sockaddr *peer ) {
+
+	memcpy ( &app->peer, peer, sizeof ( app->peer ) );
+	app->connected = 1;
+}
+
+/**
+ * Close test application
+ *
+ * @v app		Test application
+ * @v rc		Reason for close
+ */
+static void resolv_test_app_close ( struct resolv_test_app *app, int rc ) {
+
+	intf_shutdown ( &app->xfer, rc );
+	app->rc = rc;
+	app->closed = 1;
+}
+
+/** Test application data transfer interface operations */
+static struct interface_operation resolv_test_app_operations[] = {
+	INTF_OP ( xfer_window_changed, struct resolv_test_app *,
+		  resolv_test_app_window_changed ),
+	INTF_OP ( xfer_vredirect, struct resolv_test_app *,
+		  resolv_test_app_vredirect ),
+	INTF_OP ( xfer_connected, struct resolv_test_app *,
+		  resolv_test_app_connected ),
+	INTF_OP ( intf_close, struct resolv_test_app *, resolv_test_app_close ),
+};
+
+/** Test application data transfer interface descriptor */
+static struct interface_descriptor resolv_test_app_desc =
+	INTF_DESC ( struct resolv_test_app, xfer, resolv_test_app_operations );
+
+/**
+ * Create test network device
+ *
+ * @ret netdev		Network device, or NULL on error
+ */
+static struct net_device * resolv_test_create ( void ) {
+	struct net_device *netdev;
+	struct settings *settings;
+	unsigned int i;
+
+	/* Create and open test network device */
+	netdev = testnet_create ( sizeof ( struct resolv_test_net ),
+				  resolv_test_transmit, resolv_test_poll );
+	ok ( netdev != NULL );
+	if ( ! netdev )
+		return NULL;
+
+	/* Configure addresses and DNS servers */
+	settings = netdev_settings ( netdev );
+	ok ( store_setting ( settings, &ip_setting, &resolv_test_local,
+			     sizeof ( resolv_test_local ) ) == 0 );
+	ok ( store_setting ( settings, &netmask_setting, &resolv_test_netmask,
+			     sizeof ( resolv_test_netmask ) ) == 0 );
+	ok ( store_setting ( settings, &ip6_setting, &resolv_test_local6,
+			     sizeof ( resolv_test_local6 ) ) == 0 );
+	ok ( store_setting ( settings, &len6_setting, &resolv_test_len6,
+			     sizeof ( resolv_test_len6 ) ) == 0 );
+	ok ( store_setting ( settings, &dns6_setting, &resolv_test_dns6,
+			     sizeof ( resolv_test_dns6 ) ) == 0 );
+	ok ( store_setting ( settings, &dns_setting, resolv_test_dns,
+			     sizeof ( resolv_test_dns ) ) == 0 );
+
+	/* Define IPv4 peers' link-layer addresses */
+	for ( i = 0 ; i < RESOLV_TEST_SERVERS ; i++ ) {
+		ok ( neighbour_define ( netdev, &ipv4_protocol,
+					&resolv_test_dns[i],
+					resolv_test_remote_mac ) == 0 );
+	}
+	ok ( neighbour_define ( netdev, &ipv4_protocol, &resolv_test_accept,
+				resolv_test_remote_mac ) == 0 );
+	ok ( neighbour_define ( netdev, &ipv4_protocol, &resolv_test_refuse,
+				resolv_test_remote_mac ) == 0 );
+
+	return netdev;
+}
+
+/**
+ * Remove test network device
+ *
+ * @v netdev		Network device
+ */
+static void resolv_test_remove ( struct net_device *netdev ) {
+	struct resolv_test_net *net = netdev->priv;
+	unsigned int i;
+
+	/* Discard any delayed packets */
+	for ( i = 0 ; i < RESOLV_TEST_MAX_PENDING ; i++ ) {
+		free_iob ( net->pending[i].iobuf );
+		net->pending[i].iobuf = NULL;
+	}
+
+	testnet_remove ( netdev );
+}
+
+/**
+ * Configure simulated DNS servers
+ *
+ * @v netdev		Network device
+ * @v in		IPv4 address, or NULL for no A record
+ * @v in6		IPv6 address, or NULL for no AAAA record
+ * @v delay_a		Delay before responding to A queries
+ * @v delay_aaaa	Delay before responding to AAAA queries
+ *
+ * The first DNS server is configured as specified, and the second
+ * DNS server never responds.
+ */
+static void resolv_test_config ( struct net_device *netdev,
+				 const struct in_addr *in,
+				 const struct in6_addr *in6,
+				 unsigned long delay_a,
+				 unsigned long delay_aaaa ) {
+	struct resolv_test_net *net = netdev->priv;
+	struct resolv_test_server *server = &net->server[0];
+
+	/* Forget any previous results */
+	dns_cache_flush();
+	memset ( net->server, 0, sizeof ( net->server ) );
+	memset ( net->queries, 0, sizeof ( net->queries ) );
+	net->syn = 0;
+
+	/* Configure first DNS server */
+	if ( in )
+		server->in = *in;
+	if ( in6 )
+		server->in6 = *in6;
+	server->delay_a = delay_a;
+	server->delay_aaaa = delay_aaaa;
+
+	/* Configure second DNS server to never respond */
+	net->server[1].delay_a = RESOLV_TEST_NEVER;
+	net->server[1].delay_aaaa = RESOLV_TEST_NEVER;
+}
+
+/**
+ * Resolve test name
+ *
+ * @v resolver		Test name resolution consumer to fill in
+ * @ret start		Time at which resolution started
+ */
+static unsigned long resolv_test_resolve ( struct resolv_test_resolver
+					   *resolver ) {
+	unsigned long start;
+
+	/* Start name resolution */
+	memset ( resolver, 0, sizeof ( *resolver ) );
+	intf_init ( &resolver->resolv, &resolv_test_resolver_desc, NULL );
+	start = currticks();
+	ok ( resolv ( &resolver->resolv, "resolv.test", NULL ) == 0 );
+
+	/* Wait for name resolution to complete */
+	while ( ( ( currticks() - start ) < RESOLV_TEST_TIMEOUT ) &&
+		( ! resolver->closed ) ) {
+		step();
+	}
+	ok ( resolver->closed );
+
+	return start;
+}
+
+/**
+ * Open named socket to test name
+ *
+ * @v app		Test application to fill in
+ * @ret start		Time at which socket was opened
+ */
+static unsigned long resolv_test_connect ( struct resolv_test_app *app ) {
+	struct sockaddr_tcpip st;
+	struct tcp_info info;
+	unsigned long start;
+
+	/* Open named socket */
+	memset ( app, 0, sizeof ( *app ) );
+	intf_init ( &app->xfer, &resolv_test_app_desc, NULL );
+	memset ( &st, 0, sizeof ( st ) );
+	st.st_port = htons ( RESOLV_TEST_PORT );
+	start = currticks();
+	ok ( xfer_open_named_socket ( &app->xfer, SOCK_STREAM,
+				      ( struct sockaddr * ) &st,
+				      "resolv.test", NULL ) == 0 );
+
+	/* Wait for connection to become ready or to fail */
+	while ( ( ( currticks() - start ) < RESOLV_TEST_TIMEOUT ) &&
+		( ! app->ready ) && ( ! app->closed ) ) {
+		step();
+	}
+
+	/* Close connection, and wait for all connections to be freed */
+	intf_shutdown ( &app->xfer, 0 );
+	while ( ( ( currticks() - start ) < RESOLV_TEST_TIMEOUT ) &&
+		( tcp_connection_info ( 0, &info ) == 0 ) ) {
+		step();
+	}
+	ok ( tcp_connection_info ( 0, &info ) != 0 );
+
+	return start;
+}
+
+/**
+ * Perform name resolution self-tests
+ *
+ * @v netdev		Network device
+ */
+static void resolv_test_lookup ( struct net_device *netdev ) {
+	struct resolv_test_net *net = netdev->priv;
+	struct resolv_test_resolver resolver;
+	unsigned long start;
+
+	/* An IPv4 address should be held back while the AAAA query
+	 * is outstanding, until the resolution delay expires.
+	 */
+	resolv_test_config ( netdev, &resolv_test_accept, &resolv_test_stall6,
+			     0, ( 4 * DNS_RESOLUTION_DELAY ) );
+	start = resolv_test_resolve ( &resolver );
+	ok ( resolver.rc == 0 );
+	ok ( resolver.count == 2 );
+	ok ( resolver.results[0].sa.sa_family == AF_INET );
+	ok ( resolver.results[0].sin.sin_addr.s_addr ==
+	     resolv_test_accept.s_addr );
+	ok ( ( resolver.times[0] - start ) >= DNS_RESOLUTION_DELAY );
+	ok ( ( resolver.times[0] - start ) < ( 4 * DNS_RESOLUTION_DELAY ) );
+	ok ( resolver.results[1].sa.sa_family == AF_INET6 );
+	ok ( memcmp ( &resolver.results[1].sin6.sin6_addr,
+		      &resolv_test_stall6,
+		      sizeof ( resolv_test_stall6 ) ) == 0 );
+	ok ( ( resolver.times[1] - start ) >= ( 4 * DNS_RESOLUTION_DELAY ) );
+
+	/* An IPv6 address arriving within the resolution delay should
+	 * be reported first.
+	 */
+	resolv_test_config ( netdev, &resolv_test_accept, &resolv_test_stall6,
+			     0, ( DNS_RESOLUTION_DELAY / 2 ) );
+	start = resolv_test_resolve ( &resolver );
+	ok ( resolver.rc == 0 );
+	ok ( resolver.count == 2 );
+	ok ( resolver.results[0].sa.sa_family == AF_INET6 );
+	ok ( resolver.results[1].sa.sa_family == AF_INET );
+	ok ( ( resolver.times[1] - start ) < DNS_RESOLUTION_DELAY );
+
+	/* An IPv4 address should be reported without waiting for the
+	 * resolution delay once the AAAA query finds no record.
+	 */
+	resolv_test_config ( netdev, &resolv_test_accept, NULL,
+			     0, ( DNS_RESOLUTION_DELAY / 2 ) );
+	start = resolv_test_resolve ( &resolver );
+	ok ( resolver.rc == 0 );
+	ok ( resolver.count == 1 );
+	ok ( resolver.results[0].sa.sa_family == AF_INET );
+	ok ( ( resolver.times[0] - start ) < DNS_RESOLUTION_DELAY );
+
+	/* Queries should be sent to all DNS servers, and the first
+	 * response should be used.
+	 */
+	resolv_test_config ( netdev, &resolv_test_accept, NULL, 0, 0 );
+	net->server[0].delay_a = RESOLV_TEST_NEVER;
+	net->server[0].delay_aaaa = RESOLV_TEST_NEVER;
+	net->server[1].in = resolv_test_other;
+	net->server[1].delay_a = 0;
+	net->server[1].delay_aaaa = 0;
+	resolv_test_resolve ( &resolver );
+	ok ( resolver.rc == 0 );
+	ok ( resolver.count == 1 );
+	ok ( resolver.results[0].sin.sin_addr.s_addr ==
+	     resolv_test_other.s_addr );
+	ok ( net->queries[0] != 0 );
+	resolv_test_config ( netdev, &resolv_test_accept, NULL,
+			     ( DNS_RESOLUTION_DELAY / 2 ), 0 );
+	net->server[1].in = resolv_test_other;
+	net->server[1].delay_a = 0;
+	net->server[1].delay_aaaa = 0;
+	resolv_test_resolve ( &resolver );
+	ok ( resolver.rc == 0 );
+	ok ( resolver.count == 1 );
+	ok ( resolver.results[0].sin.sin_addr.s_addr ==
+	     resolv_test_other.s_addr );
+}
+
+/**
+ * Perform named socket self-tests
+ *
+ * @v netdev		Network device
+ */
+static void resolv_test_named ( struct net_device *netdev ) {
+	struct resolv_test_net *net = netdev->priv;
+	struct resolv_test_app app;
+	unsigned long start;
+
+	/* A single resolved address should be used without racing */
+	resolv_test_config ( netdev, &resolv_test_accept, NULL, 0, 0 );
+	start = resolv_test_connect ( &app );
+	ok ( app.ready );
+	ok ( app.redirected );
+	ok ( ! app.connected );
+	ok ( app.peer.sin_addr.s_addr == resolv_test_accept.s_addr );
+	ok ( ntohs ( app.peer.sin_port ) == RESOLV_TEST_PORT );
+
+	/* An IPv4 connection attempt should be started once the IPv6
+	 * connection attempt has stalled for the connection attempt
+	 * delay, and should win the race.  The parent should be told
+	 * the winning peer address.
+	 */
+	resolv_test_config ( netdev, &resolv_test_accept, &resolv_test_stall6,
+			     0, 0 );
+	start = resolv_test_connect ( &app );
+	ok ( app.ready );
+	ok ( ! app.redirected );
+	ok ( app.connected );
+	ok ( app.peer.sin_family == AF_INET );
+	ok ( app.peer.sin_addr.s_addr == resolv_test_accept.s_addr );
+	ok ( net->syn );
+	ok ( ( net->syn_time - start ) >= RESOLV_TEST_ATTEMPT_DELAY );
+	ok ( ( app.ready_time - start ) >= RESOLV_TEST_ATTEMPT_DELAY );
+
+	/* A failed connection attempt should fail over immediately to
+	 * the next address.
+	 */
+	resolv_test_config ( netdev, &resolv_test_accept,
+			     &resolv_test_unreachable6, 0, 0 );
+	start = resolv_test_connect ( &app );
+	ok ( app.ready );
+	ok ( app.redirected || app.connected );
+	ok ( app.peer.sin_addr.s_addr == resolv_test_accept.s_addr );
+	ok ( ( app.ready_time - start ) < RESOLV_TEST_ATTEMPT_DELAY );
+
+	/* The socket should fail if all connection attempts fail */
+	resolv_test_config ( netdev, &resolv_test_refuse,
+			     &resolv_test_unreachable6, 0, 0 );
+	resolv_test_connect ( &app );
+	ok ( ! app.ready );
+	ok ( app.closed );
+	ok ( app.rc != 0 );
+}
+
+/**
+ * Perform name resolution and named socket self-tests
+ *
+ */
+static void resolv_test_exec ( void ) {
+	struct net_device *netdev;
+
+	/* Create test network device */
+	netdev = resolv_test_create();
+	if ( ! netdev )
+		return;
+
+	/* Run tests */
+	resolv_test_lookup ( netdev );
+	resolv_test_named ( netdev );
+
+	/* Remove test network device */
+	resolv_test_remove ( netdev );
+	dns_cache_flush();
+}
+
+/** Name resolution self-test */
+struct self_test resolv_test __self_test = {
+	.name = "resolv",
+	.exec = resolv_test_exec,
+};
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Retry timer self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/timer.h>
+#include <ipxe/retry.h>
+#include <ipxe/test.h>
+#include <ipxe/profile.h>
+
+/** Number of timers used to test expiry */
+#define RETRY_EXPIRY_COUNT 64
+
+/** Number of idle timers used to measure polling overhead */
+#define RETRY_IDLE_COUNT 4096
+
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 1024
+
+/** A retry timer test */
+struct retry_test_timer {
+	/** Retry timer */
+	struct retry_timer timer;
+	/** Requested timeout */
+	unsigned long timeout;
+	/** Expiry time */
+	unsigned long expired;
+	/** Number of expiries */
+	unsigned int count;
+};
+
+/**
+ * Handle test timer expiry
+ *
+ * @v timer		Retry timer
+ * @v over		Failure indicator
+ */
+static void retry_test_expired ( struct retry_timer *timer, int over __unused ){
+	struct retry_test_timer *test =
+		container_of ( timer, struct retry_test_timer, timer );
+
+	test->expired = currticks();
+	test->count++;
+}
+
+/**
+ * Start test timer
+ *
+ * @v test		Retry timer test
+ * @v timeout		Timeout
+ */
+static void retry_test_start ( struct retry_test_timer *test,
+			       unsigned long timeout ) {
+
+	timer_init ( &test->timer, retry_test_expired, NULL );
+	test->timeout = timeout;
+	test->count = 0;
+	start_timer_fixed ( &test->timer, timeout );
+}
+
+/**
+ * Poll retry timers until all test timers have expired
+ *
+ * @v tests		Retry timer tests
+ * @v count		Number of tests
+ * @v timeout		Maximum time to wait
+ * @ret expired		Number of expired timers
+ */
+static unsigned int retry_test_wait ( struct retry_test_timer *tests,
+				      unsigned int count,
+				      unsigned long timeout ) {
+	unsigned long start = currticks();
+	unsigned int expired;
+	unsigned int i;
+
+	do {
+		retry_poll();
+		for ( expired = 0, i = 0 ; i < count ; i++ )
+			expired += ( tests[i].count ? 1 : 0 );
+	} while ( ( expired < count ) && ( ( currticks() - start ) < timeout ));
+
+	return expired;
+}
+
+/**
+ * Perform retry timer expiry self-tests
+ *
+ */
+static void retry_expiry_test_exec ( void ) {
+	struct retry_test_timer *tests;
+	struct retry_test_timer stopped;
+	unsigned long max = ( TICKS_PER_SEC / 2 );
+	unsigned int i;
+
+	/* Allocate timers */
+	tests = zalloc ( RETRY_EXPIRY_COUNT * sizeof ( tests[0] ) );
+	ok ( tests != NULL );
+	if ( ! tests )
+		return;
+
+	/* Start timers with a spread of timeouts (including zero) */
+	for ( i = 0 ; i < RETRY_EXPIRY_COUNT ; i++ ) {
+		retry_test_start ( &tests[i],
+				   ( ( ( i * 37 ) % RETRY_EXPIRY_COUNT ) *
+				     max / RETRY_EXPIRY_COUNT ) );
+	}
+
+	/* Start and immediately stop a timer */
+	memset ( &stopped, 0, sizeof ( stopped ) );
+	retry_test_start ( &stopped, 0 );
+	stop_timer ( &stopped.timer );
+	ok ( ! timer_running ( &stopped.timer ) );
+
+	/* Wait for all timers to expire */
+	ok ( retry_test_wait ( tests, RETRY_EXPIRY_COUNT,
+			       ( 4 * max ) ) == RETRY_EXPIRY_COUNT );
+
+	/* Check that each timer expired exactly once, and not early */
+	for ( i = 0 ; i < RETRY_EXPIRY_COUNT ; i++ ) {
+		ok ( tests[i].count == 1 );
+		ok ( ! timer_running ( &tests[i].timer ) );
+		ok ( ( tests[i].expired - tests[i].timer.start ) >=
+		     tests[i].timeout );
+	}
+	ok ( stopped.count == 0 );
+
+	/* Restart a running timer with a shorter timeout */
+	retry_test_start ( &tests[0], ( 60 * TICKS_PER_SEC ) );
+	start_timer_fixed ( &tests[0].timer, 0 );
+	tests[0].timeout = 0;
+	ok ( retry_test_wait ( tests, 1, max ) == 1 );
+
+	free ( tests );
+}
+
+/**
+ * Perform retry timer polling speed self-tests
+ *
+ */
+static void retry_speed_test_exec ( void ) {
+	struct retry_test_timer *tests;
+	struct profiler profiler;
+	unsigned int i;
+
+	/* Allocate timers */
+	tests = zalloc ( RETRY_IDLE_COUNT * sizeof ( tests[0] ) );
+	ok ( tests != NULL );
+	if ( ! tests )
+		return;
+
+	/* Arm many timers which will not expire during the test */
+	for ( i = 0 ; i < RETRY_IDLE_COUNT ; i++ ) {
+		retry_test_start ( &tests[i], ( ( 60 * TICKS_PER_SEC ) +
+						( i * 97 ) ) );
+	}
+
+	/* Profile polling */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		retry_poll();
+		profile_stop ( &profiler );
+	}
+	DBG ( "RETRY polled %d timers in %ld +/- %ld ticks\n",
+	      RETRY_IDLE_COUNT, profile_mean ( &profiler ),
+	      profile_stddev ( &profiler ) );
+
+	/* Stop timers */
+	for ( i = 0 ; i < RETRY_IDLE_COUNT ; i++ ) {
+		ok ( timer_running ( &tests[i].timer ) );
+		ok ( tests[i].count == 0 );
+		stop_timer ( &tests[i].timer );
+	}
+
+	free ( tests );
+}
+
+/**
+ * Perform retry timer self-tests
+ *
+ */
+static void retry_test_exec ( void ) {
+
+	retry_expiry_test_exec();
+	retry_speed_test_exec();
+}
+
+/** Retry timer self-test */
+struct self_test retry_test __self_test = {
+	.name = "retry",
+	.exec = retry_test_exec,
+};
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Cached transmit route self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/neighbour.h>
+#include <ipxe/settings.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+#include "testnet.h"
+
+/** Number of iterations used for benchmarking */
+#define ROUTE_TEST_ITERATIONS 256
+
+/** Number of concurrent destinations used for benchmarking */
+#define ROUTE_TEST_FLOWS 32
+
+/** Length of test packet payload */
+#define ROUTE_TEST_LEN 64
+
+/** A transmitted test frame */
+struct route_test_frame {
+	/** Ethernet header */
+	struct ethhdr ethhdr;
+	/** IPv4 header */
+	struct iphdr iphdr;
+} __attribute__ (( packed ));
+
+/** Most recently transmitted frame */
+static struct route_test_frame route_test_frame;
+
+/** Number of transmitted frames */
+static unsigned int route_test_count;
+
+/** Local IPv4 address */
+static const struct in_addr route_test_local = {
+	.s_addr = htonl ( 0xc0a86601UL ), /* 192.168.102.1 */
+};
+
+/** On-link peer IPv4 address */
+static const struct in_addr route_test_peer = {
+	.s_addr = htonl ( 0xc0a86602UL ), /* 192.168.102.2 */
+};
+
+/** Unresolved on-link peer IPv4 address */
+static const struct in_addr route_test_other = {
+	.s_addr = htonl ( 0xc0a86603UL ), /* 192.168.102.3 */
+};
+
+/** First benchmark destination IPv4 address */
+static const struct in_addr route_test_flows = {
+	.s_addr = htonl ( 0xc0a86620UL ), /* 192.168.102.32 */
+};
+
+/** Off-link peer IPv4 address */
+static const struct in_addr route_test_remote = {
+	.s_addr = htonl ( 0x0a000001UL ), /* 10.0.0.1 */
+};
+
+/** Gateway IPv4 address */
+static const struct in_addr route_test_gateway = {
+	.s_addr = htonl ( 0xc0a866feUL ), /* 192.168.102.254 */
+};
+
+/** IPv4 netmask */
+static const struct in_addr route_test_netmask = {
+	.s_addr = htonl ( 0xffffff00UL ),
+};
+
+/** Alternative IPv4 netmask */
+static const struct in_addr route_test_netmask_alt = {
+	.s_addr = htonl ( 0xffff0000UL ),
+};
+
+/** First peer link-layer address */
+static const uint8_t route_test_mac1[ETH_ALEN] =
+	{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+/** Second peer link-layer address */
+static const uint8_t route_test_mac2[ETH_ALEN] =
+	{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+/** Gateway link-layer address */
+static const uint8_t route_test_mac_gw[ETH_ALEN] =
+	{ 0x02, 0x00, 0x00, 0x00, 0x00, 0xfe };
+
+/** Test transport-layer protocol */
+static struct tcpip_protocol route_test_protocol = {
+	.name = "ROUTETEST",
+	.zero_csum = TCPIP_NEGATIVE_ZERO_CSUM,
+	.tcpip_proto = 253,
+};
+
+/**
+ * Record packet transmitted via test network device
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ */
+static void route_test_transmit ( struct net_device *netdev __unused,
+				  struct io_buffer *iobuf ) {
+
+	assert ( iob_len ( iobuf ) >= sizeof ( route_test_frame ) );
+	memcpy ( &route_test_frame, iobuf->data, sizeof ( route_test_frame ) );
+	route_test_count++;
+}
+
+/**
+ * Transmit test packet
+ *
+ * @v dest		Destination address
+ * @v route		Cached transmit route, or NULL
+ * @ret rc		Return status code
+ */
+static int route_test_tx ( struct in_addr dest, struct tcpip_route *route ) {
+	struct io_buffer *iobuf;
+	struct sockaddr_in sin;
+
+	/* Construct packet */
+	iobuf = alloc_iob ( MAX_LL_NET_HEADER_LEN + ROUTE_TEST_LEN );
+	if ( ! iobuf )
+		return -ENOMEM;
+	iob_reserve ( iobuf, MAX_LL_NET_HEADER_LEN );
+	memset ( iob_put ( iobuf, ROUTE_TEST_LEN ), 0, ROUTE_TEST_LEN );
+
+	/* Transmit packet */
+	memset ( &sin, 0, sizeof ( sin ) );
+	sin.sin_family = AF_INET;
+	sin.sin_addr = dest;
+	return tcpip_tx ( iobuf, &route_test_protocol, NULL,
+			  ( struct sockaddr_tcpip * ) &sin, NULL, route, NULL );
+}
+
+/**
+ * Report transmitted frame test result
+ *
+ * @v dest		Destination address
+ * @v route		Cached transmit route, or NULL
+ * @v ll_dest		Expected link-layer destination address
+ * @v netdev		Network device
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void route_tx_okx ( struct in_addr dest, struct tcpip_route *route,
+			   const uint8_t *ll_dest, struct net_device *netdev,
+			   const char *file, unsigned int line ) {
+	unsigned int count = route_test_count;
+
+	okx ( route_test_tx ( dest, route ) == 0, file, line );
+	okx ( route_test_count == ( count + 1 ), file, line );
+	okx ( memcmp ( route_test_frame.ethhdr.h_dest, ll_dest,
+		       ETH_ALEN ) == 0, file, line );
+	okx ( memcmp ( route_test_frame.ethhdr.h_source, netdev->ll_addr,
+		       ETH_ALEN ) == 0, file, line );
+	okx ( route_test_frame.ethhdr.h_protocol == htons ( ETH_P_IP ),
+	      file, line );
+	okx ( route_test_frame.iphdr.src.s_addr == route_test_local.s_addr,
+	      file, line );
+	okx ( route_test_frame.iphdr.dest.s_addr == dest.s_addr, file, line );
+	okx ( route_test_frame.iphdr.protocol ==
+	      route_test_protocol.tcpip_proto, file, line );
+	okx ( tcpip_chksum ( &route_test_frame.iphdr,
+			     sizeof ( route_test_frame.iphdr ) ) == 0,
+	      file, line );
+}
+#define route_tx_ok( dest, route, ll_dest, netdev )			\
+	route_tx_okx ( dest, route, ll_dest, netdev, __FILE__, __LINE__ )
+
+/**
+ * Check if cached route is valid
+ *
+ * @v route		Cached transmit route
+ * @v dest		Destination address
+ * @ret is_valid	Cached route is valid
+ */
+static int route_test_is_valid ( struct tcpip_route *route,
+				 struct in_addr dest ) {
+
+	return tcpip_route_is_valid ( route, &dest, sizeof ( dest ) );
+}
+
+/**
+ * Measure cost of transmitting packets
+ *
+ * @v netdev		Network device
+ * @v cached		Use cached transmit routes
+ *
+ * Packets are transmitted to each of several on-link destinations in
+ * turn, as for several concurrent connections.
+ */
+static void route_test_benchmark ( struct net_device *netdev, int cached ) {
+	static struct tcpip_route routes[ROUTE_TEST_FLOWS];
+	struct profiler profiler;
+	struct in_addr dest;
+	unsigned int i;
+	unsigned int j;
+
+	/* Define neighbours */
+	for ( j = 0 ; j < ROUTE_TEST_FLOWS ; j++ ) {
+		dest.s_addr = htonl ( ntohl ( route_test_flows.s_addr ) + j );
+		ok ( neighbour_define ( netdev, &ipv4_protocol, &dest,
+					route_test_mac1 ) == 0 );
+	}
+
+	/* Measure transmission cost */
+	memset ( routes, 0, sizeof ( routes ) );
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < ROUTE_TEST_ITERATIONS ; i++ ) {
+		for ( j = 0 ; j < ROUTE_TEST_FLOWS ; j++ ) {
+			dest.s_addr = htonl ( ntohl ( route_test_flows.s_addr )
+					      + j );
+			profile_start ( &profiler );
+			route_test_tx ( dest, ( cached ? &routes[j] : NULL ) );
+			profile_stop ( &profiler );
+		}
+	}
+	for ( j = 0 ; cached && ( j < ROUTE_TEST_FLOWS ) ; j++ ) {
+		dest.s_addr = htonl ( ntohl ( route_test_flows.s_addr ) + j );
+		ok ( route_test_is_valid ( &routes[j], dest ) );
+	}
+	DBG ( "ROUTE transmit to %d destinations %s cached routes: %ld +/- %ld "
+	      "ticks\n", ROUTE_TEST_FLOWS, ( cached ? "with" : "without" ),
+	      profile_mean ( &profiler ), profile_stddev ( &profiler ) );
+}
+
+/**
+ * Perform cached transmit route self-tests
+ *
+ */
+static void route_test_exec ( void ) {
+	struct tcpip_route route;
+	struct tcpip_route gw_route;
+	struct net_device *netdev;
+	struct settings *settings;
+
+	/* Create and open test network device */
+	netdev = testnet_create ( 0, route_test_transmit, NULL );
+	ok ( netdev != NULL );
+	if ( ! netdev )
+		return;
+	settings = netdev_settings ( netdev );
+	ok ( store_setting ( settings, &ip_setting, &route_test_local,
+			     sizeof ( route_test_local ) ) == 0 );
+	ok ( store_setting ( settings, &netmask_setting, &route_test_netmask,
+			     sizeof ( route_test_netmask ) ) == 0 );
+	ok ( store_setting ( settings, &gateway_setting, &route_test_gateway,
+			     sizeof ( route_test_gateway ) ) == 0 );
+	ok ( neighbour_define ( netdev, &ipv4_protocol, &route_test_peer,
+				route_test_mac1 ) == 0 );
+	ok ( neighbour_define ( netdev, &ipv4_protocol, &route_test_gateway,
+				route_test_mac_gw ) == 0 );
+
+	/* Route should be cached on first use and reused thereafter */
+	memset ( &route, 0, sizeof ( route ) );
+	ok ( ! route_test_is_valid ( &route, route_test_peer ) );
+	route_tx_ok ( route_test_peer, &route, route_test_mac1, netdev );
+	ok ( route_test_is_valid ( &route, route_test_peer ) );
+	ok ( route.netdev == netdev );
+	ok ( route.ll_header_len == ETH_HLEN );
+	route_tx_ok ( route_test_peer, &route, route_test_mac1, netdev );
+	ok ( route_test_is_valid ( &route, route_test_peer ) );
+
+	/* Route should not be used for a different destination */
+	ok ( ! route_test_is_valid ( &route, route_test_remote ) );
+
+	/* Changing the neighbour should invalidate the route */
+	ok ( neighbour_define ( netdev, &ipv4_protocol, &route_test_peer,
+				route_test_mac2 ) == 0 );
+	ok ( ! route_test_is_valid ( &route, route_test_peer ) );
+	route_tx_ok ( route_test_peer, &route, route_test_mac2, netdev );
+	ok ( route_test_is_valid ( &route, route_test_peer ) );
+
+	/* Redefining the neighbour unchanged should not */
+	ok ( neighbour_define ( netdev, &ipv4_protocol, &route_test_peer,
+				route_test_mac2 ) == 0 );
+	ok ( route_test_is_valid ( &route, route_test_peer ) );
+
+	/* Off-link destinations should be reached via the gateway */
+	memset ( &gw_route, 0, sizeof ( gw_route ) );
+	route_tx_ok ( route_test_remote, &gw_route, route_test_mac_gw,
+		      netdev );
+	ok ( route_test_is_valid ( &gw_route, route_test_remote ) );
+	route_tx_ok ( route_test_remote, &gw_route, route_test_mac_gw,
+		      netdev );
+
+	/* Changing the routing table should invalidate all routes */
+	ok ( store_setting ( settings, &netmask_setting,
+			     &route_test_netmask_alt,
+			     sizeof ( route_test_netmask_alt ) ) == 0 );
+	ok ( ! route_test_is_valid ( &route, route_test_peer ) );
+	ok ( ! route_test_is_valid ( &gw_route, route_test_remote ) );
+	route_tx_ok ( route_test_peer, &route, route_test_mac2, netdev );
+	route_tx_ok ( route_test_remote, &gw_route, route_test_mac_gw,
+		      netdev );
+	ok ( store_setting ( settings, &netmask_setting, &route_test_netmask,
+			     sizeof ( route_test_netmask ) ) == 0 );
+
+	/* Routes should not be cached until the neighbour is known */
+	memset ( &route, 0, sizeof ( route ) );
+	ok ( route_test_tx ( route_test_other, &route ) == 0 );
+	ok ( ! route_test_is_valid ( &route, route_test_other ) );
+	ok ( neighbour_define ( netdev, &ipv4_protocol, &route_test_other,
+				route_test_mac1 ) == 0 );
+	ok ( route_test_frame.iphdr.dest.s_addr == route_test_other.s_addr );
+	ok ( ! route_test_is_valid ( &route, route_test_other ) );
+	route_tx_ok ( route_test_other, &route, route_test_mac1, netdev );
+	ok ( route_test_is_valid ( &route, route_test_other ) );
+
+	/* Measure transmission cost */
+	route_test_benchmark ( netdev, 0 );
+	route_test_benchmark ( netdev, 1 );
+
+	/* Closing the network device should invalidate all routes */
+	ok ( route_test_is_valid ( &route, route_test_other ) );
+	netdev_close ( netdev );
+	ok ( ! route_test_is_valid ( &route, route_test_other ) );
+	ok ( route_test_tx ( route_test_other, &route ) != 0 );
+
+	/* Remove test network device */
+	testnet_remove ( netdev );
+}
+
+/** Cached transmit route self-test */
+struct self_test route_test __self_test = {
+	.name = "route",
+	.exec = route_test_exec,
+};
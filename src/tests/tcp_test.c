@@ -0,0 +1,917 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TCP sender self-tests
+ *
+ * These tests transfer data from a TCP connection over a test network
+ * device to a simulated peer, which acknowledges each data segment
+ * (with selective acknowledgements, if enabled) and may drop segments
+ * to simulate a lossy path.  The peer may also support TCP Fast
+ * Open, accepting data within a SYN that carries a valid cookie, and
+ * may send data in bursts of back-to-back segments (which will be
+ * coalesced by the network device layer).
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/neighbour.h>
+#include <ipxe/settings.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/socket.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
+#include <ipxe/test.h>
+#include "testnet.h"
+
+/** Length of data transferred in each test */
+#define TCP_TEST_LEN ( 1024 * 1024 )
+
+/** Maximum length of each application data delivery */
+#define TCP_TEST_CHUNK 4096
+
+/** Maximum time allowed for each test */
+#define TCP_TEST_TIMEOUT ( 60 * TICKS_PER_SEC )
+
+/** Peer port */
+#define TCP_TEST_PORT 4242
+
+/** Peer initial sequence number */
+#define TCP_TEST_ISN 0x12345678UL
+
+/** Peer window scale */
+#define TCP_TEST_WS 4
+
+/** Maximum number of received blocks tracked by peer */
+#define TCP_TEST_BLOCKS 64
+
+/** Length of each data segment sent by peer */
+#define TCP_TEST_MSS 1024
+
+/** Maximum number of data segments sent by peer in each poll */
+#define TCP_TEST_BURST 8
+
+/** Maximum length of unacknowledged data sent by peer */
+#define TCP_TEST_INFLIGHT ( 16 * TCP_TEST_MSS )
+
+/** A simulated TCP peer */
+struct tcp_test_peer {
+	/** Peer supports selective acknowledgements */
+	int sack;
+	/** Peer supports Fast Open */
+	int fastopen;
+	/** Test network device offloads checksums */
+	int offload;
+	/** Random loss rate (in parts per 10000) */
+	unsigned int loss;
+	/** Data segments to drop (by arrival index), terminated by zero */
+	const unsigned int *drops;
+	/** Random number generator state */
+	uint32_t seed;
+
+	/** SYN has been received */
+	int syn;
+	/** Local port */
+	unsigned int local_port;
+	/** Local initial sequence number */
+	uint32_t isn;
+	/** Next expected sequence number */
+	uint32_t rcv_nxt;
+	/** SYN carried a Fast Open option */
+	int syn_fastopen;
+	/** Fast Open cookie should be sent with SYN-ACK */
+	int send_cookie;
+	/** Length of data accepted within SYN */
+	size_t syn_len;
+	/** Most recently received timestamp */
+	uint32_t ts_recent;
+	/** Received out-of-order blocks */
+	struct tcp_sack_block blocks[TCP_TEST_BLOCKS];
+	/** Number of received out-of-order blocks */
+	unsigned int count;
+	/** Number of data segments received (including dropped) */
+	unsigned int segments;
+	/** Number of data segments dropped */
+	unsigned int dropped;
+	/** Number of corrupt data bytes received */
+	unsigned int corrupt;
+	/** Number of packets received with incorrect checksums */
+	unsigned int bad_csum;
+	/** Number of checksums inserted by test network device */
+	unsigned int offloaded;
+	/** Connection has been reset */
+	int reset;
+	/** Length of data to be sent by peer */
+	size_t tx_len;
+	/** Length of data sent by peer */
+	size_t tx_offset;
+	/** Length of data sent by peer and acknowledged */
+	size_t tx_acked;
+};
+
+/** A test application */
+struct tcp_test_app {
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Length of data delivered */
+	size_t offset;
+	/** Length of data received */
+	size_t received;
+	/** Number of corrupt data bytes received */
+	unsigned int corrupt;
+	/** Connection close status (if closed) */
+	int rc;
+	/** Connection has been closed */
+	int closed;
+};
+
+/** Local IPv4 address */
+static const struct in_addr tcp_test_local = {
+	.s_addr = htonl ( 0xc0a86401UL ), /* 192.168.100.1 */
+};
+
+/** Peer IPv4 address */
+static const struct in_addr tcp_test_remote = {
+	.s_addr = htonl ( 0xc0a86402UL ), /* 192.168.100.2 */
+};
+
+/** IPv4 netmask */
+static const struct in_addr tcp_test_netmask = {
+	.s_addr = htonl ( 0xffffff00UL ),
+};
+
+/** Peer MAC address */
+static const uint8_t tcp_test_remote_mac[ETH_ALEN] = {
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x02
+};
+
+/** Peer Fast Open cookie */
+static const uint8_t tcp_test_cookie[8] = {
+	0xc0, 0x0c, 0x1e, 0x5f, 0x0f, 0x0a, 0x57, 0x01
+};
+
+/**
+ * Calculate stream data byte
+ *
+ * @v offset		Offset within stream
+ * @ret byte		Data byte
+ */
+static inline uint8_t tcp_test_byte ( size_t offset ) {
+	return ( ( offset * 7 ) + ( offset >> 12 ) );
+}
+
+/**
+ * Transmit packet from simulated peer
+ *
+ * @v netdev		Network device
+ * @v flags		TCP flags
+ * @v seq		SEQ value
+ * @v sack_seq		SEQ value for first selective acknowledgement block
+ * @v len		Length of data to send
+ */
+static void tcp_test_peer_tx ( struct net_device *netdev, unsigned int flags,
+			       uint32_t seq, uint32_t sack_seq, size_t len ) {
+	struct tcp_test_peer *peer = netdev->priv;
+	struct io_buffer *iobuf;
+	struct ethhdr *ethhdr;
+	struct iphdr *iphdr;
+	struct tcp_header *tcphdr;
+	struct tcp_mss_option *mssopt;
+	struct tcp_window_scale_padded_option *wsopt;
+	struct tcp_sack_permitted_padded_option *spopt;
+	struct tcp_timestamp_padded_option *tsopt;
+	struct tcp_sack_padded_option *sackopt;
+	struct tcp_sack_block *sack;
+	struct tcp_fastopen_option *foopt;
+	struct ipv4_pseudo_header pshdr;
+	unsigned int first = 0;
+	unsigned int count = 0;
+	unsigned int i;
+	uint8_t *data;
+	uint16_t csum;
+	size_t sack_len;
+
+	/* Allocate I/O buffer */
+	iobuf = alloc_iob ( 128 + len );
+	if ( ! iobuf )
+		return;
+	iob_reserve ( iobuf, ( sizeof ( *ethhdr ) + sizeof ( *iphdr ) ) );
+
+	/* Construct TCP header and options */
+	tcphdr = iob_put ( iobuf, sizeof ( *tcphdr ) );
+	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
+	if ( flags & TCP_SYN ) {
+		mssopt = iob_put ( iobuf, sizeof ( *mssopt ) );
+		mssopt->kind = TCP_OPTION_MSS;
+		mssopt->length = sizeof ( *mssopt );
+		mssopt->mss = htons ( 1460 );
+		wsopt = iob_put ( iobuf, sizeof ( *wsopt ) );
+		wsopt->nop = TCP_OPTION_NOP;
+		wsopt->wsopt.kind = TCP_OPTION_WS;
+		wsopt->wsopt.length = sizeof ( wsopt->wsopt );
+		wsopt->wsopt.scale = TCP_TEST_WS;
+		if ( peer->sack ) {
+			spopt = iob_put ( iobuf, sizeof ( *spopt ) );
+			memset ( spopt->nop, TCP_OPTION_NOP,
+				 sizeof ( spopt->nop ) );
+			spopt->spopt.kind = TCP_OPTION_SACK_PERMITTED;
+			spopt->spopt.length = sizeof ( spopt->spopt );
+		}
+		if ( peer->send_cookie ) {
+			memset ( iob_put ( iobuf, 2 ), TCP_OPTION_NOP, 2 );
+			foopt = iob_put ( iobuf, ( sizeof ( *foopt ) +
+						   sizeof ( tcp_test_cookie ) ) );
+			foopt->kind = TCP_OPTION_FASTOPEN;
+			foopt->length = ( sizeof ( *foopt ) +
+					  sizeof ( tcp_test_cookie ) );
+			memcpy ( foopt->cookie, tcp_test_cookie,
+				 sizeof ( tcp_test_cookie ) );
+		}
+	}
+	tsopt = iob_put ( iobuf, sizeof ( *tsopt ) );
+	memset ( tsopt->nop, TCP_OPTION_NOP, sizeof ( tsopt->nop ) );
+	tsopt->tsopt.kind = TCP_OPTION_TS;
+	tsopt->tsopt.length = sizeof ( tsopt->tsopt );
+	tsopt->tsopt.tsval = htonl ( currticks() );
+	tsopt->tsopt.tsecr = htonl ( peer->ts_recent );
+	if ( peer->sack && peer->count && ! ( flags & TCP_SYN ) ) {
+
+		/* Report the block containing the most recently
+		 * received segment first, as per RFC 2018.
+		 */
+		for ( i = 0 ; i < peer->count ; i++ ) {
+			if ( tcp_in_window ( sack_seq, peer->blocks[i].left,
+					     ( peer->blocks[i].right -
+					       peer->blocks[i].left ) ) ) {
+				first = i;
+				break;
+			}
+		}
+		count = ( ( peer->count < TCP_SACK_MAX ) ?
+			  peer->count : TCP_SACK_MAX );
+		sack_len = ( count * sizeof ( *sack ) );
+		sackopt = iob_put ( iobuf, ( sizeof ( *sackopt ) + sack_len ) );
+		memset ( sackopt->nop, TCP_OPTION_NOP, sizeof ( sackopt->nop ) );
+		sackopt->sackopt.kind = TCP_OPTION_SACK;
+		sackopt->sackopt.length = ( sizeof ( sackopt->sackopt ) +
+					    sack_len );
+		sack = ( ( ( void * ) sackopt ) + sizeof ( *sackopt ) );
+		sack->left = htonl ( peer->blocks[first].left );
+		sack->right = htonl ( peer->blocks[first].right );
+		for ( i = 0 ; count > 1 ; i++ ) {
+			if ( i == first )
+				continue;
+			sack++;
+			sack->left = htonl ( peer->blocks[i].left );
+			sack->right = htonl ( peer->blocks[i].right );
+			count--;
+		}
+	}
+	tcphdr->src = htons ( TCP_TEST_PORT );
+	tcphdr->dest = htons ( peer->local_port );
+	tcphdr->seq = htonl ( seq );
+	tcphdr->ack = htonl ( peer->rcv_nxt );
+	tcphdr->hlen = ( iob_len ( iobuf ) << 2 );
+	tcphdr->flags = flags;
+	tcphdr->win = htons ( 0xffff );
+
+	/* Construct data */
+	data = iob_put ( iobuf, len );
+	for ( i = 0 ; i < len ; i++ )
+		data[i] = tcp_test_byte ( seq - TCP_TEST_ISN - 1 + i );
+
+	/* Calculate TCP checksum */
+	pshdr.src = tcp_test_remote;
+	pshdr.dest = tcp_test_local;
+	pshdr.zero_padding = 0;
+	pshdr.protocol = IP_TCP;
+	pshdr.len = htons ( iob_len ( iobuf ) );
+	csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	tcphdr->csum = tcpip_continue_chksum ( csum, &pshdr, sizeof ( pshdr ) );
+
+	/* Corrupt checksum if the test network device claims to have
+	 * validated it, to ensure that it is not checked again.
+	 */
+	if ( peer->offload ) {
+		tcphdr->csum ^= htons ( 0x0001 );
+		iobuf->flags |= IOB_CSUM_VERIFIED;
+	}
+
+	/* Construct IPv4 header */
+	iphdr = iob_push ( iobuf, sizeof ( *iphdr ) );
+	memset ( iphdr, 0, sizeof ( *iphdr ) );
+	iphdr->verhdrlen = ( IP_VER | ( sizeof ( *iphdr ) / 4 ) );
+	iphdr->len = htons ( iob_len ( iobuf ) );
+	iphdr->ttl = 64;
+	iphdr->protocol = IP_TCP;
+	iphdr->src = tcp_test_remote;
+	iphdr->dest = tcp_test_local;
+	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+
+	/* Construct Ethernet header */
+	ethhdr = iob_push ( iobuf, sizeof ( *ethhdr ) );
+	memcpy ( ethhdr->h_dest, netdev->ll_addr, ETH_ALEN );
+	memcpy ( ethhdr->h_source, tcp_test_remote_mac, ETH_ALEN );
+	ethhdr->h_protocol = htons ( ETH_P_IP );
+
+	/* Hand packet to network device (for processing when polled) */
+	netdev_rx ( netdev, iobuf );
+}
+
+/**
+ * Record data received by simulated peer
+ *
+ * @v peer		Simulated peer
+ * @v left		Start of received data
+ * @v right		End of received data
+ */
+static void tcp_test_peer_rx_data ( struct tcp_test_peer *peer,
+				    uint32_t left, uint32_t right ) {
+	struct tcp_sack_block *blocks = peer->blocks;
+	unsigned int i;
+
+	/* Ignore duplicate data */
+	if ( tcp_cmp ( right, peer->rcv_nxt ) <= 0 )
+		return;
+	if ( tcp_cmp ( left, peer->rcv_nxt ) < 0 )
+		left = peer->rcv_nxt;
+
+	/* Merge with any overlapping or adjacent blocks */
+	for ( i = 0 ; i < peer->count ; ) {
+		if ( ( tcp_cmp ( blocks[i].left, right ) > 0 ) ||
+		     ( tcp_cmp ( blocks[i].right, left ) < 0 ) ) {
+			i++;
+			continue;
+		}
+		if ( tcp_cmp ( blocks[i].left, left ) < 0 )
+			left = blocks[i].left;
+		if ( tcp_cmp ( blocks[i].right, right ) > 0 )
+			right = blocks[i].right;
+		peer->count--;
+		memmove ( &blocks[i], &blocks[ i + 1 ],
+			  ( ( peer->count - i ) * sizeof ( blocks[0] ) ) );
+	}
+
+	/* Advance acknowledgement number, or record new block */
+	if ( left == peer->rcv_nxt ) {
+		peer->rcv_nxt = right;
+	} else {
+		for ( i = 0 ; i < peer->count ; i++ ) {
+			if ( tcp_cmp ( blocks[i].left, left ) > 0 )
+				break;
+		}
+		assert ( peer->count < TCP_TEST_BLOCKS );
+		memmove ( &blocks[ i + 1 ], &blocks[i],
+			  ( ( peer->count - i ) * sizeof ( blocks[0] ) ) );
+		blocks[i].left = left;
+		blocks[i].right = right;
+		peer->count++;
+	}
+}
+
+/**
+ * Receive packet at simulated peer
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ */
+static void tcp_test_peer_rx ( struct net_device *netdev,
+			       struct io_buffer *iobuf ) {
+	struct tcp_test_peer *peer = netdev->priv;
+	struct ethhdr *ethhdr;
+	struct iphdr *iphdr;
+	struct tcp_header *tcphdr;
+	const struct tcp_timestamp_option *tsopt;
+	const struct tcp_fastopen_option *foopt = NULL;
+	struct ipv4_pseudo_header pshdr;
+	const uint8_t *option;
+	const uint8_t *data;
+	unsigned int flags;
+	unsigned int index;
+	unsigned int i;
+	const unsigned int *drop;
+	size_t hlen;
+	size_t len;
+	size_t acked;
+	uint32_t seq;
+	uint16_t csum;
+
+	/* Ignore anything other than TCP over IPv4 */
+	ethhdr = iobuf->data;
+	if ( ethhdr->h_protocol != htons ( ETH_P_IP ) )
+		return;
+	iphdr = ( ( ( void * ) ethhdr ) + sizeof ( *ethhdr ) );
+	if ( iphdr->protocol != IP_TCP )
+		return;
+	hlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	tcphdr = ( ( ( void * ) iphdr ) + hlen );
+	len = ( ntohs ( iphdr->len ) - hlen );
+
+	/* Verify checksum */
+	pshdr.src = iphdr->src;
+	pshdr.dest = iphdr->dest;
+	pshdr.zero_padding = 0;
+	pshdr.protocol = IP_TCP;
+	pshdr.len = htons ( len );
+	csum = tcpip_chksum ( &pshdr, sizeof ( pshdr ) );
+	if ( tcpip_continue_chksum ( csum, tcphdr, len ) != 0 ) {
+		peer->bad_csum++;
+		return;
+	}
+
+	hlen = ( ( ( tcphdr->hlen & TCP_MASK_HLEN ) / 16 ) * 4 );
+	data = ( ( ( void * ) tcphdr ) + hlen );
+	len -= hlen;
+	seq = ntohl ( tcphdr->seq );
+	flags = tcphdr->flags;
+
+	/* Record timestamp and locate Fast Open option, if present */
+	option = ( ( ( void * ) tcphdr ) + sizeof ( *tcphdr ) );
+	while ( ( option < data ) && ( option[0] != TCP_OPTION_END ) ) {
+		if ( option[0] == TCP_OPTION_NOP ) {
+			option++;
+			continue;
+		}
+		if ( option[0] == TCP_OPTION_TS ) {
+			tsopt = ( ( const void * ) option );
+			peer->ts_recent = ntohl ( tsopt->tsval );
+		}
+		if ( option[0] == TCP_OPTION_FASTOPEN )
+			foopt = ( ( const void * ) option );
+		option += option[1];
+	}
+
+	/* Ignore RSTs */
+	if ( flags & TCP_RST )
+		return;
+
+	/* Respond to SYN with SYN-ACK, accepting any data within the
+	 * SYN if it carries a valid Fast Open cookie, and providing a
+	 * cookie if the SYN does not.
+	 */
+	if ( flags & TCP_SYN ) {
+		peer->syn = 1;
+		peer->local_port = ntohs ( tcphdr->src );
+		peer->isn = seq;
+		peer->rcv_nxt = ( seq + 1 );
+		peer->send_cookie = 0;
+		peer->syn_fastopen = ( foopt != NULL );
+		if ( peer->fastopen && foopt &&
+		     ( foopt->length == ( sizeof ( *foopt ) +
+					  sizeof ( tcp_test_cookie ) ) ) &&
+		     ( memcmp ( foopt->cookie, tcp_test_cookie,
+				sizeof ( tcp_test_cookie ) ) == 0 ) ) {
+			for ( i = 0 ; i < len ; i++ ) {
+				if ( data[i] != tcp_test_byte ( i ) )
+					peer->corrupt++;
+			}
+			peer->rcv_nxt += len;
+			peer->syn_len = len;
+		} else if ( peer->fastopen && foopt ) {
+			peer->send_cookie = 1;
+		}
+		tcp_test_peer_tx ( netdev, ( TCP_SYN | TCP_ACK ),
+				   TCP_TEST_ISN, 0, 0 );
+		return;
+	}
+
+	/* Record acknowledgement of data sent by peer */
+	if ( flags & TCP_ACK ) {
+		acked = ( ntohl ( tcphdr->ack ) - TCP_TEST_ISN - 1 );
+		if ( ( acked <= peer->tx_offset ) && ( acked > peer->tx_acked ) )
+			peer->tx_acked = acked;
+	}
+
+	/* Respond to FIN with RST, once all data has been received */
+	if ( ( flags & TCP_FIN ) && ( ( seq + len ) == peer->rcv_nxt ) ) {
+		tcp_test_peer_tx ( netdev, TCP_RST,
+				   ( TCP_TEST_ISN + 1 + peer->tx_offset ), 0, 0 );
+		peer->reset = 1;
+		return;
+	}
+
+	/* Ignore segments carrying no data */
+	if ( ! len )
+		return;
+
+	/* Drop segment, if applicable */
+	index = ++peer->segments;
+	peer->seed = ( ( peer->seed * 1103515245UL ) + 12345 );
+	for ( drop = peer->drops ; drop && *drop ; drop++ ) {
+		if ( *drop == index ) {
+			peer->dropped++;
+			return;
+		}
+	}
+	if ( ( ( peer->seed >> 16 ) % 10000 ) < peer->loss ) {
+		peer->dropped++;
+		return;
+	}
+
+	/* Verify data */
+	for ( i = 0 ; i < len ; i++ ) {
+		if ( data[i] != tcp_test_byte ( seq + i - peer->isn - 1 ) )
+			peer->corrupt++;
+	}
+
+	/* Record data and send acknowledgement */
+	tcp_test_peer_rx_data ( peer, seq, ( seq + len ) );
+	tcp_test_peer_tx ( netdev, TCP_ACK,
+			   ( TCP_TEST_ISN + 1 + peer->tx_offset ), seq, 0 );
+}
+
+/**
+ * Transmit packet via test network device
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ */
+static void tcp_test_transmit ( struct net_device *netdev,
+				struct io_buffer *iobuf ) {
+	struct tcp_test_peer *peer = netdev->priv;
+
+	/* Insert checksum, if applicable */
+	if ( iobuf->flags & IOB_CSUM_PARTIAL ) {
+		tcpip_csum_complete ( iobuf );
+		peer->offloaded++;
+	}
+
+	tcp_test_peer_rx ( netdev, iobuf );
+}
+
+/**
+ * Poll test network device
+ *
+ * @v netdev		Network device
+ *
+ * Packets sent in response to received packets are enqueued as they
+ * are generated.  Data sent by the peer is enqueued as a burst of
+ * back-to-back segments in each poll.
+ */
+static void tcp_test_poll ( struct net_device *netdev ) {
+	struct tcp_test_peer *peer = netdev->priv;
+	unsigned int i;
+	size_t len;
+
+	/* Send a burst of data, if applicable */
+	for ( i = 0 ; ( ( i < TCP_TEST_BURST ) && peer->syn &&
+			( ! peer->reset ) &&
+			( peer->tx_offset < peer->tx_len ) &&
+			( ( peer->tx_offset - peer->tx_acked ) <
+			  TCP_TEST_INFLIGHT ) ) ; i++ ) {
+		len = ( peer->tx_len - peer->tx_offset );
+		if ( len > TCP_TEST_MSS )
+			len = TCP_TEST_MSS;
+		tcp_test_peer_tx ( netdev, TCP_ACK,
+				   ( TCP_TEST_ISN + 1 + peer->tx_offset ),
+				   0, len );
+		peer->tx_offset += len;
+	}
+}
+
+/**
+ * Deliver data from test application
+ *
+ * @v app		Test application
+ */
+static void tcp_test_app_fill ( struct tcp_test_app *app ) {
+	struct io_buffer *iobuf;
+	uint8_t *data;
+	size_t len;
+	size_t i;
+
+	/* Deliver as much data as the window allows */
+	while ( ( app->offset < TCP_TEST_LEN ) &&
+		( ( len = xfer_window ( &app->xfer ) ) != 0 ) ) {
+		if ( len > TCP_TEST_CHUNK )
+			len = TCP_TEST_CHUNK;
+		if ( len > ( TCP_TEST_LEN - app->offset ) )
+			len = ( TCP_TEST_LEN - app->offset );
+		iobuf = xfer_alloc_iob ( &app->xfer, len );
+		if ( ! iobuf )
+			return;
+		data = iob_put ( iobuf, len );
+		for ( i = 0 ; i < len ; i++ )
+			data[i] = tcp_test_byte ( app->offset + i );
+		if ( xfer_deliver_iob ( &app->xfer, iobuf ) != 0 )
+			return;
+		app->offset += len;
+	}
+}
+
+/**
+ * Receive data at test application
+ *
+ * @v app		Test application
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int tcp_test_app_deliver ( struct tcp_test_app *app,
+				  struct io_buffer *iobuf,
+				  struct xfer_metadata *meta __unused ) {
+	const uint8_t *data = iobuf->data;
+	size_t len = iob_len ( iobuf );
+	size_t i;
+
+	/* Verify data */
+	for ( i = 0 ; i < len ; i++ ) {
+		if ( data[i] != tcp_test_byte ( app->received + i ) )
+			app->corrupt++;
+	}
+	app->received += len;
+
+	free_iob ( iobuf );
+	return 0;
+}
+
+/**
+ * Close test application
+ *
+ * @v app		Test application
+ * @v rc		Reason for close
+ */
+static void tcp_test_app_close ( struct tcp_test_app *app, int rc ) {
+
+	intf_shutdown ( &app->xfer, rc );
+	app->rc = rc;
+	app->closed = 1;
+}
+
+/** Test application data transfer interface operations */
+static struct interface_operation tcp_test_app_operations[] = {
+	INTF_OP ( xfer_deliver, struct tcp_test_app *,
+		  tcp_test_app_deliver ),
+	INTF_OP ( xfer_window_changed, struct tcp_test_app *,
+		  tcp_test_app_fill ),
+	INTF_OP ( intf_close, struct tcp_test_app *, tcp_test_app_close ),
+};
+
+/** Test application data transfer interface descriptor */
+static struct interface_descriptor tcp_test_app_desc =
+	INTF_DESC ( struct tcp_test_app, xfer, tcp_test_app_operations );
+
+/**
+ * Find TCP connection information
+ *
+ * @v port		Local port
+ * @v info		Connection information to fill in
+ * @ret rc		Return status code
+ */
+static int tcp_test_info ( unsigned int port, struct tcp_info *info ) {
+	unsigned int i;
+	int rc;
+
+	for ( i = 0 ; ( rc = tcp_connection_info ( i, info ) ) == 0 ; i++ ) {
+		if ( info->local_port == port )
+			return 0;
+	}
+	return rc;
+}
+
+/**
+ * Run TCP transfer test
+ *
+ * @v sack		Peer supports selective acknowledgements
+ * @v fastopen		Peer supports Fast Open
+ * @v offload		Test network device offloads checksums
+ * @v loss		Random loss rate (in parts per 10000)
+ * @v drops		Data segments to drop, or NULL
+ * @v rx_len		Length of data to be sent by peer
+ * @v info		Connection information to fill in
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tcp_transfer_okx ( int sack, int fastopen, int offload,
+			       unsigned int loss, const unsigned int *drops,
+			       size_t rx_len, struct tcp_info *info,
+			       const char *file, unsigned int line ) {
+	struct sockaddr_in sin;
+	struct tcp_test_app app;
+	struct tcp_test_peer *peer;
+	struct net_device *netdev;
+	struct settings *settings;
+	struct tcp_info tmp;
+	unsigned long start;
+	unsigned long elapsed;
+
+	/* Create and open test network device */
+	netdev = testnet_create ( sizeof ( *peer ), tcp_test_transmit,
+				  tcp_test_poll );
+	okx ( netdev != NULL, file, line );
+	if ( ! netdev )
+		return;
+	peer = netdev->priv;
+	peer->sack = sack;
+	peer->fastopen = fastopen;
+	peer->offload = offload;
+	peer->loss = loss;
+	peer->drops = drops;
+	peer->seed = ( loss + 1 );
+	peer->tx_len = rx_len;
+	if ( offload )
+		netdev->state |= ( NETDEV_TX_CSUM | NETDEV_RX_CSUM );
+
+	/* Configure IPv4 address and peer's link-layer address */
+	settings = netdev_settings ( netdev );
+	okx ( store_setting ( settings, &ip_setting, &tcp_test_local,
+			      sizeof ( tcp_test_local ) ) == 0, file, line );
+	okx ( store_setting ( settings, &netmask_setting, &tcp_test_netmask,
+			      sizeof ( tcp_test_netmask ) ) == 0, file, line );
+	okx ( neighbour_define ( netdev, &ipv4_protocol, &tcp_test_remote,
+				 tcp_test_remote_mac ) == 0, file, line );
+
+	/* Open connection */
+	memset ( &app, 0, sizeof ( app ) );
+	intf_init ( &app.xfer, &tcp_test_app_desc, NULL );
+	memset ( &sin, 0, sizeof ( sin ) );
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons ( TCP_TEST_PORT );
+	sin.sin_addr = tcp_test_remote;
+	okx ( xfer_open_socket ( &app.xfer, SOCK_STREAM,
+				 ( struct sockaddr * ) &sin, NULL ) == 0,
+	      file, line );
+
+	/* Transfer data */
+	start = currticks();
+	while ( ( ( elapsed = ( currticks() - start ) ) < TCP_TEST_TIMEOUT ) &&
+		( ( ! peer->syn ) ||
+		  ( ( peer->rcv_nxt - peer->isn - 1 ) < TCP_TEST_LEN ) ||
+		  ( app.received < rx_len ) ) &&
+		( ! app.closed ) ) {
+		step();
+	}
+	okx ( ! app.closed, file, line );
+	okx ( ( peer->rcv_nxt - peer->isn - 1 ) == TCP_TEST_LEN, file, line );
+	okx ( peer->corrupt == 0, file, line );
+	okx ( app.received == rx_len, file, line );
+	okx ( app.corrupt == 0, file, line );
+	okx ( ( netdev->rx_gro.packets != 0 ) == ( rx_len != 0 ), file, line );
+	okx ( netdev->rx_gro.segments >= ( 2 * netdev->rx_gro.packets ),
+	      file, line );
+	okx ( peer->bad_csum == 0, file, line );
+	okx ( ( peer->offloaded != 0 ) == ( offload != 0 ), file, line );
+
+	/* Record connection information */
+	okx ( tcp_test_info ( peer->local_port, info ) == 0, file, line );
+	okx ( info->fastopen == peer->syn_len, file, line );
+	okx ( peer->syn_fastopen ==
+	      ( fetch_intz_setting ( NULL, &tcp_fastopen_setting ) != 0 ),
+	      file, line );
+	DBG ( "TCP %s loss %d.%02d%%: %d bytes in %ldms (%d dropped, %d "
+	      "retransmitted, %d fast retransmits, %d timeouts)\n",
+	      ( sack ? "SACK" : "NewReno" ), ( loss / 100 ), ( loss % 100 ),
+	      TCP_TEST_LEN, ( ( elapsed * 1000 ) / TICKS_PER_SEC ),
+	      peer->dropped, info->retransmits, info->fast_retransmits,
+	      info->timeouts );
+	if ( rx_len ) {
+		DBG ( "TCP received %zd bytes (%d segments coalesced into %d "
+		      "packets)\n", rx_len, netdev->rx_gro.segments,
+		      netdev->rx_gro.packets );
+	}
+
+	/* Close connection, and wait for the peer to reset it */
+	intf_shutdown ( &app.xfer, 0 );
+	start = currticks();
+	while ( ( ( currticks() - start ) < TCP_TEST_TIMEOUT ) &&
+		( tcp_test_info ( peer->local_port, &tmp ) == 0 ) ) {
+		step();
+	}
+	okx ( peer->reset, file, line );
+	okx ( tcp_test_info ( peer->local_port, &tmp ) != 0, file, line );
+
+	/* Close and remove test network device */
+	testnet_remove ( netdev );
+}
+#define tcp_transfer_ok( sack, fastopen, offload, loss, drops, rx_len,	\
+			 info )						\
+	tcp_transfer_okx ( sack, fastopen, offload, loss, drops, rx_len,	\
+			   info, __FILE__, __LINE__ )
+
+/**
+ * Perform TCP self-tests
+ *
+ */
+static void tcp_test_exec ( void ) {
+	static const unsigned int single[] = { 100, 0 };
+	static const unsigned int multiple[] = { 100, 103, 106, 0 };
+	struct tcp_info info;
+
+	/* Lossless transfer should require no retransmissions */
+	tcp_transfer_ok ( 1, 0, 0, 0, NULL, 0, &info );
+	ok ( info.retransmits == 0 );
+	ok ( info.timeouts == 0 );
+
+	/* A single loss should be repaired by fast retransmission */
+	tcp_transfer_ok ( 1, 0, 0, 0, single, 0, &info );
+	ok ( info.fast_retransmits == 1 );
+	ok ( info.retransmits == 1 );
+	ok ( info.timeouts == 0 );
+
+	/* Multiple losses within a window should be repaired within a
+	 * single fast recovery, using either SACK or NewReno partial
+	 * acknowledgements.
+	 */
+	tcp_transfer_ok ( 1, 0, 0, 0, multiple, 0, &info );
+	ok ( info.fast_retransmits == 1 );
+	ok ( info.retransmits == 3 );
+	ok ( info.timeouts == 0 );
+	tcp_transfer_ok ( 0, 0, 0, 0, multiple, 0, &info );
+	ok ( info.fast_retransmits == 1 );
+	ok ( info.retransmits == 3 );
+	ok ( info.timeouts == 0 );
+
+	/* Random losses should be survivable */
+	tcp_transfer_ok ( 1, 0, 0, 10, NULL, 0, &info );
+	tcp_transfer_ok ( 1, 0, 0, 100, NULL, 0, &info );
+	tcp_transfer_ok ( 1, 0, 0, 500, NULL, 0, &info );
+	tcp_transfer_ok ( 0, 0, 0, 100, NULL, 0, &info );
+
+	/* Checksums should be left to a network device that can
+	 * insert them, and should not be verified again if the
+	 * network device has already done so.
+	 */
+	tcp_transfer_ok ( 1, 0, 1, 0, NULL, 0, &info );
+	ok ( info.retransmits == 0 );
+	tcp_transfer_ok ( 1, 0, 1, 100, NULL, 0, &info );
+
+	/* Back-to-back data segments sent by the peer should be
+	 * coalesced into larger packets before reaching TCP, with
+	 * checksums verified (unless already verified by the network
+	 * device).
+	 */
+	tcp_transfer_ok ( 1, 0, 0, 0, NULL, TCP_TEST_LEN, &info );
+	ok ( info.retransmits == 0 );
+	tcp_transfer_ok ( 1, 0, 1, 0, NULL, TCP_TEST_LEN, &info );
+	ok ( info.retransmits == 0 );
+
+	/* Fast Open should not be used unless explicitly enabled */
+	tcp_transfer_ok ( 1, 1, 0, 0, NULL, 0, &info );
+	ok ( info.fastopen == 0 );
+	ok ( info.retransmits == 0 );
+	ok ( storef_setting ( NULL, &tcp_fastopen_setting, "1" ) == 0 );
+
+	/* Fast Open should obtain a cookie on the first connection
+	 * to a peer, and send data within the SYN thereafter.
+	 */
+	tcp_transfer_ok ( 1, 1, 0, 0, NULL, 0, &info );
+	ok ( info.fastopen == 0 );
+	tcp_transfer_ok ( 1, 1, 0, 0, NULL, 0, &info );
+	ok ( info.fastopen == TCP_FASTOPEN_MAX_DATA );
+	ok ( info.retransmits == 0 );
+
+	/* Fast Open should fall back to retransmitting the data if
+	 * the peer ignores it, and should then forget the cookie.
+	 */
+	tcp_transfer_ok ( 1, 0, 0, 0, NULL, 0, &info );
+	ok ( info.fastopen == 0 );
+	ok ( info.retransmits == 1 );
+	ok ( info.timeouts == 0 );
+	tcp_transfer_ok ( 1, 1, 0, 0, NULL, 0, &info );
+	ok ( info.fastopen == 0 );
+	ok ( info.retransmits == 0 );
+	ok ( delete_setting ( NULL, &tcp_fastopen_setting ) == 0 );
+}
+
+/** TCP self-test */
+struct self_test tcp_test __self_test = {
+	.name = "tcp",
+	.exec = tcp_test_exec,
+};
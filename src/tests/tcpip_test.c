@@ -81,9 +81,16 @@ struct tcpip_random_test {
 		.offset = OFFSET,					\
 	}
 
+/** Maximum length of data used for benchmarking */
+#define TCPIP_BENCHMARK_MAX_LEN 16384
+
 /** Buffer for pseudorandom-data tests */
 static uint8_t __attribute__ (( aligned ( 16 ) ))
-	tcpip_data[ 4096 + 7 /* offset */ ];
+	tcpip_data[ TCPIP_BENCHMARK_MAX_LEN + 7 /* offset */ ];
+
+/** Destination buffer for copy tests */
+static uint8_t __attribute__ (( aligned ( 16 ) ))
+	tcpip_copy[ TCPIP_BENCHMARK_MAX_LEN + 7 /* offset */ ];
 
 /** Empty data */
 TCPIP_TEST ( empty, DATA() );
@@ -182,6 +189,13 @@ static void tcpip_okx ( struct tcpip_test *test, const char *file,
 	/* Verify optimised tcpip_continue_chksum() result */
 	sum = tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, test->data, test->len );
 	okx ( sum == expected, file, line );
+
+	/* Verify tcpip_copy_chksum() result */
+	memset ( tcpip_copy, 0, sizeof ( tcpip_copy ) );
+	sum = tcpip_copy_chksum ( TCPIP_EMPTY_CSUM, tcpip_copy, test->data,
+				  test->len );
+	okx ( sum == expected, file, line );
+	okx ( memcmp ( tcpip_copy, test->data, test->len ) == 0, file, line );
 }
 #define tcpip_ok( test ) tcpip_okx ( test, __FILE__, __LINE__ )
 
@@ -195,6 +209,7 @@ static void tcpip_okx ( struct tcpip_test *test, const char *file,
 static void tcpip_random_okx ( struct tcpip_random_test *test,
 			       const char *file, unsigned int line ) {
 	uint8_t *data = ( tcpip_data + test->offset );
+	uint8_t *copy = ( tcpip_copy + ( ( test->offset + 3 ) & 7 ) );
 	struct profiler profiler;
 	uint16_t expected;
 	uint16_t generic_sum;
@@ -219,6 +234,14 @@ static void tcpip_random_okx ( struct tcpip_random_test *test,
 	sum = tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, test->len );
 	okx ( sum == expected, file, line );
 
+	/* Verify tcpip_copy_chksum() result (to a differently-aligned
+	 * destination buffer).
+	 */
+	memset ( tcpip_copy, 0, sizeof ( tcpip_copy ) );
+	sum = tcpip_copy_chksum ( TCPIP_EMPTY_CSUM, copy, data, test->len );
+	okx ( sum == expected, file, line );
+	okx ( memcmp ( copy, data, test->len ) == 0, file, line );
+
 	/* Profile optimised calculation */
 	memset ( &profiler, 0, sizeof ( profiler ) );
 	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
@@ -233,6 +256,50 @@ static void tcpip_random_okx ( struct tcpip_random_test *test,
 }
 #define tcpip_random_ok( test ) tcpip_random_okx ( test, __FILE__, __LINE__ )
 
+/**
+ * Benchmark TCP/IP checksum calculation
+ *
+ * @v len		Length of data
+ * @v offset		Alignment offset
+ */
+static void tcpip_benchmark ( size_t len, size_t offset ) {
+	uint8_t *data = ( tcpip_data + offset );
+	uint8_t *copy = ( tcpip_copy + offset );
+	struct profiler optimised;
+	struct profiler generic;
+	struct profiler copied;
+	struct profiler memcopied;
+	unsigned int i;
+
+	/* Sanity check */
+	assert ( ( len + offset ) <= sizeof ( tcpip_data ) );
+
+	/* Profile each implementation */
+	memset ( &optimised, 0, sizeof ( optimised ) );
+	memset ( &generic, 0, sizeof ( generic ) );
+	memset ( &copied, 0, sizeof ( copied ) );
+	memset ( &memcopied, 0, sizeof ( memcopied ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &optimised );
+		tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, len );
+		profile_stop ( &optimised );
+		profile_start ( &generic );
+		generic_tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, len );
+		profile_stop ( &generic );
+		profile_start ( &copied );
+		tcpip_copy_chksum ( TCPIP_EMPTY_CSUM, copy, data, len );
+		profile_stop ( &copied );
+		profile_start ( &memcopied );
+		memcpy ( copy, data, len );
+		tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, copy, len );
+		profile_stop ( &memcopied );
+	}
+	DBG ( "TCPIP benchmark %5zd bytes (+%zd): optimised %ld, generic %ld, "
+	      "copy %ld (vs. %ld) ticks\n", len, offset,
+	      profile_mean ( &optimised ), profile_mean ( &generic ),
+	      profile_mean ( &copied ), profile_mean ( &memcopied ) );
+}
+
 /**
  * Perform TCP/IP self-tests
  *
@@ -251,6 +318,19 @@ static void tcpip_test_exec ( void ) {
 	tcpip_random_ok ( &random_unaligned_2 );
 	tcpip_random_ok ( &random_aligned_truncated );
 	tcpip_random_ok ( &partial );
+
+	/* Benchmark across a range of lengths and alignments */
+	tcpip_benchmark ( 64, 0 );
+	tcpip_benchmark ( 64, 2 );
+	tcpip_benchmark ( 576, 0 );
+	tcpip_benchmark ( 576, 2 );
+	tcpip_benchmark ( 1460, 0 );
+	tcpip_benchmark ( 1460, 2 );
+	tcpip_benchmark ( 1460, 1 );
+	tcpip_benchmark ( 4096, 0 );
+	tcpip_benchmark ( 4096, 2 );
+	tcpip_benchmark ( TCPIP_BENCHMARK_MAX_LEN, 0 );
+	tcpip_benchmark ( TCPIP_BENCHMARK_MAX_LEN, 4 );
 }
 
 /** TCP/IP self-test */
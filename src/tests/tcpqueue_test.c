@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TCP out-of-order receive queue self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/tcp.h>
+#include <ipxe/tcpqueue.h>
+#include <ipxe/test.h>
+#include <ipxe/profile.h>
+
+/** Initial sequence number (chosen to exercise wraparound) */
+#define TCPQUEUE_TEST_ISN 0xfff00000UL
+
+/** Maximum segment size used in simulated stream */
+#define TCPQUEUE_TEST_MSS 1460
+
+/** Number of segments in simulated stream */
+#define TCPQUEUE_TEST_COUNT 4096
+
+/** Total length of simulated stream */
+#define TCPQUEUE_TEST_LEN ( TCPQUEUE_TEST_COUNT * TCPQUEUE_TEST_MSS )
+
+/** Delay (in segments) before a lost segment is retransmitted */
+#define TCPQUEUE_TEST_RETRANSMIT 64
+
+/** A simulated TCP receiver */
+struct tcpqueue_test_receiver {
+	/** Receive queue */
+	struct tcp_rx_queue queue;
+	/** Current acknowledgement number */
+	uint32_t ack;
+	/** Number of data bytes found to be corrupt */
+	unsigned int errors;
+};
+
+/** Insertion profiler */
+static struct profiler tcpqueue_insert_profiler;
+
+/**
+ * Get expected stream content
+ *
+ * @v seq		SEQ value
+ * @ret byte		Expected data byte
+ */
+static uint8_t tcpqueue_test_byte ( uint32_t seq ) {
+
+	return ( ( seq * 0x9e3779b1UL ) >> 24 );
+}
+
+/**
+ * Construct queued packet
+ *
+ * @v seq		SEQ value
+ * @v len		Length of data
+ * @ret iobuf		I/O buffer (starting with internal header)
+ */
+static struct io_buffer * tcpqueue_test_packet ( uint32_t seq, size_t len ) {
+	struct tcp_rx_queued_header *tcpqhdr;
+	struct io_buffer *iobuf;
+	uint8_t *data;
+	size_t i;
+
+	iobuf = alloc_iob ( sizeof ( *tcpqhdr ) + len );
+	if ( ! iobuf )
+		return NULL;
+	tcpqhdr = iob_put ( iobuf, sizeof ( *tcpqhdr ) );
+	memset ( tcpqhdr, 0, sizeof ( *tcpqhdr ) );
+	tcpqhdr->seq = seq;
+	tcpqhdr->nxt = ( seq + len );
+	data = iob_put ( iobuf, len );
+	for ( i = 0 ; i < len ; i++ )
+		data[i] = tcpqueue_test_byte ( seq + i );
+	return iobuf;
+}
+
+/**
+ * Receive packet
+ *
+ * @v rx		Simulated receiver
+ * @v seq		SEQ value
+ * @v len		Length of data
+ */
+static void tcpqueue_test_rx ( struct tcpqueue_test_receiver *rx,
+			       uint32_t seq, size_t len ) {
+	struct tcp_rx_queued_header *tcpqhdr;
+	struct io_buffer *iobuf;
+	uint8_t *data;
+	size_t skip;
+	size_t i;
+
+	/* Construct and enqueue packet */
+	iobuf = tcpqueue_test_packet ( seq, len );
+	if ( ! iobuf ) {
+		rx->errors++;
+		return;
+	}
+	profile_start ( &tcpqueue_insert_profiler );
+	tcp_rx_queue_insert ( &rx->queue, iobuf );
+	profile_stop ( &tcpqueue_insert_profiler );
+
+	/* Process queue in the same way as tcp_process_rx_queue() */
+	while ( ( iobuf = tcp_rx_queue_dequeue ( &rx->queue, rx->ack ) ) ) {
+		tcpqhdr = iobuf->data;
+		if ( tcp_cmp ( tcpqhdr->seq, rx->ack ) > 0 )
+			rx->errors++;
+		skip = ( rx->ack - tcpqhdr->seq );
+		if ( tcp_cmp ( tcpqhdr->nxt, rx->ack ) > 0 ) {
+			data = ( iobuf->data + sizeof ( *tcpqhdr ) );
+			len = ( tcpqhdr->nxt - tcpqhdr->seq );
+			for ( i = skip ; i < len ; i++ ) {
+				if ( data[i] != tcpqueue_test_byte ( rx->ack ) )
+					rx->errors++;
+				rx->ack++;
+			}
+		}
+		free_iob ( iobuf );
+	}
+}
+
+/**
+ * Check SACK block
+ *
+ * @v rx		Simulated receiver
+ * @v seq		SEQ value within block
+ * @v left		Expected start of block
+ * @v right		Expected end of block
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tcpqueue_sack_okx ( struct tcpqueue_test_receiver *rx,
+				uint32_t seq, uint32_t left, uint32_t right,
+				const char *file, unsigned int line ) {
+	struct tcp_sack_block sack;
+
+	memset ( &sack, 0, sizeof ( sack ) );
+	okx ( tcp_rx_queue_sack ( &rx->queue, seq, &sack ) ==
+	      ( right - left ), file, line );
+	if ( left != right ) {
+		okx ( sack.left == left, file, line );
+		okx ( sack.right == right, file, line );
+	}
+}
+#define tcpqueue_sack_ok( rx, seq, left, right ) \
+	tcpqueue_sack_okx ( rx, seq, left, right, __FILE__, __LINE__ )
+
+/**
+ * Perform block merging self-tests
+ *
+ */
+static void tcpqueue_merge_test_exec ( void ) {
+	struct tcpqueue_test_receiver rx;
+	uint32_t base = TCPQUEUE_TEST_ISN;
+
+	memset ( &rx, 0, sizeof ( rx ) );
+	tcp_rx_queue_init ( &rx.queue );
+	rx.ack = base;
+
+	/* Create three separate blocks */
+	tcpqueue_test_rx ( &rx, ( base + 100 ), 100 );
+	tcpqueue_test_rx ( &rx, ( base + 400 ), 100 );
+	tcpqueue_test_rx ( &rx, ( base + 250 ), 50 );
+	ok ( rx.queue.count == 3 );
+	tcpqueue_sack_ok ( &rx, ( base + 150 ), ( base + 100 ), ( base + 200 ));
+	tcpqueue_sack_ok ( &rx, ( base + 250 ), ( base + 250 ), ( base + 300 ));
+	tcpqueue_sack_ok ( &rx, ( base + 499 ), ( base + 400 ), ( base + 500 ));
+	tcpqueue_sack_ok ( &rx, ( base + 350 ), 0, 0 );
+	tcpqueue_sack_ok ( &rx, ( base + 50 ), 0, 0 );
+
+	/* Duplicate data should be discarded */
+	tcpqueue_test_rx ( &rx, ( base + 120 ), 60 );
+	ok ( rx.queue.count == 3 );
+
+	/* Overlapping data should extend a block */
+	tcpqueue_test_rx ( &rx, ( base + 150 ), 100 );
+	ok ( rx.queue.count == 4 );
+	tcpqueue_sack_ok ( &rx, ( base + 100 ), ( base + 100 ), ( base + 300 ));
+
+	/* Data spanning a gap should merge blocks */
+	tcpqueue_test_rx ( &rx, ( base + 290 ), 120 );
+	ok ( rx.queue.count == 5 );
+	tcpqueue_sack_ok ( &rx, ( base + 450 ), ( base + 100 ), ( base + 500 ));
+
+	/* Create a further block and discard it */
+	tcpqueue_test_rx ( &rx, ( base + 600 ), 100 );
+	tcpqueue_sack_ok ( &rx, ( base + 600 ), ( base + 600 ), ( base + 700 ));
+	ok ( tcp_rx_queue_discard ( &rx.queue ) == 1 );
+	tcpqueue_sack_ok ( &rx, ( base + 600 ), 0, 0 );
+	ok ( rx.queue.count == 5 );
+
+	/* Discarding the most recently merged packet should shrink
+	 * the block back to the end of the spanning packet.
+	 */
+	ok ( tcp_rx_queue_discard ( &rx.queue ) == 1 );
+	ok ( rx.queue.count == 4 );
+	tcpqueue_sack_ok ( &rx, ( base + 100 ), ( base + 100 ), ( base + 410 ));
+
+	/* Filling the initial gap should allow all data to be processed */
+	tcpqueue_test_rx ( &rx, base, 100 );
+	ok ( rx.ack == ( base + 410 ) );
+	ok ( tcp_rx_queue_empty ( &rx.queue ) );
+
+	/* Flush queue */
+	tcpqueue_test_rx ( &rx, ( base + 500 ), 100 );
+	tcpqueue_test_rx ( &rx, ( base + 700 ), 100 );
+	ok ( rx.queue.count == 2 );
+	tcp_rx_queue_flush ( &rx.queue );
+	ok ( tcp_rx_queue_empty ( &rx.queue ) );
+	ok ( rx.queue.count == 0 );
+	ok ( tcp_rx_queue_discard ( &rx.queue ) == 0 );
+	ok ( rx.errors == 0 );
+}
+
+/**
+ * Perform lossy stream self-test
+ *
+ * @v loss		Loss interval (in segments)
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tcpqueue_stream_okx ( unsigned int loss, const char *file,
+				  unsigned int line ) {
+	struct tcpqueue_test_receiver rx;
+	struct tcp_sack_block sack;
+	uint32_t base = TCPQUEUE_TEST_ISN;
+	unsigned long elapsed;
+	unsigned int max_count = 0;
+	unsigned int lost = 0;
+	size_t start;
+	size_t end;
+	unsigned int i;
+	unsigned int j;
+
+	memset ( &rx, 0, sizeof ( rx ) );
+	tcp_rx_queue_init ( &rx.queue );
+	rx.ack = base;
+	memset ( &tcpqueue_insert_profiler, 0,
+		 sizeof ( tcpqueue_insert_profiler ) );
+	elapsed = profile_timestamp();
+
+	/* Transmit stream, dropping segments at a fixed interval and
+	 * retransmitting them after a fixed delay.  Retransmissions
+	 * are extended to overlap the neighbouring segments, to
+	 * exercise the handling of partial overlaps.
+	 */
+	for ( i = 0 ; i < ( TCPQUEUE_TEST_COUNT + TCPQUEUE_TEST_RETRANSMIT ) ;
+	      i++ ) {
+		if ( i < TCPQUEUE_TEST_COUNT ) {
+			if ( ( ( i * 7 ) % loss ) == 0 ) {
+				lost++;
+			} else {
+				tcpqueue_test_rx ( &rx, ( base + i *
+							  TCPQUEUE_TEST_MSS ),
+						   TCPQUEUE_TEST_MSS );
+			}
+		}
+		if ( i >= TCPQUEUE_TEST_RETRANSMIT ) {
+			j = ( i - TCPQUEUE_TEST_RETRANSMIT );
+			if ( ( ( j * 7 ) % loss ) == 0 ) {
+				start = ( j * TCPQUEUE_TEST_MSS );
+				if ( j )
+					start -= ( TCPQUEUE_TEST_MSS / 2 );
+				end = ( ( j + 1 ) * TCPQUEUE_TEST_MSS +
+					( TCPQUEUE_TEST_MSS / 2 ) );
+				if ( end > TCPQUEUE_TEST_LEN )
+					end = TCPQUEUE_TEST_LEN;
+				tcpqueue_test_rx ( &rx, ( base + start ),
+						   ( end - start ) );
+			}
+		}
+		if ( ! tcp_rx_queue_empty ( &rx.queue ) ) {
+			okx ( tcp_rx_queue_sack ( &rx.queue, rx.ack,
+						  &sack ) == 0, file, line );
+		}
+		if ( max_count < rx.queue.count )
+			max_count = rx.queue.count;
+	}
+	elapsed = ( profile_timestamp() - elapsed );
+
+	/* Check that complete stream was received */
+	okx ( rx.ack == ( base + TCPQUEUE_TEST_LEN ), file, line );
+	okx ( tcp_rx_queue_empty ( &rx.queue ), file, line );
+	okx ( rx.queue.count == 0, file, line );
+	okx ( rx.errors == 0, file, line );
+
+	DBG ( "TCPQUEUE lost %d/%d segments (max %d queued) inserted in "
+	      "%ld +/- %ld ticks, reassembled in %ld ticks\n", lost,
+	      TCPQUEUE_TEST_COUNT, max_count,
+	      profile_mean ( &tcpqueue_insert_profiler ),
+	      profile_stddev ( &tcpqueue_insert_profiler ), elapsed );
+}
+#define tcpqueue_stream_ok( loss ) \
+	tcpqueue_stream_okx ( loss, __FILE__, __LINE__ )
+
+/**
+ * Perform TCP receive queue self-tests
+ *
+ */
+static void tcpqueue_test_exec ( void ) {
+
+	/* Check block merging */
+	tcpqueue_merge_test_exec();
+
+	/* Check reassembly of lossy streams */
+	tcpqueue_stream_ok ( 1000 );
+	tcpqueue_stream_ok ( 100 );
+	tcpqueue_stream_ok ( 10 );
+	tcpqueue_stream_ok ( 3 );
+}
+
+/** TCP receive queue self-test */
+struct self_test tcpqueue_test __self_test = {
+	.name = "tcpqueue",
+	.exec = tcpqueue_test_exec,
+};
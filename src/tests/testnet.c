@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Test network devices
+ *
+ * A test network device is an Ethernet device whose transmitted
+ * packets are handed to a self-test's transmit hook, and which may
+ * deliver received packets from a self-test's poll hook.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ipxe/ethernet.h>
+#include "testnet.h"
+
+/**
+ * Get test network device
+ *
+ * @v netdev		Network device
+ * @ret testnet		Test network device
+ */
+static inline struct testnet * testnet ( struct net_device *netdev ) {
+	return container_of ( netdev->dev, struct testnet, dev );
+}
+
+/**
+ * Open test network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int testnet_open ( struct net_device *netdev __unused ) {
+	return 0;
+}
+
+/**
+ * Close test network device
+ *
+ * @v netdev		Network device
+ */
+static void testnet_close ( struct net_device *netdev __unused ) {
+	/* Nothing to do */
+}
+
+/**
+ * Transmit packet via test network device
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int testnet_transmit ( struct net_device *netdev,
+			      struct io_buffer *iobuf ) {
+	struct testnet *test = testnet ( netdev );
+
+	/* Hand packet to self-test, if applicable */
+	if ( test->transmit )
+		test->transmit ( netdev, iobuf );
+
+	/* Complete packet */
+	netdev_tx_complete ( netdev, iobuf );
+	return 0;
+}
+
+/**
+ * Poll test network device
+ *
+ * @v netdev		Network device
+ */
+static void testnet_poll ( struct net_device *netdev ) {
+	struct testnet *test = testnet ( netdev );
+
+	/* Poll self-test, if applicable */
+	if ( test->poll )
+		test->poll ( netdev );
+}
+
+/** Test network device operations */
+static struct net_device_operations testnet_operations = {
+	.open = testnet_open,
+	.close = testnet_close,
+	.transmit = testnet_transmit,
+	.poll = testnet_poll,
+};
+
+/**
+ * Create and open test network device
+ *
+ * @v priv_len		Length of self-test private data
+ * @v transmit		Transmit hook, or NULL to discard packets
+ * @v poll		Poll hook, or NULL
+ * @ret netdev		Network device, or NULL on error
+ */
+struct net_device *
+testnet_create ( size_t priv_len,
+		 void ( * transmit ) ( struct net_device *netdev,
+				       struct io_buffer *iobuf ),
+		 void ( * poll ) ( struct net_device *netdev ) ) {
+	struct net_device *netdev;
+	struct testnet *test;
+
+	/* Allocate and initialise structures */
+	test = zalloc ( sizeof ( *test ) );
+	if ( ! test )
+		goto err_alloc_test;
+	snprintf ( test->dev.name, sizeof ( test->dev.name ), "testnet" );
+	test->dev.driver_name = "testnet";
+	INIT_LIST_HEAD ( &test->dev.children );
+	test->transmit = transmit;
+	test->poll = poll;
+	netdev = alloc_etherdev ( priv_len );
+	if ( ! netdev )
+		goto err_alloc_netdev;
+	netdev_init ( netdev, &testnet_operations );
+	netdev->dev = &test->dev;
+	eth_random_addr ( netdev->hw_addr );
+
+	/* Register and open network device */
+	if ( register_netdev ( netdev ) != 0 )
+		goto err_register;
+	if ( netdev_open ( netdev ) != 0 )
+		goto err_open;
+
+	return netdev;
+
+	netdev_close ( netdev );
+ err_open:
+	unregister_netdev ( netdev );
+ err_register:
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+ err_alloc_netdev:
+	free ( test );
+ err_alloc_test:
+	return NULL;
+}
+
+/**
+ * Close and remove test network device
+ *
+ * @v netdev		Network device
+ */
+void testnet_remove ( struct net_device *netdev ) {
+	struct testnet *test = testnet ( netdev );
+
+	netdev_close ( netdev );
+	unregister_netdev ( netdev );
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+	free ( test );
+}
@@ -0,0 +1,44 @@
+#ifndef _TESTNET_H
+#define _TESTNET_H
+
+/** @file
+ *
+ * Test network devices
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stddef.h>
+#include <ipxe/device.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+
+/** A test network device */
+struct testnet {
+	/** Underlying device */
+	struct device dev;
+	/** Inspect transmitted packet
+	 *
+	 * @v netdev		Network device
+	 * @v iobuf		I/O buffer
+	 *
+	 * The packet will be completed (and freed) on return.
+	 */
+	void ( * transmit ) ( struct net_device *netdev,
+			      struct io_buffer *iobuf );
+	/** Poll for received packets
+	 *
+	 * @v netdev		Network device
+	 */
+	void ( * poll ) ( struct net_device *netdev );
+};
+
+extern struct net_device *
+testnet_create ( size_t priv_len,
+		 void ( * transmit ) ( struct net_device *netdev,
+				       struct io_buffer *iobuf ),
+		 void ( * poll ) ( struct net_device *netdev ) );
+extern void testnet_remove ( struct net_device *netdev );
+
+#endif /* _TESTNET_H */
@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 PROVIDE_REQUIRING_SYMBOL();
 REQUIRE_OBJECT ( memset_test );
 REQUIRE_OBJECT ( memcpy_test );
+REQUIRE_OBJECT ( malloc_test );
 REQUIRE_OBJECT ( string_test );
 REQUIRE_OBJECT ( math_test );
 REQUIRE_OBJECT ( vsprintf_test );
@@ -62,12 +63,24 @@ REQUIRE_OBJECT ( pnm_test );
 REQUIRE_OBJECT ( deflate_test );
 REQUIRE_OBJECT ( png_test );
 REQUIRE_OBJECT ( dns_test );
+REQUIRE_OBJECT ( resolv_test );
 REQUIRE_OBJECT ( uri_test );
 REQUIRE_OBJECT ( profile_test );
 REQUIRE_OBJECT ( setjmp_test );
 REQUIRE_OBJECT ( pccrc_test );
 REQUIRE_OBJECT ( linebuf_test );
 REQUIRE_OBJECT ( iobuf_test );
+REQUIRE_OBJECT ( xferbuf_test );
+REQUIRE_OBJECT ( retry_test );
+REQUIRE_OBJECT ( process_test );
+REQUIRE_OBJECT ( trace_test );
+REQUIRE_OBJECT ( netdev_test );
+REQUIRE_OBJECT ( tcpqueue_test );
+REQUIRE_OBJECT ( tcp_test );
+REQUIRE_OBJECT ( demux_test );
+REQUIRE_OBJECT ( fragment_test );
+REQUIRE_OBJECT ( route_test );
+REQUIRE_OBJECT ( mtu_test );
 REQUIRE_OBJECT ( bitops_test );
 REQUIRE_OBJECT ( der_test );
 REQUIRE_OBJECT ( pem_test );
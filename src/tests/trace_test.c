@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Binary event trace self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/trace.h>
+#include <ipxe/test.h>
+
+/** Number of events in test trace ring */
+#define TRACE_TEST_SIZE 8
+
+/**
+ * Perform binary event trace self-tests
+ *
+ */
+static void trace_test_exec ( void ) {
+	struct trace_event events[TRACE_TEST_SIZE];
+	struct trace_ring ring;
+	struct trace_event *event;
+	unsigned long timestamp;
+	unsigned int seq;
+	unsigned int i;
+
+	/* Initialise ring */
+	memset ( events, 0, sizeof ( events ) );
+	memset ( &ring, 0, sizeof ( ring ) );
+	ring.events = events;
+	ring.size = TRACE_TEST_SIZE;
+
+	/* Empty ring should contain no events */
+	ok ( trace_ring_oldest ( &ring ) == 0 );
+	ok ( trace_ring_event ( &ring, 0 ) == NULL );
+
+	/* Record a few events */
+	timestamp = profile_timestamp();
+	for ( i = 0 ; i < 3 ; i++ )
+		trace_ring_record ( &ring, TRACE_TCP_RX, i, ( i + 1 ), 42 );
+	ok ( trace_ring_oldest ( &ring ) == 0 );
+	for ( seq = 0 ; seq < 3 ; seq++ ) {
+		event = trace_ring_event ( &ring, seq );
+		ok ( event != NULL );
+		ok ( event->id == TRACE_TCP_RX );
+		ok ( event->data[0] == seq );
+		ok ( event->data[1] == ( seq + 1 ) );
+		ok ( event->data[2] == 42 );
+		ok ( ( event->timestamp - timestamp ) <=
+		     ( profile_timestamp() - timestamp ) );
+	}
+	ok ( trace_ring_event ( &ring, 3 ) == NULL );
+
+	/* Wrap around ring, overwriting oldest events */
+	for ( i = 3 ; i < ( TRACE_TEST_SIZE + 5 ) ; i++ )
+		trace_ring_record ( &ring, TRACE_NETDEV_TX, i, 0, 0 );
+	seq = trace_ring_oldest ( &ring );
+	ok ( seq == 5 );
+	ok ( trace_ring_event ( &ring, ( seq - 1 ) ) == NULL );
+	for ( i = 0 ; ( event = trace_ring_event ( &ring, seq ) ) ; seq++ ) {
+		ok ( event->data[0] == seq );
+		i++;
+	}
+	ok ( i == TRACE_TEST_SIZE );
+
+	/* Check event names */
+	ok ( strcmp ( trace_name ( TRACE_NETDEV_RX ), "netdev_rx" ) == 0 );
+	ok ( strcmp ( trace_name ( TRACE_XFERBUF ), "xferbuf" ) == 0 );
+	ok ( strcmp ( trace_name ( 0 ), "unknown" ) == 0 );
+}
+
+/** Binary event trace self-test */
+struct self_test trace_test __self_test = {
+	.name = "trace",
+	.exec = trace_test_exec,
+};
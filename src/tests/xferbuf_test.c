@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Data transfer buffer self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/xfer.h>
+#include <ipxe/xferbuf.h>
+#include <ipxe/test.h>
+#include <ipxe/profile.h>
+
+/** Total length of simulated chunked download */
+#define XFERBUF_TEST_LEN ( 8 * 1024 * 1024 )
+
+/** Maximum packet length used in simulated download */
+#define XFERBUF_TEST_MTU 1460
+
+/** Number of reallocations */
+static unsigned int xferbuf_test_reallocs;
+
+/** Number of bytes copied by reallocations */
+static size_t xferbuf_test_copied;
+
+/**
+ * Reallocate data buffer (counting data copied)
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v len		New length (or zero to free buffer)
+ * @ret rc		Return status code
+ */
+static int xferbuf_test_realloc ( struct xfer_buffer *xferbuf, size_t len ) {
+
+	/* Any existing data may need to be copied by urealloc() */
+	xferbuf_test_reallocs++;
+	if ( len )
+		xferbuf_test_copied += xferbuf->len;
+
+	return xferbuf_umalloc_operations.realloc ( xferbuf, len );
+}
+
+/**
+ * Reallocate data buffer to exact length (counting data copied)
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v len		New length (or zero to free buffer)
+ * @ret rc		Return status code
+ */
+static int xferbuf_test_realloc_exact ( struct xfer_buffer *xferbuf,
+					size_t len ) {
+	userptr_t *udata = xferbuf->data;
+	userptr_t new_udata;
+
+	/* Any existing data may need to be copied by urealloc() */
+	xferbuf_test_reallocs++;
+	if ( len )
+		xferbuf_test_copied += xferbuf->len;
+
+	new_udata = urealloc ( *udata, len );
+	if ( len && ( ! new_udata ) )
+		return -ENOSPC;
+	*udata = new_udata;
+	return 0;
+}
+
+/** Data buffer operations with geometric growth */
+static struct xfer_buffer_operations xferbuf_test_operations = {
+	.realloc = xferbuf_test_realloc,
+};
+
+/** Data buffer operations with exact growth */
+static struct xfer_buffer_operations xferbuf_test_exact_operations = {
+	.realloc = xferbuf_test_realloc_exact,
+};
+
+/**
+ * Deliver data to data transfer buffer
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v offset		Absolute offset
+ * @v len		Length of data
+ * @ret rc		Return status code
+ */
+static int xferbuf_test_deliver ( struct xfer_buffer *xferbuf, size_t offset,
+				  size_t len ) {
+	struct xfer_metadata meta;
+	struct io_buffer *iobuf;
+	uint8_t *data;
+	size_t i;
+
+	/* Construct I/O buffer containing a recognisable pattern */
+	iobuf = alloc_iob ( len );
+	if ( ! iobuf )
+		return -ENOMEM;
+	data = iob_put ( iobuf, len );
+	for ( i = 0 ; i < len ; i++ )
+		data[i] = ( offset + i );
+
+	/* Deliver to buffer */
+	memset ( &meta, 0, sizeof ( meta ) );
+	meta.flags = XFER_FL_ABS_OFFSET;
+	meta.offset = offset;
+	return xferbuf_deliver ( xferbuf, iobuf, &meta );
+}
+
+/**
+ * Simulate a download into a data transfer buffer
+ *
+ * @v op		Data buffer operations
+ * @v presize		Total length is known in advance
+ * @v name		Test name
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void xferbuf_download_okx ( struct xfer_buffer_operations *op,
+				   int presize, const char *name,
+				   const char *file, unsigned int line ) {
+	struct xfer_buffer xferbuf;
+	userptr_t data = UNULL;
+	unsigned long elapsed;
+	size_t offset = 0;
+	size_t chunk_end;
+	size_t chunk_len;
+	size_t frag_len;
+	uint8_t buf[64];
+	unsigned int i;
+	unsigned int j;
+
+	/* Initialise buffer */
+	memset ( &xferbuf, 0, sizeof ( xferbuf ) );
+	xferbuf_umalloc_init ( &xferbuf, &data );
+	xferbuf.op = op;
+	xferbuf_test_reallocs = 0;
+	xferbuf_test_copied = 0;
+	elapsed = profile_timestamp();
+
+	/* Provide size hint, if applicable */
+	if ( presize ) {
+		okx ( xferbuf_test_deliver ( &xferbuf, XFERBUF_TEST_LEN,
+					     0 ) == 0, file, line );
+	}
+
+	/* Deliver data as a sequence of varying-length chunks, each
+	 * preceded by a size hint for the end of the chunk (as done
+	 * by the HTTP chunked transfer encoding).
+	 */
+	for ( i = 0 ; offset < XFERBUF_TEST_LEN ; i++ ) {
+		chunk_len = ( 2048 + ( ( i * 7919 ) % 30000 ) );
+		chunk_end = ( offset + chunk_len );
+		if ( chunk_end > XFERBUF_TEST_LEN )
+			chunk_end = XFERBUF_TEST_LEN;
+		if ( ! presize ) {
+			okx ( xferbuf_test_deliver ( &xferbuf, chunk_end,
+						     0 ) == 0, file, line );
+		}
+		while ( offset < chunk_end ) {
+			frag_len = ( chunk_end - offset );
+			if ( frag_len > XFERBUF_TEST_MTU )
+				frag_len = XFERBUF_TEST_MTU;
+			okx ( xferbuf_test_deliver ( &xferbuf, offset,
+						     frag_len ) == 0,
+			      file, line );
+			offset += frag_len;
+		}
+	}
+
+	/* Trim buffer */
+	okx ( xferbuf_trim ( &xferbuf ) == 0, file, line );
+	elapsed = ( profile_timestamp() - elapsed );
+	okx ( xferbuf.len == XFERBUF_TEST_LEN, file, line );
+	okx ( ( xferbuf.size == 0 ) || ( xferbuf.size == XFERBUF_TEST_LEN ),
+	      file, line );
+
+	/* Verify content at a selection of offsets */
+	for ( offset = 0 ; offset < XFERBUF_TEST_LEN ;
+	      offset += ( XFERBUF_TEST_LEN / 16 - 37 ) ) {
+		copy_from_user ( buf, data, offset, sizeof ( buf ) );
+		for ( j = 0 ; j < sizeof ( buf ) ; j++ ) {
+			okx ( buf[j] == ( ( uint8_t ) ( offset + j ) ),
+			      file, line );
+		}
+	}
+
+	DBG ( "XFERBUF %s: %d reallocations copied %zd bytes for %d-byte "
+	      "download in %ld ticks\n", name, xferbuf_test_reallocs,
+	      xferbuf_test_copied, XFERBUF_TEST_LEN, elapsed );
+
+	/* Free buffer */
+	xferbuf_free ( &xferbuf );
+}
+#define xferbuf_download_ok( op, presize, name ) \
+	xferbuf_download_okx ( op, presize, name, __FILE__, __LINE__ )
+
+/**
+ * Perform data transfer buffer self-tests
+ *
+ */
+static void xferbuf_test_exec ( void ) {
+
+	/* Use umalloc()-based buffer accessors */
+	xferbuf_test_operations.write = xferbuf_umalloc_operations.write;
+	xferbuf_test_operations.read = xferbuf_umalloc_operations.read;
+	xferbuf_test_exact_operations.write = xferbuf_umalloc_operations.write;
+	xferbuf_test_exact_operations.read = xferbuf_umalloc_operations.read;
+
+	/* Chunked download with exact reallocation (for comparison) */
+	xferbuf_download_ok ( &xferbuf_test_exact_operations, 0, "exact" );
+
+	/* Chunked download with geometric growth */
+	xferbuf_download_ok ( &xferbuf_test_operations, 0, "chunked" );
+	ok ( xferbuf_test_copied < ( 4 * XFERBUF_TEST_LEN ) );
+
+	/* Download with known length should never copy data */
+	xferbuf_download_ok ( &xferbuf_test_operations, 1, "presized" );
+	ok ( xferbuf_test_copied == 0 );
+}
+
+/** Data transfer buffer self-test */
+struct self_test xferbuf_test __self_test = {
+	.name = "xferbuf",
+	.exec = xferbuf_test_exec,
+};
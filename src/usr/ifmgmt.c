@@ -121,6 +121,20 @@ void ifstat ( struct net_device *netdev ) {
 		printf ( "  [Link status: %s]\n",
 			 strerror ( netdev->link_rc ) );
 	}
+	if ( netdev->rx_pool.hits || netdev->rx_pool.misses ) {
+		printf ( "  [RX pool: %u hits, %u misses]\n",
+			 netdev->rx_pool.hits, netdev->rx_pool.misses );
+	}
+	if ( netdev->rx_budget.repolls || netdev->rx_budget.exhausted ||
+	     netdev->rx_budget.overruns ) {
+		printf ( "  [RX budget: %u repolls, %u exhausted, %u overruns]\n",
+			 netdev->rx_budget.repolls, netdev->rx_budget.exhausted,
+			 netdev->rx_budget.overruns );
+	}
+	if ( netdev->rx_gro.packets ) {
+		printf ( "  [RX coalescing: %u segments in %u packets]\n",
+			 netdev->rx_gro.segments, netdev->rx_gro.packets );
+	}
 	ifstat_errors ( &netdev->tx_stats, "TXE" );
 	ifstat_errors ( &netdev->rx_stats, "RXE" );
 }
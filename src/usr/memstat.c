@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <ipxe/malloc.h>
+#include <usr/memstat.h>
+
+/** @file
+ *
+ * Memory usage statistics
+ *
+ */
+
+/**
+ * Print memory usage statistics
+ *
+ */
+void memstat ( void ) {
+
+	printf ( "Heap: %zdkB used (peak %zdkB), %zdkB free, %zdkB total "
+		 "(%u dynamic regions)\n", ( ( heapmem - freemem ) / 1024 ),
+		 ( maxusedmem / 1024 ), ( freemem / 1024 ), ( heapmem / 1024 ),
+		 heapregions );
+}
@@ -23,10 +23,12 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <byteswap.h>
 #include <ipxe/resolv.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/monojob.h>
 #include <ipxe/settings.h>
+#include <ipxe/dns.h>
 #include <usr/nslookup.h>
 
 /** @file
@@ -201,3 +203,25 @@ int nslookup ( const char *name, const char *setting_name ) {
 
 	return 0;
 }
+
+/**
+ * Print DNS cache statistics
+ *
+ */
+void nslookup_stat ( void ) {
+	struct dns_cache_entry *entry;
+	unsigned int entries = 0;
+
+	list_for_each_entry ( entry, &dns_cache, list ) {
+		printf ( "%s %s is %s (%lds)\n", entry->name,
+			 ( ( entry->qtype == htons ( DNS_TYPE_AAAA ) ) ?
+			   "AAAA" : "A" ),
+			 ( entry->rc ? "(negative)" :
+			   sock_ntoa ( &entry->address.sa ) ),
+			 dns_cache_remaining ( entry ) );
+		entries++;
+	}
+	printf ( "DNS cache: %d entries, %ld hits, %ld negative hits, "
+		 "%ld misses\n", entries, dns_cache_stats.hits,
+		 dns_cache_stats.negative, dns_cache_stats.misses );
+}
@@ -25,6 +25,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdio.h>
 #include <ipxe/profile.h>
+#include <ipxe/process.h>
 #include <usr/profstat.h>
 
 /** @file
@@ -33,6 +34,31 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/**
+ * Print profiler statistics
+ *
+ * @v profiler		Profiler
+ */
+static void profstat_print ( struct profiler *profiler ) {
+	unsigned long high;
+	unsigned long low;
+
+	/* vsprintf() cannot format a 64-bit decimal value, so split
+	 * the total into two parts of up to nine decimal digits each.
+	 */
+	high = ( profiler->total / 1000000000UL );
+	low = ( profiler->total % 1000000000UL );
+
+	printf ( "%s: %ld +/- %ld ticks (%d samples, ", profiler->name,
+		 profile_mean ( profiler ), profile_stddev ( profiler ),
+		 profiler->count );
+	if ( high ) {
+		printf ( "%lu%09lu total)\n", high, low );
+	} else {
+		printf ( "%lu total)\n", low );
+	}
+}
+
 /**
  * Print profiling statistics
  *
@@ -40,9 +66,33 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 void profstat ( void ) {
 	struct profiler *profiler;
 
-	for_each_table_entry ( profiler, PROFILERS ) {
-		printf ( "%s: %ld +/- %ld ticks (%d samples)\n",
-			 profiler->name, profile_mean ( profiler ),
-			 profile_stddev ( profiler ), profiler->count );
-	}
+	for_each_table_entry ( profiler, PROFILERS )
+		profstat_print ( profiler );
+}
+
+/**
+ * Print per-process profiling statistics
+ *
+ * Only processes that have been stepped with profiling enabled will
+ * be shown.
+ */
+void profstat_processes ( void ) {
+	struct process_descriptor *desc;
+
+	list_for_each_entry ( desc, &process_descriptors, list )
+		profstat_print ( &desc->profiler );
+}
+
+/**
+ * Reset all profiling statistics
+ *
+ */
+void profstat_reset ( void ) {
+	struct profiler *profiler;
+	struct process_descriptor *desc;
+
+	for_each_table_entry ( profiler, PROFILERS )
+		profile_reset ( profiler );
+	list_for_each_entry ( desc, &process_descriptors, list )
+		profile_reset ( &desc->profiler );
 }
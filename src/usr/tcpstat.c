@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <byteswap.h>
+#include <ipxe/socket.h>
+#include <ipxe/timer.h>
+#include <ipxe/tcp.h>
+#include <usr/tcpstat.h>
+
+/** @file
+ *
+ * TCP statistics
+ *
+ */
+
+/**
+ * Convert ticks to milliseconds
+ *
+ * @v ticks		Time (in ticks)
+ * @ret ms		Time (in milliseconds)
+ */
+static unsigned long tcpstat_ms ( unsigned long ticks ) {
+
+	return ( ( ticks * 1000 ) / TICKS_PER_SEC );
+}
+
+/**
+ * Print TCP statistics
+ *
+ */
+void tcpstat ( void ) {
+	struct tcp_info info;
+	unsigned int i;
+
+	for ( i = 0 ; tcp_connection_info ( i, &info ) == 0 ; i++ ) {
+		printf ( "TCP %d->%s:%d %s\n", info.local_port,
+			 sock_ntoa ( ( struct sockaddr * ) &info.peer ),
+			 ntohs ( info.peer.st_port ),
+			 tcp_state ( info.tcp_state ) );
+		printf ( "  SRTT:%ldms RTTVAR:%ldms RTO:%ldms\n",
+			 tcpstat_ms ( info.srtt ), tcpstat_ms ( info.rttvar ),
+			 tcpstat_ms ( info.rto ) );
+		printf ( "  RTT:%ldms MinRTT:%ldms Samples:%d Timeouts:%d\n",
+			 tcpstat_ms ( info.rtt ), tcpstat_ms ( info.rtt_min ),
+			 info.rtt_samples, info.timeouts );
+		printf ( "  Cwnd:%d Ssthresh:%d SndWin:%d FastRetrans:%d "
+			 "Retrans:%d FastOpen:%d\n", info.cwnd,
+			 info.ssthresh, info.snd_win, info.fast_retransmits,
+			 info.retransmits, info.fastopen );
+		printf ( "  RcvWin:%d RcvWinMax:%d\n",
+			 info.rcv_win, info.rcv_win_max );
+	}
+}
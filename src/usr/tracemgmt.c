@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <ipxe/trace.h>
+#include <ipxe/process.h>
+#include <ipxe/console.h>
+#include <ipxe/keys.h>
+#include <usr/tracemgmt.h>
+
+/** @file
+ *
+ * Binary event trace management
+ *
+ */
+
+/** Width of event name column */
+#define TRACE_NAME_WIDTH 9
+
+/**
+ * Print trace event
+ *
+ * @v event		Trace event
+ */
+static void trace_print ( struct trace_event *event ) {
+	const char *name = trace_name ( event->id );
+	int len;
+
+	/* Print event name, padded by hand since printf() does not
+	 * support left-justified fields.
+	 */
+	len = printf ( "%016lx %s", event->timestamp, name );
+	for ( ; len < ( 16 + 1 + TRACE_NAME_WIDTH ) ; len++ )
+		putchar ( ' ' );
+	printf ( " %#08lx %#08lx %#08lx\n", event->data[0],
+		 event->data[1], event->data[2] );
+}
+
+/**
+ * Print trace events
+ *
+ * @v seq		Sequence number of first event to print
+ * @ret seq		Sequence number of next event to print
+ */
+static unsigned int trace_print_from ( unsigned int seq ) {
+	struct trace_event *event;
+	unsigned int oldest = trace_ring_oldest ( &trace_ring );
+
+	/* Skip any events that have already been overwritten */
+	if ( ( ( signed int ) ( seq - oldest ) ) < 0 )
+		seq = oldest;
+
+	/* Print events */
+	for ( ; ( event = trace_ring_event ( &trace_ring, seq ) ) ; seq++ )
+		trace_print ( event );
+
+	return seq;
+}
+
+/**
+ * Print contents of trace ring
+ *
+ */
+void trace_show ( void ) {
+
+	trace_print_from ( trace_ring_oldest ( &trace_ring ) );
+}
+
+/**
+ * Print trace events as they are recorded
+ *
+ * Events are printed until a key is pressed.
+ */
+void trace_follow ( void ) {
+	unsigned int seq = trace_ring.prod;
+
+	while ( 1 ) {
+		seq = trace_print_from ( seq );
+		if ( iskey() ) {
+			getchar();
+			break;
+		}
+		step();
+	}
+}
+
+/**
+ * Discard contents of trace ring
+ *
+ */
+void trace_clear ( void ) {
+
+	trace_ring.prod = 0;
+}